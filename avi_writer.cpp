@@ -0,0 +1,164 @@
+#include "avi_writer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+template <typename T>
+void put(QByteArray& buf, T v) {
+    T le = qToLittleEndian(v);
+    buf.append(reinterpret_cast<const char*>(&le), sizeof(T));
+}
+
+void fourcc(QByteArray& buf, const char* cc) {
+    buf.append(cc, 4);
+}
+} // namespace
+
+AviWriter::~AviWriter() {
+    close();
+}
+
+QString AviWriter::open(const QString& path, int width, int height, double fps, bool grey) {
+    close();
+    if (width <= 0 || height <= 0 || fps <= 0.0) return "Invalid AVI geometry";
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return QString("Cannot open %1: %2").arg(path, file.errorString());
+    }
+    index.clear();
+    maxFrameBytes = 0;
+
+    const quint32 rateScale = 1000;
+    const quint32 rate = static_cast<quint32>(std::lround(fps * rateScale));
+
+    QByteArray h;
+    fourcc(h, "RIFF");
+    put<quint32>(h, 0);                   // patched on close
+    fourcc(h, "AVI ");
+    fourcc(h, "LIST");
+    put<quint32>(h, 4 + 8 + 56 + 8 + 4 + 8 + 56 + 8 + 40);
+    fourcc(h, "hdrl");
+
+    fourcc(h, "avih");
+    put<quint32>(h, 56);
+    put<quint32>(h, static_cast<quint32>(std::lround(1e6 / fps)));
+    put<quint32>(h, 0);                   // max bytes/s
+    put<quint32>(h, 0);                   // padding granularity
+    put<quint32>(h, 0x10);                // AVIF_HASINDEX
+    totalFramesPos = h.size();
+    put<quint32>(h, 0);                   // total frames, patched
+    put<quint32>(h, 0);                   // initial frames
+    put<quint32>(h, 1);                   // streams
+    suggestedBufPos = h.size();
+    put<quint32>(h, 0);                   // suggested buffer, patched
+    put<quint32>(h, static_cast<quint32>(width));
+    put<quint32>(h, static_cast<quint32>(height));
+    for (int i = 0; i < 4; ++i) put<quint32>(h, 0);
+
+    fourcc(h, "LIST");
+    put<quint32>(h, 4 + 8 + 56 + 8 + 40);
+    fourcc(h, "strl");
+    fourcc(h, "strh");
+    put<quint32>(h, 56);
+    fourcc(h, "vids");
+    fourcc(h, "MJPG");
+    put<quint32>(h, 0);                   // flags
+    put<quint16>(h, 0);                   // priority
+    put<quint16>(h, 0);                   // language
+    put<quint32>(h, 0);                   // initial frames
+    put<quint32>(h, rateScale);
+    put<quint32>(h, rate);
+    put<quint32>(h, 0);                   // start
+    lengthPos = h.size();
+    put<quint32>(h, 0);                   // length, patched
+    put<quint32>(h, 0);                   // suggested buffer
+    put<qint32>(h, -1);                   // quality
+    put<quint32>(h, 0);                   // sample size
+    put<qint16>(h, 0);
+    put<qint16>(h, 0);
+    put<qint16>(h, static_cast<qint16>(width));
+    put<qint16>(h, static_cast<qint16>(height));
+
+    fourcc(h, "strf");
+    put<quint32>(h, 40);
+    put<quint32>(h, 40);                  // BITMAPINFOHEADER
+    put<qint32>(h, width);
+    put<qint32>(h, height);
+    put<quint16>(h, 1);
+    put<quint16>(h, grey ? 8 : 24);
+    fourcc(h, "MJPG");
+    put<quint32>(h, static_cast<quint32>(width) * height * (grey ? 1 : 3));
+    put<qint32>(h, 0);
+    put<qint32>(h, 0);
+    put<quint32>(h, 0);
+    put<quint32>(h, 0);
+
+    fourcc(h, "LIST");
+    moviListPos = h.size();
+    put<quint32>(h, 0);                   // patched
+    fourcc(h, "movi");
+
+    if (file.write(h) != h.size()) return "AVI header write failed";
+    endPos = h.size();
+    return {};
+}
+
+qint64 AviWriter::projectedSize(qint64 jpegBytes) const {
+    qint64 chunk = 8 + jpegBytes + (jpegBytes & 1);
+    qint64 idx = 8 + 16LL * (index.size() + 1);
+    return endPos + chunk + idx;
+}
+
+QString AviWriter::addFrame(const QByteArray& jpeg) {
+    if (!file.isOpen()) return "AVI not open";
+    if (projectedSize(jpeg.size()) > kMaxBytes) return "AVI size limit reached";
+
+    QByteArray hdr;
+    fourcc(hdr, "00dc");
+    put<quint32>(hdr, static_cast<quint32>(jpeg.size()));
+    // idx1 offsets are relative to the 'movi' fourcc.
+    const qint64 moviStart = moviListPos + 4;
+    index.push_back({static_cast<quint32>(endPos - moviStart), static_cast<quint32>(jpeg.size())});
+    if (file.write(hdr) != hdr.size() || file.write(jpeg) != jpeg.size()) return "AVI frame write failed";
+    endPos += hdr.size() + jpeg.size();
+    if (jpeg.size() & 1) {
+        file.write("\0", 1);
+        ++endPos;
+    }
+    maxFrameBytes = std::max(maxFrameBytes, static_cast<quint32>(jpeg.size()));
+    return {};
+}
+
+QString AviWriter::close() {
+    if (!file.isOpen()) return {};
+
+    QByteArray idx;
+    fourcc(idx, "idx1");
+    put<quint32>(idx, static_cast<quint32>(index.size() * 16));
+    for (const IndexEntry& e : index) {
+        fourcc(idx, "00dc");
+        put<quint32>(idx, 0x10);          // AVIIF_KEYFRAME
+        put<quint32>(idx, e.offset);
+        put<quint32>(idx, e.size);
+    }
+    const qint64 moviEnd = endPos;
+    file.write(idx);
+    endPos += idx.size();
+
+    auto patch = [&](qint64 pos, quint32 v){
+        QByteArray b;
+        put<quint32>(b, v);
+        file.seek(pos);
+        file.write(b);
+    };
+    patch(4, static_cast<quint32>(endPos - 8));
+    patch(moviListPos, static_cast<quint32>(moviEnd - moviListPos - 4));
+    patch(totalFramesPos, static_cast<quint32>(index.size()));
+    patch(lengthPos, static_cast<quint32>(index.size()));
+    patch(suggestedBufPos, maxFrameBytes + 8);
+
+    file.close();
+    index.clear();
+    if (file.error() != QFileDevice::NoError) return file.errorString();
+    return {};
+}
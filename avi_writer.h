@@ -0,0 +1,35 @@
+#pragma once
+#include <QtCore>
+#include <vector>
+
+// Motion-JPEG AVI 1.0 muxer. Takes already encoded JPEG frames in order;
+// the header fields that depend on the frame count are patched on close.
+class AviWriter {
+public:
+    // AVI 1.0 offsets are 32-bit; keep well inside the 2 GB RIFF limit.
+    static constexpr qint64 kMaxBytes = 1900LL * 1024 * 1024;
+
+    ~AviWriter();
+
+    // grey: the JPEGs are single-channel, declared as 8 bits per pixel.
+    QString open(const QString& path, int width, int height, double fps, bool grey = false);
+    QString addFrame(const QByteArray& jpeg);
+    QString close();
+
+    qint64 bytesWritten() const { return endPos; }
+    int frameCount() const { return static_cast<int>(index.size()); }
+    // Size after adding a frame of the given length, including its index entry.
+    qint64 projectedSize(qint64 jpegBytes) const;
+
+private:
+    struct IndexEntry { quint32 offset; quint32 size; };
+
+    QFile file;
+    std::vector<IndexEntry> index;
+    qint64 endPos = 0;
+    qint64 moviListPos = 0;     // LIST size field of 'movi'
+    qint64 totalFramesPos = 0;  // avih.dwTotalFrames
+    qint64 lengthPos = 0;       // strh.dwLength
+    qint64 suggestedBufPos = 0; // avih.dwSuggestedBufferSize
+    quint32 maxFrameBytes = 0;
+};
@@ -0,0 +1,244 @@
+#include "bleach_corrector.h"
+#include "frame_sequence.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace {
+QImage toGray(const QImage& img) {
+    if (img.format() == QImage::Format_Grayscale8 || img.format() == QImage::Format_Grayscale16) return img;
+    return img.convertToFormat(img.depth() == 16 ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+}
+
+double regionMean(const QImage& img, const QRect& r) {
+    uint64_t sum = 0;
+    for (int y = r.top(); y <= r.bottom(); ++y) {
+        if (img.format() == QImage::Format_Grayscale16) {
+            uint64_t rowSum = 0, rowSq = 0;
+            simd::momentsU16(reinterpret_cast<const uint16_t*>(img.constScanLine(y)) + r.left(),
+                             static_cast<size_t>(r.width()), rowSum, rowSq);
+            sum += rowSum;
+        } else {
+            const uchar* row = img.constScanLine(y) + r.left();
+            for (int x = 0; x < r.width(); ++x) sum += row[x];
+        }
+    }
+    return static_cast<double>(sum) / (static_cast<double>(r.width()) * r.height());
+}
+
+// Least-squares slope of ln(v) against t, as a decay rate: ln(v) = a - rate t.
+double fitRate(double n, double st, double stt, double sy, double sty) {
+    const double den = n * stt - st * st;
+    return den > 0.0 ? -(n * sty - st * sy) / den : 0.0;
+}
+
+// Rescales the signal above offset in columns [x0, x0 + w) of one row:
+// v' = offset + (v - offset) * gain. The 16-bit path is the flat-field
+// kernel, with dark = offset - offset / gain filled in by the caller.
+void rescaleRow(QImage& img, int y, int x0, int w, const float* gain, const float* dark, float offset) {
+    if (img.format() == QImage::Format_Grayscale16) {
+        uint16_t* row = reinterpret_cast<uint16_t*>(img.scanLine(y)) + x0;
+        simd::calibrateU16(row, dark, gain, row, static_cast<size_t>(w));
+    } else {
+        uchar* row = img.scanLine(y) + x0;
+        for (int x = 0; x < w; ++x) {
+            const float v = offset + (row[x] - offset) * gain[x];
+            row[x] = static_cast<uchar>(std::clamp(static_cast<int>(v + 0.5f), 0, 255));
+        }
+    }
+}
+} // namespace
+
+QString BleachCorrector::modelName(BleachOptions::Model m) {
+    switch (m) {
+    case BleachOptions::Model::FrameMean: return "frame mean";
+    case BleachOptions::Model::MeanExponential: return "mean exponential";
+    case BleachOptions::Model::PixelExponential: return "per-pixel exponential";
+    }
+    return {};
+}
+
+QString BleachCorrector::run(const QString& sourcePath, const BleachOptions& opt,
+                             const Progress& progress, const std::atomic<bool>* cancel) {
+    FrameSequence src(64);
+    QString err = src.open(sourcePath);
+    if (!err.isEmpty()) return err;
+    if (!src.isOpen()) return "No frames in " + sourcePath;
+    const int n = src.count();
+    const int first = std::clamp(opt.output.first, 0, n - 1);
+    const int step = std::max(1, opt.output.step);
+    const int total = SequenceExporter::frameCount(opt.output, n);
+    const int threads = opt.output.threads > 0 ? opt.output.threads : std::max(1, QThread::idealThreadCount());
+    QImage probe = toGray(src.read(first, &err));
+    if (probe.isNull()) return err;
+    const QRect measure = opt.measureRoi.isEmpty() ? probe.rect() : opt.measureRoi.intersected(probe.rect());
+    const QRect region = opt.output.roi.isEmpty() ? probe.rect() : opt.output.roi.intersected(probe.rect());
+    if (measure.isEmpty() || region.isEmpty()) return "ROI does not intersect the frame";
+
+    const FrameTimeline& tl = src.timeline();
+    auto timeOf = [&](int idx){ return tl.isEmpty() ? static_cast<double>(idx) : tl.timeAt(idx); };
+    const double t0 = timeOf(first);
+    const float offset = static_cast<float>(opt.offset);
+    const float maxGain = static_cast<float>(std::max(1.0, opt.maxGain));
+    auto clampGain = [maxGain](double g){ return std::clamp(static_cast<float>(g), 1.0f / maxGain, maxGain); };
+    const bool twoPass = opt.model != BleachOptions::Model::FrameMean;
+    const int progressTotal = twoPass ? 2 * total : total;
+    const int progressEvery = std::max(1, total / 200);
+    std::atomic<int> done{0};
+    std::mutex mutex;
+
+    // Statistics pass. Frames are read in chunks of a few per thread, so
+    // memory is bounded by the chunk and the per-pixel sums.
+    std::vector<double> means(total, 0.0);
+    std::vector<float> rates;
+    double meanRate = 0.0;
+    if (opt.model == BleachOptions::Model::MeanExponential) {
+        parallelBands(total, threads, [&](int k0, int k1) {
+            for (int k = k0; k < k1; ++k) {
+                if (cancel && cancel->load()) return;
+                QString readErr;
+                QImage img = toGray(src.read(first + k * step, &readErr));
+                if (img.isNull() || img.size() != probe.size()) {
+                    std::lock_guard<std::mutex> lk(mutex);
+                    if (err.isEmpty()) err = QString("Frame %1: %2").arg(first + k * step)
+                                                 .arg(img.isNull() ? readErr : QString("size differs from the first frame"));
+                    return;
+                }
+                means[k] = regionMean(img, measure);
+                const int d = ++done;
+                if (progress && (d % progressEvery == 0 || d == total)) progress(d, progressTotal);
+            }
+        }, 4);
+        double cnt = 0.0, st = 0.0, stt = 0.0, sy = 0.0, sty = 0.0;
+        for (int k = 0; k < total; ++k) {
+            if (means[k] - offset < 1.0) continue;
+            const double t = timeOf(first + k * step) - t0;
+            const double y = std::log(means[k] - offset);
+            cnt += 1.0;
+            st += t;
+            stt += t * t;
+            sy += y;
+            sty += t * y;
+        }
+        meanRate = fitRate(cnt, st, stt, sy, sty);
+    } else if (opt.model == BleachOptions::Model::PixelExponential) {
+        const size_t pixels = static_cast<size_t>(region.width()) * region.height();
+        std::vector<double> sumY(pixels, 0.0), sumTY(pixels, 0.0);
+        double st = 0.0, stt = 0.0;
+        const int chunk = 2 * threads;
+        std::vector<QImage> frames(chunk);
+        std::vector<double> times(chunk);
+        for (int c0 = 0; c0 < total && err.isEmpty(); c0 += chunk) {
+            if (cancel && cancel->load()) break;
+            const int count = std::min(chunk, total - c0);
+            parallelBands(count, threads, [&](int i0, int i1) {
+                for (int i = i0; i < i1; ++i) {
+                    const int idx = first + (c0 + i) * step;
+                    QString readErr;
+                    frames[i] = toGray(src.read(idx, &readErr));
+                    times[i] = timeOf(idx) - t0;
+                    if (frames[i].isNull() || frames[i].size() != probe.size()) {
+                        std::lock_guard<std::mutex> lk(mutex);
+                        if (err.isEmpty()) err = QString("Frame %1: %2").arg(idx)
+                                                     .arg(frames[i].isNull() ? readErr : QString("size differs from the first frame"));
+                    }
+                }
+            }, 1);
+            if (!err.isEmpty()) break;
+            // Row bands own disjoint slices of the sums, so no locking.
+            parallelBands(region.height(), threads, [&](int y0, int y1) {
+                for (int i = 0; i < count; ++i) {
+                    const bool deep = frames[i].format() == QImage::Format_Grayscale16;
+                    const float t = static_cast<float>(times[i]);
+                    for (int y = y0; y < y1; ++y) {
+                        const uchar* line = frames[i].constScanLine(region.top() + y);
+                        double* sy = sumY.data() + static_cast<size_t>(y) * region.width();
+                        double* sty = sumTY.data() + static_cast<size_t>(y) * region.width();
+                        for (int x = 0; x < region.width(); ++x) {
+                            const float v = deep ? reinterpret_cast<const uint16_t*>(line)[region.left() + x]
+                                                 : line[region.left() + x];
+                            const float l = std::log(std::max(1.0f, v - offset));
+                            sy[x] += l;
+                            sty[x] += t * l;
+                        }
+                    }
+                }
+            });
+            for (int i = 0; i < count; ++i) {
+                st += times[i];
+                stt += times[i] * times[i];
+                frames[i] = QImage();
+            }
+            const int d = done += count;
+            if (progress) progress(d, progressTotal);
+        }
+        if (cancel && cancel->load()) return "Correction cancelled";
+        if (!err.isEmpty()) return err;
+        rates.resize(pixels);
+        for (size_t i = 0; i < pixels; ++i) rates[i] = static_cast<float>(fitRate(total, st, stt, sumY[i], sumTY[i]));
+    }
+    if (cancel && cancel->load()) return "Correction cancelled";
+    if (!err.isEmpty()) return err;
+
+    // Writing pass, with the correction applied on the exporter's workers.
+    const double reference = regionMean(probe, measure) - offset;
+    std::vector<float> gains(total, 1.0f);
+    ExportOptions out = opt.output;
+    out.filter = [&](int idx, QImage& img) -> QString {
+        if (img.size() != probe.size()) return "size differs from the first frame";
+        const int k = (idx - first) / step;
+        const double dt = timeOf(idx) - t0;
+        std::vector<float> gain(region.width()), dark(region.width());
+        if (opt.model == BleachOptions::Model::PixelExponential) {
+            for (int y = 0; y < region.height(); ++y) {
+                const float* rate = rates.data() + static_cast<size_t>(y) * region.width();
+                for (int x = 0; x < region.width(); ++x) {
+                    gain[x] = clampGain(std::exp(rate[x] * dt));
+                    dark[x] = offset - offset / gain[x];
+                }
+                rescaleRow(img, region.top() + y, region.left(), region.width(), gain.data(), dark.data(), offset);
+            }
+            return {};
+        }
+        float g = 1.0f;
+        if (opt.model == BleachOptions::Model::FrameMean) {
+            // Statistics and correction in the same pass over the frame.
+            means[k] = regionMean(img, measure);
+            const double signal = means[k] - offset;
+            g = (signal >= 1.0 && reference >= 1.0) ? clampGain(reference / signal) : 1.0f;
+        } else {
+            g = clampGain(std::exp(meanRate * dt));
+        }
+        gains[k] = g;
+        std::fill(gain.begin(), gain.end(), g);
+        std::fill(dark.begin(), dark.end(), offset - offset / g);
+        for (int y = region.top(); y <= region.bottom(); ++y) {
+            rescaleRow(img, y, region.left(), region.width(), gain.data(), dark.data(), offset);
+        }
+        return {};
+    };
+    const int base = twoPass ? total : 0;
+    err = SequenceExporter::run(sourcePath, out, [&](int d, int){ if (progress) progress(base + d, progressTotal); }, cancel);
+    if (!err.isEmpty()) return err;
+
+    if (opt.model != BleachOptions::Model::PixelExponential) {
+        const QString csvPath = opt.output.format == ExportOptions::Format::TiffSequence
+            ? QDir(opt.output.outputPath).filePath("bleach.csv")
+            : FrameSequence::sidecarPath(opt.output.outputPath, "_bleach.csv");
+        QFile f(csvPath);
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return f.errorString();
+        QTextStream csv(&f);
+        csv << "index,time_s,roi_mean_dn,gain\n";
+        for (int k = 0; k < total; ++k) {
+            const int idx = first + k * step;
+            csv << idx << "," << QString::number(timeOf(idx), 'f', 6) << "," << QString::number(means[k], 'f', 3) << ","
+                << QString::number(gains[k], 'f', 5) << "\n";
+        }
+        csv.flush();
+        if (f.error() != QFileDevice::NoError) return f.errorString();
+    }
+    qInfo() << "Bleach correction" << modelName(opt.model) << "of" << total << "frames to" << opt.output.outputPath;
+    return {};
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <QtCore>
+#include <atomic>
+#include <functional>
+#include "sequence_exporter.h"
+
+struct BleachOptions {
+    enum class Model {
+        FrameMean,          // each frame scaled by its own ROI mean, one pass
+        MeanExponential,    // one exponential fitted to the ROI mean curve
+        PixelExponential    // an exponential per pixel
+    };
+
+    ExportOptions output;       // range, crop, format and threads of the written sequence
+    Model model = Model::MeanExponential;
+    QRect measureRoi;           // mean models: where the curve is measured, empty = full frame
+    int offset = 100;           // camera offset, DN; only the signal above it is rescaled
+    double maxGain = 10.0;      // per-pixel gains are clamped to [1/maxGain, maxGain]
+};
+
+// Photobleaching correction of a recording range. Intensities above the
+// offset are rescaled so the fitted decay is flat at the level of the first
+// frame, and the result is written through the sequence exporter's
+// pipeline. The exponential models take a statistics pass first: the mean
+// curve, or per-pixel sums of log intensity for a log-linear fit, which is
+// two doubles per pixel however long the recording is. Frames are streamed
+// in chunks, decoded in parallel and reduced over row bands.
+class BleachCorrector {
+public:
+    using Progress = std::function<void(int done, int total)>;
+
+    // Also writes the measured curve and applied gain as a "_bleach.csv"
+    // sidecar (bleach.csv inside a TIFF folder) for the mean models.
+    static QString run(const QString& sourcePath, const BleachOptions& opt,
+                       const Progress& progress = {}, const std::atomic<bool>* cancel = nullptr);
+    static QString modelName(BleachOptions::Model m);
+};
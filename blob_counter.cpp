@@ -0,0 +1,334 @@
+#include "blob_counter.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace {
+struct Run {
+    int y;          // ROI row
+    int x0;         // ROI columns [x0, x1)
+    int x1;
+};
+
+int findRoot(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// The lower index becomes the root, so labels come out in scan order.
+void unite(std::vector<int>& parent, int a, int b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) parent[b] = a;
+    else if (b < a) parent[a] = b;
+}
+
+// Foreground runs of one mask row. Background and foreground are skipped
+// eight bytes at a time, so sparse and solid rows both scan quickly.
+void appendRuns(const uint8_t* mask, int w, int y, std::vector<Run>& runs) {
+    int x = 0;
+    while (x < w) {
+        uint64_t word;
+        while (x + 8 <= w && (std::memcpy(&word, mask + x, 8), word == 0)) x += 8;
+        while (x < w && !mask[x]) ++x;
+        if (x >= w) break;
+        const int start = x;
+        while (x + 8 <= w && (std::memcpy(&word, mask + x, 8), word == ~uint64_t(0))) x += 8;
+        while (x < w && mask[x]) ++x;
+        runs.push_back({y, start, x});
+    }
+}
+
+// Joins 8-connected runs of two consecutive rows, both sorted by x. The
+// run that ends first cannot reach any later run of the other row.
+void connectRows(const Run* above, int na, int aBase, const Run* below, int nb, int bBase, std::vector<int>& parent) {
+    int i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (above[i].x0 <= below[j].x1 && below[j].x0 <= above[i].x1) unite(parent, aBase + i, bBase + j);
+        if (above[i].x1 < below[j].x1) ++i;
+        else ++j;
+    }
+}
+
+struct Band {
+    int y0 = 0;
+    int y1 = 0;
+    std::vector<Run> runs;
+    std::vector<int> rowStart;      // first run of each row, plus the end
+    std::vector<int> parent;        // band-local union-find
+};
+} // namespace
+
+BlobCounter::BlobCounter(QObject* parent)
+    : LiveAnalyzer(parent), ring(kTraceLength), logging(false), logged(0) {}
+
+BlobCounter::~BlobCounter() {
+    stopAnalysis();
+    stopLog();
+}
+
+void BlobCounter::setSettings(const Settings& s) {
+    QMutexLocker lk(&resultMutex);
+    current = s;
+}
+
+BlobCounter::Settings BlobCounter::settings() const {
+    QMutexLocker lk(&resultMutex);
+    return current;
+}
+
+void BlobCounter::clearResults() {
+    QMutexLocker lk(&resultMutex);
+    head = 0;
+    filled = 0;
+    found.clear();
+}
+
+std::vector<BlobCounter::Sample> BlobCounter::trace(int maxSamples) const {
+    QMutexLocker lk(&resultMutex);
+    const int n = std::min(filled, std::max(0, maxSamples));
+    std::vector<Sample> out;
+    out.reserve(n);
+    for (int k = n; k > 0; --k) out.push_back(ring[(head - k + kTraceLength) % kTraceLength]);
+    return out;
+}
+
+bool BlobCounter::hasSamples() const {
+    QMutexLocker lk(&resultMutex);
+    return filled > 0;
+}
+
+BlobCounter::Sample BlobCounter::latest() const {
+    QMutexLocker lk(&resultMutex);
+    return filled ? ring[(head - 1 + kTraceLength) % kTraceLength] : Sample();
+}
+
+std::vector<BlobCounter::Blob> BlobCounter::blobs() const {
+    QMutexLocker lk(&resultMutex);
+    return found;
+}
+
+QString BlobCounter::startLog(const QString& path) {
+    QMutexLocker lk(&logMutex);
+    if (logFile.isOpen()) logFile.close();
+    logFile.setFileName(path);
+    if (!logFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return logFile.errorString();
+    logStream.setDevice(&logFile);
+    logStream << "framestamp,time_s,threshold,count,blob,x,y,area\n";
+    logged = 0;
+    logging = true;
+    return {};
+}
+
+void BlobCounter::stopLog() {
+    QMutexLocker lk(&logMutex);
+    logging = false;
+    if (!logFile.isOpen()) return;
+    logStream.flush();
+    logStream.setDevice(nullptr);
+    logFile.close();
+}
+
+void BlobCounter::analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) {
+    const Settings s = settings();
+    Sample smp;
+    smp.time = meta.timestamp;
+    smp.framestamp = meta.framestamp;
+    smp.threshold = s.otsu ? otsuThreshold(img, roi, workThreads) : s.threshold;
+    std::vector<Blob> blobs;
+    segment(img, roi, smp.threshold, s, workThreads, blobs);
+    smp.count = static_cast<int>(blobs.size());
+    double area = 0.0;
+    for (const Blob& b : blobs) area += b.area;
+    smp.meanArea = blobs.empty() ? 0.0 : area / blobs.size();
+
+    if (logging.load()) {
+        QMutexLocker lk(&logMutex);
+        if (logFile.isOpen()) {
+            const QString prefix = QString("%1,%2,%3,%4,").arg(smp.framestamp).arg(smp.time, 0, 'f', 6)
+                                       .arg(smp.threshold).arg(smp.count);
+            // A frame without blobs still gets a row, so counts of zero are logged.
+            if (blobs.empty()) logStream << prefix << ",,,\n";
+            // Positions and areas in sensor pixels, like a recording.
+            const SoftwareBinning::Settings bin = binning();
+            for (size_t i = 0; i < blobs.size(); ++i) {
+                logStream << prefix << i << "," << QString::number(bin.sensorX(blobs[i].x), 'f', 2) << ","
+                          << QString::number(bin.sensorY(blobs[i].y), 'f', 2) << ","
+                          << static_cast<qint64>(blobs[i].area) * bin.pixels() << "\n";
+            }
+            ++logged;
+        }
+    }
+
+    QMutexLocker lk(&resultMutex);
+    ring[head] = smp;
+    head = (head + 1) % kTraceLength;
+    filled = std::min(filled + 1, kTraceLength);
+    found = std::move(blobs);
+}
+
+int BlobCounter::otsuThreshold(const QImage& img, const QRect& roi, int threads) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    // 16 DN bins for 16-bit data: 12-bit data still gets 256 of them.
+    const int shift = deep ? 4 : 0;
+    const int bins = deep ? 4096 : 256;
+    std::vector<uint64_t> hist(bins, 0);
+    std::mutex merge;
+    const int rows = (roi.height() + 1) / 2;
+    parallelBands(rows, threads, [&](int r0, int r1) {
+        std::vector<uint32_t> local(bins, 0);
+        for (int r = r0; r < r1; ++r) {
+            const uchar* line = src.constScanLine(roi.top() + 2 * r);
+            if (deep) {
+                const uint16_t* row = reinterpret_cast<const uint16_t*>(line) + roi.left();
+                for (int x = 0; x < roi.width(); ++x) ++local[row[x] >> shift];
+            } else {
+                const uchar* row = line + roi.left();
+                for (int x = 0; x < roi.width(); ++x) ++local[row[x]];
+            }
+        }
+        std::lock_guard<std::mutex> lk(merge);
+        for (int k = 0; k < bins; ++k) hist[k] += local[k];
+    });
+
+    // Maximise the between-class variance w0 w1 (m0 - m1)^2 over cuts after bin k.
+    double total = 0.0, sum = 0.0;
+    for (int k = 0; k < bins; ++k) {
+        total += static_cast<double>(hist[k]);
+        sum += static_cast<double>(k) * hist[k];
+    }
+    double w0 = 0.0, s0 = 0.0, best = -1.0;
+    int cut = 0;
+    for (int k = 0; k + 1 < bins; ++k) {
+        w0 += static_cast<double>(hist[k]);
+        s0 += static_cast<double>(k) * hist[k];
+        const double w1 = total - w0;
+        if (w0 == 0.0) continue;
+        if (w1 == 0.0) break;
+        const double d = s0 / w0 - (sum - s0) / w1;
+        const double between = w0 * w1 * d * d;
+        if (between > best) {
+            best = between;
+            cut = k;
+        }
+    }
+    return (cut + 1) << shift;
+}
+
+void BlobCounter::segment(const QImage& img, const QRect& roi, int threshold, const Settings& s, int threads,
+                          std::vector<Blob>& out) {
+    out.clear();
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    const int w = roi.width();
+    const int h = roi.height();
+    if (w <= 0 || h <= 0) return;
+
+    // One band per thread, each labelled on its own.
+    const int nb = std::clamp(std::min(threads, h / 64), 1, h);
+    std::vector<Band> bands(nb);
+    for (int b = 0; b < nb; ++b) {
+        bands[b].y0 = static_cast<int>(static_cast<long long>(h) * b / nb);
+        bands[b].y1 = static_cast<int>(static_cast<long long>(h) * (b + 1) / nb);
+    }
+    parallelBands(nb, nb, [&](int b0, int b1) {
+        std::vector<uint8_t> mask(w);
+        std::vector<uint16_t> widened(deep ? 0 : w);
+        for (int b = b0; b < b1; ++b) {
+            Band& band = bands[b];
+            band.rowStart.reserve(band.y1 - band.y0 + 1);
+            for (int y = band.y0; y < band.y1; ++y) {
+                const uchar* line = src.constScanLine(roi.top() + y);
+                const uint16_t* row = nullptr;
+                if (deep) {
+                    row = reinterpret_cast<const uint16_t*>(line) + roi.left();
+                } else {
+                    simd::widenU8ToU16(line + roi.left(), widened.data(), static_cast<size_t>(w));
+                    row = widened.data();
+                }
+                simd::thresholdU16(row, mask.data(), static_cast<size_t>(w), threshold, s.dark);
+                const int start = static_cast<int>(band.runs.size());
+                band.rowStart.push_back(start);
+                appendRuns(mask.data(), w, y, band.runs);
+                const int end = static_cast<int>(band.runs.size());
+                for (int i = start; i < end; ++i) band.parent.push_back(i);
+                if (y > band.y0) {
+                    const int prev = band.rowStart[y - band.y0 - 1];
+                    connectRows(band.runs.data() + prev, start - prev, prev,
+                                band.runs.data() + start, end - start, start, band.parent);
+                }
+            }
+            band.rowStart.push_back(static_cast<int>(band.runs.size()));
+        }
+    }, 1);
+
+    // Merge: one union-find over all runs, then join across band edges.
+    std::vector<int> offset(nb + 1, 0);
+    for (int b = 0; b < nb; ++b) offset[b + 1] = offset[b] + static_cast<int>(bands[b].runs.size());
+    const int total = offset[nb];
+    std::vector<int> parent(total);
+    std::vector<Run> runs;
+    runs.reserve(total);
+    for (int b = 0; b < nb; ++b) {
+        for (size_t i = 0; i < bands[b].parent.size(); ++i) parent[offset[b] + i] = bands[b].parent[i] + offset[b];
+        runs.insert(runs.end(), bands[b].runs.begin(), bands[b].runs.end());
+    }
+    for (int b = 1; b < nb; ++b) {
+        const Band& up = bands[b - 1];
+        const Band& down = bands[b];
+        const int rowsUp = up.y1 - up.y0;
+        const int a0 = offset[b - 1] + up.rowStart[rowsUp - 1];
+        const int a1 = offset[b - 1] + up.rowStart[rowsUp];
+        const int b0 = offset[b] + down.rowStart[0];
+        const int b1 = offset[b] + down.rowStart[1];
+        connectRows(runs.data() + a0, a1 - a0, a0, runs.data() + b0, b1 - b0, b0, parent);
+    }
+
+    // Per-component moments, in scan order of the first run.
+    struct Acc {
+        long long area = 0;
+        double sx = 0.0, sy = 0.0;
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;     // inclusive box
+        bool edge = false;
+    };
+    std::vector<int> slot(total, -1);
+    std::vector<Acc> acc;
+    for (int i = 0; i < total; ++i) {
+        const int root = findRoot(parent, i);
+        const Run& r = runs[i];
+        if (slot[root] < 0) {
+            slot[root] = static_cast<int>(acc.size());
+            Acc a;
+            a.x0 = r.x0;
+            a.x1 = r.x1 - 1;
+            a.y0 = a.y1 = r.y;
+            acc.push_back(a);
+        }
+        Acc& a = acc[slot[root]];
+        const long long len = r.x1 - r.x0;
+        a.area += len;
+        a.sx += 0.5 * static_cast<double>(r.x0 + r.x1 - 1) * len;
+        a.sy += static_cast<double>(r.y) * len;
+        a.x0 = std::min(a.x0, r.x0);
+        a.x1 = std::max(a.x1, r.x1 - 1);
+        a.y0 = std::min(a.y0, r.y);
+        a.y1 = std::max(a.y1, r.y);
+        a.edge = a.edge || r.x0 == 0 || r.x1 == w || r.y == 0 || r.y == h - 1;
+    }
+    out.reserve(acc.size());
+    for (const Acc& a : acc) {
+        if (a.area < s.minArea || (s.maxArea > 0 && a.area > s.maxArea) || (s.excludeEdges && a.edge)) continue;
+        Blob blob;
+        blob.area = static_cast<int>(a.area);
+        blob.x = static_cast<float>(roi.left() + a.sx / a.area);
+        blob.y = static_cast<float>(roi.top() + a.sy / a.area);
+        blob.box = QRect(QPoint(roi.left() + a.x0, roi.top() + a.y0), QPoint(roi.left() + a.x1, roi.top() + a.y1));
+        out.push_back(blob);
+    }
+}
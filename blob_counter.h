@@ -0,0 +1,80 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <vector>
+#include "live_analyzer.h"
+
+// Live cell / particle counting: threshold the ROI (fixed, or Otsu from
+// its histogram every frame), label 8-connected components and report the
+// count, areas and centroids. Labelling works on runs of foreground pixels:
+// row bands are scanned in parallel, runs that touch the run above are
+// joined in a union-find, and a final step joins the runs across band edges.
+class BlobCounter : public LiveAnalyzer {
+    Q_OBJECT
+public:
+    struct Settings {
+        bool otsu = true;
+        int threshold = 1000;       // fixed threshold, DN
+        bool dark = false;          // objects below the threshold
+        int minArea = 4;            // pixels; smaller blobs are noise
+        int maxArea = 0;            // 0 = no limit
+        bool excludeEdges = false;  // drop blobs touching the ROI border
+    };
+    struct Blob {
+        float x = 0.0f;             // centroid, frame pixels
+        float y = 0.0f;
+        int area = 0;               // pixels
+        QRect box;
+    };
+    struct Sample {
+        double time = 0.0;          // camera timestamp, seconds
+        qint64 framestamp = 0;
+        int threshold = 0;          // as applied, DN
+        int count = 0;
+        double meanArea = 0.0;
+    };
+
+    explicit BlobCounter(QObject* parent=nullptr);
+    ~BlobCounter() override;
+
+    void setSettings(const Settings& s);
+    Settings settings() const;
+
+    std::vector<Sample> trace(int maxSamples) const;
+    bool hasSamples() const;
+    Sample latest() const;
+    std::vector<Blob> blobs() const;
+
+    // Logs every blob of every analysed frame: framestamp, time, x, y, area,
+    // with positions and areas in sensor pixels under software binning.
+    QString startLog(const QString& path);
+    void stopLog();
+    bool isLogging() const { return logging.load(); }
+    qint64 loggedFrames() const { return logged.load(); }
+
+    // Otsu threshold of the ROI histogram (every other row), in DN.
+    static int otsuThreshold(const QImage& img, const QRect& roi, int threads);
+    static void segment(const QImage& img, const QRect& roi, int threshold, const Settings& s, int threads,
+                        std::vector<Blob>& out);
+
+protected:
+    void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) override;
+    void clearResults() override;
+
+private:
+    static constexpr int kTraceLength = 4096;
+
+    mutable QMutex resultMutex;
+    Settings current;
+    std::vector<Sample> ring;   // kTraceLength slots
+    int head = 0;
+    int filled = 0;
+    std::vector<Blob> found;
+
+    QMutex logMutex;
+    QFile logFile;
+    QTextStream logStream;
+    std::atomic<bool> logging;
+    std::atomic<qint64> logged;
+};
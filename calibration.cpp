@@ -0,0 +1,129 @@
+#include "calibration.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr char kMagic[8] = {'D','C','C','A','L','0','1','\0'};
+constexpr int kTileRows = 16;   // a 2304-wide tile of maps and rows stays within L2
+}
+
+void Calibration::reset(const QSize& size) {
+    mapSize = size;
+    const size_t n = static_cast<size_t>(size.width()) * size.height();
+    offset.assign(n, 0.0f);
+    gain.assign(n, 1.0f);
+    dark = false;
+    flat = false;
+}
+
+void Calibration::setDark(const QSize& size, std::vector<float> mean) {
+    if (size != mapSize) reset(size);
+    offset = std::move(mean);
+    dark = true;
+}
+
+QString Calibration::setFlat(const QSize& size, const std::vector<float>& mean) {
+    if (size != mapSize) reset(size);
+    const size_t n = offset.size();
+    if (mean.size() != n) return "Flat stack does not match the frame size";
+    double total = 0.0;
+    size_t valid = 0;
+    for (size_t i = 0; i < n; ++i) {
+        float signal = mean[i] - offset[i];
+        if (signal > 0.0f) {
+            total += signal;
+            ++valid;
+        }
+    }
+    if (valid == 0) return "Flat stack has no signal above the dark level";
+    const float level = static_cast<float>(total / valid);
+    // Unlit or dead pixels keep unit gain rather than blowing up.
+    for (size_t i = 0; i < n; ++i) {
+        float signal = mean[i] - offset[i];
+        gain[i] = signal > level * 0.05f ? std::clamp(level / signal, 0.1f, 10.0f) : 1.0f;
+    }
+    flat = true;
+    return {};
+}
+
+QImage Calibration::apply(const QImage& raw, int threads) const {
+    if (!matches(raw)) return raw;
+    const bool deep = raw.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || raw.format() == QImage::Format_Grayscale8) ? raw : raw.convertToFormat(QImage::Format_Grayscale8);
+    QImage out(src.size(), src.format());
+    const int w = src.width();
+    // One row pointer for the bands: scanLine() detaches on every call.
+    uchar* dst = out.bits();
+    const qsizetype bpl = out.bytesPerLine();
+    parallelBands(src.height(), threads, [&](int y0, int y1) {
+        std::vector<uint16_t> wide;
+        if (!deep) wide.resize(static_cast<size_t>(w) * 2);
+        for (int t = y0; t < y1; t += kTileRows) {
+            const int tileEnd = std::min(y1, t + kTileRows);
+            for (int y = t; y < tileEnd; ++y) {
+                const size_t base = static_cast<size_t>(y) * w;
+                if (deep) {
+                    simd::calibrateU16(reinterpret_cast<const uint16_t*>(src.constScanLine(y)), offset.data() + base,
+                                       gain.data() + base, reinterpret_cast<uint16_t*>(dst + y * bpl), static_cast<size_t>(w));
+                } else {
+                    uint16_t* in = wide.data();
+                    uint16_t* corrected = wide.data() + w;
+                    simd::widenU8ToU16(src.constScanLine(y), in, static_cast<size_t>(w));
+                    simd::calibrateU16(in, offset.data() + base, gain.data() + base, corrected, static_cast<size_t>(w));
+                    simd::windowU16ToU8(corrected, dst + y * bpl, static_cast<size_t>(w), 0, 255);
+                }
+            }
+        }
+    });
+    return out;
+}
+
+QString Calibration::defaultPath() {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (dir.isEmpty()) dir = QCoreApplication::applicationDirPath();
+    QDir().mkpath(dir);
+    return QDir(dir).filePath("calibration.dcal");
+}
+
+// "DCCAL01\0" | u32 width | u32 height | u32 flags (1 dark, 2 flat) |
+// width*height f32 dark | width*height f32 gain, little-endian.
+QString Calibration::save(const QString& path) const {
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return f.errorString();
+    QDataStream ds(&f);
+    ds.setByteOrder(QDataStream::LittleEndian);
+    ds.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    ds.writeRawData(kMagic, sizeof(kMagic));
+    ds << quint32(mapSize.width()) << quint32(mapSize.height()) << quint32((dark ? 1 : 0) | (flat ? 2 : 0));
+    for (float v : offset) ds << v;
+    for (float v : gain) ds << v;
+    if (ds.status() != QDataStream::Ok) return "Calibration write failed";
+    return {};
+}
+
+QString Calibration::load(const QString& path) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return f.errorString();
+    QDataStream ds(&f);
+    ds.setByteOrder(QDataStream::LittleEndian);
+    ds.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    char magic[sizeof(kMagic)];
+    if (ds.readRawData(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        return "Not a calibration file";
+    }
+    quint32 w = 0, h = 0, flags = 0;
+    ds >> w >> h >> flags;
+    if (w == 0 || h == 0 || w > 16384 || h > 16384) return "Bad calibration geometry";
+    reset(QSize(static_cast<int>(w), static_cast<int>(h)));
+    for (float& v : offset) ds >> v;
+    for (float& v : gain) ds >> v;
+    if (ds.status() != QDataStream::Ok) {
+        reset(QSize());
+        return "Calibration file is truncated";
+    }
+    dark = flags & 1;
+    flat = flags & 2;
+    return {};
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <vector>
+
+// Dark-frame and flat-field maps for one sensor geometry, applied as
+// (raw - dark) * gain per pixel. Both maps are float; without a flat the
+// gain is 1, without a dark the offset is 0.
+class Calibration {
+public:
+    bool isEmpty() const { return !dark && !flat; }
+    bool hasDark() const { return dark; }
+    bool hasFlat() const { return flat; }
+    QSize size() const { return mapSize; }
+    bool matches(const QImage& img) const { return !isEmpty() && img.size() == mapSize; }
+
+    // Mean of a dark stack (shutter closed, same exposure as the data).
+    void setDark(const QSize& size, std::vector<float> mean);
+    // Mean of a flat stack. Gain normalises (flat - dark) to its mean, so a
+    // corrected flat comes out uniform at its original level.
+    QString setFlat(const QSize& size, const std::vector<float>& mean);
+
+    // Corrected copy in the input's format (Grayscale8 or Grayscale16).
+    // Rows are processed in tiles, split into bands over `threads`.
+    QImage apply(const QImage& raw, int threads = 2) const;
+
+    QString save(const QString& path) const;
+    QString load(const QString& path);
+    static QString defaultPath();
+
+private:
+    void reset(const QSize& size);
+
+    QSize mapSize;
+    std::vector<float> offset;  // dark map, 0 when no dark is set
+    std::vector<float> gain;    // 1 when no flat is set
+    bool dark = false;
+    bool flat = false;
+};
@@ -2,7 +2,9 @@
 #include <QtGui/QImage>
 
 DcamController::DcamController(QObject* parent)
-    : QObject(parent), hdcam(nullptr), hwait(nullptr), opened(false), frameCounter(0) {}
+    : QObject(parent), hdcam(nullptr), hwait(nullptr), opened(false), frameCounter(0) {
+    hostClock.start();
+}
 
 DcamController::~DcamController() {
     cleanup();
@@ -238,6 +240,12 @@ bool DcamController::lockLatestFrame(QImage& outImage, FrameMeta& meta) {
     meta.binning = bin;
     meta.bits = static_cast<int>(bits);
     meta.frameIndex = frameCounter;
+    meta.framestamp = bf.framestamp;
+    meta.timestamp = static_cast<double>(bf.timestamp.sec) + bf.timestamp.microsec * 1e-6;
+    if (meta.timestamp <= 0.0) {
+        // Some models leave the timestamp empty; fall back to host arrival time.
+        meta.timestamp = hostClock.nsecsElapsed() * 1e-9;
+    }
     DCAMCAP_TRANSFERINFO ti = {};
     ti.size = sizeof(ti);
     if (!failed(dcamcap_transferinfo(hdcam, &ti))) {
@@ -252,13 +260,11 @@ bool DcamController::lockLatestFrame(QImage& outImage, FrameMeta& meta) {
 
     frameCounter = (frameCounter + 1) % 10000;
 
-    if (bits <= 8) {
-        QImage img(reinterpret_cast<uchar*>(bf.buf), bf.width, bf.height, bf.rowbytes, QImage::Format_Grayscale8);
-        outImage = img.copy();
-    } else {
-        QImage img(reinterpret_cast<uchar*>(bf.buf), bf.width, bf.height, bf.rowbytes, QImage::Format_Grayscale16);
-        outImage = img.convertToFormat(QImage::Format_Grayscale8);
-    }
+    // Keep the native depth: recordings stay raw and the display path does
+    // its own conversion.
+    QImage img(reinterpret_cast<uchar*>(bf.buf), bf.width, bf.height, bf.rowbytes,
+               bits <= 8 ? QImage::Format_Grayscale8 : QImage::Format_Grayscale16);
+    outImage = img.copy();
     return true;
 }
 
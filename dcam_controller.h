@@ -32,4 +32,5 @@ private:
     HDCAMWAIT hwait;
     bool opened;
     qint64 frameCounter;
+    QElapsedTimer hostClock;
 };
@@ -0,0 +1,170 @@
+#include "display_converter.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace {
+// Nine evenly spaced samples of each map, interpolated to 256 entries.
+// Viridis and inferno are matplotlib's; fire follows ImageJ's.
+using Anchors = std::array<QRgb, 9>;
+constexpr Anchors kViridis = {0x440154, 0x472d7b, 0x3b528b, 0x2c728e, 0x21918c, 0x28ae80, 0x5ec962, 0xaddc30, 0xfde725};
+constexpr Anchors kInferno = {0x000004, 0x1f0c48, 0x550f6d, 0x88226a, 0xba3655, 0xe35933, 0xf9950a, 0xf8c932, 0xfcffa4};
+constexpr Anchors kFire = {0x000000, 0x1c0070, 0x6a00a8, 0xb4106e, 0xe6321e, 0xfa7800, 0xffb400, 0xffe650, 0xffffff};
+
+std::array<QRgb, 256> buildPalette(DisplayConverter::Colormap m) {
+    std::array<QRgb, 256> p{};
+    const Anchors* a = m == DisplayConverter::Colormap::Viridis ? &kViridis
+                     : m == DisplayConverter::Colormap::Inferno ? &kInferno
+                     : m == DisplayConverter::Colormap::Fire ? &kFire : nullptr;
+    for (int i = 0; i < 256; ++i) {
+        if (!a) {
+            p[i] = qRgb(i, i, i);
+            continue;
+        }
+        const int seg = std::min(7, i * 8 / 255);
+        const double f = i * 8.0 / 255.0 - seg;
+        const QRgb c0 = (*a)[seg];
+        const QRgb c1 = (*a)[seg + 1];
+        auto mix = [f](int x, int y){ return static_cast<int>(x + (y - x) * f + 0.5); };
+        p[i] = qRgb(mix(qRed(c0), qRed(c1)), mix(qGreen(c0), qGreen(c1)), mix(qBlue(c0), qBlue(c1)));
+    }
+    // HiLo marks the ends of the window, like ImageJ's.
+    if (m == DisplayConverter::Colormap::HiLo) {
+        p[0] = DisplayConverter::kZeroColour;
+        p[255] = DisplayConverter::kSaturatedColour;
+    }
+    return p;
+}
+} // namespace
+
+int DisplayConverter::saturationFor(int bits) {
+    return bits > 0 && bits < 16 ? (1 << bits) - 1 : 65535;
+}
+
+QString DisplayConverter::colormapName(Colormap m) {
+    switch (m) {
+    case Colormap::Grey: return "Grey";
+    case Colormap::Viridis: return "Viridis";
+    case Colormap::Inferno: return "Inferno";
+    case Colormap::Fire: return "Fire";
+    case Colormap::HiLo: return "HiLo";
+    }
+    return {};
+}
+
+const std::array<uint32_t, 256>& DisplayConverter::palette(Colormap m) {
+    static const std::array<std::array<uint32_t, 256>, kColormaps> palettes = [] {
+        std::array<std::array<uint32_t, 256>, kColormaps> p{};
+        for (int i = 0; i < kColormaps; ++i) p[i] = buildPalette(static_cast<Colormap>(i));
+        return p;
+    }();
+    return palettes[static_cast<int>(m)];
+}
+
+bool DisplayConverter::converts(const QImage& img) {
+    return img.format() == QImage::Format_Grayscale16 || img.format() == QImage::Format_Grayscale8;
+}
+
+void DisplayConverter::render(const QImage& img, const QRect& area, int factor, const Settings& s, QImage& buffer,
+                              int threads) {
+    if (!converts(img)) return;
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    factor = std::max(1, factor);
+    const QRect src = area.intersected(img.rect());
+    if (src.width() < factor || src.height() < factor) return;
+    const int w = src.width() / factor;
+    const int h = src.height() / factor;
+    if (buffer.size() != QSize(w, h) || buffer.format() != QImage::Format_RGB32) buffer = QImage(w, h, QImage::Format_RGB32);
+    const int black = deep ? s.black : 0;
+    const int white = deep ? s.white : 255;
+    const int saturation = deep ? s.saturation : std::min(s.saturation, 255);
+    const uint32_t* pal = palette(s.map).data();
+    // Non-const scanLine() detaches, bumping the image's cache key, on
+    // every call; rows are addressed from one pointer taken up front.
+    uchar* base = buffer.bits();
+    const qsizetype bpl = buffer.bytesPerLine();
+    const int blockPixels = factor * factor;
+
+    parallelBands(h, threads, [&](int y0, int y1) {
+        std::vector<uint16_t> row(static_cast<size_t>(w));
+        // Reduced rows keep the block extremes, so a single saturated or
+        // zero pixel is still tinted when zoomed out.
+        std::vector<uint32_t> sum(factor > 1 ? w : 0);
+        std::vector<uint16_t> lo(factor > 1 && s.tint ? w : 0);
+        std::vector<uint16_t> hi(lo.size());
+        for (int y = y0; y < y1; ++y) {
+            uint32_t* out = reinterpret_cast<uint32_t*>(base + y * bpl);
+            if (factor == 1) {
+                const uchar* line = img.constScanLine(src.y() + y);
+                const uint16_t* in = reinterpret_cast<const uint16_t*>(line) + src.x();
+                if (!deep) {
+                    simd::widenU8ToU16(line + src.x(), row.data(), static_cast<size_t>(w));
+                    in = row.data();
+                }
+                simd::paletteU16ToRgb32(in, out, static_cast<size_t>(w), black, white, pal, s.tint ? 0 : -1,
+                                        s.tint ? saturation : 65536, kZeroColour, kSaturatedColour);
+                continue;
+            }
+            std::fill(sum.begin(), sum.end(), 0u);
+            std::fill(lo.begin(), lo.end(), uint16_t(65535));
+            std::fill(hi.begin(), hi.end(), uint16_t(0));
+            for (int r = 0; r < factor; ++r) {
+                const uchar* line = img.constScanLine(src.y() + y * factor + r);
+                const uint16_t* line16 = reinterpret_cast<const uint16_t*>(line);
+                for (int x = 0; x < w; ++x) {
+                    const int x0 = src.x() + x * factor;
+                    uint32_t acc = 0;
+                    uint16_t mn = 65535, mx = 0;
+                    for (int k = 0; k < factor; ++k) {
+                        const uint16_t v = deep ? line16[x0 + k] : line[x0 + k];
+                        acc += v;
+                        mn = std::min(mn, v);
+                        mx = std::max(mx, v);
+                    }
+                    sum[x] += acc;
+                    if (!lo.empty()) {
+                        lo[x] = std::min(lo[x], mn);
+                        hi[x] = std::max(hi[x], mx);
+                    }
+                }
+            }
+            for (int x = 0; x < w; ++x) row[x] = static_cast<uint16_t>((sum[x] + blockPixels / 2) / blockPixels);
+            simd::paletteU16ToRgb32(row.data(), out, static_cast<size_t>(w), black, white, pal, -1, 65536, 0, 0);
+            for (size_t x = 0; x < lo.size(); ++x) {
+                if (lo[x] == 0) out[x] = kZeroColour;
+                if (hi[x] >= saturation) out[x] = kSaturatedColour;
+            }
+        }
+    });
+}
+
+DisplayConverter::Stats DisplayConverter::clipStats(const QImage& img, const Settings& s, int threads) {
+    Stats stats;
+    if (!converts(img)) return stats;
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    const int w = img.width();
+    const int saturation = deep ? s.saturation : std::min(s.saturation, 255);
+    std::atomic<qint64> saturated{0};
+    std::atomic<qint64> zero{0};
+    parallelBands(img.height(), threads, [&](int y0, int y1) {
+        std::vector<uint16_t> widened(deep ? 0 : static_cast<size_t>(w));
+        uint64_t lows = 0, highs = 0;
+        for (int y = y0; y < y1; ++y) {
+            const uint16_t* row = reinterpret_cast<const uint16_t*>(img.constScanLine(y));
+            if (!deep) {
+                simd::widenU8ToU16(img.constScanLine(y), widened.data(), static_cast<size_t>(w));
+                row = widened.data();
+            }
+            simd::countClipU16(row, static_cast<size_t>(w), 0, saturation, lows, highs);
+        }
+        zero += static_cast<qint64>(lows);
+        saturated += static_cast<qint64>(highs);
+    });
+    stats.pixels = static_cast<qint64>(w) * img.height();
+    stats.saturated = saturated.load();
+    stats.zero = zero.load();
+    return stats;
+}
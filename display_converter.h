@@ -0,0 +1,53 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <array>
+
+// Display conversion of Grayscale8/16 frames to RGB32 for the views. A
+// view converts only what it shows: the frame pixels under its viewport,
+// reduced to screen resolution when zoomed out, into a buffer it keeps.
+// Every map, grey included, goes through the same two-stage lookup (SIMD
+// window to an 8-bit index, then a 256-entry palette), so false colour
+// costs the same as grey. Saturated pixels (at or above the saturation
+// level) and pixels at zero are counted over the whole frame for the stats
+// panel in a separate read-only pass and, with the overlay on, tinted.
+class DisplayConverter {
+public:
+    enum class Colormap { Grey, Viridis, Inferno, Fire, HiLo };
+    static constexpr int kColormaps = 5;
+
+    struct Settings {
+        Colormap map = Colormap::Grey;
+        bool tint = false;
+        int saturation = 65535;     // DN counted as saturated, e.g. 4095 for 12-bit data
+        int black = 0;              // window mapped to 0..255
+        int white = 65535;
+    };
+    struct Stats {
+        qint64 pixels = 0;
+        qint64 saturated = 0;
+        qint64 zero = 0;
+        double saturatedPercent() const { return pixels > 0 ? 100.0 * saturated / pixels : 0.0; }
+        double zeroPercent() const { return pixels > 0 ? 100.0 * zero / pixels : 0.0; }
+    };
+    static constexpr QRgb kSaturatedColour = 0xFFFF2020u;
+    static constexpr QRgb kZeroColour = 0xFF2060FFu;
+
+    // Grayscale16 and Grayscale8 are converted (8-bit frames use 0..255 as
+    // the window and saturate at 255); anything else is shown as is.
+    static bool converts(const QImage& img);
+    // The frame pixels in src (clipped to the frame), reduced by `factor`
+    // in each direction to the mean of factor x factor blocks, as RGB32.
+    // A buffer that already has the output size is written in place.
+    static void render(const QImage& img, const QRect& src, int factor, const Settings& s, QImage& buffer,
+                       int threads = 1);
+    // Clip counts over the whole frame; empty for formats not converted.
+    static Stats clipStats(const QImage& img, const Settings& s, int threads = 1);
+
+    static QString colormapName(Colormap m);
+    // Full-scale value of a camera bit depth, 65535 when unknown.
+    static int saturationFor(int bits);
+
+private:
+    static const std::array<uint32_t, 256>& palette(Colormap m);
+};
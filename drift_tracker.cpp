@@ -0,0 +1,235 @@
+#include "drift_tracker.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+std::vector<float> hann(int n) {
+    std::vector<float> w(n);
+    for (int i = 0; i < n; ++i) w[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * (i + 0.5) / n));
+    return w;
+}
+
+// Per-axis weights exp(-2 pi^2 s^2 f^2) over signed frequencies f = k / n:
+// the transform of a Gaussian of s pixels.
+std::vector<float> gaussianWeights(int n, int count, double s) {
+    std::vector<float> g(count);
+    for (int k = 0; k < count; ++k) {
+        const double f = static_cast<double>(k <= n / 2 ? k : k - n) / n;
+        g[k] = static_cast<float>(std::exp(-2.0 * kPi * kPi * s * s * f * f));
+    }
+    return g;
+}
+
+// Vertex offset of the Gaussian through (-1, a), (0, b), (1, c), from a
+// parabola on the logarithms; a plain parabola when a sample is not positive.
+double peakOffset(double a, double b, double c) {
+    double den = 0.0, num = 0.0;
+    if (a > 0.0 && b > 0.0 && c > 0.0) {
+        num = std::log(a) - std::log(c);
+        den = std::log(a) - 2.0 * std::log(b) + std::log(c);
+    } else {
+        num = a - c;
+        den = a - 2.0 * b + c;
+    }
+    if (den >= 0.0) return 0.0;
+    return std::clamp(0.5 * num / den, -0.5, 0.5);
+}
+}
+
+void PhaseCorrelator::setReference(const float* window, int width, int height) {
+    if (fft.width() != width || fft.height() != height) {
+        fft = RealFft2D(width, height);
+        hannX = hann(width);
+        hannY = hann(height);
+        weightX = gaussianWeights(width, fft.spectrumWidth(), kPeakSigma);
+        weightY = gaussianWeights(height, height, kPeakSigma);
+        // The self-correlation peak: the weights summed over the full spectrum.
+        const std::vector<float> fullX = gaussianWeights(width, width, kPeakSigma);
+        double sx = 0.0, sy = 0.0;
+        for (float g : fullX) sx += g;
+        for (float g : weightY) sy += g;
+        peakNorm = sx * sy;
+        tapered.resize(static_cast<size_t>(width) * height);
+        surface.resize(tapered.size());
+        reference.resize(static_cast<size_t>(fft.spectrumWidth()) * height);
+        spectrum.resize(reference.size());
+    }
+    taper(window);
+    fft.forward(tapered.data(), reference.data());
+}
+
+void PhaseCorrelator::taper(const float* window) {
+    const int w = fft.width();
+    const int h = fft.height();
+    double sum = 0.0;
+    for (size_t i = 0; i < tapered.size(); ++i) sum += window[i];
+    const float mean = static_cast<float>(sum / tapered.size());
+    for (int y = 0; y < h; ++y) {
+        const float* src = window + static_cast<size_t>(y) * w;
+        float* dst = tapered.data() + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; ++x) dst[x] = (src[x] - mean) * hannX[x] * hannY[y];
+    }
+}
+
+void PhaseCorrelator::measure(const float* window, double& dx, double& dy, double& peak) {
+    const int w = fft.width();
+    const int h = fft.height();
+    taper(window);
+    fft.forward(tapered.data(), spectrum.data());
+    // Whitened cross power: only the phase difference is kept. The Gaussian
+    // weight turns the delta-like peak into a Gaussian a few pixels wide,
+    // which the three-point fit below locates to a small fraction of a pixel.
+    const int hw = fft.spectrumWidth();
+    for (int ky = 0; ky < h; ++ky) {
+        FftPlan::Complex* row = spectrum.data() + static_cast<size_t>(ky) * hw;
+        const FftPlan::Complex* ref = reference.data() + static_cast<size_t>(ky) * hw;
+        for (int kx = 0; kx < hw; ++kx) {
+            const FftPlan::Complex c = row[kx] * std::conj(ref[kx]);
+            const float mag = std::abs(c);
+            row[kx] = mag > 1e-20f ? c * (weightX[kx] * weightY[ky] / mag) : FftPlan::Complex();
+        }
+    }
+    fft.inverse(spectrum.data(), surface.data());
+
+    const size_t best = static_cast<size_t>(std::max_element(surface.begin(), surface.end()) - surface.begin());
+    const int px = static_cast<int>(best % w);
+    const int py = static_cast<int>(best / w);
+    auto at = [&](int x, int y) { return static_cast<double>(surface[static_cast<size_t>((y + h) % h) * w + (x + w) % w]); };
+    const double centre = at(px, py);
+    dx = px + peakOffset(at(px - 1, py), centre, at(px + 1, py));
+    dy = py + peakOffset(at(px, py - 1), centre, at(px, py + 1));
+    // The correlation surface wraps; shifts past half the window are negative.
+    if (dx > w / 2.0) dx -= w;
+    if (dy > h / 2.0) dy -= h;
+    peak = centre / peakNorm;
+}
+
+DriftTracker::DriftTracker(QObject* parent) : LiveAnalyzer(parent, 2), maxWindow(512) {}
+
+DriftTracker::~DriftTracker() {
+    stopAnalysis();
+}
+
+void DriftTracker::setMaxWindow(int side) {
+    maxWindow = std::clamp(side, 32, 2048);
+    reset();
+}
+
+void DriftTracker::clearResults() {
+    referenceWindow = QRect();
+    QMutexLocker lk(&resultMutex);
+    samples.clear();
+}
+
+std::vector<DriftTracker::Sample> DriftTracker::history() const {
+    QMutexLocker lk(&resultMutex);
+    return samples;
+}
+
+std::vector<DriftTracker::Sample> DriftTracker::trace(int maxSamples) const {
+    QMutexLocker lk(&resultMutex);
+    const size_t n = std::min(samples.size(), static_cast<size_t>(std::max(0, maxSamples)));
+    return std::vector<Sample>(samples.end() - static_cast<std::ptrdiff_t>(n), samples.end());
+}
+
+bool DriftTracker::hasSamples() const {
+    QMutexLocker lk(&resultMutex);
+    return !samples.empty();
+}
+
+DriftTracker::Sample DriftTracker::latest() const {
+    QMutexLocker lk(&resultMutex);
+    return samples.empty() ? Sample() : samples.back();
+}
+
+bool DriftTracker::driftAt(const std::vector<Sample>& list, qint64 framestamp, double& dx, double& dy) {
+    if (list.empty()) return false;
+    auto it = std::lower_bound(list.begin(), list.end(), framestamp,
+                               [](const Sample& s, qint64 f) { return s.framestamp < f; });
+    if (it == list.begin() || it == list.end()) {
+        const Sample& s = it == list.end() ? list.back() : list.front();
+        dx = s.dx;
+        dy = s.dy;
+        return true;
+    }
+    const Sample& b = *it;
+    const Sample& a = *(it - 1);
+    const double t = static_cast<double>(framestamp - a.framestamp) / static_cast<double>(b.framestamp - a.framestamp);
+    dx = a.dx + t * (b.dx - a.dx);
+    dy = a.dy + t * (b.dy - a.dy);
+    return true;
+}
+
+QImage DriftTracker::shifted(const QImage& img, int dx, int dy) {
+    if (img.isNull() || (dx == 0 && dy == 0)) return img;
+    QImage out(img.size(), img.format());
+    out.fill(0);
+    const int bpp = img.depth() / 8;
+    const int w = img.width() - std::abs(dx);
+    if (w <= 0 || std::abs(dy) >= img.height()) return out;
+    const int srcX = std::max(0, -dx);
+    const int dstX = std::max(0, dx);
+    for (int y = std::max(0, dy); y < std::min(img.height(), img.height() + dy); ++y) {
+        memcpy(out.scanLine(y) + dstX * bpp, img.constScanLine(y - dy) + srcX * bpp, static_cast<size_t>(w) * bpp);
+    }
+    return out;
+}
+
+void DriftTracker::analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    if (referenceFrame != src.size()) {
+        referenceFrame = src.size();
+        clearResults();
+    }
+
+    Sample last = latest();
+    QRect window;
+    if (referenceWindow.isEmpty()) {
+        const int cap = maxWindow.load();
+        const int w = FftPlan::fastSizeAtMost(std::min(roi.width(), cap));
+        const int h = FftPlan::fastSizeAtMost(std::min(roi.height(), cap));
+        if (w < 16 || h < 16) return;
+        window = QRect(roi.left() + (roi.width() - w) / 2, roi.top() + (roi.height() - h) / 2, w, h);
+    } else {
+        // Follow the content: move the window by the whole-pixel drift so far.
+        window = referenceWindow.translated(static_cast<int>(std::lround(last.dx)), static_cast<int>(std::lround(last.dy)));
+        window.moveLeft(std::clamp(window.left(), 0, src.width() - window.width()));
+        window.moveTop(std::clamp(window.top(), 0, src.height() - window.height()));
+    }
+
+    const int w = window.width();
+    const int h = window.height();
+    pixels.resize(static_cast<size_t>(w) * h);
+    scratch.resize(static_cast<size_t>(w));
+    for (int y = 0; y < h; ++y) {
+        const uint16_t* row = nullptr;
+        if (deep) {
+            row = reinterpret_cast<const uint16_t*>(src.constScanLine(window.top() + y)) + window.left();
+        } else {
+            simd::widenU8ToU16(src.constScanLine(window.top() + y) + window.left(), scratch.data(), static_cast<size_t>(w));
+            row = scratch.data();
+        }
+        simd::widenU16ToF32(row, pixels.data() + static_cast<size_t>(y) * w, static_cast<size_t>(w));
+    }
+
+    Sample s;
+    s.time = meta.timestamp;
+    s.framestamp = meta.framestamp;
+    if (referenceWindow.isEmpty()) {
+        correlator.setReference(pixels.data(), w, h);
+        referenceWindow = window;
+        s.peak = 1.0;
+    } else {
+        double dx = 0.0, dy = 0.0;
+        correlator.measure(pixels.data(), dx, dy, s.peak);
+        s.dx = window.left() - referenceWindow.left() + dx;
+        s.dy = window.top() - referenceWindow.top() + dy;
+    }
+    QMutexLocker lk(&resultMutex);
+    samples.push_back(s);
+}
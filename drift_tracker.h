@@ -0,0 +1,85 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <vector>
+#include "fft.h"
+#include "live_analyzer.h"
+
+// Phase correlation of equally sized windows against a stored reference.
+// Windows are mean-subtracted and Hann-tapered. The peak of the normalised
+// cross-power spectrum's inverse gives the shift, refined to sub-pixel
+// precision by a Gaussian through its neighbours in x and y.
+class PhaseCorrelator {
+public:
+    // Window sides must be fast FFT sizes (FftPlan::isFastSize).
+    void setReference(const float* window, int width, int height);
+    bool hasReference() const { return !fft.isNull(); }
+    int width() const { return fft.width(); }
+    int height() const { return fft.height(); }
+
+    // Shift of `window` relative to the reference: window(x) ~ reference(x - d).
+    // peak is the correlation height, 1 for identical content, near 0 for none.
+    void measure(const float* window, double& dx, double& dy, double& peak);
+
+private:
+    void taper(const float* window);
+
+    static constexpr double kPeakSigma = 1.0;   // correlation peak width, pixels
+
+    RealFft2D fft;
+    std::vector<float> hannX, hannY;
+    std::vector<float> weightX, weightY;
+    double peakNorm = 1.0;
+    std::vector<float> tapered;
+    std::vector<FftPlan::Complex> reference;
+    std::vector<FftPlan::Complex> spectrum;
+    std::vector<float> surface;
+};
+
+// Sample drift at a decimated rate (see LiveAnalyzer::setDecimation) against
+// the first analysed frame after a reset. The measured window follows the
+// drift, so shifts larger than a quarter of the window stay trackable; its
+// side is the largest fast FFT size that fits the ROI, capped at maxWindow.
+class DriftTracker : public LiveAnalyzer {
+    Q_OBJECT
+public:
+    struct Sample {
+        double time = 0.0;          // camera timestamp, seconds
+        qint64 framestamp = 0;
+        double dx = 0.0;            // content displacement from the reference, pixels
+        double dy = 0.0;
+        double peak = 0.0;          // correlation height, 0..1
+    };
+
+    explicit DriftTracker(QObject* parent=nullptr);
+    ~DriftTracker() override;
+
+    void setMaxWindow(int side);
+    // All samples since the last reset, in frame order.
+    std::vector<Sample> history() const;
+    std::vector<Sample> trace(int maxSamples) const;
+    bool hasSamples() const;
+    Sample latest() const;
+
+    // Drift at a framestamp, linear between samples and held beyond the ends.
+    // False when there are no samples.
+    static bool driftAt(const std::vector<Sample>& samples, qint64 framestamp, double& dx, double& dy);
+    // img moved by (dx, dy) whole pixels; uncovered pixels are black.
+    static QImage shifted(const QImage& img, int dx, int dy);
+
+protected:
+    void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) override;
+    void clearResults() override;
+
+private:
+    std::atomic<int> maxWindow;
+    mutable QMutex resultMutex;
+    std::vector<Sample> samples;
+
+    // Analysis thread only.
+    PhaseCorrelator correlator;
+    QRect referenceWindow;
+    QSize referenceFrame;
+    std::vector<float> pixels;
+    std::vector<uint16_t> scratch;
+};
@@ -0,0 +1,246 @@
+#include "fft.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+namespace {
+constexpr double kTwoPi = 6.28318530717958647692;
+}
+
+FftPlan::FftPlan(int length) : n(std::max(1, length)) {
+    // Radix 4 first: fewest passes for the common power-of-two sizes.
+    int rest = n;
+    std::vector<int> radices;
+    for (int p : {4, 2, 3, 5}) {
+        while (rest % p == 0) {
+            radices.push_back(p);
+            rest /= p;
+        }
+    }
+    if (rest != 1) radices.push_back(rest);   // not a fast size: one direct DFT stage
+
+    int len = n;
+    for (int p : radices) {
+        Stage st{p, len / p, twiddles.size()};
+        for (int q = 0; q < st.m; ++q) {
+            for (int r = 1; r < p; ++r) {
+                const double a = -kTwoPi * static_cast<double>(q) * r / len;
+                twiddles.emplace_back(static_cast<float>(std::cos(a)), static_cast<float>(std::sin(a)));
+            }
+        }
+        stages.push_back(st);
+        len = st.m;
+    }
+}
+
+bool FftPlan::isFastSize(int n) {
+    if (n < 1) return false;
+    for (int p : {2, 3, 5}) {
+        while (n % p == 0) n /= p;
+    }
+    return n == 1;
+}
+
+int FftPlan::fastSizeAtMost(int n) {
+    while (n > 1 && !isFastSize(n)) --n;
+    return std::max(1, n);
+}
+
+int FftPlan::fastSizeAtLeast(int n) {
+    n = std::max(1, n);
+    while (!isFastSize(n)) ++n;
+    return n;
+}
+
+std::shared_ptr<const FftPlan> FftPlan::cached(int n) {
+    static std::mutex mutex;
+    static std::map<int, std::shared_ptr<const FftPlan>> plans;
+    std::lock_guard<std::mutex> lk(mutex);
+    std::shared_ptr<const FftPlan>& plan = plans[n];
+    if (!plan) plan = std::make_shared<const FftPlan>(n);
+    return plan;
+}
+
+namespace {
+using Complex = FftPlan::Complex;
+
+// Plain products: std::complex multiplication may take a slow NaN-checking path.
+inline Complex mul(Complex a, Complex b) {
+    return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+// v * -i (forward) or v * +i (inverse).
+inline Complex rotate(Complex v, bool inverse) {
+    return inverse ? Complex(-v.imag(), v.real()) : Complex(v.imag(), -v.real());
+}
+}
+
+void FftPlan::run(Complex* data, Complex* work, bool inverse) const {
+    // Stage with radix p over sub-length len = p * m, stride s: DFT_p of the
+    // inputs x[k + s * (q + m * j)], output r scaled by w_len^(q * r) and
+    // written to y[k + s * (p * q + r)].
+    Complex* x = data;
+    Complex* y = work;
+    const double sign = inverse ? 1.0 : -1.0;
+    int s = 1;
+    for (const Stage& st : stages) {
+        const int p = st.radix;
+        const int m = st.m;
+        // Roots of unity for the direct DFT of leftover radices.
+        std::vector<Complex> roots;
+        std::vector<Complex> v;
+        if (p > 5) {
+            roots.resize(p);
+            v.resize(p);
+            for (int k = 0; k < p; ++k) {
+                const double a = sign * kTwoPi * k / p;
+                roots[k] = Complex(static_cast<float>(std::cos(a)), static_cast<float>(std::sin(a)));
+            }
+        }
+        const size_t step = static_cast<size_t>(s) * m;
+        Complex w[8];
+        std::vector<Complex> wBig(p > 8 ? p : 0);
+        Complex* tw = p > 8 ? wBig.data() : w;
+        for (int q = 0; q < m; ++q) {
+            const Complex* wq = twiddles.data() + st.twiddles + static_cast<size_t>(q) * (p - 1);
+            for (int r = 1; r < p; ++r) tw[r] = inverse ? std::conj(wq[r - 1]) : wq[r - 1];
+            for (int k = 0; k < s; ++k) {
+                const Complex* in = x + k + static_cast<size_t>(s) * q;
+                Complex* out = y + k + static_cast<size_t>(s) * p * q;
+                switch (p) {
+                case 2: {
+                    const Complex a0 = in[0], a1 = in[step];
+                    out[0] = a0 + a1;
+                    out[s] = mul(a0 - a1, tw[1]);
+                    break;
+                }
+                case 4: {
+                    const Complex a0 = in[0], a1 = in[step], a2 = in[2 * step], a3 = in[3 * step];
+                    const Complex t0 = a0 + a2, t1 = a0 - a2, t2 = a1 + a3;
+                    const Complex t3 = rotate(a1 - a3, inverse);
+                    out[0] = t0 + t2;
+                    out[s] = mul(t1 + t3, tw[1]);
+                    out[2 * s] = mul(t0 - t2, tw[2]);
+                    out[3 * s] = mul(t1 - t3, tw[3]);
+                    break;
+                }
+                case 3: {
+                    constexpr float kSin60 = 0.86602540378443865f;
+                    const Complex a0 = in[0], a1 = in[step], a2 = in[2 * step];
+                    const Complex t1 = a1 + a2;
+                    const Complex t2 = a0 - 0.5f * t1;
+                    const Complex t3 = rotate(kSin60 * (a1 - a2), inverse);
+                    out[0] = a0 + t1;
+                    out[s] = mul(t2 + t3, tw[1]);
+                    out[2 * s] = mul(t2 - t3, tw[2]);
+                    break;
+                }
+                case 5: {
+                    constexpr float c1 = 0.30901699437494742f, c2 = -0.80901699437494742f;
+                    constexpr float s1 = 0.95105651629515357f, s2 = 0.58778525229247313f;
+                    const Complex a0 = in[0], a1 = in[step], a2 = in[2 * step], a3 = in[3 * step], a4 = in[4 * step];
+                    const Complex t1 = a1 + a4, t2 = a2 + a3, t3 = a1 - a4, t4 = a2 - a3;
+                    const Complex m1 = a0 + c1 * t1 + c2 * t2;
+                    const Complex m2 = a0 + c2 * t1 + c1 * t2;
+                    const Complex n1 = rotate(s1 * t3 + s2 * t4, inverse);
+                    const Complex n2 = rotate(s2 * t3 - s1 * t4, inverse);
+                    out[0] = a0 + t1 + t2;
+                    out[s] = mul(m1 + n1, tw[1]);
+                    out[2 * s] = mul(m2 + n2, tw[2]);
+                    out[3 * s] = mul(m2 - n2, tw[3]);
+                    out[4 * s] = mul(m1 - n1, tw[4]);
+                    break;
+                }
+                default: {
+                    for (int j = 0; j < p; ++j) v[j] = in[j * step];
+                    for (int r = 0; r < p; ++r) {
+                        Complex acc = v[0];
+                        int e = 0;
+                        for (int j = 1; j < p; ++j) {
+                            e += r;
+                            if (e >= p) e -= p;
+                            acc += mul(v[j], roots[e]);
+                        }
+                        out[r * s] = r ? mul(acc, tw[r]) : acc;
+                    }
+                    break;
+                }
+                }
+            }
+        }
+        s *= p;
+        std::swap(x, y);
+    }
+    if (x != data) std::copy(x, x + n, data);
+}
+
+RealFft2D::RealFft2D(int width, int height)
+    : w(width), h(height), rowPlan(FftPlan::cached(width)), colPlan(FftPlan::cached(height)),
+      row(width), col(static_cast<size_t>(height) * kColumnBlock), work(std::max(width, height)),
+      half(static_cast<size_t>(width / 2 + 1) * height) {}
+
+void RealFft2D::forward(const float* src, Complex* spectrum) {
+    const int hw = spectrumWidth();
+    for (int y = 0; y < h; y += 2) {
+        // z = a + i b; A[k] = (Z[k] + conj Z[-k]) / 2, B[k] = (Z[k] - conj Z[-k]) / 2i.
+        const float* a = src + static_cast<size_t>(y) * w;
+        const float* b = y + 1 < h ? a + w : nullptr;
+        for (int x = 0; x < w; ++x) row[x] = Complex(a[x], b ? b[x] : 0.0f);
+        rowPlan->forward(row.data(), work.data());
+        Complex* outA = spectrum + static_cast<size_t>(y) * hw;
+        for (int k = 0; k < hw; ++k) {
+            const Complex zk = row[k];
+            const Complex zn = std::conj(row[(w - k) % w]);
+            outA[k] = 0.5f * (zk + zn);
+            if (b) {
+                const Complex d = 0.5f * (zk - zn);
+                outA[hw + k] = Complex(d.imag(), -d.real());
+            }
+        }
+    }
+    columns(spectrum, false);
+}
+
+void RealFft2D::inverse(const Complex* spectrum, float* dst) {
+    const int hw = spectrumWidth();
+    std::copy(spectrum, spectrum + half.size(), half.begin());
+    columns(half.data(), true);
+    for (int y = 0; y < h; y += 2) {
+        // Each row spectrum is Hermitian; rebuild it in full and pack two rows as a + i b.
+        const Complex* sa = half.data() + static_cast<size_t>(y) * hw;
+        const Complex* sb = y + 1 < h ? sa + hw : nullptr;
+        for (int x = 0; x < w; ++x) {
+            const Complex a = x < hw ? sa[x] : std::conj(sa[w - x]);
+            const Complex b = sb ? (x < hw ? sb[x] : std::conj(sb[w - x])) : Complex();
+            row[x] = a + Complex(-b.imag(), b.real());
+        }
+        rowPlan->inverse(row.data(), work.data());
+        float* outA = dst + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; ++x) outA[x] = row[x].real();
+        if (sb) {
+            for (int x = 0; x < w; ++x) outA[w + x] = row[x].imag();
+        }
+    }
+}
+
+void RealFft2D::columns(Complex* spectrum, bool inverse) {
+    // Columns go through in blocks, so each spectrum row is read a cache
+    // line at a time instead of one value per line.
+    const int hw = spectrumWidth();
+    for (int k0 = 0; k0 < hw; k0 += kColumnBlock) {
+        const int nb = std::min(kColumnBlock, hw - k0);
+        for (int y = 0; y < h; ++y) {
+            const Complex* src = spectrum + static_cast<size_t>(y) * hw + k0;
+            for (int b = 0; b < nb; ++b) col[static_cast<size_t>(b) * h + y] = src[b];
+        }
+        for (int b = 0; b < nb; ++b) {
+            Complex* c = col.data() + static_cast<size_t>(b) * h;
+            if (inverse) colPlan->inverse(c, work.data());
+            else colPlan->forward(c, work.data());
+        }
+        for (int y = 0; y < h; ++y) {
+            Complex* dst = spectrum + static_cast<size_t>(y) * hw + k0;
+            for (int b = 0; b < nb; ++b) dst[b] = col[static_cast<size_t>(b) * h + y];
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <complex>
+#include <memory>
+#include <vector>
+
+// Mixed-radix complex FFT (radices 4, 2, 3 and 5) in Stockham autosort
+// form, so no bit reversal pass is needed. A plan holds the factorisation
+// and twiddles of one length and never changes after construction; threads
+// may share it as long as each brings its own work buffer.
+class FftPlan {
+public:
+    using Complex = std::complex<float>;
+
+    explicit FftPlan(int n = 1);
+    int size() const { return n; }
+
+    // In place. data and work hold size() values; inverse is unnormalised.
+    void forward(Complex* data, Complex* work) const { run(data, work, false); }
+    void inverse(Complex* data, Complex* work) const { run(data, work, true); }
+
+    // Lengths a plan supports: products of 2, 3 and 5.
+    static bool isFastSize(int n);
+    static int fastSizeAtMost(int n);
+    static int fastSizeAtLeast(int n);
+    // Plans are built once per length and then shared.
+    static std::shared_ptr<const FftPlan> cached(int n);
+
+private:
+    struct Stage {
+        int radix;
+        int m;              // sub-transform count of this stage
+        size_t twiddles;    // offset of this stage's m * (radix - 1) twiddles
+    };
+
+    void run(Complex* data, Complex* work, bool inverse) const;
+
+    int n;
+    std::vector<Stage> stages;
+    std::vector<Complex> twiddles;
+};
+
+// 2D FFT of a real width x height image to its half spectrum, (width / 2 + 1)
+// x height complex values in row-major order, and back. Two real rows go
+// through one complex row transform. Both sides must be fast sizes; all
+// buffers are allocated with the object, so repeated calls do not allocate.
+class RealFft2D {
+public:
+    using Complex = FftPlan::Complex;
+
+    RealFft2D() = default;
+    RealFft2D(int width, int height);
+    int width() const { return w; }
+    int height() const { return h; }
+    int spectrumWidth() const { return w / 2 + 1; }
+    bool isNull() const { return w == 0; }
+
+    void forward(const float* src, Complex* spectrum);
+    // Unnormalised: a forward/inverse round trip scales by width * height.
+    void inverse(const Complex* spectrum, float* dst);
+
+private:
+    void columns(Complex* spectrum, bool inverse);
+
+    static constexpr int kColumnBlock = 8;
+
+    int w = 0;
+    int h = 0;
+    std::shared_ptr<const FftPlan> rowPlan;
+    std::shared_ptr<const FftPlan> colPlan;
+    std::vector<Complex> row;
+    std::vector<Complex> col;
+    std::vector<Complex> work;
+    std::vector<Complex> half;
+};
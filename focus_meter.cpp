@@ -0,0 +1,130 @@
+#include "focus_meter.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <mutex>
+
+FocusMeter::FocusMeter(QObject* parent)
+    : LiveAnalyzer(parent), currentMetric(Metric::LaplacianVariance), ring(kTraceLength) {}
+
+FocusMeter::~FocusMeter() {
+    stopAnalysis();
+}
+
+void FocusMeter::setMetric(Metric m) {
+    currentMetric = m;
+    reset();
+}
+
+void FocusMeter::clearResults() {
+    QMutexLocker lk(&resultMutex);
+    head = 0;
+    filled = 0;
+    best = Sample();
+}
+
+std::vector<FocusMeter::Sample> FocusMeter::trace(int maxSamples) const {
+    QMutexLocker lk(&resultMutex);
+    const int n = std::min(filled, std::max(0, maxSamples));
+    std::vector<Sample> out;
+    out.reserve(n);
+    for (int k = n; k > 0; --k) out.push_back(ring[(head - k + kTraceLength) % kTraceLength]);
+    return out;
+}
+
+bool FocusMeter::hasSamples() const {
+    QMutexLocker lk(&resultMutex);
+    return filled > 0;
+}
+
+FocusMeter::Sample FocusMeter::latest() const {
+    QMutexLocker lk(&resultMutex);
+    return filled ? ring[(head - 1 + kTraceLength) % kTraceLength] : Sample();
+}
+
+FocusMeter::Sample FocusMeter::peak() const {
+    QMutexLocker lk(&resultMutex);
+    return best;
+}
+
+void FocusMeter::analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) {
+    Sample s;
+    s.time = meta.timestamp;
+    s.framestamp = meta.framestamp;
+    s.score = score(img, roi, currentMetric.load(), workThreads);
+    QMutexLocker lk(&resultMutex);
+    ring[head] = s;
+    head = (head + 1) % kTraceLength;
+    filled = std::min(filled + 1, kTraceLength);
+    if (filled == 1 || s.score > best.score) best = s;
+}
+
+double FocusMeter::score(const QImage& img, const QRect& roi, Metric m, int threads) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    const QRect r = roi.intersected(src.rect());
+    const int w = r.width();
+    if (w < 3 || r.height() < 3) return 0.0;
+
+    // 16-bit rows are read in place; 8-bit rows are widened into a per-band buffer.
+    auto rowAt = [&](int y, uint16_t* scratch) -> const uint16_t* {
+        if (deep) return reinterpret_cast<const uint16_t*>(src.constScanLine(y)) + r.left();
+        simd::widenU8ToU16(src.constScanLine(y) + r.left(), scratch, static_cast<size_t>(w));
+        return scratch;
+    };
+
+    std::mutex merge;
+    double total = 0.0;
+    double totalSq = 0.0;
+    double count = 0.0;
+    switch (m) {
+    case Metric::LaplacianVariance:
+        // Interior rows only; each band reads one row above and below it.
+        parallelBands(r.height() - 2, threads, [&](int y0, int y1) {
+            std::vector<uint16_t> scratch(deep ? 0 : static_cast<size_t>(w) * 3);
+            int64_t sum = 0;
+            double sumSq = 0.0;
+            for (int y = r.top() + 1 + y0; y < r.top() + 1 + y1; ++y) {
+                const uint16_t* up = rowAt(y - 1, scratch.data());
+                const uint16_t* mid = rowAt(y, scratch.data() + (deep ? 0 : w));
+                const uint16_t* down = rowAt(y + 1, scratch.data() + (deep ? 0 : 2 * w));
+                simd::laplacianMomentsU16(up, mid, down, static_cast<size_t>(w), sum, sumSq);
+            }
+            std::lock_guard<std::mutex> lk(merge);
+            total += static_cast<double>(sum);
+            totalSq += sumSq;
+        });
+        count = static_cast<double>(w - 2) * (r.height() - 2);
+        break;
+    case Metric::Brenner:
+        parallelBands(r.height(), threads, [&](int y0, int y1) {
+            std::vector<uint16_t> scratch(deep ? 0 : static_cast<size_t>(w));
+            uint64_t a = 0, b = 0, sq = 0;
+            for (int y = r.top() + y0; y < r.top() + y1; ++y) {
+                const uint16_t* row = rowAt(y, scratch.data());
+                simd::pairStatsU16(row + 2, row, static_cast<size_t>(w - 2), a, b, sq);
+            }
+            std::lock_guard<std::mutex> lk(merge);
+            totalSq += static_cast<double>(sq);
+        });
+        count = static_cast<double>(w - 2) * r.height();
+        return totalSq / count;
+    case Metric::NormalizedVariance:
+        parallelBands(r.height(), threads, [&](int y0, int y1) {
+            std::vector<uint16_t> scratch(deep ? 0 : static_cast<size_t>(w));
+            uint64_t sum = 0, sumSq = 0;
+            for (int y = r.top() + y0; y < r.top() + y1; ++y) {
+                simd::momentsU16(rowAt(y, scratch.data()), static_cast<size_t>(w), sum, sumSq);
+            }
+            std::lock_guard<std::mutex> lk(merge);
+            total += static_cast<double>(sum);
+            totalSq += static_cast<double>(sumSq);
+        });
+        count = static_cast<double>(w) * r.height();
+        break;
+    }
+    const double mean = total / count;
+    const double variance = std::max(0.0, totalSq / count - mean * mean);
+    if (m == Metric::NormalizedVariance) return mean > 0.0 ? variance / mean : 0.0;
+    return variance;
+}
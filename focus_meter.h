@@ -0,0 +1,54 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <vector>
+#include "live_analyzer.h"
+
+// Focus score of every acquired frame (or of the ROI), with a trace and
+// peak hold for stage sweeps. Scores are normalised per pixel, so changing
+// the ROI size does not change the scale.
+class FocusMeter : public LiveAnalyzer {
+    Q_OBJECT
+public:
+    enum class Metric {
+        LaplacianVariance,   // variance of the 4-neighbour Laplacian
+        Brenner,             // mean of (I(x+2) - I(x))^2
+        NormalizedVariance   // intensity variance / mean
+    };
+    struct Sample {
+        double time = 0.0;      // camera timestamp, seconds
+        qint64 framestamp = 0;
+        double score = 0.0;
+    };
+
+    explicit FocusMeter(QObject* parent=nullptr);
+    ~FocusMeter() override;
+
+    // Scores of different metrics are not comparable; this resets the trace.
+    void setMetric(Metric m);
+    Metric metric() const { return currentMetric.load(); }
+
+    // Newest samples, oldest first, at most maxSamples.
+    std::vector<Sample> trace(int maxSamples) const;
+    bool hasSamples() const;
+    Sample latest() const;
+    Sample peak() const;
+
+    // One frame's score; the rows of larger ROIs are split over `threads`.
+    static double score(const QImage& img, const QRect& roi, Metric m, int threads);
+
+protected:
+    void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) override;
+    void clearResults() override;
+
+private:
+    static constexpr int kTraceLength = 4096;
+
+    std::atomic<Metric> currentMetric;
+    mutable QMutex resultMutex;
+    std::vector<Sample> ring;   // kTraceLength slots
+    int head = 0;
+    int filled = 0;
+    Sample best;
+};
@@ -1,5 +1,6 @@
 #include "frame_grabber.h"
 #include "dcam_controller.h"
+#include "hot_pixels.h"
 
 FrameGrabber::FrameGrabber(DcamController* ctrl, QObject* parent)
     : QThread(parent), controller(ctrl), running(false), displayEvery(1) {}
@@ -8,6 +9,21 @@ void FrameGrabber::setDisplayEvery(int n) {
     displayEvery = std::max(1, n);
 }
 
+void FrameGrabber::setHotPixels(std::shared_ptr<const HotPixelMap> map) {
+    QMutexLocker lk(&hotPixelMutex);
+    hotPixels = std::move(map);
+}
+
+void FrameGrabber::setDisplayBinning(const SoftwareBinning::Settings& s) {
+    QMutexLocker lk(&binningMutex);
+    displayBinning = s;
+}
+
+SoftwareBinning::Settings FrameGrabber::displayBinningSettings() {
+    QMutexLocker lk(&binningMutex);
+    return displayBinning;
+}
+
 void FrameGrabber::startGrabbing() {
     running = true;
     if (!isRunning()) start();
@@ -49,8 +65,17 @@ void FrameGrabber::run() {
             QImage img;
             FrameMeta meta;
             if (controller->lockLatestFrame(img, meta)) {
+                std::shared_ptr<const HotPixelMap> hp;
+                {
+                    QMutexLocker lk(&hotPixelMutex);
+                    hp = hotPixels;
+                }
+                if (hp) hp->correct(img);
                 if (recordHook) {
-                    recordHook(img);
+                    recordHook(img, meta);
+                }
+                if (processHook) {
+                    processHook(img, meta);
                 }
                 framesThisSecond++;
                 if (secondTimer.elapsed() >= 1000) {
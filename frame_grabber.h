@@ -3,9 +3,12 @@
 #include <QtGui>
 #include <atomic>
 #include "frame_types.h"
+#include "software_binning.h"
 #include <functional>
+#include <memory>
 
 class DcamController;
+class HotPixelMap;
 
 class FrameGrabber : public QThread {
     Q_OBJECT
@@ -15,7 +18,16 @@ public:
     void setDisplayEvery(int n);
     void startGrabbing();
     void stopGrabbing();
-    void setRecordHook(std::function<void(const QImage&)> hook) { recordHook = std::move(hook); }
+    void setRecordHook(std::function<void(const QImage&, const FrameMeta&)> hook) { recordHook = std::move(hook); }
+    // Sees every acquired frame, like the record hook; must only hand it off.
+    void setProcessHook(std::function<void(const QImage&, const FrameMeta&)> hook) { processHook = std::move(hook); }
+    // Hot pixels are fixed in place before any hook sees the frame; the cost
+    // scales with the number of hot pixels. Null disables correction.
+    void setHotPixels(std::shared_ptr<const HotPixelMap> map);
+    // Binning the consumers apply to the frames they are handed; this
+    // thread only passes it on, so every frame here stays full resolution.
+    void setDisplayBinning(const SoftwareBinning::Settings& s);
+    SoftwareBinning::Settings displayBinningSettings();
 
 signals:
     void frameReady(const QImage& img, FrameMeta meta, double fps);
@@ -27,5 +39,10 @@ private:
     DcamController* controller;
     std::atomic<bool> running;
     int displayEvery;
-    std::function<void(const QImage&)> recordHook;
+    std::function<void(const QImage&, const FrameMeta&)> recordHook;
+    std::function<void(const QImage&, const FrameMeta&)> processHook;
+    QMutex hotPixelMutex;
+    std::shared_ptr<const HotPixelMap> hotPixels;
+    QMutex binningMutex;
+    SoftwareBinning::Settings displayBinning;  // guarded by binningMutex
 };
@@ -0,0 +1,496 @@
+#include "frame_processor.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <QtGui/QColor>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr size_t kQueueDepth = 4;
+constexpr int kMaxWindow = 64;            // further capped by kMaxWindowBytes
+constexpr qint64 kMinEmitIntervalMs = 15; // same cap as the grabber's UI updates
+constexpr int kMaxVarianceWindow = 1000;
+
+// Blue (quiet) through green and yellow to red (noisy).
+const std::array<QRgb, 256>& noiseColours() {
+    static const std::array<QRgb, 256> lut = [](){
+        std::array<QRgb, 256> t{};
+        for (int i = 0; i < 256; ++i) t[i] = QColor::fromHsv(240 - i * 240 / 255, 255, 255).rgb();
+        return t;
+    }();
+    return lut;
+}
+
+// Value at fraction q of a strided sample of v.
+float samplePercentile(const std::vector<float>& v, double q, bool sqrtValues) {
+    if (v.empty()) return 0.0f;
+    const size_t stride = std::max<size_t>(1, v.size() / 65536);
+    std::vector<float> sample;
+    sample.reserve(v.size() / stride + 1);
+    for (size_t i = 0; i < v.size(); i += stride) sample.push_back(sqrtValues ? std::sqrt(std::max(0.0f, v[i])) : v[i]);
+    auto it = sample.begin() + static_cast<std::ptrdiff_t>(q * (sample.size() - 1));
+    std::nth_element(sample.begin(), it, sample.end());
+    return *it;
+}
+}
+
+FrameProcessor::FrameProcessor(QObject* parent)
+    : QThread(parent), currentMode(Mode::Raw), windowFrames(8), appliedWindow(0), alpha(0.1f),
+      resetRequested(false), running(false), dropped(0), correctDisplay(false), captureRemaining(0),
+      captureReset(false), varianceWindow(100), overlayOpacity(0.7f), varianceRange(0.0f), shownRange(0.0), snapshotRequested(false), pairRemaining(0), pairReset(false),
+      workThreads(std::clamp(QThread::idealThreadCount() / 2, 1, 4)) {}
+
+FrameProcessor::~FrameProcessor() {
+    stopProcessing();
+}
+
+void FrameProcessor::setMode(Mode m) {
+    currentMode = m;
+    resetRequested = true;
+    ensureRunning();
+}
+
+void FrameProcessor::ensureRunning() {
+    if (isActive() && !isRunning()) {
+        running = true;
+        start();
+    }
+}
+
+bool FrameProcessor::isActive() const {
+    return currentMode.load() != Mode::Raw || correctDisplay.load() || captureRemaining.load() > 0 ||
+           pairRemaining.load() > 0;
+}
+
+void FrameProcessor::setCalibration(std::shared_ptr<const Calibration> cal) {
+    QMutexLocker lk(&calibrationMutex);
+    calibration = std::move(cal);
+}
+
+std::shared_ptr<const Calibration> FrameProcessor::calibrationMaps() const {
+    QMutexLocker lk(&calibrationMutex);
+    return calibration;
+}
+
+void FrameProcessor::setCorrectDisplay(bool on) {
+    correctDisplay = on;
+    resetRequested = true;
+    ensureRunning();
+}
+
+void FrameProcessor::setBinning(const SoftwareBinning::Settings& s) {
+    QMutexLocker lk(&calibrationMutex);
+    binning = s;
+}
+
+void FrameProcessor::captureStack(int frames, StackDone done) {
+    {
+        QMutexLocker lk(&calibrationMutex);
+        captureDone = std::move(done);
+    }
+    captureReset = true;
+    captureRemaining = std::max(1, frames);
+    ensureRunning();
+}
+
+bool FrameProcessor::cancelStack() {
+    const bool pending = captureRemaining.exchange(0) > 0;
+    QMutexLocker lk(&calibrationMutex);
+    captureDone = nullptr;
+    return pending;
+}
+
+void FrameProcessor::capturePairs(int pairs, const QRect& roi, int skipFrames, PairsDone done) {
+    {
+        QMutexLocker lk(&calibrationMutex);
+        pairsDone = std::move(done);
+        pairRoi = roi;
+        pairSkip = std::max(0, skipFrames);
+    }
+    {
+        // Anything queued was exposed before the caller changed the settings.
+        QMutexLocker lk(&queueMutex);
+        queue.clear();
+    }
+    pairReset = true;
+    pairRemaining = std::max(1, pairs);
+    ensureRunning();
+}
+
+void FrameProcessor::cancelPairs() {
+    pairRemaining = 0;
+    QMutexLocker lk(&calibrationMutex);
+    pairsDone = nullptr;
+}
+
+void FrameProcessor::setWindow(int frames) {
+    windowFrames = std::clamp(frames, 1, kMaxWindow);
+    resetRequested = true;
+}
+
+qint64 FrameProcessor::windowBytes(Mode m, int width, int height, int frames) {
+    if (m == Mode::RollingMedian || m == Mode::BackgroundSubtract) return TemporalMedian::memoryBytes(width, height, frames);
+    if (m != Mode::RollingMean) return 0;
+    // Ring of 16-bit frames plus the 32-bit running sum.
+    return static_cast<qint64>(width) * height * (2 * frames + 4);
+}
+
+void FrameProcessor::setVarianceWindow(int frames) {
+    varianceWindow = std::clamp(frames, 2, kMaxVarianceWindow);
+}
+
+void FrameProcessor::setOverlayOpacity(double opacity) {
+    overlayOpacity = static_cast<float>(std::clamp(opacity, 0.0, 1.0));
+}
+
+void FrameProcessor::setVarianceRange(double sigma) {
+    varianceRange = static_cast<float>(std::max(0.0, sigma));
+}
+
+void FrameProcessor::requestVarianceSnapshot(StackDone done) {
+    {
+        QMutexLocker lk(&calibrationMutex);
+        snapshotDone = std::move(done);
+    }
+    snapshotRequested = true;
+}
+
+void FrameProcessor::setAlpha(double a) {
+    alpha = static_cast<float>(std::clamp(a, 0.001, 1.0));
+}
+
+void FrameProcessor::submit(const QImage& img, const FrameMeta& meta) {
+    if (!isActive() || img.isNull()) return;
+    QMutexLocker lk(&queueMutex);
+    if (queue.size() >= kQueueDepth) {
+        queue.pop_front();
+        ++dropped;
+    }
+    queue.push_back({img, meta});
+    queueCond.wakeOne();
+}
+
+void FrameProcessor::stopProcessing() {
+    running = false;
+    {
+        QMutexLocker lk(&queueMutex);
+        queue.clear();
+        queueCond.wakeAll();
+    }
+    wait(5000);
+}
+
+void FrameProcessor::run() {
+    QElapsedTimer emitTimer;
+    emitTimer.start();
+    qint64 lastEmitMs = -kMinEmitIntervalMs;
+    while (running) {
+        Pending item;
+        {
+            QMutexLocker lk(&queueMutex);
+            if (queue.empty()) queueCond.wait(&queueMutex, 100);
+            if (!running) break;
+            if (!queue.empty()) {
+                item = std::move(queue.front());
+                queue.pop_front();
+            }
+        }
+        if (item.image.isNull() || !isActive()) {
+            // Idle or back to plain raw display: release the accumulators.
+            if (!isActive() && !frameSize.isEmpty()) clearState();
+            continue;
+        }
+        if (captureRemaining.load() > 0) captureFrame(item.image);
+        if (pairRemaining.load() > 0) capturePair(item.image);
+        if (currentMode.load() == Mode::Raw && !correctDisplay.load()) continue;
+
+        // Correct first, so every display mode accumulates calibrated data.
+        QImage frame = item.image;
+        if (correctDisplay.load()) {
+            std::shared_ptr<const Calibration> cal = calibrationMaps();
+            if (cal && cal->matches(frame)) frame = cal->apply(frame, 2);
+        }
+        SoftwareBinning::Settings bin;
+        {
+            QMutexLocker lk(&calibrationMutex);
+            bin = binning;
+        }
+        frame = SoftwareBinning::apply(frame, bin, workThreads);
+        if (currentMode.load() == Mode::Raw) {
+            rawResult = frame;
+            frameSize = frame.size();
+            accumulated = 1;
+        } else {
+            rawResult = QImage();
+            process(frame);
+            if (activeMode == Mode::TemporalVariance && snapshotRequested.exchange(false)) deliverVarianceSnapshot();
+        }
+        if (emitTimer.elapsed() - lastEmitMs >= kMinEmitIntervalMs) {
+            lastEmitMs = emitTimer.elapsed();
+            emit frameReady(result(), item.meta, accumulated);
+        }
+    }
+    clearState();
+}
+
+void FrameProcessor::captureFrame(const QImage& img) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    const int w = src.width();
+    const size_t n = static_cast<size_t>(w) * src.height();
+    if (captureReset.exchange(false) || captureSize != src.size() || captureSum.size() != n) {
+        // New stack, or geometry changed mid-stack: start over.
+        captureSize = src.size();
+        captureSum.assign(n, 0);
+        captureSumSq.assign(n, 0);
+        captureFrames = 0;
+    }
+    std::vector<uint16_t> row(deep ? 0 : w);
+    for (int y = 0; y < src.height(); ++y) {
+        const uint16_t* in = reinterpret_cast<const uint16_t*>(src.constScanLine(y));
+        if (!deep) {
+            simd::widenU8ToU16(src.constScanLine(y), row.data(), static_cast<size_t>(w));
+            in = row.data();
+        }
+        const size_t base = static_cast<size_t>(y) * w;
+        simd::accumulateU16(captureSum.data() + base, in, nullptr, static_cast<size_t>(w));
+        quint64* sq = captureSumSq.data() + base;
+        for (int x = 0; x < w; ++x) sq[x] += static_cast<quint64>(in[x]) * in[x];
+    }
+    ++captureFrames;
+    if (--captureRemaining == 0) finishCapture();
+}
+
+void FrameProcessor::finishCapture() {
+    const size_t n = captureSum.size();
+    std::vector<float> mean(n);
+    std::vector<float> variance(n);
+    const double inv = 1.0 / captureFrames;
+    for (size_t i = 0; i < n; ++i) {
+        const double m = captureSum[i] * inv;
+        mean[i] = static_cast<float>(m);
+        variance[i] = static_cast<float>(std::max(0.0, captureSumSq[i] * inv - m * m));
+    }
+    StackDone done;
+    {
+        QMutexLocker lk(&calibrationMutex);
+        done.swap(captureDone);
+    }
+    const QSize size = captureSize;
+    captureSum.clear();
+    captureSumSq.clear();
+    captureSize = QSize();
+    captureFrames = 0;
+    if (done) done(size, std::move(mean), std::move(variance));
+}
+
+void FrameProcessor::capturePair(const QImage& img) {
+    {
+        QMutexLocker lk(&calibrationMutex);
+        if (pairReset.exchange(false)) pairStats.reset(pairRoi);
+        if (pairSkip > 0) {
+            --pairSkip;
+            return;
+        }
+    }
+    const int before = pairStats.pairs();
+    pairStats.add(img, workThreads);
+    if (pairStats.pairs() == before || --pairRemaining > 0) return;
+    PairsDone done;
+    {
+        QMutexLocker lk(&calibrationMutex);
+        done.swap(pairsDone);
+    }
+    if (done) done(pairStats.mean(), pairStats.variance(), pairStats.pairs());
+}
+
+void FrameProcessor::deliverVarianceSnapshot() {
+    StackDone done;
+    {
+        QMutexLocker lk(&calibrationMutex);
+        done.swap(snapshotDone);
+    }
+    if (done && !varVar.empty()) done(frameSize, varMean, varVar);
+}
+
+void FrameProcessor::clearState() {
+    frameSize = QSize();
+    rawResult = QImage();
+    input.clear();
+    sum.clear();
+    ring.clear();
+    ema.clear();
+    peak.clear();
+    varMean.clear();
+    varVar.clear();
+    median.reset();
+    ringHead = 0;
+    ringFill = 0;
+    accumulated = 0;
+}
+
+void FrameProcessor::process(const QImage& img) {
+    const Mode m = currentMode.load();
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    // A new mode, geometry or depth (after Apply) starts from scratch.
+    if (resetRequested.exchange(false) || m != activeMode || src.size() != frameSize || eightBit == deep) {
+        clearState();
+        activeMode = m;
+        frameSize = src.size();
+        eightBit = !deep;
+    }
+    const int w = src.width();
+    const int h = src.height();
+    const size_t n = static_cast<size_t>(w) * h;
+    input.resize(n);
+    for (int y = 0; y < h; ++y) {
+        uint16_t* row = input.data() + static_cast<size_t>(y) * w;
+        if (deep) std::memcpy(row, src.constScanLine(y), static_cast<size_t>(w) * sizeof(uint16_t));
+        else simd::widenU8ToU16(src.constScanLine(y), row, static_cast<size_t>(w));
+    }
+
+    // The longest window up to the requested one that fits the memory cap.
+    auto fittedWindow = [&](){
+        int frames = windowFrames.load();
+        while (frames > 1 && windowBytes(m, w, h, frames) > kMaxWindowBytes) --frames;
+        appliedWindow = frames;
+        return frames;
+    };
+
+    switch (m) {
+    case Mode::RollingMean: {
+        if (sum.empty()) {
+            sum.assign(n, 0);
+            ring.assign(fittedWindow(), std::vector<uint16_t>());
+        }
+        const int window = static_cast<int>(ring.size());
+        std::vector<uint16_t>& slot = ring[ringHead];
+        // Add the new frame and drop the one leaving the window in one pass.
+        simd::accumulateU16(sum.data(), input.data(), slot.empty() ? nullptr : slot.data(), n);
+        slot.swap(input);
+        ringHead = (ringHead + 1) % window;
+        ringFill = std::min(ringFill + 1, window);
+        accumulated = ringFill;
+        break;
+    }
+    case Mode::ExponentialMean:
+        if (ema.empty()) {
+            ema.assign(input.begin(), input.end());
+        } else {
+            simd::emaU16(ema.data(), input.data(), n, alpha.load());
+        }
+        ++accumulated;
+        break;
+    case Mode::RunningMax:
+        if (peak.empty()) peak = input;
+        else simd::maxU16(peak.data(), input.data(), n);
+        ++accumulated;
+        break;
+    case Mode::TemporalVariance: {
+        if (varMean.empty()) {
+            varMean.assign(n, 0.0f);
+            varVar.assign(n, 0.0f);
+        }
+        ++accumulated;
+        // 1/k gives the exact Welford variance of the first frames, until it
+        // drops below 2 / (N + 1) at k = (N + 1) / 2; after that the weights
+        // decay with the configured window.
+        const float a = std::max(2.0f / (varianceWindow.load() + 1), 1.0f / accumulated);
+        parallelBands(h, workThreads, [&](int y0, int y1){
+            const size_t base = static_cast<size_t>(y0) * w;
+            simd::ewVarianceU16(varMean.data() + base, varVar.data() + base, input.data() + base,
+                                static_cast<size_t>(y1 - y0) * w, a);
+        });
+        break;
+    }
+    case Mode::RollingMedian:
+    case Mode::BackgroundSubtract:
+        if (median.isEmpty()) median.configure(fittedWindow(), TemporalMedian::Statistic::Median, 0.0);
+        median.push(input.data(), w, h, workThreads);
+        accumulated = median.filled();
+        break;
+    case Mode::Raw:
+        break;
+    }
+}
+
+QImage FrameProcessor::result() const {
+    if (!rawResult.isNull()) return rawResult;
+    if (frameSize.isEmpty()) return {};
+    if (activeMode == Mode::TemporalVariance) return varianceOverlay();
+    const int w = frameSize.width();
+    const int h = frameSize.height();
+    const size_t n = static_cast<size_t>(w) * h;
+    std::vector<uint16_t> out(n);
+    switch (activeMode) {
+    case Mode::RollingMean:
+        simd::scaleU32ToU16(sum.data(), out.data(), n, 1.0f / std::max(1, ringFill));
+        break;
+    case Mode::ExponentialMean:
+        simd::floatToU16(ema.data(), out.data(), n);
+        break;
+    case Mode::RunningMax:
+        out = peak;
+        break;
+    case Mode::RollingMedian:
+        median.compute(out.data(), workThreads);
+        break;
+    case Mode::BackgroundSubtract:
+        median.compute(out.data(), workThreads);
+        TemporalMedian::subtract(input.data(), out.data(), 0, out.data(), n);
+        break;
+    case Mode::TemporalVariance:
+    case Mode::Raw:
+        return {};
+    }
+    QImage img(w, h, eightBit ? QImage::Format_Grayscale8 : QImage::Format_Grayscale16);
+    for (int y = 0; y < h; ++y) {
+        const uint16_t* row = out.data() + static_cast<size_t>(y) * w;
+        if (eightBit) simd::windowU16ToU8(row, img.scanLine(y), static_cast<size_t>(w), 0, 255);
+        else std::memcpy(img.scanLine(y), row, static_cast<size_t>(w) * sizeof(uint16_t));
+    }
+    return img;
+}
+
+QImage FrameProcessor::varianceOverlay() const {
+    if (varVar.empty() || input.size() != varVar.size()) return {};
+    const int w = frameSize.width();
+    const int h = frameSize.height();
+    // Auto ranges come from strided samples, so they cost the same at any
+    // frame size: 0.5 / 99.5 percentiles of the mean for the grey base and
+    // the 99.5th percentile of sigma for the top of the colour scale.
+    float range = varianceRange.load();
+    if (range <= 0.0f) range = std::max(0.5f, samplePercentile(varVar, 0.995, true));
+    shownRange = range;
+    const int black = static_cast<int>(samplePercentile(varMean, 0.005, false));
+    const int white = std::max(black + 1, static_cast<int>(samplePercentile(varMean, 0.995, false)));
+    const float scale = 255.0f / range;
+    const int alpha = static_cast<int>(std::lround(overlayOpacity.load() * 256.0f));
+    const std::array<QRgb, 256>& lut = noiseColours();
+
+    QImage img(w, h, QImage::Format_RGB32);
+    // One row pointer for the bands: scanLine() detaches on every call.
+    uchar* dst = img.bits();
+    const qsizetype bpl = img.bytesPerLine();
+    parallelBands(h, workThreads, [&](int y0, int y1){
+        std::vector<uint8_t> grey(static_cast<size_t>(w));
+        std::vector<uint8_t> level(static_cast<size_t>(w));
+        for (int y = y0; y < y1; ++y) {
+            const size_t base = static_cast<size_t>(y) * w;
+            simd::windowU16ToU8(input.data() + base, grey.data(), static_cast<size_t>(w), black, white);
+            simd::stdDevToU8(varVar.data() + base, level.data(), static_cast<size_t>(w), scale);
+            QRgb* out = reinterpret_cast<QRgb*>(dst + y * bpl);
+            for (int x = 0; x < w; ++x) {
+                const int g = grey[x];
+                const QRgb c = lut[level[x]];
+                out[x] = qRgb(g + (((qRed(c) - g) * alpha) >> 8),
+                              g + (((qGreen(c) - g) * alpha) >> 8),
+                              g + (((qBlue(c) - g) * alpha) >> 8));
+            }
+        }
+    });
+    return img;
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "calibration.h"
+#include "frame_types.h"
+#include "photon_transfer.h"
+#include "software_binning.h"
+#include "temporal_median.h"
+
+// Live display processing off the acquisition thread. The grabber hands
+// every acquired frame to submit(), which only queues it; accumulation runs
+// here, on native 16-bit data with 32-bit accumulators, and the result is
+// emitted at display rate. Recording is untouched: the record hook still
+// sees the raw frames.
+class FrameProcessor : public QThread {
+    Q_OBJECT
+public:
+    enum class Mode { Raw, RollingMean, ExponentialMean, RunningMax, TemporalVariance, RollingMedian, BackgroundSubtract };
+
+    explicit FrameProcessor(QObject* parent=nullptr);
+    ~FrameProcessor() override;
+
+    void setMode(Mode m);
+    Mode mode() const { return currentMode.load(); }
+    // True when frameReady output should replace the grabber's raw frames.
+    bool replacesDisplay() const { return currentMode.load() != Mode::Raw || correctDisplay.load(); }
+    // Frames in the rolling mean and median windows (1..64). The median
+    // modes sort per pixel up to 16 frames and keep each pixel's samples
+    // sorted beyond that; BackgroundSubtract shows the newest frame minus
+    // the median, clamped at zero. Every frame in the window is kept, so
+    // the window is shortened to fit kMaxWindowBytes at large frame sizes;
+    // windowInUse() is the length actually applied.
+    void setWindow(int frames);
+    int windowInUse() const { return appliedWindow.load(); }
+    static constexpr qint64 kMaxWindowBytes = qint64(256) << 20;
+    // Window state of the rolling modes at this frame size.
+    static qint64 windowBytes(Mode m, int width, int height, int frames);
+    // Weight of the newest frame in the exponential mean.
+    void setAlpha(double a);
+    // Temporal variance: exponentially weighted Welford over an effective
+    // window of 2..1000 frames (alpha = 2 / (N + 1)). The k-th frame gets
+    // weight 1/k while that is larger, so the first (N + 1) / 2 frames give
+    // the exact variance. Only the per-pixel mean and variance are kept.
+    void setVarianceWindow(int frames);
+    // Shown as the standard deviation in false colour over the live frame.
+    // opacity 0..1; range is the sigma (DN) at the top of the colour scale,
+    // 0 picks the 99.5th percentile of the current map.
+    void setOverlayOpacity(double opacity);
+    void setVarianceRange(double sigma);
+    double shownVarianceRange() const { return shownRange.load(); }
+    // Restart accumulation with the next frame.
+    void reset() { resetRequested = true; }
+
+    // Dark/flat correction ahead of the display modes. The maps are shared
+    // read-only; replacing them swaps the pointer.
+    void setCalibration(std::shared_ptr<const Calibration> cal);
+    std::shared_ptr<const Calibration> calibrationMaps() const;
+    void setCorrectDisplay(bool on);
+    bool correctsDisplay() const { return correctDisplay.load(); }
+    // Software binning after correction and ahead of the display modes, so
+    // the accumulators run at the binned size. Captures stay full frame.
+    void setBinning(const SoftwareBinning::Settings& s);
+    // Averages the next `frames` raw frames and hands the per-pixel mean and
+    // temporal variance to `done` on the processing thread.
+    using StackDone = std::function<void(const QSize& size, std::vector<float> mean, std::vector<float> variance)>;
+    void captureStack(int frames, StackDone done);
+    // Drops a stack still being captured, e.g. when the stream stops; its
+    // `done` is never called. Returns whether one was pending.
+    bool cancelStack();
+    // Hands a copy of the current variance mean/variance maps to `done` on
+    // the processing thread after the next TemporalVariance frame.
+    void requestVarianceSnapshot(StackDone done);
+    // Photon transfer: reduces `pairs` consecutive frame pairs inside roi
+    // (empty = full frame) after dropping `skipFrames`, then hands the mean
+    // signal and pair-difference variance to `done` on the processing thread.
+    using PairsDone = std::function<void(double mean, double variance, int pairs)>;
+    void capturePairs(int pairs, const QRect& roi, int skipFrames, PairsDone done);
+    void cancelPairs();
+
+    // Called from the grabber thread; never blocks on processing. When the
+    // processor falls behind, the oldest queued frame is dropped.
+    void submit(const QImage& img, const FrameMeta& meta);
+    void stopProcessing();
+    qint64 droppedFrames() const { return dropped.load(); }
+
+signals:
+    // Same depth as the input (Grayscale8 or Grayscale16), except the RGB32
+    // overlay of TemporalVariance.
+    void frameReady(const QImage& img, FrameMeta meta, int framesAccumulated);
+
+protected:
+    void run() override;
+
+private:
+    struct Pending {
+        QImage image;
+        FrameMeta meta;
+    };
+
+    bool isActive() const;
+    void ensureRunning();
+    void captureFrame(const QImage& img);
+    void finishCapture();
+    void capturePair(const QImage& img);
+    void process(const QImage& img);
+    void deliverVarianceSnapshot();
+    QImage result() const;
+    QImage varianceOverlay() const;
+    void clearState();
+
+    std::atomic<Mode> currentMode;
+    std::atomic<int> windowFrames;
+    std::atomic<int> appliedWindow;
+    std::atomic<float> alpha;
+    std::atomic<bool> resetRequested;
+    std::atomic<bool> running;
+    std::atomic<qint64> dropped;
+    std::atomic<bool> correctDisplay;
+    std::atomic<int> captureRemaining;
+    std::atomic<bool> captureReset;
+    std::atomic<int> varianceWindow;
+    std::atomic<float> overlayOpacity;
+    std::atomic<float> varianceRange;
+    mutable std::atomic<double> shownRange;
+    std::atomic<bool> snapshotRequested;
+    std::atomic<int> pairRemaining;
+    std::atomic<bool> pairReset;
+    const int workThreads;
+
+    mutable QMutex calibrationMutex;
+    std::shared_ptr<const Calibration> calibration;
+    StackDone captureDone;              // guarded by calibrationMutex
+    StackDone snapshotDone;             // guarded by calibrationMutex
+    PairsDone pairsDone;                // guarded by calibrationMutex
+    QRect pairRoi;                      // guarded by calibrationMutex
+    int pairSkip = 0;                   // guarded by calibrationMutex
+    SoftwareBinning::Settings binning;  // guarded by calibrationMutex
+
+    QMutex queueMutex;
+    QWaitCondition queueCond;
+    std::deque<Pending> queue;
+
+    // Processing-thread state.
+    Mode activeMode = Mode::Raw;
+    QSize frameSize;
+    bool eightBit = false;
+    std::vector<uint16_t> input;        // current frame at 16 bits
+    std::vector<uint32_t> sum;          // rolling mean
+    std::vector<std::vector<uint16_t>> ring;
+    int ringHead = 0;
+    int ringFill = 0;
+    std::vector<float> ema;
+    std::vector<uint16_t> peak;         // running max
+    std::vector<float> varMean;         // temporal variance
+    std::vector<float> varVar;
+    TemporalMedian median;              // rolling median, background
+    int accumulated = 0;
+    std::vector<uint32_t> captureSum;   // calibration stack
+    std::vector<quint64> captureSumSq;
+    QSize captureSize;
+    int captureFrames = 0;
+    QImage rawResult;                   // Raw mode with correction
+    FramePairStats pairStats;           // photon transfer step
+};
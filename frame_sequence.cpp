@@ -0,0 +1,282 @@
+#include "frame_sequence.h"
+#include <QtGui/QImageReader>
+#include <algorithm>
+
+FrameSequence::FrameSequence(int cacheMB, int prefetchDepth_)
+    : kind(Source::None), fileNameWidth(6), frameCount(0), nominalFps(0.0),
+      prefetchDepth(std::max(1, prefetchDepth_)), generation(0) {
+    cache.setMaxCost(std::max(16, cacheMB) * 1024); // cost in KB
+    pool.setMaxThreadCount(2);
+}
+
+FrameSequence::~FrameSequence() {
+    close();
+}
+
+QString FrameSequence::sidecarPath(const QString& filePath, const QString& suffix) {
+    QFileInfo fi(filePath);
+    return fi.absoluteDir().absoluteFilePath(fi.completeBaseName() + suffix);
+}
+
+QString FrameSequence::open(const QString& path) {
+    close();
+    QFileInfo fi(path);
+    if (!fi.exists()) return "The selected folder or file does not exist.";
+
+    QString infoPath;
+    if (fi.isDir()) {
+        QDir dir(path);
+        QStringList filters;
+        filters << "*.tif" << "*.tiff" << "*.TIF" << "*.TIFF";
+        QStringList names = dir.entryList(filters, QDir::Files, QDir::Name);
+        for (const QString& f : names) files << dir.absoluteFilePath(f);
+        kind = Source::Folder;
+        sourcePath = dir.absolutePath();
+        frameCount = static_cast<int>(files.size());
+        if (!files.isEmpty()) fileNameWidth = QFileInfo(files.first()).completeBaseName().size();
+        infoPath = dir.absoluteFilePath("capture_info.txt");
+        indexPath = dir.absoluteFilePath("frame_index.csv");
+    } else if (fi.suffix().compare("dcraw", Qt::CaseInsensitive) == 0) {
+        QString err = container.open(fi.absoluteFilePath());
+        if (!err.isEmpty()) return err;
+        kind = Source::Container;
+        sourcePath = fi.absoluteFilePath();
+        frameCount = container.count();
+        infoPath = sidecarPath(sourcePath, "_info.txt");
+    } else {
+        QImageReader reader(fi.absoluteFilePath());
+        if (!reader.canRead()) return "Unsupported file: " + reader.errorString();
+        kind = Source::MultiPageTiff;
+        sourcePath = fi.absoluteFilePath();
+        // Page offsets are cached once, so reads seek straight to a page
+        // instead of walking the IFD chain; other formats use Qt's reader.
+        if (!tiff.open(sourcePath).isEmpty()) tiff = TiffReader();
+        frameCount = tiff.count() > 0 ? tiff.count() : std::max(1, reader.imageCount());
+        infoPath = sidecarPath(sourcePath, "_info.txt");
+        indexPath = sidecarPath(sourcePath, "_index.csv");
+    }
+    nominalFps = readFpsFromInfo(infoPath);
+
+    // Prefer per-frame camera timestamps; fall back to index / fps.
+    int n = frameCount;
+    if (kind == Source::Container) {
+        std::vector<double> times;
+        std::vector<qint64> stamps;
+        container.readTimes(0, times, stamps);
+        frameTimeline.setTimestamps(std::move(times), std::move(stamps));
+    } else {
+        frameTimeline.loadIndex(indexPath, n);
+        // Writers add the info sidecar last. Without it the recording is
+        // still in progress and frames beyond the index may be half written.
+        if (frameTimeline.count() > 0 && frameTimeline.count() < n && !QFileInfo::exists(infoPath)) {
+            n = frameTimeline.count();
+            frameCount = n;
+        }
+    }
+    if (frameTimeline.count() != n) frameTimeline.setUniform(n, nominalFps);
+    return {};
+}
+
+int FrameSequence::refresh() {
+    const int oldCount = frameCount;
+    int newCount = oldCount;
+    switch (kind) {
+    case Source::Container: {
+        RawContainerReader grown = container;
+        newCount = grown.refresh();
+        if (newCount <= oldCount) return 0;
+        std::vector<double> times;
+        std::vector<qint64> stamps;
+        grown.readTimes(oldCount, times, stamps);
+        {
+            QMutexLocker lk(&sourceMutex);
+            container = grown;
+        }
+        if (frameTimeline.count() == oldCount) frameTimeline.appendTimestamps(times, stamps);
+        break;
+    }
+    case Source::Folder: {
+        // The saver appends an index line only after the frame's file is
+        // complete, so the index tail is the list of readable frames.
+        if (frameTimeline.appendIndex(indexPath) == 0) return 0;
+        newCount = frameTimeline.count();
+        QMutexLocker lk(&sourceMutex);
+        if (files.isEmpty()) {
+            // First frames of a recording opened empty: learn the name width once.
+            QStringList names = QDir(sourcePath).entryList(QStringList() << "*.tif" << "*.tiff", QDir::Files, QDir::Name);
+            if (names.isEmpty()) return 0;
+            fileNameWidth = QFileInfo(names.first()).completeBaseName().size();
+        }
+        for (int i = static_cast<int>(files.size()); i < newCount; ++i) files << frameFileName(i);
+        break;
+    }
+    case Source::MultiPageTiff: {
+        // Only the pages linked since the last refresh are parsed.
+        TiffReader grown = tiff;
+        if (grown.isOpen()) {
+            grown.refresh();
+            QMutexLocker lk(&sourceMutex);
+            tiff = grown;
+        }
+        if (QFileInfo::exists(indexPath)) {
+            frameTimeline.appendIndex(indexPath);
+            newCount = frameTimeline.count();
+        } else if (grown.isOpen()) {
+            newCount = grown.count();
+        } else {
+            // No index to tail; walk the IFD chain again.
+            QImageReader reader(sourcePath);
+            newCount = std::max(oldCount, reader.imageCount());
+        }
+        break;
+    }
+    case Source::None:
+        return 0;
+    }
+    if (newCount <= oldCount) return 0;
+    frameCount = newCount;
+    if (frameTimeline.count() != newCount) frameTimeline.setUniform(newCount, nominalFps);
+    return newCount - oldCount;
+}
+
+QString FrameSequence::growthPath() const {
+    if (kind == Source::Container) return sourcePath;
+    if (QFileInfo::exists(indexPath)) return indexPath;
+    return kind == Source::None ? QString() : sourcePath;
+}
+
+QString FrameSequence::frameFileName(int index) const {
+    return QDir(sourcePath).absoluteFilePath(QString("%1.tiff").arg(index, fileNameWidth, 10, QChar('0')));
+}
+
+void FrameSequence::close() {
+    ++generation;
+    pool.clear();
+    pool.waitForDone();
+    QMutexLocker lk(&cacheMutex);
+    cache.clear();
+    pending.clear();
+    {
+        QMutexLocker sourceLock(&sourceMutex);
+        files.clear();
+        container = RawContainerReader();
+        tiff = TiffReader();
+    }
+    kind = Source::None;
+    sourcePath.clear();
+    indexPath.clear();
+    fileNameWidth = 6;
+    frameCount = 0;
+    frameTimeline.clear();
+    nominalFps = 0.0;
+}
+
+QString FrameSequence::directory() const {
+    if (kind == Source::Folder || kind == Source::None) return sourcePath;
+    return QFileInfo(sourcePath).absolutePath();
+}
+
+QImage FrameSequence::frame(int index, QString* error) {
+    if (index < 0 || index >= count()) return {};
+    {
+        QMutexLocker lk(&cacheMutex);
+        if (QImage* hit = cache.object(index)) return *hit;
+    }
+    QImage img = read(index, error);
+    if (!img.isNull()) store(index, img);
+    return img;
+}
+
+void FrameSequence::prefetch(int index, int direction) {
+    int step = direction < 0 ? -1 : 1;
+    quint64 gen = generation.load();
+    for (int k = 1; k <= prefetchDepth; ++k) {
+        int target = index + k * step;
+        if (target < 0 || target >= count()) break;
+        {
+            QMutexLocker lk(&cacheMutex);
+            if (cache.contains(target) || pending.contains(target)) continue;
+            pending.insert(target);
+        }
+        pool.start([this, target, gen](){
+            QImage img;
+            if (gen == generation.load()) img = read(target, nullptr);
+            QMutexLocker lk(&cacheMutex);
+            pending.remove(target);
+            if (!img.isNull() && gen == generation.load()) {
+                cache.insert(target, new QImage(img), std::max<qsizetype>(1, img.sizeInBytes() / 1024));
+            }
+        });
+    }
+}
+
+QImage FrameSequence::read(int index, QString* error) const {
+    switch (kind) {
+    case Source::Container: {
+        RawContainerReader reader;
+        {
+            QMutexLocker lk(&sourceMutex);
+            reader = container;
+        }
+        return reader.read(index, error);
+    }
+    case Source::MultiPageTiff: {
+        TiffReader pages;
+        {
+            QMutexLocker lk(&sourceMutex);
+            pages = tiff;
+        }
+        if (pages.canDecode(index)) return pages.read(index, error);
+        // Compressed or unusual pages, and files that are not TIFF.
+        QImageReader reader(sourcePath);
+        if (index > 0 && !reader.jumpToImage(index)) {
+            if (error) *error = QString("Cannot seek to page %1").arg(index + 1);
+            return {};
+        }
+        QImage img = reader.read();
+        if (img.isNull() && error) *error = reader.errorString();
+        return img;
+    }
+    case Source::Folder: {
+        QString file;
+        {
+            QMutexLocker lk(&sourceMutex);
+            file = files.value(index);
+        }
+        QImageReader reader(file);
+        reader.setAutoTransform(true);
+        QImage img = reader.read();
+        if (img.isNull() && error) *error = reader.errorString();
+        return img;
+    }
+    case Source::None:
+        break;
+    }
+    if (error) *error = "No recording open";
+    return {};
+}
+
+void FrameSequence::store(int index, const QImage& img) {
+    QMutexLocker lk(&cacheMutex);
+    cache.insert(index, new QImage(img), std::max<qsizetype>(1, img.sizeInBytes() / 1024));
+}
+
+double FrameSequence::readFpsFromInfo(const QString& infoPath) {
+    QFile f(infoPath);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) return 0.0;
+    QTextStream ts(&f);
+    double foundFps = 0.0;
+    while (!ts.atEnd()) {
+        QString line = ts.readLine().trimmed();
+        if (line.startsWith("Internal FPS:", Qt::CaseInsensitive) ||
+            line.startsWith("FPS:", Qt::CaseInsensitive)) {
+            QStringList parts = line.split(":");
+            if (parts.size() >= 2) {
+                bool ok = false;
+                double val = parts.last().trimmed().toDouble(&ok);
+                if (ok) foundFps = val;
+            }
+        }
+    }
+    return foundFps;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include "frame_timeline.h"
+#include "raw_container.h"
+#include "tiff_writer.h"
+
+// A recording opened for review: a TIFF folder, a multi-page TIFF or a
+// .dcraw container, with its time axis, an LRU decode cache and a private
+// prefetch pool. Each viewer pane owns one, so two sequences never evict
+// each other's frames.
+class FrameSequence {
+public:
+    enum class Source { None, Folder, MultiPageTiff, Container };
+
+    explicit FrameSequence(int cacheMB = 512, int prefetchDepth = 8);
+    ~FrameSequence();
+
+    QString open(const QString& path);
+    void close();
+    // Picks up frames appended since open() by a writer that is still
+    // running: new index lines, container records or TIFF pages. Only the
+    // tail of the index is parsed. Returns the number of new frames.
+    int refresh();
+    // File that grows with every frame; watch it to know when to refresh().
+    QString growthPath() const;
+
+    bool isOpen() const { return frameCount > 0; }
+    int count() const { return frameCount; }
+    Source source() const { return kind; }
+    QString path() const { return sourcePath; }
+    // Folder holding the recording (the path itself for TIFF folders).
+    QString directory() const;
+    double fps() const { return nominalFps; }
+    const FrameTimeline& timeline() const { return frameTimeline; }
+
+    // Cached frame or a synchronous decode on a miss.
+    QImage frame(int index, QString* error=nullptr);
+    // Uncached decode; safe to call from several threads at once.
+    QImage read(int index, QString* error=nullptr) const;
+    // Queue decodes of the next frames in the playback direction.
+    void prefetch(int index, int direction);
+
+    // Sidecar names for file-based recordings ("<base>_index.csv", ...).
+    static QString sidecarPath(const QString& filePath, const QString& suffix);
+
+private:
+    void store(int index, const QImage& img);
+    static double readFpsFromInfo(const QString& infoPath);
+    QString frameFileName(int index) const;
+
+    Source kind;
+    QString sourcePath;
+    QString indexPath;
+    QStringList files;          // guarded by sourceMutex while following
+    int fileNameWidth;          // zero padding of "<index>.tiff" names
+    RawContainerReader container;
+    TiffReader tiff;            // page offsets of a multi-page TIFF, when it parses
+    mutable QMutex sourceMutex;
+    std::atomic<int> frameCount;
+    FrameTimeline frameTimeline;
+    double nominalFps;
+
+    QMutex cacheMutex;
+    QCache<int, QImage> cache;
+    QSet<int> pending;
+    QThreadPool pool;
+    int prefetchDepth;
+    std::atomic<quint64> generation;
+};
@@ -0,0 +1,188 @@
+#include "frame_timeline.h"
+#include <algorithm>
+#include <cmath>
+
+void FrameTimeline::clear() {
+    times.clear();
+    framestamps.clear();
+    markerList.clear();
+    uniformCount = 0;
+    uniformFps = 0.0;
+    medianDt = 0.0;
+    jitterTol = 0.0;
+    analyzedCount = 0;
+    measured = false;
+    indexOffset = 0;
+    timeCol = 2;
+    stampCol = 1;
+}
+
+void FrameTimeline::setUniform(int count, double fps) {
+    clear();
+    if (count <= 0 || fps <= 0.0) return;
+    uniformCount = count;
+    uniformFps = fps;
+    medianDt = 1.0 / fps;
+}
+
+bool FrameTimeline::loadIndex(const QString& csvPath, int maxFrames) {
+    clear();
+    appendIndex(csvPath, maxFrames);
+    return measured;
+}
+
+int FrameTimeline::appendIndex(const QString& csvPath, int maxFrames) {
+    QFile f(csvPath);
+    if (!f.open(QIODevice::ReadOnly)) return 0;
+
+    if (indexOffset == 0) {
+        // Columns: index,framestamp,time_s[,...]. Extra columns are ignored.
+        QByteArray header = f.readLine();
+        if (!header.endsWith('\n')) return 0;
+        QList<QByteArray> names = header.trimmed().split(',');
+        for (int i = 0; i < names.size(); ++i) {
+            if (names[i].trimmed() == "time_s") timeCol = i;
+            else if (names[i].trimmed() == "framestamp") stampCol = i;
+        }
+        indexOffset = f.pos();
+    } else if (f.size() <= indexOffset) {
+        return 0;
+    }
+
+    f.seek(indexOffset);
+    const size_t oldCount = times.size();
+    while (!f.atEnd()) {
+        if (maxFrames >= 0 && static_cast<int>(times.size()) >= maxFrames) break;
+        QByteArray line = f.readLine();
+        if (!line.endsWith('\n')) break; // partially written tail, re-read next time
+        QList<QByteArray> cols = line.trimmed().split(',');
+        if (cols.size() <= std::max(timeCol, stampCol)) break;
+        bool ok = false;
+        double t = cols[timeCol].toDouble(&ok);
+        if (!ok) break;
+        times.push_back(t);
+        framestamps.push_back(cols[stampCol].toLongLong());
+        indexOffset += line.size();
+    }
+    grew(oldCount);
+    return static_cast<int>(times.size() - oldCount);
+}
+
+void FrameTimeline::setTimestamps(std::vector<double> t, std::vector<qint64> stamps) {
+    clear();
+    if (t.empty()) return;
+    times = std::move(t);
+    framestamps = std::move(stamps);
+    measured = true;
+    analyze();
+}
+
+int FrameTimeline::appendTimestamps(const std::vector<double>& t, const std::vector<qint64>& stamps) {
+    if (t.empty()) return 0;
+    if (!measured) clear();
+    const size_t oldCount = times.size();
+    times.insert(times.end(), t.begin(), t.end());
+    framestamps.insert(framestamps.end(), stamps.begin(), stamps.end());
+    grew(oldCount);
+    return static_cast<int>(t.size());
+}
+
+// Re-deriving the median over the whole recording on every poll would make
+// following a long recording quadratic, so new intervals are classified
+// against the current statistics and the full analysis reruns only each
+// time the recording doubles.
+void FrameTimeline::grew(size_t oldCount) {
+    if (times.size() == oldCount) return;
+    measured = true;
+    uniformCount = 0;
+    uniformFps = 0.0;
+    if (analyzedCount < 16 || times.size() >= 2 * analyzedCount) analyze();
+    else classifyFrom(oldCount);
+}
+
+int FrameTimeline::count() const {
+    return measured ? static_cast<int>(times.size()) : uniformCount;
+}
+
+double FrameTimeline::timeAt(int index) const {
+    if (measured) {
+        if (times.empty()) return 0.0;
+        index = std::clamp(index, 0, static_cast<int>(times.size()) - 1);
+        return times[index] - times.front();
+    }
+    if (uniformFps <= 0.0) return 0.0;
+    return static_cast<double>(index) / uniformFps;
+}
+
+qint64 FrameTimeline::framestampAt(int index) const {
+    if (index >= 0 && index < static_cast<int>(framestamps.size())) return framestamps[index];
+    return index;
+}
+
+double FrameTimeline::duration() const {
+    if (measured) {
+        if (times.empty()) return 0.0;
+        return times.back() - times.front() + medianDt;
+    }
+    if (uniformFps <= 0.0) return 0.0;
+    return static_cast<double>(uniformCount) / uniformFps;
+}
+
+int FrameTimeline::indexAtTime(double seconds) const {
+    int n = count();
+    if (n == 0) return 0;
+    if (!measured) {
+        return std::clamp(static_cast<int>(std::lround(seconds * uniformFps)), 0, n - 1);
+    }
+    double target = times.front() + seconds;
+    auto it = std::lower_bound(times.begin(), times.end(), target);
+    if (it == times.end()) return n - 1;
+    int idx = static_cast<int>(it - times.begin());
+    if (idx > 0 && (target - times[idx - 1]) < (*it - target)) --idx;
+    return idx;
+}
+
+bool FrameTimeline::isGapAt(int index) const {
+    auto it = std::lower_bound(markerList.begin(), markerList.end(), index,
+                               [](const Marker& m, int v){ return m.index < v; });
+    return it != markerList.end() && it->index == index && it->kind == MarkerKind::Gap;
+}
+
+void FrameTimeline::analyze() {
+    markerList.clear();
+    medianDt = 0.0;
+    jitterTol = 0.0;
+    analyzedCount = times.size();
+    if (times.size() < 2) return;
+
+    std::vector<double> dts(times.size() - 1);
+    for (size_t i = 1; i < times.size(); ++i) dts[i - 1] = times[i] - times[i - 1];
+
+    std::vector<double> scratch = dts;
+    auto mid = scratch.begin() + scratch.size() / 2;
+    std::nth_element(scratch.begin(), mid, scratch.end());
+    medianDt = *mid;
+    for (double& v : scratch) v = std::abs(v - medianDt);
+    std::nth_element(scratch.begin(), mid, scratch.end());
+    double mad = *mid;
+
+    jitterTol = std::max(5.0 * 1.4826 * mad, 0.1 * medianDt);
+    classifyFrom(1);
+}
+
+// Gaps: a missed camera frame or a stall of more than half a period.
+// Jitter: interval outside a robust band around the median.
+void FrameTimeline::classifyFrom(size_t first) {
+    const double gapLimit = medianDt * 1.5;
+    const bool haveStamps = framestamps.size() == times.size();
+    for (size_t i = std::max<size_t>(1, first); i < times.size(); ++i) {
+        const double dt = times[i] - times[i - 1];
+        const int index = static_cast<int>(i);
+        bool stampGap = haveStamps && framestamps[i] - framestamps[i - 1] > 1;
+        if (stampGap || (medianDt > 0.0 && dt > gapLimit)) {
+            markerList.push_back({index, MarkerKind::Gap});
+        } else if (std::abs(dt - medianDt) > jitterTol) {
+            markerList.push_back({index, MarkerKind::Jitter});
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <QtCore>
+#include <vector>
+
+// Per-frame time axis of a recording. Loaded from frame_index.csv when the
+// recording has one, otherwise synthesized from the nominal fps.
+class FrameTimeline {
+public:
+    enum class MarkerKind { Gap, Jitter };
+    struct Marker {
+        int index;
+        MarkerKind kind;
+    };
+
+    void clear();
+    void setUniform(int count, double fps);
+    bool loadIndex(const QString& csvPath, int maxFrames = -1);
+    void setTimestamps(std::vector<double> t, std::vector<qint64> stamps);
+    // Live tail: parse only the lines added to the index since the last
+    // load, or append timestamps read from a growing container. Both return
+    // the number of frames added.
+    int appendIndex(const QString& csvPath, int maxFrames = -1);
+    int appendTimestamps(const std::vector<double>& t, const std::vector<qint64>& stamps);
+
+    bool isEmpty() const { return count() == 0; }
+    bool hasTimestamps() const { return measured; }
+    int count() const;
+    double timeAt(int index) const;
+    qint64 framestampAt(int index) const;
+    double duration() const;
+    double nominalInterval() const { return medianDt; }
+    // Nearest frame to the given time; binary search over the timestamp column.
+    int indexAtTime(double seconds) const;
+    const std::vector<Marker>& markers() const { return markerList; }
+    bool isGapAt(int index) const;
+
+private:
+    void analyze();
+    void classifyFrom(size_t first);
+    void grew(size_t oldCount);
+
+    std::vector<double> times;
+    std::vector<qint64> framestamps;
+    std::vector<Marker> markerList;
+    int uniformCount = 0;
+    double uniformFps = 0.0;
+    double medianDt = 0.0;
+    double jitterTol = 0.0;
+    size_t analyzedCount = 0;   // frames the median and MAD were taken over
+    bool measured = false;
+    qint64 indexOffset = 0;     // first unparsed byte of the index file
+    int timeCol = 2;
+    int stampCol = 1;
+};
@@ -25,6 +25,8 @@ struct FrameMeta {
     int bits = 0;
     double binning = 1.0;
     qint64 frameIndex = 0;
+    qint64 framestamp = 0;   // camera frame counter, gaps mean missed frames
+    double timestamp = 0.0;  // seconds, camera clock (host clock if unavailable)
     qint64 delivered = 0;
     qint64 dropped = 0;
     double internalFps = 0.0;
@@ -0,0 +1,156 @@
+#include "hot_pixels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr char kMagic[8] = {'D','C','H','O','T','0','1','\0'};
+constexpr int kDx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+constexpr int kDy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+// Median and MAD over a subsample; a full nth_element over 5 M pixels twice
+// is not needed for a threshold.
+void robustStats(const std::vector<float>& v, float& median, float& mad) {
+    const size_t stride = std::max<size_t>(1, v.size() / 262144);
+    std::vector<float> sample;
+    sample.reserve(v.size() / stride + 1);
+    for (size_t i = 0; i < v.size(); i += stride) sample.push_back(v[i]);
+    auto mid = sample.begin() + sample.size() / 2;
+    std::nth_element(sample.begin(), mid, sample.end());
+    median = *mid;
+    for (float& x : sample) x = std::abs(x - median);
+    std::nth_element(sample.begin(), mid, sample.end());
+    mad = std::max(*mid * 1.4826f, 1e-3f);
+}
+
+template <typename T>
+void correctPixels(QImage& img, const std::vector<quint32>& hot, const std::vector<quint8>& masks) {
+    const int w = img.width();
+    const qsizetype stride = img.bytesPerLine() / static_cast<qsizetype>(sizeof(T));
+    T* base = reinterpret_cast<T*>(img.bits());
+    for (size_t k = 0; k < hot.size(); ++k) {
+        const int y = static_cast<int>(hot[k] / w);
+        const int x = static_cast<int>(hot[k] % w);
+        const quint8 mask = masks[k];
+        if (!mask) continue; // surrounded by hot pixels; leave it
+        T vals[8];
+        int n = 0;
+        for (int d = 0; d < 8; ++d) {
+            if (!(mask & (1 << d))) continue;
+            T v = base[(y + kDy[d]) * stride + x + kDx[d]];
+            // Insertion into the sorted prefix; at most eight values.
+            int j = n++;
+            while (j > 0 && vals[j - 1] > v) {
+                vals[j] = vals[j - 1];
+                --j;
+            }
+            vals[j] = v;
+        }
+        base[y * stride + x] = static_cast<T>((static_cast<int>(vals[(n - 1) / 2]) + vals[n / 2] + 1) / 2);
+    }
+}
+} // namespace
+
+HotPixelMap HotPixelMap::detect(const QSize& size, const std::vector<float>& mean,
+                                const std::vector<float>& variance, const Thresholds& t) {
+    HotPixelMap map;
+    const size_t n = static_cast<size_t>(size.width()) * size.height();
+    if (n == 0 || mean.size() != n || variance.size() != n) return map;
+    map.mapSize = size;
+
+    float meanMed = 0, meanMad = 0, varMed = 0, varMad = 0;
+    robustStats(mean, meanMed, meanMad);
+    robustStats(variance, varMed, varMad);
+    const float meanLimit = meanMed + static_cast<float>(t.meanSigma) * meanMad;
+    const float varLimit = varMed + static_cast<float>(t.varianceSigma) * varMad;
+
+    // Score by how far past the limit a pixel is, so the cap keeps the worst.
+    std::vector<std::pair<float, quint32>> flagged;
+    for (size_t i = 0; i < n; ++i) {
+        float score = std::max((mean[i] - meanLimit) / meanMad, (variance[i] - varLimit) / varMad);
+        if (score > 0.0f) flagged.push_back({score, static_cast<quint32>(i)});
+    }
+    const size_t cap = static_cast<size_t>(n * t.maxFraction);
+    if (flagged.size() > cap) {
+        std::nth_element(flagged.begin(), flagged.begin() + cap, flagged.end(),
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+        flagged.resize(cap);
+    }
+    map.hot.reserve(flagged.size());
+    for (const auto& f : flagged) map.hot.push_back(f.second);
+    std::sort(map.hot.begin(), map.hot.end());
+    map.buildNeighbours();
+    return map;
+}
+
+void HotPixelMap::buildNeighbours() {
+    neighbours.assign(hot.size(), 0);
+    const int w = mapSize.width();
+    const int h = mapSize.height();
+    for (size_t k = 0; k < hot.size(); ++k) {
+        const int y = static_cast<int>(hot[k] / w);
+        const int x = static_cast<int>(hot[k] % w);
+        quint8 mask = 0;
+        for (int d = 0; d < 8; ++d) {
+            const int nx = x + kDx[d];
+            const int ny = y + kDy[d];
+            if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+            const quint32 idx = static_cast<quint32>(ny) * w + nx;
+            if (std::binary_search(hot.begin(), hot.end(), idx)) continue;
+            mask |= static_cast<quint8>(1 << d);
+        }
+        neighbours[k] = mask;
+    }
+}
+
+void HotPixelMap::correct(QImage& img) const {
+    if (!matches(img)) return;
+    if (img.format() == QImage::Format_Grayscale16) correctPixels<quint16>(img, hot, neighbours);
+    else if (img.format() == QImage::Format_Grayscale8) correctPixels<quint8>(img, hot, neighbours);
+}
+
+QString HotPixelMap::defaultPath() {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (dir.isEmpty()) dir = QCoreApplication::applicationDirPath();
+    QDir().mkpath(dir);
+    return QDir(dir).filePath("hot_pixels.dhot");
+}
+
+// "DCHOT01\0" | u32 width | u32 height | u32 count | count x u32 index, little-endian.
+QString HotPixelMap::save(const QString& path) const {
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return f.errorString();
+    QDataStream ds(&f);
+    ds.setByteOrder(QDataStream::LittleEndian);
+    ds.writeRawData(kMagic, sizeof(kMagic));
+    ds << quint32(mapSize.width()) << quint32(mapSize.height()) << quint32(hot.size());
+    for (quint32 idx : hot) ds << idx;
+    if (ds.status() != QDataStream::Ok) return "Hot pixel map write failed";
+    return {};
+}
+
+QString HotPixelMap::load(const QString& path) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return f.errorString();
+    QDataStream ds(&f);
+    ds.setByteOrder(QDataStream::LittleEndian);
+    char magic[sizeof(kMagic)];
+    if (ds.readRawData(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        return "Not a hot pixel map";
+    }
+    quint32 w = 0, h = 0, count = 0;
+    ds >> w >> h >> count;
+    const quint64 pixels = static_cast<quint64>(w) * h;
+    if (w == 0 || h == 0 || count > pixels) return "Bad hot pixel map header";
+    std::vector<quint32> indices(count);
+    for (quint32& idx : indices) ds >> idx;
+    if (ds.status() != QDataStream::Ok) return "Hot pixel map is truncated";
+    if (!std::is_sorted(indices.begin(), indices.end()) ||
+        (!indices.empty() && indices.back() >= pixels)) {
+        return "Hot pixel map is corrupt";
+    }
+    mapSize = QSize(static_cast<int>(w), static_cast<int>(h));
+    hot = std::move(indices);
+    buildNeighbours();
+    return {};
+}
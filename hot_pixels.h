@@ -0,0 +1,43 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <vector>
+
+// Sparse map of hot and noisy pixels found in a dark stack. The map is a
+// sorted list of linear pixel indices plus, per entry, which of its eight
+// neighbours are usable, so correcting a frame costs time proportional to
+// the number of hot pixels rather than to the frame size.
+class HotPixelMap {
+public:
+    struct Thresholds {
+        double meanSigma = 6.0;       // robust sigmas above the median dark level
+        double varianceSigma = 6.0;   // robust sigmas above the median temporal variance
+        double maxFraction = 0.01;    // never flag more than this share of the sensor
+    };
+
+    // Flags pixels whose temporal mean or variance is an outlier against the
+    // median / MAD of the whole sensor.
+    static HotPixelMap detect(const QSize& size, const std::vector<float>& mean,
+                              const std::vector<float>& variance, const Thresholds& t = {});
+
+    bool isEmpty() const { return hot.empty(); }
+    int count() const { return static_cast<int>(hot.size()); }
+    QSize size() const { return mapSize; }
+    bool matches(const QImage& img) const { return !isEmpty() && img.size() == mapSize; }
+    const std::vector<quint32>& indices() const { return hot; }
+
+    // Replaces each hot pixel with the median of its non-hot 8-neighbours,
+    // in place (Grayscale8 or Grayscale16).
+    void correct(QImage& img) const;
+
+    QString save(const QString& path) const;
+    QString load(const QString& path);
+    static QString defaultPath();
+
+private:
+    void buildNeighbours();
+
+    QSize mapSize;
+    std::vector<quint32> hot;           // sorted linear indices
+    std::vector<quint8> neighbours;     // bit k: neighbour k is inside and not hot
+};
@@ -0,0 +1,96 @@
+#include "live_analyzer.h"
+#include <algorithm>
+
+LiveAnalyzer::LiveAnalyzer(QObject* parent, size_t depth)
+    : QThread(parent), workThreads(std::clamp(QThread::idealThreadCount() / 2, 1, 4)),
+      queueDepth(std::max<size_t>(1, depth)), enabled(false), running(false), resetRequested(false),
+      dropped(0), analyzed(0), decimation(1) {}
+
+LiveAnalyzer::~LiveAnalyzer() {
+    stopAnalysis();
+}
+
+void LiveAnalyzer::setEnabled(bool on) {
+    enabled = on;
+    if (on) {
+        resetRequested = true;
+        if (!isRunning()) {
+            running = true;
+            start();
+        }
+    } else {
+        QMutexLocker lk(&queueMutex);
+        queue.clear();
+    }
+}
+
+void LiveAnalyzer::setRoi(const QRect& r) {
+    QMutexLocker lk(&roiMutex);
+    roiRect = r;
+}
+
+SoftwareBinning::Settings LiveAnalyzer::binning() const {
+    QMutexLocker lk(&roiMutex);
+    return binnedAs;
+}
+
+QRect LiveAnalyzer::roi() const {
+    QMutexLocker lk(&roiMutex);
+    return roiRect;
+}
+
+void LiveAnalyzer::submit(const std::shared_ptr<SharedBinnedFrame>& frame, const FrameMeta& meta) {
+    if (!enabled.load() || !frame) return;
+    if (submitted++ % decimation.load() != 0) return;
+    QMutexLocker lk(&queueMutex);
+    if (queue.size() >= queueDepth) {
+        queue.pop_front();
+        ++dropped;
+    }
+    queue.push_back({frame, meta});
+    queueCond.wakeOne();
+}
+
+void LiveAnalyzer::stopAnalysis() {
+    running = false;
+    {
+        QMutexLocker lk(&queueMutex);
+        queue.clear();
+        queueCond.wakeAll();
+    }
+    wait(5000);
+}
+
+void LiveAnalyzer::run() {
+    while (running) {
+        Pending item;
+        {
+            QMutexLocker lk(&queueMutex);
+            if (queue.empty()) queueCond.wait(&queueMutex, 100);
+            if (!running) break;
+            if (!queue.empty()) {
+                item = std::move(queue.front());
+                queue.pop_front();
+            }
+        }
+        bool rebinned = false;
+        if (item.frame) {
+            QMutexLocker lk(&roiMutex);
+            rebinned = item.frame->settings() != binnedAs;
+            binnedAs = item.frame->settings();
+        }
+        if (resetRequested.exchange(false) || rebinned) {
+            clearResults();
+            dropped = 0;
+            analyzed = 0;
+        }
+        if (!item.frame || !enabled.load() || !wants()) continue;
+        const QImage& img = item.frame->binned(workThreads);
+        if (img.isNull()) continue;
+        QRect r = roi();
+        r = r.isEmpty() ? img.rect() : r.intersected(img.rect());
+        if (r.isEmpty()) continue;
+        analyze(img, item.meta, r);
+        ++analyzed;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include "frame_types.h"
+#include "software_binning.h"
+
+// Base for live measurements that must see every acquired frame rather
+// than the display-rate subset. Like FrameProcessor, submit() only queues
+// (the oldest frame is dropped when the thread falls behind) and the work
+// runs on this thread. Results are kept by the subclass for the GUI to poll
+// at display rate, so a 1 kHz stream never floods the event loop.
+//
+// Subclasses implement analyze() and must call stopAnalysis() in their own
+// destructor, before their members go away.
+class LiveAnalyzer : public QThread {
+    Q_OBJECT
+public:
+    explicit LiveAnalyzer(QObject* parent=nullptr, size_t queueDepth = 8);
+    ~LiveAnalyzer() override;
+
+    void setEnabled(bool on);
+    bool isEnabled() const { return enabled.load(); }
+    // Image pixels; empty = full frame. Applies from the next frame.
+    void setRoi(const QRect& r);
+    QRect roi() const;
+    // Binning of the frames behind the current results. The ROI and results
+    // are in binned pixels, matching a binned live view; a frame binned
+    // differently from the last clears the results first.
+    SoftwareBinning::Settings binning() const;
+    // Clears results on the analysis thread before the next frame.
+    void reset() { resetRequested = true; }
+    // Only every n-th submitted frame is queued, for analyses that need a
+    // rate rather than every frame. Skipped frames do not count as dropped.
+    void setDecimation(int n) { decimation = n < 1 ? 1 : n; }
+    int decimationFactor() const { return decimation.load(); }
+
+    // Called from the grabber thread; never blocks on analysis. The frame
+    // is binned (once, for every analyzer it went to) on an analysis thread.
+    void submit(const std::shared_ptr<SharedBinnedFrame>& frame, const FrameMeta& meta);
+    void stopAnalysis();
+    qint64 droppedFrames() const { return dropped.load(); }
+    qint64 analyzedFrames() const { return analyzed.load(); }
+
+protected:
+    void run() override;
+    // Asked on this thread before a queued frame is binned; a frame turned
+    // down costs nothing, so rate-limited analyses say no here rather than
+    // in analyze().
+    virtual bool wants() { return true; }
+    // roi is already clipped to the frame and never empty.
+    virtual void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) = 0;
+    virtual void clearResults() {}
+
+    // Worker threads a subclass may hand to parallelBands.
+    const int workThreads;
+
+private:
+    struct Pending {
+        std::shared_ptr<SharedBinnedFrame> frame;
+        FrameMeta meta;
+    };
+
+    const size_t queueDepth;
+    std::atomic<bool> enabled;
+    std::atomic<bool> running;
+    std::atomic<bool> resetRequested;
+    std::atomic<qint64> dropped;
+    std::atomic<qint64> analyzed;
+    std::atomic<int> decimation;
+    qint64 submitted = 0;       // grabber thread only
+    mutable QMutex roiMutex;
+    QRect roiRect;
+    SoftwareBinning::Settings binnedAs;  // guarded by roiMutex
+    QMutex queueMutex;
+    QWaitCondition queueCond;
+    std::deque<Pending> queue;
+};
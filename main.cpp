@@ -19,13 +19,40 @@
 #include <csignal>
 #include <thread>
 #include <vector>
+#include <array>
 #include <cmath>
+#include <limits>
 #include <string>
 #include <iostream>
 #include "log_teebuf.h"
 #include "frame_types.h"
 #include "dcam_controller.h"
 #include "frame_grabber.h"
+#include "frame_processor.h"
+#include "calibration.h"
+#include "hot_pixels.h"
+#include "photon_transfer.h"
+#include "focus_meter.h"
+#include "spot_tracker.h"
+#include "smlm_localizer.h"
+#include "drift_tracker.h"
+#include "power_spectrum.h"
+#include "motion_estimator.h"
+#include "blob_counter.h"
+#include "particle_tracker.h"
+#include "bleach_corrector.h"
+#include "temporal_median.h"
+#include "software_binning.h"
+#include "display_converter.h"
+#include "frame_timeline.h"
+#include "frame_sequence.h"
+#include "simd_kernels.h"
+#include "sequence_exporter.h"
+#include "video_exporter.h"
+#include "temporal_spectrum.h"
+#include "mip_pyramid.h"
+#include "avi_writer.h"
+#include "tiff_writer.h"
 
 namespace {
 QMutex gLogMutex;
@@ -34,10 +61,51 @@ QString gLogPath;
 void logMessage(const QString& msg);
 void installLogTees();
 
+// Transparent layer over the shown image for live annotations. The painter is
+// pre-scaled, so callers draw in image pixels with cosmetic pens.
+class OverlayLayer : public QWidget {
+public:
+    explicit OverlayLayer(QWidget* parent) : QWidget(parent) {
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+        setAttribute(Qt::WA_NoSystemBackground);
+        hide();
+    }
+
+    std::function<void(QPainter&)> draw;
+    double scale = 1.0;
+
+protected:
+    void paintEvent(QPaintEvent*) override {
+        if (!draw) return;
+        QPainter p(this);
+        p.setRenderHint(QPainter::Antialiasing);
+        p.scale(scale, scale);
+        draw(p);
+    }
+};
+
+// The shown image. With a render callback set it paints the exposed part
+// itself instead of drawing its pixmap.
+class ImageLabel : public QLabel {
+public:
+    std::function<void(QPainter&, const QRect&)> render;
+
+protected:
+    void paintEvent(QPaintEvent* ev) override {
+        if (!render) {
+            QLabel::paintEvent(ev);
+            return;
+        }
+        QPainter p(this);
+        render(p, ev->rect());
+    }
+};
+
 class ZoomImageView : public QScrollArea {
 public:
     ZoomImageView(QWidget* parent=nullptr)
-        : QScrollArea(parent), label(new QLabel), scale(1.0), hasImage(false), zoomSteps(0), effectiveScale(1.0) {
+        : QScrollArea(parent), label(new ImageLabel), scale(1.0), hasImage(false), zoomSteps(0), effectiveScale(1.0),
+          selecting(false) {
         label->setBackgroundRole(QPalette::Base);
         label->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
         label->setScaledContents(true); // paint-time scaling instead of allocating huge pixmaps
@@ -47,27 +115,95 @@ public:
         setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
         setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
         setMouseTracking(true);
+        selectionBand = new QRubberBand(QRubberBand::Rectangle, label);
+        selectionBand->hide();
+        overlay = new OverlayLayer(label);
+        overlay->stackUnder(selectionBand);
+        pyramidPool.setMaxThreadCount(1);
+        pyramidCache.setMaxCost(128 * 1024); // cost in KB
+    }
+
+    ~ZoomImageView() override {
+        pyramidPool.clear();
+        pyramidPool.waitForDone();
     }
 
     void setZoomChanged(const std::function<void(double)>& cb) { onZoomChanged = cb; }
+    void setSelectionChanged(const std::function<void(const QRect&)>& cb) { onSelectionChanged = cb; }
+    // Keep built pyramids per image (viewer frames are revisited); live
+    // views rebuild for each new frame instead.
+    void setCachePyramids(bool on) { cachePyramids = on; }
+    // Drawn over the image in image-pixel coordinates; nullptr removes it.
+    void setOverlayPainter(const std::function<void(QPainter&)>& cb) {
+        overlay->draw = cb;
+        overlay->setVisible(static_cast<bool>(cb));
+        overlay->update();
+    }
+    void updateOverlay() { overlay->update(); }
+
+    // ROI in image pixels, drawn with Shift+drag; empty when nothing is selected.
+    QRect selection() const { return selectionRect; }
+    void clearSelection() {
+        selectionRect = QRect();
+        selectionBand->hide();
+        if (onSelectionChanged) onSelectionChanged(selectionRect);
+    }
 
     void setImage(const QImage& img) {
         if (img.isNull()) return;
-        if (!hasImage) {
-            scale = 1.0;
-            effectiveScale = 1.0;
-            hasImage = true;
-            zoomSteps = 0;
-            if (onZoomChanged) onZoomChanged(effectiveScale);
-            if (horizontalScrollBar()) horizontalScrollBar()->setValue(0);
-            if (verticalScrollBar()) verticalScrollBar()->setValue(0);
-        }
-        // Make a deep copy so the buffer is stable while frames keep streaming.
-        lastImage = img.copy();
+        startImage();
+        // QImage data is shared copy-on-write, so holding the caller's
+        // image costs no copy and later writes to theirs leave this alone.
+        imageKey = img.cacheKey();
+        lastImage = img;
+        label->render = nullptr;
         basePixmap = QPixmap::fromImage(lastImage);
+        pyramid = MipPyramid();
+        if (cachePyramids) {
+            if (MipPyramid* hit = pyramidCache.object(imageKey)) pyramid = *hit;
+        }
+        shownLevel = -1;
         updatePixmap();
     }
 
+    // Grayscale8/16 frames through a display conversion (other formats go
+    // to setImage). The frame is kept without a copy or a pixmap; when the
+    // view paints, only the frame pixels under the viewport are converted,
+    // reduced to about screen resolution when zoomed out, into an RGB32
+    // buffer the view keeps from frame to frame.
+    void setConvertedImage(const QImage& img, const DisplayConverter::Settings& s) {
+        if (!DisplayConverter::converts(img)) {
+            setImage(img);
+            return;
+        }
+        const bool relayout = !label->render || img.size() != lastImage.size();
+        startImage();
+        imageKey = img.cacheKey();
+        lastImage = img;
+        convertSettings = s;
+        if (!label->render) {
+            basePixmap = QPixmap();
+            pyramid = MipPyramid();
+            label->clear();
+            label->render = [this](QPainter& p, const QRect& r){ paintConverted(p, r); };
+        }
+        if (relayout) updatePixmap();
+        else label->update();
+    }
+
+    // Takes another view's zoom and scroll position, so two panes showing
+    // related frames stay aligned.
+    void matchView(const ZoomImageView& other) {
+        if (!hasImage || !other.hasImage) return;
+        if (!qFuzzyCompare(scale, other.scale)) {
+            scale = other.scale;
+            zoomSteps = other.zoomSteps;
+            updatePixmap();
+        }
+        horizontalScrollBar()->setValue(other.horizontalScrollBar()->value());
+        verticalScrollBar()->setValue(other.verticalScrollBar()->value());
+    }
+
     void resetScale() {
         scale = 1.0;
         effectiveScale = 1.0;
@@ -78,6 +214,50 @@ public:
     }
 
 protected:
+    void mousePressEvent(QMouseEvent* ev) override {
+        if (ev->button() == Qt::LeftButton && (ev->modifiers() & Qt::ShiftModifier) && !lastImage.isNull()) {
+            selecting = true;
+            dragOrigin = label->mapFrom(viewport(), ev->position().toPoint());
+            selectionBand->setGeometry(QRect(dragOrigin, QSize()));
+            selectionBand->show();
+            ev->accept();
+            return;
+        }
+        QScrollArea::mousePressEvent(ev);
+    }
+
+    void mouseMoveEvent(QMouseEvent* ev) override {
+        if (selecting) {
+            QPoint p = label->mapFrom(viewport(), ev->position().toPoint());
+            selectionBand->setGeometry(QRect(dragOrigin, p).normalized().intersected(label->rect()));
+            ev->accept();
+            return;
+        }
+        QScrollArea::mouseMoveEvent(ev);
+    }
+
+    void mouseReleaseEvent(QMouseEvent* ev) override {
+        if (!selecting) {
+            QScrollArea::mouseReleaseEvent(ev);
+            return;
+        }
+        selecting = false;
+        QRect r = selectionBand->geometry();
+        if (r.width() < 3 || r.height() < 3 || effectiveScale <= 0.0) {
+            clearSelection();
+        } else {
+            int x0 = static_cast<int>(std::floor(r.left() / effectiveScale));
+            int y0 = static_cast<int>(std::floor(r.top() / effectiveScale));
+            int x1 = static_cast<int>(std::ceil((r.right() + 1) / effectiveScale));
+            int y1 = static_cast<int>(std::ceil((r.bottom() + 1) / effectiveScale));
+            selectionRect = QRect(x0, y0, x1 - x0, y1 - y0).intersected(lastImage.rect());
+            logMessage(QString("Selection %1,%2 %3x%4").arg(selectionRect.x()).arg(selectionRect.y())
+                       .arg(selectionRect.width()).arg(selectionRect.height()));
+            if (onSelectionChanged) onSelectionChanged(selectionRect);
+        }
+        ev->accept();
+    }
+
     void wheelEvent(QWheelEvent* ev) override {
         try {
             if (lastImage.isNull()) {
@@ -122,10 +302,44 @@ protected:
     }
 
 private:
+    // The first image starts at 100% from the top left.
+    void startImage() {
+        if (hasImage) return;
+        scale = 1.0;
+        effectiveScale = 1.0;
+        hasImage = true;
+        zoomSteps = 0;
+        if (onZoomChanged) onZoomChanged(effectiveScale);
+        if (horizontalScrollBar()) horizontalScrollBar()->setValue(0);
+        if (verticalScrollBar()) verticalScrollBar()->setValue(0);
+    }
+
+    // Converts the frame pixels under the exposed part of the label. Zoomed
+    // out, frame pixels are taken in whole blocks of `factor`, aligned to the
+    // frame, so the reduced image does not shimmer while panning; zoomed in,
+    // they are converted as they are and the painter scales them up.
+    void paintConverted(QPainter& p, const QRect& exposed) {
+        const double s = effectiveScale;
+        if (lastImage.isNull() || s <= 0.0) return;
+        const int factor = s >= 1.0 ? 1 : std::max(1, static_cast<int>(1.0 / s));
+        const QRect under = QRectF(exposed.x() / s, exposed.y() / s, exposed.width() / s, exposed.height() / s)
+                                .toAlignedRect();
+        const int x0 = under.left() / factor * factor;
+        const int y0 = under.top() / factor * factor;
+        const int x1 = (under.right() + factor) / factor * factor;
+        const int y1 = (under.bottom() + factor) / factor * factor;
+        const QRect src = QRect(x0, y0, x1 - x0, y1 - y0).intersected(lastImage.rect());
+        DisplayConverter::render(lastImage, src, factor, convertSettings, viewBuffer, 2);
+        if (viewBuffer.isNull()) return;
+        const double block = factor * s;
+        p.drawImage(QRectF(src.x() * s, src.y() * s, viewBuffer.width() * block, viewBuffer.height() * block),
+                    viewBuffer);
+    }
+
     double computeMaxScale() const {
-        if (basePixmap.isNull()) return 1.56;
-        int w = basePixmap.width();
-        int h = basePixmap.height();
+        if (lastImage.isNull()) return 1.56;
+        int w = lastImage.width();
+        int h = lastImage.height();
         int maxDim = (std::min(w, h) <= 256) ? 8192 : 4096;
         double dimCap = static_cast<double>(maxDim) / static_cast<double>(std::max(w, h));
         // Allow more zoom for small dimensions but cap to a sane upper bound.
@@ -134,15 +348,15 @@ private:
 
     void updatePixmap() {
         try {
-            if (basePixmap.isNull() || scale <= 0.0) return;
+            if (lastImage.isNull() || scale <= 0.0) return;
             if (updatingPixmap.test_and_set()) {
                 // Skip re-entrant calls that can happen when zooming rapidly during streaming.
                 return;
             }
-            int baseW = basePixmap.width();
-            int baseH = basePixmap.height();
+            int baseW = lastImage.width();
+            int baseH = lastImage.height();
             QSize targetSize = (scale == 1.0)
-                ? basePixmap.size()
+                ? lastImage.size()
                 : QSize(std::max(1, int(std::lround(baseW * scale))),
                         std::max(1, int(std::lround(baseH * scale))));
 
@@ -154,13 +368,22 @@ private:
                 logMessage(QString("updatePixmap clamped target to %1x%2").arg(targetSize.width()).arg(targetSize.height()));
             }
 
-            label->setPixmap(basePixmap);
+            if (!label->render) showLevel(MipPyramid::levelForScale(static_cast<double>(targetSize.width()) / baseW));
             label->resize(targetSize);
             label->setAlignment(Qt::AlignCenter);
             effectiveScale = static_cast<double>(targetSize.width()) / static_cast<double>(baseW);
+            overlay->setGeometry(label->rect());
+            overlay->scale = effectiveScale;
+            overlay->update();
+            if (!selectionRect.isEmpty() && !selecting) {
+                selectionBand->setGeometry(QRectF(selectionRect.x() * effectiveScale, selectionRect.y() * effectiveScale,
+                                                  selectionRect.width() * effectiveScale,
+                                                  selectionRect.height() * effectiveScale).toAlignedRect());
+            }
             logMessage(QString("updatePixmap scaled=%1x%2 scaleReq=%3 scaleEff=%4")
                        .arg(targetSize.width()).arg(targetSize.height())
                        .arg(scale,0,'f',2).arg(effectiveScale,0,'f',2));
+            if (label->render) label->update();
             if (onZoomChanged) onZoomChanged(effectiveScale);
             updatingPixmap.clear();
         } catch (const std::exception& e) {
@@ -172,15 +395,71 @@ private:
         }
     }
 
-    QLabel* label;
+    // Draw the pyramid level matching the zoom. Missing levels are built on
+    // the worker; until they arrive the deepest existing level is shown.
+    void showLevel(int wanted) {
+        wanted = std::min(wanted, MipPyramid::maxLevel(lastImage.size()));
+        int level = wanted;
+        if (level > 0 && pyramid.levelCount() <= level) {
+            requestPyramid(level);
+            level = std::max(0, pyramid.levelCount() - 1);
+        }
+        if (level == shownLevel) return;
+        shownLevel = level;
+        label->setPixmap(level == 0 ? basePixmap : QPixmap::fromImage(pyramid.level(level)));
+    }
+
+    void requestPyramid(int level) {
+        if (requestedKey == imageKey && requestedLevel >= level) return;
+        requestedKey = imageKey;
+        requestedLevel = level;
+        MipPyramid start = pyramid.isNull() ? MipPyramid(lastImage) : pyramid;
+        const qint64 key = imageKey;
+        // Only the newest request matters; drop any that have not started.
+        pyramidPool.clear();
+        pyramidPool.start([this, start, key, level]() mutable {
+            start.buildTo(level);
+            QMetaObject::invokeMethod(this, [this, start, key](){
+                pyramidReady(key, start);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void pyramidReady(qint64 key, const MipPyramid& built) {
+        if (cachePyramids) {
+            pyramidCache.insert(key, new MipPyramid(built), std::max<qint64>(1, built.sizeInBytes() / 1024));
+        }
+        if (key != imageKey || built.levelCount() <= pyramid.levelCount()) return;
+        pyramid = built;
+        shownLevel = -1;
+        updatePixmap();
+    }
+
+    ImageLabel* label;
     QImage lastImage;
-    QPixmap basePixmap;
+    QPixmap basePixmap;                 // plain images only
+    DisplayConverter::Settings convertSettings;
+    QImage viewBuffer;                  // converted viewport, reused between paints
+    qint64 imageKey = 0;
+    MipPyramid pyramid;
+    int shownLevel = -1;
+    qint64 requestedKey = 0;
+    int requestedLevel = 0;
+    bool cachePyramids = false;
+    QCache<qint64, MipPyramid> pyramidCache;
+    QThreadPool pyramidPool;
     double scale;
     double effectiveScale;
     bool hasImage;
     int zoomSteps;
     std::atomic_flag updatingPixmap = ATOMIC_FLAG_INIT;
     std::function<void(double)> onZoomChanged;
+    QRubberBand* selectionBand;
+    OverlayLayer* overlay;
+    QPoint dragOrigin;
+    QRect selectionRect;
+    bool selecting;
+    std::function<void(const QRect&)> onSelectionChanged;
 };
 
 static QString formatTimeSeconds(double seconds) {
@@ -205,62 +484,387 @@ static QString formatTimeSeconds(double seconds) {
         .arg(ms,3,10,QChar('0'));
 }
 
+// Accepts "hh:mm:ss.zzz", "mm:ss.zzz" or plain seconds.
+static bool parseTimeSeconds(const QString& text, double& seconds) {
+    QStringList parts = text.trimmed().split(':');
+    if (parts.isEmpty() || parts.size() > 3) return false;
+    double total = 0.0;
+    for (const QString& part : parts) {
+        bool ok = false;
+        double v = part.trimmed().toDouble(&ok);
+        if (!ok || v < 0.0) return false;
+        total = total * 60.0 + v;
+    }
+    seconds = total;
+    return true;
+}
+
+// Slider whose groove marks timeline gaps (red) and jitter outliers (orange).
+// Markers are binned per pixel so multi-million frame recordings paint cheaply.
+class TimelineSlider : public QSlider {
+public:
+    TimelineSlider(QWidget* parent=nullptr) : QSlider(Qt::Horizontal, parent) {}
+
+    void setMarkers(const std::vector<FrameTimeline::Marker>& m) {
+        markers = m;
+        binSpan = -1;
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent* ev) override {
+        QSlider::paintEvent(ev);
+        if (markers.empty() || maximum() <= minimum()) return;
+        QStyleOptionSlider opt;
+        initStyleOption(&opt);
+        QRect groove = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderGroove, this);
+        QRect handle = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderHandle, this);
+        int span = std::max(1, groove.width() - handle.width());
+        if (span != binSpan || minimum() != binMin || maximum() != binMax) {
+            bins.assign(span + 1, 0);
+            for (const auto& m : markers) {
+                int x = QStyle::sliderPositionFromValue(minimum(), maximum(), m.index, span);
+                bins[x] |= (m.kind == FrameTimeline::MarkerKind::Gap) ? 1 : 2;
+            }
+            binSpan = span;
+            binMin = minimum();
+            binMax = maximum();
+        }
+        QPainter p(this);
+        int x0 = groove.left() + handle.width() / 2;
+        int top = groove.top();
+        int bottom = groove.bottom();
+        for (int x = 0; x <= span; ++x) {
+            if (!bins[x]) continue;
+            p.setPen((bins[x] & 1) ? QColor(220, 40, 40) : QColor(240, 160, 0));
+            p.drawLine(x0 + x, top, x0 + x, bottom);
+        }
+    }
+
+private:
+    std::vector<FrameTimeline::Marker> markers;
+    std::vector<quint8> bins;
+    int binSpan = -1;
+    int binMin = 0;
+    int binMax = 0;
+};
+
+// Scrolling line plot for live measurements, redrawn at display rate from
+// samples the analyzers keep. The optional hold line marks the best value
+// since the last reset.
+class TracePlot : public QWidget {
+public:
+    TracePlot(QWidget* parent=nullptr) : QWidget(parent) {
+        setMinimumHeight(90);
+        setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    }
+
+    // second, when given, is drawn in another colour on the same axes.
+    void setSamples(std::vector<QPointF> pts, double holdValue = std::numeric_limits<double>::quiet_NaN(),
+                    std::vector<QPointF> second = {}) {
+        points = std::move(pts);
+        secondary = std::move(second);
+        hold = holdValue;
+        update();
+    }
+    void clear() { setSamples({}); }
+
+protected:
+    void paintEvent(QPaintEvent*) override {
+        QPainter p(this);
+        p.fillRect(rect(), QColor(20, 20, 20));
+        if (points.size() < 2) return;
+        double x0 = points.front().x(), x1 = points.back().x();
+        double y0 = points.front().y(), y1 = y0;
+        for (const std::vector<QPointF>* series : {&points, &secondary}) {
+            for (const QPointF& q : *series) {
+                y0 = std::min(y0, q.y());
+                y1 = std::max(y1, q.y());
+            }
+        }
+        if (std::isfinite(hold)) {
+            y0 = std::min(y0, hold);
+            y1 = std::max(y1, hold);
+        }
+        if (x1 <= x0) x1 = x0 + 1.0;
+        if (y1 <= y0) y1 = y0 + 1.0;
+        const QRectF area = QRectF(rect()).adjusted(4, 4, -4, -4);
+        auto map = [&](double x, double y) {
+            return QPointF(area.left() + (x - x0) / (x1 - x0) * area.width(),
+                           area.bottom() - (y - y0) / (y1 - y0) * area.height());
+        };
+        if (std::isfinite(hold)) {
+            p.setPen(QPen(QColor(240, 160, 0), 1, Qt::DashLine));
+            p.drawLine(map(x0, hold), map(x1, hold));
+        }
+        auto draw = [&](const std::vector<QPointF>& series, const QColor& color) {
+            QPolygonF line;
+            line.reserve(static_cast<int>(series.size()));
+            for (const QPointF& q : series) line << map(q.x(), q.y());
+            p.setPen(QPen(color, 1));
+            p.drawPolyline(line);
+        };
+        draw(secondary, QColor(90, 150, 255));
+        draw(points, QColor(80, 200, 120));
+    }
+
+private:
+    std::vector<QPointF> points;
+    std::vector<QPointF> secondary;
+    double hold = std::numeric_limits<double>::quiet_NaN();
+};
+
+// |b - a| at the deeper of the two bit depths; null if the frames differ in size.
+static QImage differenceImage(const QImage& a, const QImage& b) {
+    if (a.isNull() || b.isNull() || a.size() != b.size()) return {};
+    bool deep = a.depth() > 8 || b.depth() > 8;
+    QImage::Format fmt = deep ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8;
+    QImage ca = (a.format() == fmt) ? a : a.convertToFormat(fmt);
+    QImage cb = (b.format() == fmt) ? b : b.convertToFormat(fmt);
+    QImage out(a.size(), fmt);
+    const size_t w = static_cast<size_t>(a.width());
+    for (int y = 0; y < a.height(); ++y) {
+        if (deep) {
+            simd::absDiffU16(reinterpret_cast<const uint16_t*>(ca.constScanLine(y)),
+                             reinterpret_cast<const uint16_t*>(cb.constScanLine(y)),
+                             reinterpret_cast<uint16_t*>(out.scanLine(y)), w);
+        } else {
+            simd::absDiffU8(ca.constScanLine(y), cb.constScanLine(y), out.scanLine(y), w);
+        }
+    }
+    return out;
+}
+
+// Format, output path and thread rows of a dialog that writes a sequence
+// through ExportOptions. Changing the format fixes the path's extension, and
+// the browse button asks for a folder or a file to match.
+struct ExportOutputRows {
+    QComboBox* format;
+    QLineEdit* path;
+    QSpinBox* threads;
+
+    static ExportOutputRows add(QDialog* dlg, QFormLayout* form, const QString& defaultPath) {
+        ExportOutputRows rows;
+        rows.format = new QComboBox;
+        rows.format->addItem("TIFF sequence (folder)", static_cast<int>(ExportOptions::Format::TiffSequence));
+        rows.format->addItem("Multi-page TIFF", static_cast<int>(ExportOptions::Format::MultiPageTiff));
+        rows.format->addItem("Raw container (.dcraw)", static_cast<int>(ExportOptions::Format::RawContainer));
+        rows.path = new QLineEdit(defaultPath);
+        auto browse = new QPushButton("...");
+        auto pathRow = new QHBoxLayout;
+        pathRow->addWidget(rows.path, 1);
+        pathRow->addWidget(browse);
+        rows.threads = new QSpinBox;
+        rows.threads->setRange(1, 256);
+        rows.threads->setValue(std::max(1, QThread::idealThreadCount()));
+        form->addRow("Format", rows.format);
+        form->addRow("Output", pathRow);
+        form->addRow("Threads", rows.threads);
+        QObject::connect(browse, &QPushButton::clicked, dlg, [dlg, rows](){
+            const ExportOptions::Format fmt = rows.selectedFormat();
+            QString path = (fmt == ExportOptions::Format::TiffSequence)
+                ? QFileDialog::getExistingDirectory(dlg, "Output folder", rows.path->text())
+                : QFileDialog::getSaveFileName(dlg, "Output file", rows.path->text(),
+                      fmt == ExportOptions::Format::RawContainer ? "Raw container (*.dcraw)" : "TIFF (*.tif)");
+            if (!path.isEmpty()) rows.path->setText(path);
+        });
+        QObject::connect(rows.format, qOverload<int>(&QComboBox::currentIndexChanged), dlg, [rows](int){
+            const ExportOptions::Format fmt = rows.selectedFormat();
+            QFileInfo fi(rows.path->text());
+            QString base = fi.absolutePath() + "/" + fi.completeBaseName();
+            if (fmt == ExportOptions::Format::TiffSequence) rows.path->setText(base);
+            else rows.path->setText(base + (fmt == ExportOptions::Format::RawContainer ? ".dcraw" : ".tif"));
+        });
+        return rows;
+    }
+
+    ExportOptions::Format selectedFormat() const {
+        return static_cast<ExportOptions::Format>(format->currentData().toInt());
+    }
+    // Format, output path and threads; the caller sets the rest.
+    void applyTo(ExportOptions& opt) const {
+        opt.format = selectedFormat();
+        opt.outputPath = path->text();
+        opt.threads = threads->value();
+    }
+};
+
 class ViewerWindow : public QWidget {
 public:
     ViewerWindow(QWidget* parent=nullptr)
-        : QWidget(parent), fps(0.0) {
+        : QWidget(parent), lastDirection(1), playStartSec(0.0) {
         setWindowFlags(Qt::Window);
         setWindowTitle("Capture Viewer");
+        diffCache.setMaxCost(64 * 1024); // cost in KB
+        motionCache.setMaxCost(16 * 1024);
+        motionPool.setMaxThreadCount(1);
         resize(1100, 800);
         setMinimumSize(800, 600);
 
         imageView = new ZoomImageView;
-        imageView->setMinimumSize(640, 480);
+        imageView->setMinimumSize(320, 480);
         imageView->setStyleSheet("background:#000;");
         imageView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 
+        compareView = new ZoomImageView;
+        compareView->setMinimumSize(320, 480);
+        compareView->setStyleSheet("background:#000;");
+        compareView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        compareView->hide();
+        imageView->setCachePyramids(true);
+        compareView->setCachePyramids(true);
+
+        auto viewSplitter = new QSplitter(Qt::Horizontal);
+        viewSplitter->addWidget(imageView);
+        viewSplitter->addWidget(compareView);
+
         frameLabel = new QLabel("Frame: -- / --");
         timeLabel = new QLabel("Time: -- / --");
+        compareLabel = new QLabel;
         frameLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
         timeLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+        compareLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
 
         folderEdit = new QLineEdit;
         folderEdit->setPlaceholderText("Select capture folder...");
         auto browseBtn = new QPushButton("...");
+        auto fileBtn = new QPushButton("File...");
         auto loadBtn = new QPushButton("Load");
         recentCombo = new QComboBox;
         recentCombo->setMinimumWidth(200);
 
-        slider = new QSlider(Qt::Horizontal);
+        compareCheck = new QCheckBox("Compare with");
+        compareEdit = new QLineEdit;
+        compareEdit->setPlaceholderText("Second capture folder...");
+        auto compareBrowseBtn = new QPushButton("...");
+        auto compareLoadBtn = new QPushButton("Load");
+        alignCombo = new QComboBox;
+        alignCombo->addItem("Align by frame index");
+        alignCombo->addItem("Align by timestamp");
+        diffCheck = new QCheckBox("Show difference |B - A|");
+
+        slider = new TimelineSlider;
         slider->setRange(0, 0);
         slider->setEnabled(false);
 
+        seekEdit = new QLineEdit;
+        seekEdit->setPlaceholderText("Go to time (s or mm:ss.zzz)");
+        seekEdit->setEnabled(false);
+
         prevBtn = new QPushButton("<");
+        playBtn = new QPushButton("Play");
         nextBtn = new QPushButton(">");
+        followCheck = new QCheckBox("Follow");
+        followCheck->setToolTip("Keep loading frames while the recording is still being written");
         prevBtn->setEnabled(false);
+        playBtn->setEnabled(false);
         nextBtn->setEnabled(false);
 
+        markInBtn = new QPushButton("Mark in");
+        markOutBtn = new QPushButton("Mark out");
+        exportBtn = new QPushButton("Export...");
+        videoBtn = new QPushButton("Video...");
+        flickerBtn = new QPushButton("Temporal FFT...");
+        flickerBtn->setToolTip("Per-pixel temporal spectrum of the marked range: flicker and vibration frequencies");
+        motionBtn = new QPushButton("Motion...");
+        motionBtn->setToolTip("Difference energy and block motion of the marked range, saved as CSV");
+        motionOverlayCheck = new QCheckBox("Motion vectors");
+        motionOverlayCheck->setToolTip("Block vectors from the previous frame to this one, drawn at twice their length");
+        trackBtn = new QPushButton("Track...");
+        trackBtn->setToolTip("Detect particles in the marked range and link them into tracks");
+        trackOverlayCheck = new QCheckBox("Tracks");
+        trackOverlayCheck->setToolTip("Tracks from the last tracking run, up to the shown frame");
+        trackOverlayCheck->setEnabled(false);
+        bleachBtn = new QPushButton("Bleach correct...");
+        bleachBtn->setToolTip("Write the marked range with photobleaching decay normalised out");
+        medianBtn = new QPushButton("Temporal median...");
+        medianBtn->setToolTip("Write the marked range denoised, or with the background subtracted, "
+                              "by a sliding temporal median");
+        rangeLabel = new QLabel("Range: all frames");
+        colormapCombo = new QComboBox;
+        for (int m = 0; m < DisplayConverter::kColormaps; ++m) {
+            colormapCombo->addItem(DisplayConverter::colormapName(static_cast<DisplayConverter::Colormap>(m)), m);
+        }
+        colormapCombo->setToolTip("HiLo shows pixels at the bottom of the range blue and at the top red");
+        blackSpin = new QSpinBox;
+        blackSpin->setRange(0, 65534);
+        blackSpin->setPrefix("black ");
+        whiteSpin = new QSpinBox;
+        whiteSpin->setRange(1, 65535);
+        whiteSpin->setValue(65535);
+        whiteSpin->setPrefix("white ");
+        markInBtn->setEnabled(false);
+        markOutBtn->setEnabled(false);
+        exportBtn->setEnabled(false);
+        videoBtn->setEnabled(false);
+        flickerBtn->setEnabled(false);
+        motionBtn->setEnabled(false);
+        trackBtn->setEnabled(false);
+        bleachBtn->setEnabled(false);
+        medianBtn->setEnabled(false);
+
         auto folderRow = new QHBoxLayout;
         folderRow->addWidget(new QLabel("Folder"));
         folderRow->addWidget(folderEdit, 1);
         folderRow->addWidget(browseBtn);
+        folderRow->addWidget(fileBtn);
         folderRow->addWidget(loadBtn);
 
         auto recentRow = new QHBoxLayout;
         recentRow->addWidget(new QLabel("Recent"));
         recentRow->addWidget(recentCombo, 1);
 
+        auto compareRow = new QHBoxLayout;
+        compareRow->addWidget(compareCheck);
+        compareRow->addWidget(compareEdit, 1);
+        compareRow->addWidget(compareBrowseBtn);
+        compareRow->addWidget(compareLoadBtn);
+
         auto navRow = new QHBoxLayout;
         navRow->addWidget(prevBtn);
+        navRow->addWidget(playBtn);
         navRow->addWidget(nextBtn);
+        navRow->addWidget(followCheck);
         navRow->addWidget(frameLabel, 1);
 
         auto infoCol = new QVBoxLayout;
         infoCol->addLayout(folderRow);
         infoCol->addLayout(recentRow);
+        infoCol->addLayout(compareRow);
+        infoCol->addWidget(alignCombo);
+        infoCol->addWidget(diffCheck);
+        infoCol->addWidget(compareLabel);
         infoCol->addWidget(timeLabel);
         infoCol->addLayout(navRow);
+        auto displayRow = new QHBoxLayout;
+        displayRow->addWidget(new QLabel("Colormap"));
+        displayRow->addWidget(colormapCombo);
+        displayRow->addWidget(blackSpin);
+        displayRow->addWidget(whiteSpin);
+        displayRow->addStretch(1);
+        infoCol->addLayout(displayRow);
         infoCol->addWidget(slider);
+        infoCol->addWidget(seekEdit);
+
+        auto exportRow = new QHBoxLayout;
+        exportRow->addWidget(markInBtn);
+        exportRow->addWidget(markOutBtn);
+        exportRow->addWidget(exportBtn);
+        exportRow->addWidget(videoBtn);
+        infoCol->addLayout(exportRow);
+        auto analysisRow = new QHBoxLayout;
+        analysisRow->addWidget(flickerBtn);
+        analysisRow->addWidget(motionBtn);
+        analysisRow->addWidget(motionOverlayCheck);
+        infoCol->addLayout(analysisRow);
+        auto trackRow = new QHBoxLayout;
+        trackRow->addWidget(trackBtn);
+        trackRow->addWidget(trackOverlayCheck);
+        trackRow->addWidget(bleachBtn);
+        trackRow->addWidget(medianBtn);
+        trackRow->addStretch(1);
+        infoCol->addLayout(trackRow);
+        infoCol->addWidget(rangeLabel);
         infoCol->addStretch(1);
 
         auto rightPane = new QWidget;
@@ -268,16 +872,47 @@ public:
         rightPane->setMinimumWidth(320);
 
         auto layout = new QHBoxLayout;
-        layout->addWidget(imageView, 3);
+        layout->addWidget(viewSplitter, 3);
         layout->addWidget(rightPane, 1);
         setLayout(layout);
 
-        imageView->setZoomChanged(nullptr);
+        // Zooming or panning either pane moves the other with it.
+        auto linkViews = [this](ZoomImageView* from, ZoomImageView* to) {
+            auto follow = [this, from, to]() {
+                if (syncingViews || !compareView->isVisible()) return;
+                syncingViews = true;
+                to->matchView(*from);
+                syncingViews = false;
+            };
+            from->setZoomChanged([follow](double){ follow(); });
+            QObject::connect(from->horizontalScrollBar(), &QScrollBar::valueChanged, [follow](int){ follow(); });
+            QObject::connect(from->verticalScrollBar(), &QScrollBar::valueChanged, [follow](int){ follow(); });
+        };
+        linkViews(imageView, compareView);
+        linkViews(compareView, imageView);
+
+        playTimer.setInterval(10);
+        QObject::connect(&playTimer, &QTimer::timeout, [this](){ playTick(); });
+        // Change notifications are not delivered reliably for files another
+        // process keeps open for appending (notably on Windows), so a slow
+        // poll backs up the watcher.
+        followTimer.setInterval(500);
+        QObject::connect(&followTimer, &QTimer::timeout, [this](){ pollGrowth(); });
+        QObject::connect(&followWatcher, &QFileSystemWatcher::fileChanged, [this](const QString&){ pollGrowth(); });
+        QObject::connect(followCheck, &QCheckBox::toggled, [this](bool){ updateFollowing(); });
 
         QObject::connect(browseBtn, &QPushButton::clicked, [this](){
             QString dir = QFileDialog::getExistingDirectory(this, "Select capture folder", folderEdit->text());
             if (!dir.isEmpty()) folderEdit->setText(dir);
         });
+        QObject::connect(fileBtn, &QPushButton::clicked, [this](){
+            QString file = QFileDialog::getOpenFileName(this, "Open recording", folderEdit->text(),
+                                                        "Recordings (*.dcraw *.tif *.tiff)");
+            if (!file.isEmpty()) {
+                folderEdit->setText(file);
+                loadFolder(file);
+            }
+        });
         QObject::connect(loadBtn, &QPushButton::clicked, [this](){
             loadFolder(folderEdit->text());
         });
@@ -289,19 +924,83 @@ public:
                 loadFolder(dir);
             }
         });
+        QObject::connect(compareBrowseBtn, &QPushButton::clicked, [this](){
+            QString dir = QFileDialog::getExistingDirectory(this, "Select capture folder", compareEdit->text());
+            if (!dir.isEmpty()) compareEdit->setText(dir);
+        });
+        QObject::connect(compareLoadBtn, &QPushButton::clicked, [this](){
+            loadCompareFolder(compareEdit->text());
+        });
+        QObject::connect(compareCheck, &QCheckBox::toggled, [this](bool on){
+            compareView->setVisible(on);
+            if (on && !seqB.isOpen() && !compareEdit->text().isEmpty()) loadCompareFolder(compareEdit->text());
+            else showFrame(slider->value());
+        });
+        QObject::connect(alignCombo, qOverload<int>(&QComboBox::currentIndexChanged), [this](int){
+            showFrame(slider->value());
+        });
+        QObject::connect(diffCheck, &QCheckBox::toggled, [this](bool){
+            showFrame(slider->value());
+        });
         QObject::connect(slider, &QSlider::valueChanged, [this](int v){
-            loadFrame(v);
+            showFrame(v);
+        });
+        QObject::connect(seekEdit, &QLineEdit::returnPressed, [this](){
+            double seconds = 0.0;
+            if (seqA.timeline().isEmpty() || !parseTimeSeconds(seekEdit->text(), seconds)) return;
+            slider->setValue(seqA.timeline().indexAtTime(seconds));
         });
         QObject::connect(prevBtn, &QPushButton::clicked, [this](){
-            if (frameFiles.isEmpty()) return;
-            int v = std::max(0, slider->value() - 1);
-            slider->setValue(v);
+            stepFrames(-1);
         });
         QObject::connect(nextBtn, &QPushButton::clicked, [this](){
-            if (frameFiles.isEmpty()) return;
-            int v = std::min(slider->maximum(), slider->value() + 1);
-            slider->setValue(v);
+            stepFrames(1);
+        });
+        QObject::connect(playBtn, &QPushButton::clicked, [this](){
+            setPlaying(!playTimer.isActive());
+        });
+        QObject::connect(markInBtn, &QPushButton::clicked, [this](){
+            rangeIn = slider->value();
+            if (rangeOut >= 0 && rangeOut < rangeIn) rangeOut = -1;
+            updateRangeLabel();
+        });
+        QObject::connect(markOutBtn, &QPushButton::clicked, [this](){
+            rangeOut = slider->value();
+            if (rangeOut < rangeIn) rangeIn = 0;
+            updateRangeLabel();
+        });
+        QObject::connect(exportBtn, &QPushButton::clicked, [this](){
+            showExportDialog();
+        });
+        QObject::connect(videoBtn, &QPushButton::clicked, [this](){
+            showVideoDialog();
+        });
+        QObject::connect(flickerBtn, &QPushButton::clicked, [this](){
+            showTemporalSpectrumDialog();
+        });
+        QObject::connect(motionBtn, &QPushButton::clicked, [this](){
+            showMotionDialog();
+        });
+        QObject::connect(motionOverlayCheck, &QCheckBox::toggled, [this](bool){
+            showFrame(slider->value());
         });
+        QObject::connect(trackBtn, &QPushButton::clicked, [this](){
+            showTrackDialog();
+        });
+        QObject::connect(trackOverlayCheck, &QCheckBox::toggled, [this](bool){
+            showFrame(slider->value());
+        });
+        QObject::connect(bleachBtn, &QPushButton::clicked, [this](){
+            showBleachDialog();
+        });
+        QObject::connect(medianBtn, &QPushButton::clicked, [this](){
+            showTemporalFilterDialog();
+        });
+        QObject::connect(colormapCombo, qOverload<int>(&QComboBox::currentIndexChanged), [this](int){
+            showFrame(slider->value());
+        });
+        QObject::connect(blackSpin, qOverload<int>(&QSpinBox::valueChanged), [this](int){ showFrame(slider->value()); });
+        QObject::connect(whiteSpin, qOverload<int>(&QSpinBox::valueChanged), [this](int){ showFrame(slider->value()); });
 
         auto leftShortcut = new QShortcut(QKeySequence(Qt::Key_Left), this);
         auto rightShortcut = new QShortcut(QKeySequence(Qt::Key_Right), this);
@@ -309,6 +1008,7 @@ public:
         auto ctrlRightShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_Right), this);
         auto pageUpShortcut = new QShortcut(QKeySequence(Qt::Key_PageUp), this);
         auto pageDownShortcut = new QShortcut(QKeySequence(Qt::Key_PageDown), this);
+        auto spaceShortcut = new QShortcut(QKeySequence(Qt::Key_Space), this);
         QObject::connect(leftShortcut, &QShortcut::activated, [this](){
             stepFrames(-1);
         });
@@ -327,17 +1027,50 @@ public:
         QObject::connect(pageDownShortcut, &QShortcut::activated, [this](){
             stepFrames(10);
         });
+        QObject::connect(spaceShortcut, &QShortcut::activated, [this](){
+            if (seqA.isOpen()) setPlaying(!playTimer.isActive());
+        });
 
         loadRecentFolders();
     }
 
 private:
     void stepFrames(int delta) {
-        if (frameFiles.isEmpty()) return;
+        if (!seqA.isOpen()) return;
+        lastDirection = delta < 0 ? -1 : 1;
         int v = std::clamp(slider->value() + delta, 0, slider->maximum());
         slider->setValue(v);
     }
 
+    void setPlaying(bool on) {
+        if (!on || !seqA.isOpen()) {
+            playTimer.stop();
+            playBtn->setText("Play");
+            return;
+        }
+        if (slider->value() >= slider->maximum()) slider->setValue(0);
+        lastDirection = 1;
+        playStartSec = seqA.timeline().timeAt(slider->value());
+        playClock.restart();
+        playTimer.start();
+        playBtn->setText("Pause");
+    }
+
+    // Playback follows the recorded time axis of the primary sequence; the
+    // compare pane is slaved to it through showFrame.
+    void playTick() {
+        const FrameTimeline& tl = seqA.timeline();
+        int next = tl.isEmpty()
+            ? slider->value() + 1
+            : tl.indexAtTime(playStartSec + playClock.elapsed() / 1000.0);
+        if (next >= slider->maximum()) {
+            slider->setValue(slider->maximum());
+            setPlaying(false);
+            return;
+        }
+        if (next != slider->value()) slider->setValue(next);
+    }
+
     void loadRecentFolders() {
         QSettings settings;
         QStringList recent = settings.value("viewer/recentFolders").toStringList();
@@ -361,90 +1094,1105 @@ private:
     }
 
     void loadFolder(const QString& dirPath) {
-        QDir dir(dirPath);
-        if (!dir.exists()) {
-            QMessageBox::warning(this, "Folder not found", "The selected folder does not exist.");
+        setPlaying(false);
+        diffCache.clear();
+        // A running motion field reads seqA; its result is dropped on arrival.
+        ++motionGeneration;
+        motionCache.clear();
+        motionPool.waitForDone();
+        QString err = seqA.open(dirPath);
+        if (!err.isEmpty()) {
+            QMessageBox::warning(this, "Folder not found", err);
             return;
         }
-        QStringList filters;
-        filters << "*.tif" << "*.tiff" << "*.TIF" << "*.TIFF";
-        frameFiles = dir.entryList(filters, QDir::Files, QDir::Name);
-        for (QString& f : frameFiles) {
-            f = dir.absoluteFilePath(f);
-        }
-        fps = readFpsFromInfo(dir.absoluteFilePath("capture_info.txt"));
-        slider->setEnabled(!frameFiles.isEmpty());
-        prevBtn->setEnabled(!frameFiles.isEmpty());
-        nextBtn->setEnabled(!frameFiles.isEmpty());
-        int count = static_cast<int>(frameFiles.size());
+        particleTracks.reset();
+        trackOverlayCheck->setChecked(false);
+        trackOverlayCheck->setEnabled(false);
+        int count = seqA.count();
+        const FrameTimeline& tl = seqA.timeline();
+        slider->setMarkers(tl.markers());
+        if (tl.hasTimestamps() && !tl.markers().empty()) {
+            logMessage(QString("Viewer timeline: %1 frames, %2 gap/jitter markers, median dt=%3 ms")
+                .arg(count).arg(tl.markers().size()).arg(tl.nominalInterval() * 1000.0,0,'f',3));
+        }
+        updateNavigationEnabled();
+        rangeIn = 0;
+        rangeOut = -1;
+        updateRangeLabel();
+        slider->blockSignals(true);
         slider->setRange(0, std::max(0, count - 1));
         slider->setValue(0);
+        slider->blockSignals(false);
         updateTimeLabel(0);
-        if (frameFiles.isEmpty()) {
+        if (count == 0) {
             frameLabel->setText("Frame: -- / --");
         } else {
-            frameLabel->setText(QString("Frame: %1 / %2").arg(1).arg(count));
-            updateRecentFolders(dir.absolutePath());
-        }
-    }
-
-    double readFpsFromInfo(const QString& infoPath) const {
-        QFile f(infoPath);
-        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) return 0.0;
-        QTextStream ts(&f);
-        double foundFps = 0.0;
-        while (!ts.atEnd()) {
-            QString line = ts.readLine().trimmed();
-            if (line.startsWith("Internal FPS:", Qt::CaseInsensitive) ||
-                line.startsWith("FPS:", Qt::CaseInsensitive)) {
-                QStringList parts = line.split(":");
-                if (parts.size() >= 2) {
-                    bool ok = false;
-                    double val = parts.last().trimmed().toDouble(&ok);
-                    if (ok) foundFps = val;
-                }
-            }
+            showFrame(0);
+            updateRecentFolders(seqA.path());
+        }
+        updateFollowing();
+    }
+
+    void updateNavigationEnabled() {
+        const bool any = seqA.count() > 0;
+        slider->setEnabled(any);
+        seekEdit->setEnabled(!seqA.timeline().isEmpty());
+        prevBtn->setEnabled(any);
+        playBtn->setEnabled(any);
+        nextBtn->setEnabled(any);
+        markInBtn->setEnabled(any);
+        markOutBtn->setEnabled(any);
+        exportBtn->setEnabled(any);
+        videoBtn->setEnabled(any);
+        flickerBtn->setEnabled(any);
+        motionBtn->setEnabled(any);
+        trackBtn->setEnabled(any);
+        bleachBtn->setEnabled(any);
+        medianBtn->setEnabled(any);
+    }
+
+    void updateFollowing() {
+        if (!followWatcher.files().isEmpty()) followWatcher.removePaths(followWatcher.files());
+        if (!followCheck->isChecked() || seqA.source() == FrameSequence::Source::None) {
+            followTimer.stop();
+            return;
+        }
+        const QString watched = seqA.growthPath();
+        if (!watched.isEmpty()) followWatcher.addPath(watched);
+        followTimer.start();
+        pollGrowth();
+    }
+
+    // Live tail: pull in frames the writer appended since the last poll. The
+    // view jumps to the newest frame only if it was already showing the end.
+    void pollGrowth() {
+        const int oldCount = seqA.count();
+        if (seqA.refresh() == 0) return;
+        const int count = seqA.count();
+        const QString watched = seqA.growthPath();
+        if (!watched.isEmpty() && !followWatcher.files().contains(watched)) followWatcher.addPath(watched);
+
+        const bool atEnd = oldCount == 0 || slider->value() >= slider->maximum();
+        slider->setMarkers(seqA.timeline().markers());
+        slider->blockSignals(true);
+        slider->setRange(0, count - 1);
+        slider->blockSignals(false);
+        if (oldCount == 0) {
+            updateNavigationEnabled();
+            updateRecentFolders(seqA.path());
         }
-        return foundFps;
+        updateRangeLabel();
+        if (atEnd && !playTimer.isActive()) slider->setValue(count - 1);
+        else showFrame(slider->value());
     }
 
-    void loadFrame(int index) {
-        if (frameFiles.isEmpty()) return;
-        int count = static_cast<int>(frameFiles.size());
+    void loadCompareFolder(const QString& dirPath) {
+        diffCache.clear();
+        QString err = seqB.open(dirPath);
+        if (!err.isEmpty()) {
+            QMessageBox::warning(this, "Folder not found", err);
+            return;
+        }
+        compareCheck->setChecked(true);
+        logMessage(QString("Viewer compare: %1 (%2 frames)").arg(seqB.directory()).arg(seqB.count()));
+        showFrame(slider->value());
+    }
+
+    // Index in the compare sequence that corresponds to a primary frame.
+    int alignedIndex(int index) const {
+        if (seqB.count() == 0) return -1;
+        if (alignCombo->currentIndex() == 1 && !seqA.timeline().isEmpty() && !seqB.timeline().isEmpty()) {
+            return seqB.timeline().indexAtTime(seqA.timeline().timeAt(index));
+        }
+        return std::min(index, seqB.count() - 1);
+    }
+
+    void showFrame(int index) {
+        if (!seqA.isOpen()) return;
+        int count = seqA.count();
         index = std::clamp(index, 0, count - 1);
-        QImageReader reader(frameFiles.at(index));
-        reader.setAutoTransform(true);
-        QImage img = reader.read();
+        QString err;
+        QImage img = seqA.frame(index, &err);
         if (img.isNull()) {
-            QMessageBox::warning(this, "Read error", "Failed to load image:\n" + reader.errorString());
+            setPlaying(false);
+            QMessageBox::warning(this, "Read error", "Failed to load image:\n" + err);
             return;
         }
-        imageView->setImage(img);
+        showConverted(imageView, img);
+        updateOverlay(index, img.rect());
+        seqA.prefetch(index, lastDirection);
         frameLabel->setText(QString("Frame: %1 / %2").arg(index + 1).arg(count));
         updateTimeLabel(index);
+
+        if (!compareCheck->isChecked() || !seqB.isOpen()) {
+            compareLabel->clear();
+            return;
+        }
+        int indexB = alignedIndex(index);
+        QImage imgB = seqB.frame(indexB);
+        seqB.prefetch(indexB, lastDirection);
+        if (imgB.isNull()) {
+            compareLabel->setText("B: read error");
+            return;
+        }
+        QString text = QString("B frame: %1 / %2").arg(indexB + 1).arg(seqB.count());
+        if (!seqB.timeline().isEmpty()) text += "  " + formatTimeSeconds(seqB.timeline().timeAt(indexB));
+        if (diffCheck->isChecked()) {
+            // Cached per frame pair: replays and display changes reuse the
+            // image, and with it the view's pyramid for its cache key.
+            const quint64 pair = (static_cast<quint64>(index) << 32) | static_cast<quint32>(indexB);
+            QImage diff;
+            if (QImage* hit = diffCache.object(pair)) {
+                diff = *hit;
+            } else {
+                diff = differenceImage(img, imgB);
+                if (!diff.isNull()) diffCache.insert(pair, new QImage(diff), std::max<qsizetype>(1, diff.sizeInBytes() / 1024));
+            }
+            if (diff.isNull()) {
+                text += "  (size mismatch, no difference)";
+            } else {
+                imgB = diff;
+                text += "  |B - A|";
+            }
+        }
+        // The pane's first image would reset its zoom and pass that on to
+        // the primary view; it follows the primary view instead.
+        syncingViews = true;
+        showConverted(compareView, imgB);
+        compareView->matchView(*imageView);
+        syncingViews = false;
+        compareLabel->setText(text);
+    }
+
+    // Frames go to the view as they are (keeping their cached pyramids)
+    // unless a colormap or display range is set; then the view converts
+    // just the part it shows each time it paints.
+    void showConverted(ZoomImageView* view, const QImage& img) {
+        DisplayConverter::Settings ds;
+        ds.map = static_cast<DisplayConverter::Colormap>(colormapCombo->currentData().toInt());
+        ds.black = blackSpin->value();
+        ds.white = std::max(whiteSpin->value(), ds.black + 1);
+        const bool plain = ds.map == DisplayConverter::Colormap::Grey && ds.black == 0 && ds.white == 65535;
+        if (plain) view->setImage(img);
+        else view->setConvertedImage(img, ds);
+    }
+
+    void updateRangeLabel() {
+        if (rangeIn <= 0 && rangeOut < 0) {
+            rangeLabel->setText("Range: all frames");
+            return;
+        }
+        int last = rangeOut < 0 ? seqA.count() - 1 : rangeOut;
+        rangeLabel->setText(QString("Range: %1 - %2 (%3 frames)").arg(rangeIn + 1).arg(last + 1).arg(last - rangeIn + 1));
+    }
+
+    // Default white level for the export dialogs: full scale of an 8-bit
+    // source, the usual 12-bit range otherwise.
+    int sourceWhite() {
+        const QImage sample = seqA.frame(slider->value());
+        return sample.format() == QImage::Format_Grayscale8 ? 255 : 4095;
+    }
+
+    void showExportDialog() {
+        if (!seqA.isOpen()) return;
+        setPlaying(false);
+        const int count = seqA.count();
+        const QRect roi = imageView->selection();
+
+        QDialog dlg(this);
+        dlg.setWindowTitle("Export frames");
+        auto form = new QFormLayout;
+        auto firstSpin = new QSpinBox;
+        auto lastSpin = new QSpinBox;
+        firstSpin->setRange(1, count);
+        lastSpin->setRange(1, count);
+        firstSpin->setValue(rangeIn + 1);
+        lastSpin->setValue((rangeOut < 0 ? count - 1 : rangeOut) + 1);
+        auto stepSpin = new QSpinBox;
+        stepSpin->setRange(1, 100000);
+        auto roiCheck = new QCheckBox(roi.isEmpty()
+            ? QString("Crop to selection (Shift+drag in the view)")
+            : QString("Crop to %1,%2 %3x%4").arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()));
+        roiCheck->setEnabled(!roi.isEmpty());
+        roiCheck->setChecked(!roi.isEmpty());
+        auto windowCheck = new QCheckBox("Reduce to 8 bits (window/level)");
+        auto blackSpin = new QSpinBox;
+        auto whiteSpin = new QSpinBox;
+        blackSpin->setRange(0, 65535);
+        whiteSpin->setRange(1, 65535);
+        whiteSpin->setValue(sourceWhite());
+        form->addRow("First frame", firstSpin);
+        form->addRow("Last frame", lastSpin);
+        form->addRow("Keep every Nth", stepSpin);
+        form->addRow(roiCheck);
+        form->addRow(windowCheck);
+        form->addRow("Black / white", blackSpin);
+        form->addRow("", whiteSpin);
+        const ExportOutputRows output = ExportOutputRows::add(&dlg, form, seqA.directory() + "_export");
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        ExportOptions opt;
+        output.applyTo(opt);
+        opt.first = firstSpin->value() - 1;
+        opt.last = lastSpin->value() - 1;
+        opt.step = stepSpin->value();
+        if (roiCheck->isChecked()) opt.roi = roi;
+        opt.applyWindow = windowCheck->isChecked();
+        opt.black = blackSpin->value();
+        opt.white = whiteSpin->value();
+        const QString source = seqA.path();
+        logMessage(QString("Export %1 frames of %2 to %3")
+            .arg(SequenceExporter::frameCount(opt, seqA.count())).arg(source).arg(opt.outputPath));
+        runExportJob("Exporting frames...", opt.outputPath,
+            [source, opt](const SequenceExporter::Progress& progress, const std::atomic<bool>* cancel){
+                return SequenceExporter::run(source, opt, progress, cancel);
+            });
+    }
+
+    void showVideoDialog() {
+        if (!seqA.isOpen()) return;
+        setPlaying(false);
+        const QRect roi = imageView->selection();
+        const double sourceFps = seqA.timeline().nominalInterval() > 0.0
+            ? 1.0 / seqA.timeline().nominalInterval() : 30.0;
+
+        QDialog dlg(this);
+        dlg.setWindowTitle("Export video (MJPEG AVI)");
+        auto form = new QFormLayout;
+        auto outEdit = new QLineEdit(seqA.directory() + ".avi");
+        auto outBrowse = new QPushButton("...");
+        auto outRow = new QHBoxLayout;
+        outRow->addWidget(outEdit, 1);
+        outRow->addWidget(outBrowse);
+        auto fpsSpin = new QDoubleSpinBox;
+        fpsSpin->setRange(1.0, 240.0);
+        fpsSpin->setValue(30.0);
+        auto speedSpin = new QDoubleSpinBox;
+        speedSpin->setDecimals(3);
+        speedSpin->setRange(0.001, 10000.0);
+        speedSpin->setValue(1.0);
+        speedSpin->setSuffix(" x");
+        auto rateLabel = new QLabel(QString("Recording rate: %1 fps").arg(sourceFps, 0, 'f', 1));
+        auto roiCheck = new QCheckBox(roi.isEmpty()
+            ? QString("Crop to selection (Shift+drag in the view)")
+            : QString("Crop to %1,%2 %3x%4").arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()));
+        roiCheck->setEnabled(!roi.isEmpty());
+        roiCheck->setChecked(!roi.isEmpty());
+        auto autoWindowCheck = new QCheckBox("Auto window/level");
+        autoWindowCheck->setChecked(true);
+        auto blackSpin = new QSpinBox;
+        auto whiteSpin = new QSpinBox;
+        blackSpin->setRange(0, 65535);
+        whiteSpin->setRange(1, 65535);
+        whiteSpin->setValue(sourceWhite());
+        auto overlayCheck = new QCheckBox("Overlay timestamp");
+        overlayCheck->setChecked(true);
+        auto qualitySpin = new QSpinBox;
+        qualitySpin->setRange(10, 100);
+        qualitySpin->setValue(85);
+        auto capSpin = new QSpinBox;
+        capSpin->setRange(1, static_cast<int>(AviWriter::kMaxBytes >> 20));
+        capSpin->setValue(static_cast<int>(AviWriter::kMaxBytes >> 20));
+        capSpin->setSuffix(" MB");
+        auto threadSpin = new QSpinBox;
+        threadSpin->setRange(1, 256);
+        threadSpin->setValue(std::max(1, QThread::idealThreadCount()));
+        form->addRow("Output", outRow);
+        form->addRow(rateLabel);
+        form->addRow("Video fps", fpsSpin);
+        form->addRow("Speed", speedSpin);
+        form->addRow(roiCheck);
+        form->addRow(autoWindowCheck);
+        form->addRow("Black / white", blackSpin);
+        form->addRow("", whiteSpin);
+        form->addRow(overlayCheck);
+        form->addRow("JPEG quality", qualitySpin);
+        form->addRow("Size cap", capSpin);
+        form->addRow("Threads", threadSpin);
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        QObject::connect(outBrowse, &QPushButton::clicked, [&](){
+            QString path = QFileDialog::getSaveFileName(&dlg, "Export video", outEdit->text(), "AVI (*.avi)");
+            if (!path.isEmpty()) outEdit->setText(path);
+        });
+        QObject::connect(autoWindowCheck, &QCheckBox::toggled, [&](bool on){
+            blackSpin->setEnabled(!on);
+            whiteSpin->setEnabled(!on);
+        });
+        blackSpin->setEnabled(false);
+        whiteSpin->setEnabled(false);
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        VideoExportOptions opt;
+        opt.outputPath = outEdit->text();
+        opt.first = rangeIn;
+        opt.last = rangeOut;
+        opt.outputFps = fpsSpin->value();
+        opt.speed = speedSpin->value();
+        if (roiCheck->isChecked()) opt.roi = roi;
+        opt.autoWindow = autoWindowCheck->isChecked();
+        opt.black = blackSpin->value();
+        opt.white = whiteSpin->value();
+        opt.overlayTimestamp = overlayCheck->isChecked();
+        opt.quality = qualitySpin->value();
+        opt.maxBytes = static_cast<qint64>(capSpin->value()) << 20;
+        opt.threads = threadSpin->value();
+        const QString source = seqA.path();
+        logMessage(QString("Video export of %1 to %2 at %3 fps, speed %4x")
+            .arg(source).arg(opt.outputPath).arg(opt.outputFps,0,'f',1).arg(opt.speed,0,'f',3));
+        runExportJob("Encoding video...", opt.outputPath,
+            [source, opt](const VideoExporter::Progress& progress, const std::atomic<bool>* cancel){
+                return VideoExporter::run(source, opt, progress, cancel);
+            });
+    }
+
+    void showBleachDialog() {
+        if (!seqA.isOpen()) return;
+        setPlaying(false);
+        const QRect roi = imageView->selection();
+        const int last = rangeOut < 0 ? seqA.count() - 1 : rangeOut;
+
+        QDialog dlg(this);
+        dlg.setWindowTitle("Photobleaching correction");
+        auto form = new QFormLayout;
+        auto rangeInfo = new QLabel(QString("Frames %1 - %2").arg(rangeIn + 1).arg(last + 1));
+        auto modelCombo = new QComboBox;
+        modelCombo->addItem("ROI mean, exponential fit", static_cast<int>(BleachOptions::Model::MeanExponential));
+        modelCombo->addItem("ROI mean, per frame (single pass)", static_cast<int>(BleachOptions::Model::FrameMean));
+        modelCombo->addItem("Per-pixel exponential fit", static_cast<int>(BleachOptions::Model::PixelExponential));
+        modelCombo->setToolTip("The per-frame mean also removes flicker; the fits only remove the decay");
+        auto measureCheck = new QCheckBox(roi.isEmpty()
+            ? QString("Measure in selection (Shift+drag in the view)")
+            : QString("Measure in %1,%2 %3x%4").arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()));
+        measureCheck->setEnabled(!roi.isEmpty());
+        measureCheck->setChecked(!roi.isEmpty());
+        auto cropCheck = new QCheckBox("Crop output to selection");
+        cropCheck->setEnabled(!roi.isEmpty());
+        auto offsetSpin = new QSpinBox;
+        offsetSpin->setRange(0, 65535);
+        offsetSpin->setValue(100);
+        offsetSpin->setSuffix(" DN");
+        offsetSpin->setToolTip("Camera offset; only the signal above it is rescaled");
+        auto gainSpin = new QDoubleSpinBox;
+        gainSpin->setRange(1.0, 1000.0);
+        gainSpin->setValue(10.0);
+        gainSpin->setSuffix(" x");
+        gainSpin->setToolTip("Largest correction applied to any frame or pixel");
+        form->addRow("Range", rangeInfo);
+        form->addRow("Model", modelCombo);
+        form->addRow(measureCheck);
+        form->addRow(cropCheck);
+        form->addRow("Offset", offsetSpin);
+        form->addRow("Max gain", gainSpin);
+        const ExportOutputRows output = ExportOutputRows::add(&dlg, form, seqA.directory() + "_bleach");
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        QObject::connect(modelCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){
+            const auto model = static_cast<BleachOptions::Model>(modelCombo->currentData().toInt());
+            measureCheck->setEnabled(!roi.isEmpty() && model != BleachOptions::Model::PixelExponential);
+        });
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        BleachOptions opt;
+        opt.model = static_cast<BleachOptions::Model>(modelCombo->currentData().toInt());
+        if (measureCheck->isChecked()) opt.measureRoi = roi;
+        opt.offset = offsetSpin->value();
+        opt.maxGain = gainSpin->value();
+        output.applyTo(opt.output);
+        opt.output.first = rangeIn;
+        opt.output.last = last;
+        if (cropCheck->isChecked()) opt.output.roi = roi;
+        const QString source = seqA.path();
+        logMessage(QString("Bleach correction (%1) of %2 to %3")
+            .arg(BleachCorrector::modelName(opt.model)).arg(source).arg(opt.output.outputPath));
+        runExportJob("Correcting photobleaching...", opt.output.outputPath,
+            [source, opt](const BleachCorrector::Progress& progress, const std::atomic<bool>* cancel){
+                return BleachCorrector::run(source, opt, progress, cancel);
+            });
+    }
+
+    void showTemporalFilterDialog() {
+        if (!seqA.isOpen()) return;
+        setPlaying(false);
+        const QRect roi = imageView->selection();
+        const int last = rangeOut < 0 ? seqA.count() - 1 : rangeOut;
+
+        QDialog dlg(this);
+        dlg.setWindowTitle("Temporal median filter");
+        auto form = new QFormLayout;
+        auto rangeInfo = new QLabel(QString("Frames %1 - %2").arg(rangeIn + 1).arg(last + 1));
+        auto windowSpin = new QSpinBox;
+        windowSpin->setRange(1, TemporalMedian::kMaxWindow);
+        windowSpin->setValue(9);
+        windowSpin->setSuffix(" frames");
+        windowSpin->setToolTip(QString("Centred on each frame. Up to %1 frames go through a sorting network; "
+                                       "longer windows keep each pixel's samples sorted, at twice the memory")
+                                   .arg(TemporalMedian::kMaxNetwork));
+        auto statCombo = new QComboBox;
+        statCombo->addItem("Median", static_cast<int>(TemporalMedian::Statistic::Median));
+        statCombo->addItem("Trimmed mean", static_cast<int>(TemporalMedian::Statistic::TrimmedMean));
+        auto trimSpin = new QSpinBox;
+        trimSpin->setRange(0, 45);
+        trimSpin->setValue(20);
+        trimSpin->setSuffix(" % each end");
+        trimSpin->setEnabled(false);
+        auto outputCombo = new QComboBox;
+        outputCombo->addItem("Filtered frames (denoise)");
+        outputCombo->addItem("Frame minus filtered (background subtract)");
+        auto pedestalSpin = new QSpinBox;
+        pedestalSpin->setRange(0, 65535);
+        pedestalSpin->setValue(100);
+        pedestalSpin->setSuffix(" DN");
+        pedestalSpin->setToolTip("Added after subtraction, so values below the background are not clipped");
+        pedestalSpin->setEnabled(false);
+        auto cropCheck = new QCheckBox("Crop output to selection");
+        cropCheck->setEnabled(!roi.isEmpty());
+        auto memoryLabel = new QLabel;
+        form->addRow("Range", rangeInfo);
+        form->addRow("Window", windowSpin);
+        form->addRow("Statistic", statCombo);
+        form->addRow("Trim", trimSpin);
+        form->addRow("Output", outputCombo);
+        form->addRow("Pedestal", pedestalSpin);
+        form->addRow(cropCheck);
+        form->addRow("Memory", memoryLabel);
+        const ExportOutputRows output = ExportOutputRows::add(&dlg, form, seqA.directory() + "_median");
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        QObject::connect(statCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){
+            trimSpin->setEnabled(statCombo->currentIndex() == 1);
+        });
+        QObject::connect(outputCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){
+            pedestalSpin->setEnabled(outputCombo->currentIndex() == 1);
+        });
+        auto updateMemory = [&](){
+            const QSize size = cropCheck->isChecked() ? roi.size() : seqA.frame(rangeIn).size();
+            memoryLabel->setText(QString("%1 MB of window state")
+                .arg(TemporalMedian::memoryBytes(size.width(), size.height(), windowSpin->value()) >> 20));
+        };
+        QObject::connect(windowSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int){ updateMemory(); });
+        QObject::connect(cropCheck, &QCheckBox::toggled, [&](bool){ updateMemory(); });
+        updateMemory();
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        TemporalFilterOptions opt;
+        opt.window = windowSpin->value();
+        opt.statistic = static_cast<TemporalMedian::Statistic>(statCombo->currentData().toInt());
+        opt.trim = trimSpin->value() / 100.0;
+        opt.subtract = outputCombo->currentIndex() == 1;
+        opt.pedestal = pedestalSpin->value();
+        output.applyTo(opt.output);
+        opt.output.first = rangeIn;
+        opt.output.last = last;
+        if (cropCheck->isChecked()) opt.output.roi = roi;
+        const QString source = seqA.path();
+        logMessage(QString("Temporal %1 of %2 frames, %3 to %4").arg(statCombo->currentText().toLower())
+            .arg(opt.window).arg(source).arg(opt.output.outputPath));
+        runExportJob("Filtering...", opt.output.outputPath,
+            [source, opt](const TemporalFilter::Progress& progress, const std::atomic<bool>* cancel){
+                return TemporalFilter::run(source, opt, progress, cancel);
+            });
+    }
+
+    using MotionFieldPtr = std::shared_ptr<const std::vector<MotionEstimator::Vector>>;
+
+    // Motion vectors from the previous frame and particle tracks up to this
+    // frame, whichever are switched on. A motion field still being computed
+    // is drawn when it arrives.
+    void updateOverlay(int index, const QRect& frameRect) {
+        overlayIndex = index;
+        overlayRect = frameRect;
+        auto field = motionField(index, frameRect);
+        auto tracks = trackOverlayCheck->isChecked() ? particleTracks : nullptr;
+        if (!field && !tracks) {
+            imageView->setOverlayPainter(nullptr);
+            return;
+        }
+        imageView->setOverlayPainter([field, tracks, index](QPainter& p){
+            if (field) {
+                p.setPen(QPen(QColor(0, 220, 255), 0));
+                for (const MotionEstimator::Vector& v : *field) {
+                    if (v.dx == 0.0f && v.dy == 0.0f) continue;
+                    const QPointF to(v.x + 2.0f * v.dx, v.y + 2.0f * v.dy);
+                    p.drawLine(QPointF(v.x, v.y), to);
+                    p.drawEllipse(to, 1.5, 1.5);
+                }
+            }
+            if (tracks) drawTracks(p, *tracks, index);
+        });
+    }
+
+    // Vectors from the previous frame to this one, over the selection or the
+    // frame, from the cache. A miss is handed to the motion worker and
+    // returns null.
+    MotionFieldPtr motionField(int index, const QRect& frameRect) {
+        if (!motionOverlayCheck->isChecked() || index == 0) return nullptr;
+        const QRect sel = imageView->selection();
+        const QRect roi = sel.isEmpty() ? frameRect : sel.intersected(frameRect);
+        if (roi.isEmpty()) return nullptr;
+        if (roi != motionRoi) {
+            motionRoi = roi;
+            ++motionGeneration;
+            motionCache.clear();
+        }
+        if (MotionFieldPtr* hit = motionCache.object(index)) return *hit;
+        motionWanted = index;
+        if (!motionBusy) startMotionField();
+        return nullptr;
+    }
+
+    // One field at a time; while it runs only the newest wanted frame is
+    // remembered, so scrubbing does not queue up stale work.
+    void startMotionField() {
+        const int index = motionWanted;
+        const QRect roi = motionRoi;
+        const quint64 generation = motionGeneration;
+        motionWanted = -1;
+        motionBusy = true;
+        FrameSequence* seq = &seqA;
+        motionPool.start([this, seq, index, roi, generation]() {
+            auto field = std::make_shared<std::vector<MotionEstimator::Vector>>();
+            const QImage prev = seq->read(index - 1);
+            const QImage img = seq->read(index);
+            if (!prev.isNull() && prev.size() == img.size() && img.rect().contains(roi)) {
+                const MotionEstimator::Settings ms;
+                const int threads = std::max(1, QThread::idealThreadCount());
+                const int shift = MotionEstimator::shiftFor(img, roi);
+                *field = MotionEstimator::match(MotionEstimator::pyramid(prev, roi, ms.level, shift, threads),
+                                                MotionEstimator::pyramid(img, roi, ms.level, shift, threads),
+                                                roi, ms, threads);
+            }
+            QMetaObject::invokeMethod(this, [this, index, generation, field](){
+                motionFieldReady(index, generation, field);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void motionFieldReady(int index, quint64 generation, const MotionFieldPtr& field) {
+        motionBusy = false;
+        if (generation == motionGeneration) {
+            const qint64 kb = static_cast<qint64>(field->size() * sizeof(MotionEstimator::Vector) / 1024);
+            motionCache.insert(index, new MotionFieldPtr(field), std::max<qint64>(1, kb));
+            if (index == overlayIndex) updateOverlay(overlayIndex, overlayRect);
+        }
+        if (motionWanted >= 0) startMotionField();
+    }
+
+    // The last kTail points of every track seen in this frame, coloured by
+    // track so neighbours stay distinguishable.
+    static void drawTracks(QPainter& p, const ParticleTrackResult& tracks, int index) {
+        constexpr int kTail = 30;
+        if (index < tracks.first || index > tracks.last) return;
+        const int k = index - tracks.first;
+        QPolygonF line;
+        for (int d = tracks.frameStart[k]; d < tracks.frameStart[k + 1]; ++d) {
+            const ParticleTrackResult::Detection& at = tracks.detections[d];
+            if (at.track < 0) continue;
+            line.clear();
+            for (int q = d; q >= 0 && line.size() < kTail; q = tracks.detections[q].prev) {
+                line << QPointF(tracks.detections[q].x + 0.5, tracks.detections[q].y + 0.5);
+            }
+            p.setPen(QPen(QColor::fromHsv((at.track * 47) % 360, 220, 255), 0));
+            p.drawPolyline(line);
+            p.drawEllipse(line.front(), 2.0, 2.0);
+        }
+    }
+
+    void showMotionDialog() {
+        if (!seqA.isOpen()) return;
+        setPlaying(false);
+        const QRect roi = imageView->selection();
+        const int last = rangeOut < 0 ? seqA.count() - 1 : rangeOut;
+
+        QDialog dlg(this);
+        dlg.setWindowTitle("Motion analysis");
+        auto form = new QFormLayout;
+        auto rangeInfo = new QLabel(QString("Frames %1 - %2").arg(rangeIn + 1).arg(last + 1));
+        auto roiCheck = new QCheckBox(roi.isEmpty()
+            ? QString("Limit to selection (Shift+drag in the view)")
+            : QString("Limit to %1,%2 %3x%4").arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()));
+        roiCheck->setEnabled(!roi.isEmpty());
+        roiCheck->setChecked(!roi.isEmpty());
+        auto vectorsCheck = new QCheckBox("Block vectors");
+        vectorsCheck->setChecked(true);
+        auto gridCombo = new QComboBox;
+        gridCombo->addItem("32 px grid", QPoint(2, 8));
+        gridCombo->addItem("64 px grid", QPoint(3, 8));
+        gridCombo->addItem("128 px grid", QPoint(3, 16));
+        gridCombo->setCurrentIndex(1);
+        auto outEdit = new QLineEdit(seqA.directory() + "_motion.csv");
+        auto outBrowse = new QPushButton("...");
+        auto outRow = new QHBoxLayout;
+        outRow->addWidget(outEdit, 1);
+        outRow->addWidget(outBrowse);
+        auto threadSpin = new QSpinBox;
+        threadSpin->setRange(1, 256);
+        threadSpin->setValue(std::max(1, QThread::idealThreadCount()));
+        form->addRow("Range", rangeInfo);
+        form->addRow(roiCheck);
+        form->addRow(vectorsCheck);
+        form->addRow("Vectors", gridCombo);
+        form->addRow("Output", outRow);
+        form->addRow("Threads", threadSpin);
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        QObject::connect(outBrowse, &QPushButton::clicked, [&](){
+            QString path = QFileDialog::getSaveFileName(&dlg, "Motion trace", outEdit->text(), "CSV (*.csv)");
+            if (!path.isEmpty()) outEdit->setText(path);
+        });
+        QObject::connect(vectorsCheck, &QCheckBox::toggled, gridCombo, &QWidget::setEnabled);
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        MotionEstimator::Settings ms;
+        ms.vectors = vectorsCheck->isChecked();
+        const QPoint grid = gridCombo->currentData().toPoint();
+        ms.level = grid.x();
+        ms.block = grid.y();
+        ms.search = grid.y() / 2;
+        const QRect region = roiCheck->isChecked() ? roi : QRect();
+        const QString source = seqA.path();
+        const QString csvPath = outEdit->text();
+        const int first = rangeIn;
+        const int threads = threadSpin->value();
+        logMessage(QString("Motion trace of %1 to %2").arg(source).arg(csvPath));
+        auto samples = std::make_shared<std::vector<MotionEstimator::Sample>>();
+        runExportJob("Estimating motion...", csvPath,
+            [=](const MotionEstimator::Progress& progress, const std::atomic<bool>* cancel){
+                return MotionEstimator::exportTrace(source, first, last, region, ms, csvPath, threads,
+                                                    samples.get(), progress, cancel);
+            },
+            [this, samples, csvPath, vectors = ms.vectors](){ showMotionTrace(*samples, csvPath, vectors); });
+    }
+
+    void showMotionTrace(const std::vector<MotionEstimator::Sample>& samples, const QString& csvPath, bool vectors) {
+        logMessage(QString("Motion trace of %1 frames saved to %2").arg(samples.size()).arg(csvPath));
+        auto dlg = new QDialog(this);
+        dlg->setAttribute(Qt::WA_DeleteOnClose);
+        dlg->setWindowTitle("Motion trace");
+        auto energyPlot = new TracePlot;
+        energyPlot->setToolTip("Difference energy, DN per pixel, against time");
+        std::vector<QPointF> energy, speed, moving;
+        double peakEnergy = 0.0, peakSpeed = 0.0;
+        for (const MotionEstimator::Sample& smp : samples) {
+            energy.push_back({smp.time, smp.energy});
+            speed.push_back({smp.time, smp.speed});
+            peakEnergy = std::max(peakEnergy, smp.energy);
+            peakSpeed = std::max(peakSpeed, smp.speed);
+        }
+        for (const MotionEstimator::Sample& smp : samples) moving.push_back({smp.time, smp.moving * peakSpeed});
+        energyPlot->setSamples(std::move(energy));
+        auto layout = new QVBoxLayout(dlg);
+        layout->addWidget(new QLabel(QString("%1 frame pairs, peak energy %2 DN/px%3\nSaved to %4")
+            .arg(samples.size()).arg(peakEnergy, 0, 'f', 2)
+            .arg(vectors ? QString(", peak mean speed %1 px/frame").arg(peakSpeed, 0, 'f', 2) : QString())
+            .arg(csvPath)));
+        layout->addWidget(new QLabel("Difference energy"));
+        layout->addWidget(energyPlot);
+        if (vectors) {
+            auto speedPlot = new TracePlot;
+            speedPlot->setToolTip("Mean vector length, pixels per frame (green), and share of moving blocks (blue, scaled)");
+            speedPlot->setSamples(std::move(speed), std::numeric_limits<double>::quiet_NaN(), std::move(moving));
+            layout->addWidget(new QLabel("Block motion"));
+            layout->addWidget(speedPlot);
+        }
+        layout->addStretch(1);
+        dlg->resize(700, vectors ? 360 : 220);
+        dlg->show();
+    }
+
+    // Particle detection with the live blob counter's segmentation, then
+    // frame-to-frame linking. Results feed the Tracks overlay.
+    void showTrackDialog() {
+        if (!seqA.isOpen()) return;
+        setPlaying(false);
+        const QRect roi = imageView->selection();
+        const int last = rangeOut < 0 ? seqA.count() - 1 : rangeOut;
+
+        QDialog dlg(this);
+        dlg.setWindowTitle("Particle tracking");
+        auto form = new QFormLayout;
+        auto rangeInfo = new QLabel(QString("Frames %1 - %2").arg(rangeIn + 1).arg(last + 1));
+        auto roiCheck = new QCheckBox(roi.isEmpty()
+            ? QString("Limit to selection (Shift+drag in the view)")
+            : QString("Limit to %1,%2 %3x%4").arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()));
+        roiCheck->setEnabled(!roi.isEmpty());
+        roiCheck->setChecked(!roi.isEmpty());
+        auto thresholdCombo = new QComboBox;
+        thresholdCombo->addItem("Otsu, per frame");
+        thresholdCombo->addItem("Fixed");
+        auto thresholdSpin = new QSpinBox;
+        thresholdSpin->setRange(1, 65535);
+        thresholdSpin->setValue(1000);
+        thresholdSpin->setSuffix(" DN");
+        thresholdSpin->setEnabled(false);
+        auto darkCheck = new QCheckBox("Dark particles");
+        auto areaSpin = new QSpinBox;
+        areaSpin->setRange(1, 100000);
+        areaSpin->setValue(4);
+        areaSpin->setSuffix(" px");
+        auto maxAreaSpin = new QSpinBox;
+        maxAreaSpin->setRange(0, 10000000);
+        maxAreaSpin->setSpecialValueText("no limit");
+        maxAreaSpin->setSuffix(" px");
+        auto stepSpin = new QDoubleSpinBox;
+        stepSpin->setRange(0.5, 500.0);
+        stepSpin->setDecimals(1);
+        stepSpin->setValue(5.0);
+        stepSpin->setSuffix(" px/frame");
+        stepSpin->setToolTip("Largest move linked between consecutive frames");
+        auto gapSpin = new QSpinBox;
+        gapSpin->setRange(0, 20);
+        gapSpin->setValue(1);
+        gapSpin->setSuffix(" frames");
+        gapSpin->setToolTip("Frames a particle may go undetected before its track ends");
+        auto linkCombo = new QComboBox;
+        linkCombo->addItem("Global assignment (least total distance)");
+        linkCombo->addItem("Nearest neighbour (greedy)");
+        auto lengthSpin = new QSpinBox;
+        lengthSpin->setRange(1, 100000);
+        lengthSpin->setValue(3);
+        lengthSpin->setSuffix(" points");
+        auto threadSpin = new QSpinBox;
+        threadSpin->setRange(1, 256);
+        threadSpin->setValue(std::max(1, QThread::idealThreadCount()));
+        form->addRow("Range", rangeInfo);
+        form->addRow(roiCheck);
+        form->addRow("Threshold", thresholdCombo);
+        form->addRow("", thresholdSpin);
+        form->addRow(darkCheck);
+        form->addRow("Min area", areaSpin);
+        form->addRow("Max area", maxAreaSpin);
+        form->addRow("Max step", stepSpin);
+        form->addRow("Max gap", gapSpin);
+        form->addRow("Linking", linkCombo);
+        form->addRow("Min length", lengthSpin);
+        form->addRow("Threads", threadSpin);
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        QObject::connect(thresholdCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int i){
+            thresholdSpin->setEnabled(i == 1);
+        });
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        ParticleTrackOptions opt;
+        opt.first = rangeIn;
+        opt.last = last;
+        if (roiCheck->isChecked()) opt.roi = roi;
+        opt.detect.otsu = thresholdCombo->currentIndex() == 0;
+        opt.detect.threshold = thresholdSpin->value();
+        opt.detect.dark = darkCheck->isChecked();
+        opt.detect.minArea = areaSpin->value();
+        opt.detect.maxArea = maxAreaSpin->value();
+        opt.maxStep = stepSpin->value();
+        opt.maxGap = gapSpin->value();
+        opt.global = linkCombo->currentIndex() == 0;
+        opt.minLength = lengthSpin->value();
+        opt.threads = threadSpin->value();
+        const QString source = seqA.path();
+        logMessage(QString("Particle tracking of %1, frames %2 - %3").arg(source).arg(opt.first + 1).arg(last + 1));
+        auto result = std::make_shared<ParticleTrackResult>();
+        runExportJob("Tracking particles...", source,
+            [source, opt, result](const ParticleTracker::Progress& progress, const std::atomic<bool>* cancel){
+                return ParticleTracker::run(source, opt, *result, progress, cancel);
+            },
+            [this, result](){ showTrackResult(result); });
+    }
+
+    void showTrackResult(std::shared_ptr<const ParticleTrackResult> result) {
+        logMessage("Particle tracking: " + QString(result->summary()).replace('\n', "; "));
+        particleTracks = result;
+        trackOverlayCheck->setEnabled(true);
+        if (trackOverlayCheck->isChecked()) showFrame(slider->value());
+        else trackOverlayCheck->setChecked(true);
+
+        auto dlg = new QDialog(this);
+        dlg->setAttribute(Qt::WA_DeleteOnClose);
+        dlg->setWindowTitle("Particle tracks");
+        // Histogram of per-track mean speeds.
+        constexpr int kBins = 50;
+        double top = 0.0;
+        for (const ParticleTrackResult::Track& t : result->tracks) top = std::max(top, t.meanSpeed);
+        std::vector<double> counts(kBins, 0.0);
+        for (const ParticleTrackResult::Track& t : result->tracks) {
+            counts[std::min(kBins - 1, static_cast<int>(kBins * t.meanSpeed / std::max(top, 1e-9)))] += 1.0;
+        }
+        std::vector<QPointF> histogram;
+        for (int b = 0; b < kBins; ++b) histogram.push_back({(b + 0.5) * top / kBins, counts[b]});
+        auto plot = new TracePlot;
+        plot->setToolTip("Tracks per mean-speed bin, pixels per frame");
+        plot->setSamples(std::move(histogram));
+        auto info = new QLabel(result->summary());
+        info->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+        auto saveBtn = new QPushButton("Save CSV...");
+        auto layout = new QVBoxLayout(dlg);
+        layout->addWidget(info);
+        layout->addWidget(new QLabel("Mean speed per track"));
+        layout->addWidget(plot);
+        layout->addWidget(saveBtn);
+        QObject::connect(saveBtn, &QPushButton::clicked, dlg, [dlg, result, dir = seqA.directory()](){
+            QString path = QFileDialog::getSaveFileName(dlg, "Save particle tracks", dir + "_particles.csv", "CSV (*.csv)");
+            if (path.isEmpty()) return;
+            QString err = result->save(path);
+            logMessage(err.isEmpty() ? "Particle tracks saved next to " + path : "Particle track save failed: " + err);
+            if (!err.isEmpty()) QMessageBox::warning(dlg, "Save failed", err);
+        });
+        dlg->resize(600, 320);
+        dlg->show();
+    }
+
+    // Per-pixel temporal FFT over the marked range, streamed in row tiles
+    // through a bounded buffer. Results open in their own window.
+    void showTemporalSpectrumDialog() {
+        if (!seqA.isOpen()) return;
+        setPlaying(false);
+        const QRect roi = imageView->selection();
+        const FrameTimeline& tl = seqA.timeline();
+        const double rate = tl.nominalInterval() > 0.0 ? 1.0 / tl.nominalInterval() : 0.0;
+        const int last = rangeOut < 0 ? seqA.count() - 1 : rangeOut;
+
+        QDialog dlg(this);
+        dlg.setWindowTitle("Temporal frequency analysis");
+        auto form = new QFormLayout;
+        auto rangeInfo = new QLabel(QString("Frames %1 - %2, %3")
+            .arg(rangeIn + 1).arg(last + 1)
+            .arg(rate > 0.0 ? QString("%1 Hz %2").arg(rate, 0, 'f', 2).arg(tl.hasTimestamps() ? "(measured)" : "(nominal)")
+                            : QString("no time axis")));
+        auto samplesCombo = new QComboBox;
+        for (int n : {128, 256, 512, 1024, 2048, 4096, 8192}) samplesCombo->addItem(QString::number(n), n);
+        samplesCombo->setCurrentIndex(3);
+        auto roiCheck = new QCheckBox(roi.isEmpty()
+            ? QString("Limit to selection (Shift+drag in the view)")
+            : QString("Limit to %1,%2 %3x%4").arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()));
+        roiCheck->setEnabled(!roi.isEmpty());
+        roiCheck->setChecked(!roi.isEmpty());
+        auto minHzSpin = new QDoubleSpinBox;
+        minHzSpin->setRange(0.0, 100000.0);
+        minHzSpin->setDecimals(2);
+        minHzSpin->setValue(1.0);
+        minHzSpin->setSuffix(" Hz");
+        minHzSpin->setToolTip("Ignore slower changes (bleaching, drift) when picking each pixel's dominant frequency");
+        auto memorySpin = new QSpinBox;
+        memorySpin->setRange(16, 65536);
+        memorySpin->setValue(512);
+        memorySpin->setSuffix(" MB");
+        auto threadSpin = new QSpinBox;
+        threadSpin->setRange(1, 256);
+        threadSpin->setValue(std::max(1, QThread::idealThreadCount()));
+        form->addRow("Range", rangeInfo);
+        form->addRow("Samples", samplesCombo);
+        form->addRow(roiCheck);
+        form->addRow("Lowest frequency", minHzSpin);
+        form->addRow("Memory", memorySpin);
+        form->addRow("Threads", threadSpin);
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        TemporalSpectrumOptions opt;
+        opt.first = rangeIn;
+        opt.last = last;
+        opt.maxSamples = samplesCombo->currentData().toInt();
+        if (roiCheck->isChecked()) opt.roi = roi;
+        opt.minHz = minHzSpin->value();
+        opt.memoryBytes = static_cast<qint64>(memorySpin->value()) << 20;
+        opt.threads = threadSpin->value();
+        const QString source = seqA.path();
+        logMessage(QString("Temporal spectrum of %1, up to %2 samples").arg(source).arg(opt.maxSamples));
+        auto result = std::make_shared<TemporalSpectrumResult>();
+        runExportJob("Computing temporal spectra...", source,
+            [source, opt, result](const TemporalSpectrum::Progress& progress, const std::atomic<bool>* cancel){
+                return TemporalSpectrum::run(source, opt, *result, progress, cancel);
+            },
+            [this, result, minHz = opt.minHz](){ showTemporalSpectrum(result, minHz); });
+    }
+
+    void showTemporalSpectrum(std::shared_ptr<TemporalSpectrumResult> result, double minHz) {
+        auto dlg = new QDialog(this);
+        dlg->setAttribute(Qt::WA_DeleteOnClose);
+        dlg->setWindowTitle(QString("Temporal spectrum: %1 samples at %2 Hz").arg(result->samples).arg(result->sampleRate, 0, 'f', 2));
+        auto mapView = new ZoomImageView;
+        mapView->setImage(result->renderMap());
+        auto plot = new TracePlot;
+        plot->setMinimumHeight(140);
+        plot->setToolTip("log10 power against frequency: mean of the pixel spectra (green), spectrum of the ROI mean (blue)");
+        std::vector<QPointF> pixelPts, meanPts;
+        for (size_t k = 1; k < result->frequency.size(); ++k) {
+            pixelPts.push_back({result->frequency[k], std::log10(result->meanPower[k] + 1e-12)});
+            meanPts.push_back({result->frequency[k], std::log10(result->coherentPower[k] + 1e-12)});
+        }
+        plot->setSamples(std::move(pixelPts), std::numeric_limits<double>::quiet_NaN(), std::move(meanPts));
+        auto info = new QLabel(QString(
+            "Map: hue is each pixel's dominant frequency, red at 0 Hz to blue at %1 Hz (Nyquist); "
+            "brightness is its share of the pixel's AC power.\n"
+            "%2 x %3 pixels, %4 frames, %5 pass(es), %6 Hz resolution\n\n"
+            "Strongest in the pixel spectra (vibration, noise):\n%7\n\n"
+            "Strongest in the ROI mean (flicker):\n%8")
+            .arg(0.5 * result->sampleRate, 0, 'f', 2)
+            .arg(result->roi.width()).arg(result->roi.height()).arg(result->framesRead).arg(result->passes)
+            .arg(result->sampleRate / result->samples, 0, 'g', 4)
+            .arg(result->peaks(result->meanPower, minHz, 5))
+            .arg(result->peaks(result->coherentPower, minHz, 5)));
+        info->setWordWrap(true);
+        info->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+        auto saveBtn = new QPushButton("Save...");
+        auto side = new QVBoxLayout;
+        side->addWidget(info);
+        side->addStretch(1);
+        side->addWidget(saveBtn);
+        auto top = new QHBoxLayout;
+        top->addWidget(mapView, 3);
+        top->addLayout(side, 1);
+        auto layout = new QVBoxLayout(dlg);
+        layout->addLayout(top, 1);
+        layout->addWidget(plot);
+        QObject::connect(saveBtn, &QPushButton::clicked, dlg, [dlg, result, dir = seqA.directory()](){
+            QString path = QFileDialog::getSaveFileName(dlg, "Save temporal spectrum", dir + "_spectrum.tiff",
+                                                        "32-bit float TIFF (*.tif *.tiff)");
+            if (path.isEmpty()) return;
+            QString err = result->save(path);
+            logMessage(err.isEmpty() ? "Temporal spectrum saved to " + path : "Temporal spectrum save failed: " + err);
+            if (!err.isEmpty()) QMessageBox::warning(dlg, "Save failed", err);
+        });
+        dlg->resize(1000, 700);
+        dlg->show();
+    }
+
+    // Runs an export on a detached thread behind a cancellable progress dialog.
+    // The job opens its own FrameSequence, so closing the viewer is safe.
+    // finished, when given, replaces the completion message on success.
+    void runExportJob(const QString& title, const QString& outputPath,
+                      std::function<QString(const std::function<void(int,int)>&, const std::atomic<bool>*)> job,
+                      std::function<void()> finished = {}) {
+        QPointer<QProgressDialog> progressDlg = new QProgressDialog(title, "Cancel", 0, 100, this);
+        progressDlg->setAttribute(Qt::WA_DeleteOnClose);
+        progressDlg->setWindowModality(Qt::WindowModal);
+        progressDlg->setMinimumDuration(0);
+        auto cancel = std::make_shared<std::atomic<bool>>(false);
+        QObject::connect(progressDlg, &QProgressDialog::canceled, [cancel](){ *cancel = true; });
+        // The viewer may be gone by the time the job ends.
+        QPointer<QWidget> owner = this;
+        std::thread([job, outputPath, progressDlg, cancel, finished, owner](){
+            QString err = job([progressDlg](int done, int total){
+                QMetaObject::invokeMethod(qApp, [progressDlg, done, total](){
+                    if (!progressDlg) return;
+                    progressDlg->setMaximum(total);
+                    progressDlg->setValue(done);
+                }, Qt::QueuedConnection);
+            }, cancel.get());
+            if (!err.isEmpty()) logMessage((finished ? "Analysis failed: " : "Export failed: ") + err);
+            else if (!finished) logMessage(QString("Export finished: %1").arg(outputPath));
+            QMetaObject::invokeMethod(qApp, [progressDlg, err, outputPath, finished, owner](){
+                if (progressDlg) progressDlg->close();
+                if (!err.isEmpty()) QMessageBox::warning(nullptr, finished ? "Analysis failed" : "Export failed", err);
+                else if (!finished) QMessageBox::information(nullptr, "Export finished", "Exported to\n" + outputPath);
+                else if (owner) finished();
+            }, Qt::QueuedConnection);
+        }).detach();
     }
 
     void updateTimeLabel(int index) {
-        int count = static_cast<int>(frameFiles.size());
-        if (fps <= 0.0 || count == 0) {
+        const FrameTimeline& tl = seqA.timeline();
+        if (tl.isEmpty() || !seqA.isOpen()) {
             timeLabel->setText("Time: -- / --");
             return;
         }
-        double totalSec = static_cast<double>(count) / fps;
-        double currentSec = static_cast<double>(index) / fps;
-        timeLabel->setText(QString("Time: %1 / %2").arg(formatTimeSeconds(currentSec)).arg(formatTimeSeconds(totalSec)));
+        double totalSec = tl.duration();
+        double currentSec = tl.timeAt(index);
+        QString text = QString("Time: %1 / %2").arg(formatTimeSeconds(currentSec)).arg(formatTimeSeconds(totalSec));
+        if (!tl.hasTimestamps()) text += " (nominal fps)";
+        else if (tl.isGapAt(index)) text += " (after gap)";
+        timeLabel->setText(text);
     }
 
     ZoomImageView* imageView;
+    ZoomImageView* compareView;
     QLabel* frameLabel;
     QLabel* timeLabel;
+    QLabel* compareLabel;
     QLineEdit* folderEdit;
     QComboBox* recentCombo;
-    QSlider* slider;
+    QCheckBox* compareCheck;
+    QLineEdit* compareEdit;
+    QComboBox* alignCombo;
+    QCheckBox* diffCheck;
+    TimelineSlider* slider;
+    QLineEdit* seekEdit;
     QPushButton* prevBtn;
+    QPushButton* playBtn;
     QPushButton* nextBtn;
-    QStringList frameFiles;
-    double fps;
+    QPushButton* markInBtn;
+    QPushButton* markOutBtn;
+    QPushButton* exportBtn;
+    QPushButton* videoBtn;
+    QPushButton* flickerBtn;
+    QPushButton* motionBtn;
+    QCheckBox* motionOverlayCheck;
+    QPushButton* trackBtn;
+    QCheckBox* trackOverlayCheck;
+    QPushButton* bleachBtn;
+    QPushButton* medianBtn;
+    QComboBox* colormapCombo;
+    QSpinBox* blackSpin;
+    QSpinBox* whiteSpin;
+    QCache<quint64, QImage> diffCache;  // |B - A| by (A index << 32 | B index)
+    QCache<int, MotionFieldPtr> motionCache;   // by frame index, over motionRoi
+    QRect motionRoi;
+    quint64 motionGeneration = 0;       // bumped when cached fields go stale
+    int motionWanted = -1;
+    bool motionBusy = false;
+    int overlayIndex = -1;
+    QRect overlayRect;
+    bool syncingViews = false;
+    std::shared_ptr<const ParticleTrackResult> particleTracks;
+    QLabel* rangeLabel;
+    int rangeIn = 0;
+    int rangeOut = -1;
+    QCheckBox* followCheck;
+    QTimer playTimer;
+    QElapsedTimer playClock;
+    QTimer followTimer;
+    QFileSystemWatcher followWatcher;
+    FrameSequence seqA;
+    FrameSequence seqB;
+    int lastDirection;
+    double playStartSec;
+    // Last member: its destructor waits for a field reading seqA.
+    QThreadPool motionPool;
+};
+
+struct RecordedFrame {
+    QImage image;
+    FrameMeta meta;
 };
 
 void pruneLogs() {
@@ -495,10 +2243,128 @@ void installLogTees() {
     std::cout.rdbuf(loggerStream.rdbuf());
     std::cerr.rdbuf(loggerStream.rdbuf());
 }
+
+// Headless batch transcoder, e.g. for nightly archive conversion:
+//   qt_hama_gui --transcode <input> <output> [--format tiff|multitiff|raw]
+//               [--first N] [--last N] [--step N] [--roi x,y,w,h]
+//               [--window black,white] [--threads N] [--recursive]
+int runTranscoder(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("Hamamatsu");
+    QCoreApplication::setApplicationName("qt_hama_gui");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Transcode recordings without the GUI.");
+    parser.addHelpOption();
+    QCommandLineOption transcodeOpt("transcode", "Run the headless transcoder.");
+    QCommandLineOption formatOpt("format", "Output format: tiff, multitiff or raw.", "format", "tiff");
+    QCommandLineOption firstOpt("first", "First frame (0-based).", "n", "0");
+    QCommandLineOption lastOpt("last", "Last frame, inclusive (-1 = end).", "n", "-1");
+    QCommandLineOption stepOpt("step", "Keep every Nth frame.", "n", "1");
+    QCommandLineOption roiOpt("roi", "Crop rectangle x,y,w,h.", "rect");
+    QCommandLineOption windowOpt("window", "Reduce to 8 bits with black,white.", "range");
+    QCommandLineOption threadsOpt("threads", "Worker threads (0 = all cores).", "n", "0");
+    QCommandLineOption recursiveOpt("recursive", "Convert every recording below <input> into <output>.");
+    parser.addOptions({transcodeOpt, formatOpt, firstOpt, lastOpt, stepOpt, roiOpt, windowOpt, threadsOpt, recursiveOpt});
+    parser.addPositionalArgument("input", "Capture folder, multi-page TIFF or .dcraw file.");
+    parser.addPositionalArgument("output", "Output folder or file.");
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 2) {
+        err << "Expected <input> and <output>\n";
+        return 2;
+    }
+
+    ExportOptions opt;
+    if (!SequenceExporter::parseFormat(parser.value(formatOpt), opt.format)) {
+        err << "Unknown format: " << parser.value(formatOpt) << "\n";
+        return 2;
+    }
+    opt.first = parser.value(firstOpt).toInt();
+    opt.last = parser.value(lastOpt).toInt();
+    opt.step = std::max(1, parser.value(stepOpt).toInt());
+    opt.threads = parser.value(threadsOpt).toInt();
+    if (parser.isSet(roiOpt)) {
+        QStringList r = parser.value(roiOpt).split(',');
+        if (r.size() != 4) {
+            err << "--roi expects x,y,w,h\n";
+            return 2;
+        }
+        opt.roi = QRect(r[0].toInt(), r[1].toInt(), r[2].toInt(), r[3].toInt());
+    }
+    if (parser.isSet(windowOpt)) {
+        QStringList w = parser.value(windowOpt).split(',');
+        if (w.size() != 2) {
+            err << "--window expects black,white\n";
+            return 2;
+        }
+        opt.applyWindow = true;
+        opt.black = w[0].toInt();
+        opt.white = w[1].toInt();
+    }
+
+    // Jobs: the input itself, or every recording found below it.
+    QString suffix = opt.format == ExportOptions::Format::MultiPageTiff ? ".tif"
+                   : opt.format == ExportOptions::Format::RawContainer ? ".dcraw" : "";
+    QList<QPair<QString, QString>> jobs;
+    const QString input = QFileInfo(args[0]).absoluteFilePath();
+    const QString output = args[1];
+    if (!parser.isSet(recursiveOpt)) {
+        jobs.append({input, output});
+    } else {
+        QDir root(input);
+        QStringList tiffFilters{"*.tif", "*.tiff", "*.TIF", "*.TIFF"};
+        // A folder is a recording when it holds numbered frames
+        // ("000123.tiff"); folders of snapshots or figures are skipped.
+        const QRegularExpression frameName("^\\d+\\.tiff?$", QRegularExpression::CaseInsensitiveOption);
+        QStringList dirs{input};
+        QDirIterator it(input, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext()) dirs << it.next();
+        for (const QString& d : dirs) {
+            QDir dir(d);
+            QString rel = root.relativeFilePath(d);
+            QString target = (rel == ".") ? output : QDir(output).filePath(rel);
+            const QStringList tiffs = dir.entryList(tiffFilters, QDir::Files);
+            if (std::any_of(tiffs.begin(), tiffs.end(), [&](const QString& f){ return frameName.match(f).hasMatch(); })) {
+                jobs.append({d, target + suffix});
+            }
+            for (const QString& f : dir.entryList(QStringList() << "*.dcraw", QDir::Files)) {
+                QString base = QDir(target).filePath(QFileInfo(f).completeBaseName());
+                jobs.append({dir.absoluteFilePath(f), base + suffix});
+            }
+        }
+    }
+
+    int failures = 0;
+    for (const auto& job : jobs) {
+        ExportOptions jobOpt = opt;
+        jobOpt.outputPath = job.second;
+        out << job.first << " -> " << job.second << "\n";
+        out.flush();
+        QString e = SequenceExporter::run(job.first, jobOpt, [&out](int done, int total){
+            out << "\r  " << done << " / " << total;
+            out.flush();
+        });
+        out << "\n";
+        if (!e.isEmpty()) {
+            err << "  failed: " << e << "\n";
+            err.flush();
+            ++failures;
+        }
+    }
+    out << jobs.size() - failures << " of " << jobs.size() << " recordings converted\n";
+    return failures == 0 ? 0 : 1;
+}
 } // namespace
 
 
 int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--transcode") == 0) return runTranscoder(argc, argv);
+    }
     QApplication app(argc, argv);
     QCoreApplication::setOrganizationName("Hamamatsu");
     QCoreApplication::setApplicationName("qt_hama_gui");
@@ -625,6 +2491,215 @@ int main(int argc, char *argv[]) {
     displayEverySpin->setMaximum(1000);
     displayEverySpin->setValue(1);
 
+    auto displayModeCombo = new QComboBox;
+    displayModeCombo->addItem("Raw", static_cast<int>(FrameProcessor::Mode::Raw));
+    displayModeCombo->addItem("Rolling mean", static_cast<int>(FrameProcessor::Mode::RollingMean));
+    displayModeCombo->addItem("Exponential mean", static_cast<int>(FrameProcessor::Mode::ExponentialMean));
+    displayModeCombo->addItem("Running max", static_cast<int>(FrameProcessor::Mode::RunningMax));
+    displayModeCombo->addItem("Temporal variance", static_cast<int>(FrameProcessor::Mode::TemporalVariance));
+    displayModeCombo->addItem("Rolling median", static_cast<int>(FrameProcessor::Mode::RollingMedian));
+    displayModeCombo->addItem("Background subtract", static_cast<int>(FrameProcessor::Mode::BackgroundSubtract));
+    auto meanWindowSpin = new QSpinBox;
+    meanWindowSpin->setRange(2, 64);
+    meanWindowSpin->setValue(8);
+    meanWindowSpin->setSuffix(" frames");
+    meanWindowSpin->setToolTip(QString("Rolling mean and median window. Every frame in it is kept (2 bytes per pixel, "
+                                       "twice that for medians over 16 frames), so at large frame sizes the window is "
+                                       "shortened to fit %1 MB").arg(FrameProcessor::kMaxWindowBytes >> 20));
+    auto emaAlphaSpin = new QDoubleSpinBox;
+    emaAlphaSpin->setDecimals(3);
+    emaAlphaSpin->setRange(0.001, 1.0);
+    emaAlphaSpin->setSingleStep(0.01);
+    emaAlphaSpin->setValue(0.1);
+    auto displayResetBtn = new QPushButton("Reset");
+    auto varianceWindowSpin = new QSpinBox;
+    varianceWindowSpin->setRange(2, 1000);
+    varianceWindowSpin->setValue(100);
+    varianceWindowSpin->setSuffix(" frames");
+    auto overlayOpacitySpin = new QSpinBox;
+    overlayOpacitySpin->setRange(0, 100);
+    overlayOpacitySpin->setValue(70);
+    overlayOpacitySpin->setSuffix(" %");
+    auto varianceRangeSpin = new QDoubleSpinBox;
+    varianceRangeSpin->setDecimals(1);
+    varianceRangeSpin->setRange(0.0, 65535.0);
+    varianceRangeSpin->setSpecialValueText("Auto");
+    varianceRangeSpin->setSuffix(" DN sigma");
+    auto varianceExportBtn = new QPushButton("Export variance...");
+    auto displayInfoLabel = new QLabel("Showing raw frames");
+    auto calibFramesSpin = new QSpinBox;
+    calibFramesSpin->setRange(4, 1024);
+    calibFramesSpin->setValue(32);
+    calibFramesSpin->setSuffix(" frames");
+    auto darkBtn = new QPushButton("Capture dark...");
+    auto flatBtn = new QPushButton("Capture flat...");
+    auto clearCalBtn = new QPushButton("Clear");
+    auto correctDisplayCheck = new QCheckBox("Correct live display");
+    auto correctSaveCheck = new QCheckBox("Correct saved frames");
+    auto calibStatusLabel = new QLabel("No calibration");
+    calibStatusLabel->setWordWrap(true);
+    auto hotDetectBtn = new QPushButton("Detect hot pixels...");
+    auto hotCheck = new QCheckBox("Correct hot pixels during acquisition");
+    auto hotStatusLabel = new QLabel("No hot pixel map");
+    hotStatusLabel->setWordWrap(true);
+    auto ptcBtn = new QPushButton("Photon transfer curve...");
+    auto binXSpin = new QSpinBox;
+    binXSpin->setRange(1, SoftwareBinning::kMaxFactor);
+    binXSpin->setPrefix("x ");
+    auto binYSpin = new QSpinBox;
+    binYSpin->setRange(1, SoftwareBinning::kMaxFactor);
+    binYSpin->setPrefix("y ");
+    auto binSumCheck = new QCheckBox("Sum");
+    binSumCheck->setToolTip("Sum the bin (saturating at 16 bits) instead of averaging it");
+    auto saturationCheck = new QCheckBox("Saturation overlay");
+    saturationCheck->setToolTip("Tint saturated pixels red and pixels at zero blue in the live view");
+    auto colormapCombo = new QComboBox;
+    for (int m = 0; m < DisplayConverter::kColormaps; ++m) {
+        colormapCombo->addItem(DisplayConverter::colormapName(static_cast<DisplayConverter::Colormap>(m)), m);
+    }
+    colormapCombo->setToolTip("HiLo shows pixels at the bottom of the range blue and at the top red");
+    auto rangeBlackSpin = new QSpinBox;
+    rangeBlackSpin->setRange(0, 65534);
+    rangeBlackSpin->setPrefix("black ");
+    auto rangeWhiteSpin = new QSpinBox;
+    rangeWhiteSpin->setRange(1, 65535);
+    rangeWhiteSpin->setValue(65535);
+    rangeWhiteSpin->setPrefix("white ");
+    const QString binTip = "Software binning of the live view and live analysis; recording stays at full resolution. "
+                           "Selections and live results are in binned pixels; drift in recordings, localisation "
+                           "and spot/blob logs are written in sensor pixels";
+    binXSpin->setToolTip(binTip);
+    binYSpin->setToolTip(binTip);
+
+    auto focusCheck = new QCheckBox("Focus metric");
+    auto focusMetricCombo = new QComboBox;
+    focusMetricCombo->addItem("Variance of Laplacian", static_cast<int>(FocusMeter::Metric::LaplacianVariance));
+    focusMetricCombo->addItem("Brenner gradient", static_cast<int>(FocusMeter::Metric::Brenner));
+    focusMetricCombo->addItem("Normalised variance", static_cast<int>(FocusMeter::Metric::NormalizedVariance));
+    auto focusResetBtn = new QPushButton("Reset peak");
+    auto focusLabel = new QLabel("Focus: --");
+    focusLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    auto focusPlot = new TracePlot;
+    auto spotCheck = new QCheckBox("Spot tracking");
+    auto spotThresholdSpin = new QDoubleSpinBox;
+    spotThresholdSpin->setRange(0.0, 90.0);
+    spotThresholdSpin->setDecimals(0);
+    spotThresholdSpin->setValue(10.0);
+    spotThresholdSpin->setSuffix(" % of peak");
+    spotThresholdSpin->setToolTip("Pixels above background + this fraction of (peak - background) count toward the spot");
+    auto spotLogBtn = new QPushButton("Log CSV...");
+    auto spotLabel = new QLabel("Spot: --");
+    spotLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    auto smlmCheck = new QCheckBox("Single-molecule localisation");
+    auto smlmPreviewBtn = new QPushButton("Preview...");
+    auto smlmSigmaSpin = new QDoubleSpinBox;
+    smlmSigmaSpin->setRange(0.5, 5.0);
+    smlmSigmaSpin->setDecimals(2);
+    smlmSigmaSpin->setSingleStep(0.05);
+    smlmSigmaSpin->setValue(1.3);
+    smlmSigmaSpin->setSuffix(" px");
+    auto smlmThresholdSpin = new QDoubleSpinBox;
+    smlmThresholdSpin->setRange(1.0, 50.0);
+    smlmThresholdSpin->setDecimals(1);
+    smlmThresholdSpin->setValue(5.0);
+    smlmThresholdSpin->setToolTip("Candidates must exceed the filtered frame's mean by this many standard deviations");
+    auto smlmOffsetSpin = new QDoubleSpinBox;
+    smlmOffsetSpin->setRange(0.0, 10000.0);
+    smlmOffsetSpin->setDecimals(1);
+    smlmOffsetSpin->setValue(100.0);
+    smlmOffsetSpin->setSuffix(" DN");
+    auto smlmGainSpin = new QDoubleSpinBox;
+    smlmGainSpin->setRange(0.001, 100.0);
+    smlmGainSpin->setDecimals(3);
+    smlmGainSpin->setValue(1.0);
+    smlmGainSpin->setSuffix(" e-/DN");
+    smlmGainSpin->setToolTip("Conversion gain, e.g. from the photon transfer curve");
+    auto smlmPixelSpin = new QDoubleSpinBox;
+    smlmPixelSpin->setRange(1.0, 10000.0);
+    smlmPixelSpin->setDecimals(1);
+    smlmPixelSpin->setValue(100.0);
+    smlmPixelSpin->setSuffix(" nm");
+    smlmPixelSpin->setToolTip("Camera pixel size in the sample plane, used for the exported table");
+    auto smlmClearBtn = new QPushButton("Clear");
+    auto smlmExportBtn = new QPushButton("Export CSV...");
+    auto smlmLabel = new QLabel("Localisations: --");
+    smlmLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    auto driftCheck = new QCheckBox("Drift tracking");
+    auto driftEverySpin = new QSpinBox;
+    driftEverySpin->setRange(1, 1000);
+    driftEverySpin->setValue(10);
+    driftEverySpin->setPrefix("every ");
+    driftEverySpin->setSuffix(" frames");
+    auto driftWindowCombo = new QComboBox;
+    for (int side : {128, 256, 512, 1024}) driftWindowCombo->addItem(QString("%1 px window").arg(side), side);
+    driftWindowCombo->setCurrentIndex(2);
+    auto driftCorrectCheck = new QCheckBox("Drift-corrected display");
+    auto driftResetBtn = new QPushButton("New reference");
+    auto driftLabel = new QLabel("Drift: --");
+    driftLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    auto driftPlot = new TracePlot;
+    driftPlot->setToolTip("Drift x (green) and y (blue) against the reference, pixels");
+    auto spectrumCheck = new QCheckBox("Power spectrum");
+    auto spectrumRateSpin = new QDoubleSpinBox;
+    spectrumRateSpin->setRange(0.5, 30.0);
+    spectrumRateSpin->setDecimals(1);
+    spectrumRateSpin->setValue(5.0);
+    spectrumRateSpin->setSuffix(" Hz");
+    spectrumRateSpin->setToolTip("Spectra per second at most; frames in between are skipped");
+    auto spectrumWindowCombo = new QComboBox;
+    for (int side : {128, 256, 512, 1024, 2048}) spectrumWindowCombo->addItem(QString("%1 px window").arg(side), side);
+    spectrumWindowCombo->setCurrentIndex(2);
+    auto spectrumAvgSpin = new QSpinBox;
+    spectrumAvgSpin->setRange(1, 100);
+    spectrumAvgSpin->setValue(1);
+    spectrumAvgSpin->setPrefix("average ");
+    spectrumAvgSpin->setToolTip("Exponential average over about this many spectra");
+    auto spectrumShowBtn = new QPushButton("Show...");
+    auto spectrumBenchBtn = new QPushButton("Benchmark FFT");
+    auto spectrumLabel = new QLabel("Spectrum: --");
+    spectrumLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    auto motionCheck = new QCheckBox("Motion");
+    auto motionThreadsSpin = new QSpinBox;
+    motionThreadsSpin->setRange(1, std::max(1, QThread::idealThreadCount()));
+    motionThreadsSpin->setValue(std::clamp(QThread::idealThreadCount() / 2, 1, 4));
+    motionThreadsSpin->setSuffix(" threads");
+    auto motionVectorsCheck = new QCheckBox("Block vectors");
+    motionVectorsCheck->setChecked(true);
+    auto motionGridCombo = new QComboBox;
+    // Grid = block << level; the search range is half a block either way.
+    motionGridCombo->addItem("32 px grid", QPoint(2, 8));
+    motionGridCombo->addItem("64 px grid", QPoint(3, 8));
+    motionGridCombo->addItem("128 px grid", QPoint(3, 16));
+    motionGridCombo->setCurrentIndex(1);
+    auto motionLabel = new QLabel("Motion: --");
+    motionLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    auto motionPlot = new TracePlot;
+    motionPlot->setToolTip("Difference energy, DN per pixel (green), and mean vector length, pixels per frame (blue, scaled to the energy range)");
+    auto blobCheck = new QCheckBox("Blob count");
+    auto blobThresholdCombo = new QComboBox;
+    blobThresholdCombo->addItem("Otsu threshold");
+    blobThresholdCombo->addItem("Fixed threshold");
+    blobThresholdCombo->setToolTip("Otsu picks the threshold from each frame's ROI histogram");
+    auto blobThresholdSpin = new QSpinBox;
+    blobThresholdSpin->setRange(1, 65535);
+    blobThresholdSpin->setValue(1000);
+    blobThresholdSpin->setSuffix(" DN");
+    blobThresholdSpin->setEnabled(false);
+    auto blobDarkCheck = new QCheckBox("Dark objects");
+    blobDarkCheck->setToolTip("Count regions below the threshold instead of above it");
+    auto blobMinAreaSpin = new QSpinBox;
+    blobMinAreaSpin->setRange(1, 100000);
+    blobMinAreaSpin->setValue(4);
+    blobMinAreaSpin->setPrefix("min ");
+    blobMinAreaSpin->setSuffix(" px");
+    auto blobEdgeCheck = new QCheckBox("Skip edge blobs");
+    blobEdgeCheck->setToolTip("Ignore blobs touching the ROI border, which are only partly seen");
+    auto blobLogBtn = new QPushButton("Log CSV...");
+    auto blobLabel = new QLabel("Blobs: --");
+    blobLabel->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    auto blobPlot = new TracePlot;
+    blobPlot->setToolTip("Blob count per frame");
+
     auto controlLayout = new QVBoxLayout;
     controlLayout->addWidget(statusLabel);
     controlLayout->addWidget(statsLabel);
@@ -659,6 +2734,127 @@ int main(int argc, char *argv[]) {
 
     tabWidget->addTab(tabFormats, "Formats / Speed");
 
+    auto displayLayout = new QGridLayout;
+    displayLayout->addWidget(new QLabel("Live display"),0,0);
+    displayLayout->addWidget(displayModeCombo,0,1);
+    displayLayout->addWidget(new QLabel("Mean / median window"),1,0);
+    displayLayout->addWidget(meanWindowSpin,1,1);
+    displayLayout->addWidget(new QLabel("EMA weight"),2,0);
+    displayLayout->addWidget(emaAlphaSpin,2,1);
+    displayLayout->addWidget(new QLabel("Variance window"),3,0);
+    displayLayout->addWidget(varianceWindowSpin,3,1);
+    displayLayout->addWidget(new QLabel("Overlay opacity"),4,0);
+    displayLayout->addWidget(overlayOpacitySpin,4,1);
+    displayLayout->addWidget(new QLabel("Noise range"),5,0);
+    displayLayout->addWidget(varianceRangeSpin,5,1);
+    auto displayBtnRow = new QHBoxLayout;
+    displayBtnRow->addWidget(displayResetBtn);
+    displayBtnRow->addWidget(varianceExportBtn);
+    displayLayout->addLayout(displayBtnRow,6,1);
+    displayLayout->addWidget(displayInfoLabel,7,0,1,2);
+    displayLayout->addWidget(new QLabel("Calibration stack"),8,0);
+    displayLayout->addWidget(calibFramesSpin,8,1);
+    auto calibBtnRow = new QHBoxLayout;
+    calibBtnRow->addWidget(darkBtn);
+    calibBtnRow->addWidget(flatBtn);
+    calibBtnRow->addWidget(clearCalBtn);
+    displayLayout->addLayout(calibBtnRow,9,0,1,2);
+    displayLayout->addWidget(correctDisplayCheck,10,0,1,2);
+    displayLayout->addWidget(correctSaveCheck,11,0,1,2);
+    displayLayout->addWidget(calibStatusLabel,12,0,1,2);
+    displayLayout->addWidget(hotDetectBtn,13,0,1,2);
+    displayLayout->addWidget(hotCheck,14,0,1,2);
+    displayLayout->addWidget(hotStatusLabel,15,0,1,2);
+    displayLayout->addWidget(ptcBtn,16,0,1,2);
+    displayLayout->addWidget(new QLabel("Software binning"),17,0);
+    auto binRow = new QHBoxLayout;
+    binRow->addWidget(binXSpin);
+    binRow->addWidget(binYSpin);
+    binRow->addWidget(binSumCheck);
+    displayLayout->addLayout(binRow,17,1);
+    displayLayout->addWidget(saturationCheck,18,0,1,2);
+    displayLayout->addWidget(new QLabel("Colormap"),19,0);
+    displayLayout->addWidget(colormapCombo,19,1);
+    displayLayout->addWidget(new QLabel("Display range"),20,0);
+    auto rangeRow = new QHBoxLayout;
+    rangeRow->addWidget(rangeBlackSpin);
+    rangeRow->addWidget(rangeWhiteSpin);
+    displayLayout->addLayout(rangeRow,20,1);
+    displayLayout->setRowStretch(21,1);
+    auto displayWidget = new QWidget;
+    displayWidget->setLayout(displayLayout);
+    tabWidget->addTab(displayWidget, "Display");
+
+    // Analysis tab: live measurements that see every acquired frame. They
+    // work on the Shift+drag selection of the live view, or the full frame.
+    auto analysisLayout = new QGridLayout;
+    analysisLayout->addWidget(focusCheck,0,0);
+    analysisLayout->addWidget(focusMetricCombo,0,1);
+    analysisLayout->addWidget(focusLabel,1,0,1,2);
+    analysisLayout->addWidget(focusPlot,2,0,1,2);
+    analysisLayout->addWidget(focusResetBtn,3,1);
+    analysisLayout->addWidget(spotCheck,4,0);
+    analysisLayout->addWidget(spotThresholdSpin,4,1);
+    analysisLayout->addWidget(spotLabel,5,0,1,2);
+    analysisLayout->addWidget(spotLogBtn,6,1);
+    analysisLayout->addWidget(smlmCheck,7,0);
+    analysisLayout->addWidget(smlmPreviewBtn,7,1);
+    analysisLayout->addWidget(new QLabel("PSF sigma"),8,0);
+    analysisLayout->addWidget(smlmSigmaSpin,8,1);
+    analysisLayout->addWidget(new QLabel("Threshold (sigmas)"),9,0);
+    analysisLayout->addWidget(smlmThresholdSpin,9,1);
+    analysisLayout->addWidget(new QLabel("Offset"),10,0);
+    analysisLayout->addWidget(smlmOffsetSpin,10,1);
+    analysisLayout->addWidget(new QLabel("Gain"),11,0);
+    analysisLayout->addWidget(smlmGainSpin,11,1);
+    analysisLayout->addWidget(new QLabel("Pixel size"),12,0);
+    analysisLayout->addWidget(smlmPixelSpin,12,1);
+    analysisLayout->addWidget(smlmLabel,13,0,1,2);
+    auto smlmBtnRow = new QHBoxLayout;
+    smlmBtnRow->addWidget(smlmClearBtn);
+    smlmBtnRow->addWidget(smlmExportBtn);
+    analysisLayout->addLayout(smlmBtnRow,14,0,1,2);
+    analysisLayout->addWidget(driftCheck,15,0);
+    analysisLayout->addWidget(driftEverySpin,15,1);
+    analysisLayout->addWidget(driftCorrectCheck,16,0);
+    analysisLayout->addWidget(driftWindowCombo,16,1);
+    analysisLayout->addWidget(driftLabel,17,0,1,2);
+    analysisLayout->addWidget(driftPlot,18,0,1,2);
+    analysisLayout->addWidget(driftResetBtn,19,1);
+    analysisLayout->addWidget(spectrumCheck,20,0);
+    analysisLayout->addWidget(spectrumRateSpin,20,1);
+    analysisLayout->addWidget(spectrumAvgSpin,21,0);
+    analysisLayout->addWidget(spectrumWindowCombo,21,1);
+    analysisLayout->addWidget(spectrumLabel,22,0,1,2);
+    auto spectrumBtnRow = new QHBoxLayout;
+    spectrumBtnRow->addWidget(spectrumShowBtn);
+    spectrumBtnRow->addWidget(spectrumBenchBtn);
+    analysisLayout->addLayout(spectrumBtnRow,23,0,1,2);
+    analysisLayout->addWidget(motionCheck,24,0);
+    analysisLayout->addWidget(motionThreadsSpin,24,1);
+    analysisLayout->addWidget(motionVectorsCheck,25,0);
+    analysisLayout->addWidget(motionGridCombo,25,1);
+    analysisLayout->addWidget(motionLabel,26,0,1,2);
+    analysisLayout->addWidget(motionPlot,27,0,1,2);
+    analysisLayout->addWidget(blobCheck,28,0);
+    analysisLayout->addWidget(blobThresholdCombo,28,1);
+    analysisLayout->addWidget(blobDarkCheck,29,0);
+    analysisLayout->addWidget(blobThresholdSpin,29,1);
+    analysisLayout->addWidget(blobEdgeCheck,30,0);
+    analysisLayout->addWidget(blobMinAreaSpin,30,1);
+    analysisLayout->addWidget(blobLabel,31,0);
+    analysisLayout->addWidget(blobLogBtn,31,1);
+    analysisLayout->addWidget(blobPlot,32,0,1,2);
+    analysisLayout->setRowStretch(33,1);
+    auto analysisWidget = new QWidget;
+    analysisWidget->setLayout(analysisLayout);
+    // The tab has outgrown small screens; scroll rather than squeeze.
+    auto analysisScroll = new QScrollArea;
+    analysisScroll->setWidgetResizable(true);
+    analysisScroll->setFrameShape(QFrame::NoFrame);
+    analysisScroll->setWidget(analysisWidget);
+    tabWidget->addTab(analysisScroll, "Analysis");
+
     auto saveLayout = new QGridLayout;
     saveLayout->addWidget(new QLabel("Save path"),0,0);
     saveLayout->addWidget(savePathEdit,0,1);
@@ -702,8 +2898,21 @@ int main(int argc, char *argv[]) {
 
     DcamController controller(&window);
     FrameGrabber grabber(&controller);
+    FrameProcessor processor;
+    FocusMeter focusMeter;
+    SpotTracker spotTracker;
+    SmlmLocalizer smlm;
+    DriftTracker drift;
+    PowerSpectrum spectrum;
+    MotionEstimator motion;
+    BlobCounter blobCounter;
+    auto hotMap = std::make_shared<HotPixelMap>();
+    if (hotMap->load(HotPixelMap::defaultPath()).isEmpty()) {
+        logLine(QString("Loaded %1 hot pixels from %2").arg(hotMap->count()).arg(HotPixelMap::defaultPath()));
+    }
     QImage lastFrame;
     FrameMeta lastMeta{};
+    DisplayConverter::Stats displayClip;
     bool viewerOnly = false;
 
     auto refreshExposureLimits = [&](){
@@ -732,28 +2941,31 @@ int main(int argc, char *argv[]) {
     customWidthSpin->setEnabled(false);
     customHeightSpin->setEnabled(false);
 
-    auto applySettings = [&](){
+    // Settings as currently shown in the Formats / Speed tab.
+    auto currentApplySettings = [&](){
         QSize preset = presetCombo->currentData().toSize();
         bool isCustom = preset.width() < 0 || preset.height() < 0;
-        int bin = binCombo->currentText().toInt();
         int bits = bitsCombo->currentText().toInt();
-        int pixel = (bits > 8) ? DCAM_PIXELTYPE_MONO16 : DCAM_PIXELTYPE_MONO8;
-        double exp_ms = exposureSpin->value();
-        double exp_s = exp_ms / 1000.0;
-        int readout = readoutCombo->currentData().toInt();
         ApplySettings s;
         s.width = isCustom ? customWidthSpin->value() : preset.width();
         s.height = isCustom ? customHeightSpin->value() : preset.height();
-        s.binning = bin;
+        s.binning = binCombo->currentText().toInt();
         s.binningIndependent = binIndCheck->isChecked();
         s.binH = binHSpin->value();
         s.binV = binVSpin->value();
         s.bits = bits;
-        s.pixelType = pixel;
-        s.exposure_s = exp_s;
-        s.readoutSpeed = readout;
+        s.pixelType = (bits > 8) ? DCAM_PIXELTYPE_MONO16 : DCAM_PIXELTYPE_MONO8;
+        s.exposure_s = exposureSpin->value() / 1000.0;
+        s.readoutSpeed = readoutCombo->currentData().toInt();
         s.bundleEnabled = false;
         s.bundleCount = 0;
+        return s;
+    };
+
+    auto applySettings = [&](){
+        ApplySettings s = currentApplySettings();
+        double exp_ms = exposureSpin->value();
+        int readout = s.readoutSpeed;
         logLine(QString("Apply: preset=%1x%2 bin=%3 binH=%4 binV=%5 bits=%6 pixType=%7 exp_ms=%8 readout=%9")
             .arg(s.width).arg(s.height).arg(s.binning).arg(s.binH).arg(s.binV)
             .arg(s.bits).arg(s.pixelType).arg(exp_ms,0,'f',3).arg(readout));
@@ -887,12 +3099,13 @@ int main(int argc, char *argv[]) {
     });
 
     // Save state
-    auto saveBuffer = std::make_shared<std::vector<QImage>>();
+    auto saveBuffer = std::make_shared<std::vector<RecordedFrame>>();
     auto saveMutex = std::make_shared<QMutex>();
     std::atomic<bool> recording{false};
     std::atomic<bool> saving{false};
     QElapsedTimer recordTimer;
     QDateTime recordStartTime;
+    std::shared_ptr<const HotPixelMap> recordHotMap;    // correction in force when recording started
     std::atomic<int> recordedFrames{0};
     QTimer saveInfoTimer;
     saveInfoTimer.setInterval(200);
@@ -919,6 +3132,7 @@ int main(int argc, char *argv[]) {
         dir.mkpath(".");
         QString fname = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss_zzz") + ".tiff";
         QString outPath = dir.filePath(fname);
+        // lastFrame is full resolution even when the view is binned.
         if (lastFrame.save(outPath, "TIFF")) {
             statusLabel->setText("Captured: " + fname);
             logLine("Captured frame to " + outPath);
@@ -940,6 +3154,7 @@ int main(int argc, char *argv[]) {
         recordedFrames = 0;
         recordTimer.restart();
         recordStartTime = QDateTime::currentDateTime();
+        recordHotMap = hotCheck->isChecked() && !hotMap->isEmpty() ? hotMap : nullptr;
         saveStartBtn->setEnabled(false);
         saveStopBtn->setEnabled(true);
         logLine("Recording started");
@@ -955,7 +3170,7 @@ int main(int argc, char *argv[]) {
         saveStopBtn->setEnabled(false);
         saveInfoTimer.stop();
 
-        std::shared_ptr<std::vector<QImage>> frames = std::make_shared<std::vector<QImage>>();
+        std::shared_ptr<std::vector<RecordedFrame>> frames = std::make_shared<std::vector<RecordedFrame>>();
         {
             QMutexLocker lk(saveMutex.get());
             frames->swap(*saveBuffer);
@@ -996,15 +3211,53 @@ int main(int argc, char *argv[]) {
 
         FrameMeta metaCopy = lastMeta;
         double expMsCopy = exposureSpin->value();
+        // Labelled with the correction from the start of the recording; a
+        // change of map or switch while it ran is noted instead.
+        const std::shared_ptr<const HotPixelMap> stopHotMap = hotCheck->isChecked() && !hotMap->isEmpty() ? hotMap : nullptr;
+        const int hotPixelCount = recordHotMap != stopHotMap ? -1
+            : recordHotMap && recordHotMap->matches(frames->front().image) ? recordHotMap->count() : 0;
+        std::shared_ptr<const Calibration> saveCal;
+        if (correctSaveCheck->isChecked()) {
+            saveCal = processor.calibrationMaps();
+            if (saveCal && !saveCal->matches(frames->front().image)) {
+                logLine("Calibration does not match the recorded frame size; saving raw frames");
+                saveCal.reset();
+            }
+        }
         QString recordStartStr = recordStartTime.toString("yyyy-MM-dd hh:mm:ss.zzz");
+        // Drift samples bracket the recorded frames; each frame gets the interpolated value.
+        auto driftHistory = std::make_shared<const std::vector<DriftTracker::Sample>>(
+            drift.isEnabled() ? drift.history() : std::vector<DriftTracker::Sample>());
+        const int driftEvery = drift.decimationFactor();
+        // Drift is measured on the binned frames; the recording is full size.
+        const SoftwareBinning::Settings driftBin = drift.binning();
+        const SoftwareBinning::Settings liveBin = grabber.displayBinningSettings();
 
-        std::thread([frames, outDir, logLine, statusLabel, savingDialog, savingProgress, totalFrames, metaCopy, expMsCopy, recordStartStr, &saving](){
+        std::thread([frames, outDir, logLine, statusLabel, savingDialog, savingProgress, totalFrames, metaCopy, expMsCopy, recordStartStr, saveCal, hotPixelCount, driftHistory, driftEvery, driftBin, liveBin, &saving](){
             int width = std::max(6, static_cast<int>(std::ceil(std::log10(std::max<size_t>(1, frames->size())))));
+            // Per-frame timestamps, appended as frames land so readers can follow.
+            QFile indexFile(outDir + "/frame_index.csv");
+            QTextStream indexTs(&indexFile);
+            if (indexFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+                indexTs << "index,framestamp,time_s" << (driftHistory->empty() ? "" : ",drift_x_px,drift_y_px") << "\n";
+            }
+            const double t0 = frames->front().meta.timestamp;
             for (size_t i = 0; i < frames->size(); ++i) {
-                const QImage& im = frames->at(i);
+                const QImage& im = frames->at(i).image;
+                const FrameMeta& fm = frames->at(i).meta;
                 QString fname = QString("%1.tiff").arg(static_cast<int>(i), width, 10, QChar('0'));
                 QString path = outDir + "/" + fname;
-                im.save(path, "TIFF");
+                if (saveCal) saveCal->apply(im, 2).save(path, "TIFF");
+                else im.save(path, "TIFF");
+                if (indexFile.isOpen()) {
+                    indexTs << i << "," << fm.framestamp << "," << QString::number(fm.timestamp - t0, 'f', 6);
+                    double dx = 0.0, dy = 0.0;
+                    if (DriftTracker::driftAt(*driftHistory, fm.framestamp, dx, dy)) {
+                        indexTs << "," << QString::number(dx * driftBin.x, 'f', 3) << "," << QString::number(dy * driftBin.y, 'f', 3);
+                    }
+                    indexTs << "\n";
+                    indexTs.flush();
+                }
                 if (savingProgress && (i % 100 == 0 || i + 1 == frames->size())) {
                     int v = static_cast<int>(i + 1);
                     QMetaObject::invokeMethod(savingProgress, [savingProgress, v](){
@@ -1012,6 +3265,7 @@ int main(int argc, char *argv[]) {
                     }, Qt::QueuedConnection);
                 }
             }
+            indexFile.close();
             // Write metadata file
             QFile infoFile(outDir + "/capture_info.txt");
             if (infoFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -1020,10 +3274,25 @@ int main(int argc, char *argv[]) {
                 ts << "Frames: " << frames->size() << "\n";
                 ts << "Resolution: " << metaCopy.width << " x " << metaCopy.height << "\n";
                 ts << "Binning: " << metaCopy.binning << "\n";
+                if (!liveBin.isNone()) {
+                    ts << "Software binning: " << SoftwareBinning::describe(liveBin)
+                       << " (live view and analysis only; frames saved unbinned)\n";
+                }
                 ts << "Bits: " << metaCopy.bits << "\n";
                 ts << "Exposure(ms): " << expMsCopy << "\n";
                 ts << "Internal FPS: " << metaCopy.internalFps << "\n";
                 ts << "Readout speed: " << metaCopy.readoutSpeed << "\n";
+                ts << "Timestamps: frame_index.csv\n";
+                if (hotPixelCount > 0) ts << "Hot pixels: " << hotPixelCount << " corrected\n";
+                if (hotPixelCount < 0) ts << "Hot pixels: correction changed during recording\n";
+                if (!driftHistory->empty()) {
+                    ts << "Drift: phase correlation every " << driftEvery
+                       << " frames, drift_x_px/drift_y_px in frame_index.csv (sensor pixels, frames not corrected)\n";
+                }
+                if (saveCal) {
+                    ts << "Calibration: " << (saveCal->hasDark() ? "dark" : "") << (saveCal->hasFlat() ? " flat" : "")
+                       << " corrected\n";
+                }
                 ts.flush();
                 infoFile.close();
             }
@@ -1050,22 +3319,878 @@ int main(int argc, char *argv[]) {
             .arg(elapsed,0,'f',1).arg(recordedFrames.load()));
     });
 
-    grabber.setRecordHook([saveMutex, saveBuffer, &recording, &recordedFrames](const QImage& img){
+    grabber.setRecordHook([saveMutex, saveBuffer, &recording, &recordedFrames](const QImage& img, const FrameMeta& meta){
         if (!recording.load()) return;
         QMutexLocker lk(saveMutex.get());
-        saveBuffer->push_back(img.copy());
+        saveBuffer->push_back({img.copy(), meta});
         recordedFrames++;
     });
 
+    const std::array<LiveAnalyzer*, 7> liveAnalyzers = {&focusMeter, &spotTracker, &smlm, &drift, &spectrum, &motion,
+                                                         &blobCounter};
+    grabber.setProcessHook([&](const QImage& img, const FrameMeta& meta){
+        processor.submit(img, meta);
+        // The running analyzers share one binned copy of the frame; with
+        // none running nothing is allocated.
+        std::shared_ptr<SharedBinnedFrame> frame;
+        for (LiveAnalyzer* a : liveAnalyzers) {
+            if (!a->isEnabled()) continue;
+            if (!frame) frame = std::make_shared<SharedBinnedFrame>(img, grabber.displayBinningSettings());
+            a->submit(frame, meta);
+        }
+    });
+
+    // Live analyzers follow the live view's selection and are polled at
+    // display rate; they keep their own results at the camera rate.
+    imageView->setSelectionChanged([&](const QRect& r){
+        focusMeter.setRoi(r);
+        spotTracker.setRoi(r);
+        smlm.setRoi(r);
+        // A new region needs a new reference.
+        drift.setRoi(r);
+        drift.reset();
+        spectrum.setRoi(r);
+        spectrum.reset();
+        motion.setRoi(r);
+        blobCounter.setRoi(r);
+    });
+    // One binning for the view, the display modes and the analyzers, so
+    // selections and results share the view's pixel grid.
+    auto updateBinning = [&](){
+        SoftwareBinning::Settings bin;
+        bin.x = binXSpin->value();
+        bin.y = binYSpin->value();
+        bin.sum = binSumCheck->isChecked();
+        grabber.setDisplayBinning(bin);
+        processor.setBinning(bin);
+        // The analyzers clear their results when the first frame binned the
+        // new way reaches them.
+        imageView->clearSelection();
+        logLine("Software binning: " + SoftwareBinning::describe(bin));
+    };
+    QObject::connect(binXSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int){ updateBinning(); });
+    QObject::connect(binYSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int){ updateBinning(); });
+    QObject::connect(binSumCheck, &QCheckBox::toggled, [&](bool){ updateBinning(); });
+    QTimer analysisTimer;
+    analysisTimer.setInterval(50);
+    auto updateFocus = [&](){
+        if (!focusMeter.isEnabled() || !focusMeter.hasSamples()) return;
+        const std::vector<FocusMeter::Sample> trace = focusMeter.trace(1000);
+        std::vector<QPointF> pts;
+        pts.reserve(trace.size());
+        for (const FocusMeter::Sample& smp : trace) pts.push_back({smp.time, smp.score});
+        const FocusMeter::Sample best = focusMeter.peak();
+        const FocusMeter::Sample now = trace.back();
+        focusPlot->setSamples(std::move(pts), best.score);
+        focusLabel->setText(QString("Focus: %1 (%2 % of peak)\nPeak: %3 at frame %4, t=%5 s\n%6 frames, dropped %7")
+            .arg(now.score, 0, 'g', 5)
+            .arg(best.score > 0.0 ? 100.0 * now.score / best.score : 0.0, 0, 'f', 1)
+            .arg(best.score, 0, 'g', 5).arg(best.framestamp).arg(best.time, 0, 'f', 3)
+            .arg(focusMeter.analyzedFrames()).arg(focusMeter.droppedFrames()));
+    };
+    auto updateSpot = [&](){
+        if (!spotTracker.isEnabled()) return;
+        const SpotTracker::Spot s = spotTracker.latest();
+        QString text = s.found
+            ? QString("Spot: x=%1 y=%2 px\nD4s: %3 x %4 px at %5 deg, ellipticity %6\nPeak %7, background %8, sum %9")
+                .arg(s.x, 0, 'f', 2).arg(s.y, 0, 'f', 2).arg(s.major, 0, 'f', 2).arg(s.minor, 0, 'f', 2)
+                .arg(s.angle, 0, 'f', 1).arg(s.ellipticity, 0, 'f', 3)
+                .arg(s.peak, 0, 'f', 0).arg(s.background, 0, 'f', 1).arg(s.sum, 0, 'g', 6)
+            : QString("Spot: not found");
+        text += QString("\n%1 frames, dropped %2").arg(spotTracker.analyzedFrames()).arg(spotTracker.droppedFrames());
+        if (spotTracker.isLogging()) text += QString(", logged %1").arg(spotTracker.loggedFrames());
+        spotLabel->setText(text);
+    };
+    // The super-resolution preview is a separate window, re-rendered at a
+    // few Hz while it is open and new localisations arrive.
+    QPointer<QDialog> smlmPreview;
+    ZoomImageView* smlmPreviewView = nullptr;
+    qint64 smlmShownCount = -1;
+    int smlmTicks = 0;
+    auto updateSmlm = [&](){
+        if (!smlm.isEnabled()) return;
+        const qint64 total = smlm.count();
+        const qint64 rows = smlm.tableRows();
+        const std::vector<SmlmLocalizer::Localization> now = smlm.latestFrame();
+        double precision = 0.0;
+        for (const SmlmLocalizer::Localization& l : now) precision += l.precision;
+        smlmLabel->setText(QString("Localisations: %1 (%2 in last frame, mean precision %3 nm)\n%4 frames, dropped %5%6")
+            .arg(total).arg(now.size())
+            .arg(now.empty() ? 0.0 : precision / now.size() * smlmPixelSpin->value()
+                                         * std::sqrt(static_cast<double>(smlm.binning().pixels())), 0, 'f', 1)
+            .arg(smlm.analyzedFrames()).arg(smlm.droppedFrames())
+            .arg(rows < total ? QString(", table keeps the newest %1").arg(rows) : QString()));
+        if (!smlmPreview || !smlmPreview->isVisible() || ++smlmTicks % 10 != 0 || total == smlmShownCount) return;
+        QImage img = smlm.render();
+        if (img.isNull()) return;
+        smlmShownCount = total;
+        smlmPreviewView->setImage(img);
+        smlmPreview->setWindowTitle(QString("Localisation preview (%1x, %2 localisations)").arg(smlm.magnification()).arg(total));
+    };
+    auto updateDrift = [&](){
+        if (!drift.isEnabled() || !drift.hasSamples()) return;
+        const std::vector<DriftTracker::Sample> trace = drift.trace(1000);
+        std::vector<QPointF> xs, ys;
+        xs.reserve(trace.size());
+        ys.reserve(trace.size());
+        for (const DriftTracker::Sample& smp : trace) {
+            xs.push_back({smp.time, smp.dx});
+            ys.push_back({smp.time, smp.dy});
+        }
+        driftPlot->setSamples(std::move(xs), std::numeric_limits<double>::quiet_NaN(), std::move(ys));
+        const DriftTracker::Sample now = trace.back();
+        driftLabel->setText(QString("Drift: x=%1 y=%2 px (correlation %3)\n%4 samples, dropped %5")
+            .arg(now.dx, 0, 'f', 2).arg(now.dy, 0, 'f', 2).arg(now.peak, 0, 'f', 2)
+            .arg(drift.analyzedFrames()).arg(drift.droppedFrames()));
+    };
+    QPointer<QDialog> spectrumView;
+    ZoomImageView* spectrumImageView = nullptr;
+    qint64 spectrumShown = -1;
+    auto updateSpectrum = [&](){
+        if (!spectrum.isEnabled()) return;
+        const qint64 passes = spectrum.spectra();
+        if (passes == spectrumShown) return;
+        spectrumShown = passes;
+        const QImage img = spectrum.image();
+        if (img.isNull()) return;
+        spectrumLabel->setText(QString("Spectrum: %1 x %2 px window, DC at centre, Nyquist at the edges\n%3 spectra, %4 frames seen, dropped %5")
+            .arg(img.width()).arg(img.height()).arg(passes)
+            .arg(spectrum.analyzedFrames()).arg(spectrum.droppedFrames()));
+        if (spectrumView && spectrumView->isVisible()) spectrumImageView->setImage(img);
+    };
+    auto updateMotion = [&](){
+        if (!motion.isEnabled() || !motion.hasSamples()) return;
+        const std::vector<MotionEstimator::Sample> trace = motion.trace(1000);
+        double top = 0.0, fastest = 0.0;
+        for (const MotionEstimator::Sample& smp : trace) {
+            top = std::max(top, smp.energy);
+            fastest = std::max(fastest, smp.speed);
+        }
+        // Speed shares the energy axis, scaled so its peak meets the energy peak.
+        const double speedScale = fastest > 0.0 ? top / fastest : 0.0;
+        std::vector<QPointF> energyPts, speedPts;
+        energyPts.reserve(trace.size());
+        for (const MotionEstimator::Sample& smp : trace) {
+            energyPts.push_back({smp.time, smp.energy});
+            if (motionVectorsCheck->isChecked()) speedPts.push_back({smp.time, smp.speed * speedScale});
+        }
+        motionPlot->setSamples(std::move(energyPts), std::numeric_limits<double>::quiet_NaN(), std::move(speedPts));
+        const MotionEstimator::Sample now = trace.back();
+        QString text = QString("Motion: energy %1 DN/px").arg(now.energy, 0, 'f', 2);
+        if (motionVectorsCheck->isChecked()) {
+            text += QString("\nVectors: mean %1 px/frame, %2 % of blocks moving, drift (%3, %4)")
+                .arg(now.speed, 0, 'f', 2).arg(100.0 * now.moving, 0, 'f', 1).arg(now.dx, 0, 'f', 2).arg(now.dy, 0, 'f', 2);
+        }
+        motionLabel->setText(text + QString("\n%1 frames, dropped %2").arg(motion.analyzedFrames()).arg(motion.droppedFrames()));
+    };
+    auto updateBlobs = [&](){
+        if (!blobCounter.isEnabled() || !blobCounter.hasSamples()) return;
+        const std::vector<BlobCounter::Sample> trace = blobCounter.trace(1000);
+        std::vector<QPointF> pts;
+        pts.reserve(trace.size());
+        for (const BlobCounter::Sample& smp : trace) pts.push_back({smp.time, static_cast<double>(smp.count)});
+        blobPlot->setSamples(std::move(pts));
+        const BlobCounter::Sample now = trace.back();
+        QString text = QString("Blobs: %1, mean area %2 px\nThreshold %3 DN, %4 frames, dropped %5")
+            .arg(now.count).arg(now.meanArea, 0, 'f', 1).arg(now.threshold)
+            .arg(blobCounter.analyzedFrames()).arg(blobCounter.droppedFrames());
+        if (blobCounter.isLogging()) text += QString(", logged %1").arg(blobCounter.loggedFrames());
+        blobLabel->setText(text);
+    };
+    QObject::connect(&analysisTimer, &QTimer::timeout, [&](){
+        updateFocus();
+        updateSpot();
+        updateSmlm();
+        updateDrift();
+        updateSpectrum();
+        updateMotion();
+        updateBlobs();
+        imageView->updateOverlay();
+    });
+    auto updateAnalysisTimer = [&](){
+        if (focusMeter.isEnabled() || spotTracker.isEnabled() || smlm.isEnabled() || drift.isEnabled()
+            || spectrum.isEnabled() || motion.isEnabled() || blobCounter.isEnabled()) analysisTimer.start();
+        else analysisTimer.stop();
+    };
+    // Whole-pixel shift that undoes the latest measured drift on the live view.
+    auto driftCorrection = [&]() -> QPoint {
+        if (!driftCorrectCheck->isChecked() || !drift.isEnabled()) return {};
+        const DriftTracker::Sample now = drift.latest();
+        return QPoint(-static_cast<int>(std::lround(now.dx)), -static_cast<int>(std::lround(now.dy)));
+    };
+    // The 8-bit conversion for the view also counts clipped pixels; a
+    // binned sum saturates at the camera's full scale times the bin area.
+    auto showLive = [&](const QImage& img){
+        const QPoint c = driftCorrection();
+        DisplayConverter::Settings ds;
+        ds.map = static_cast<DisplayConverter::Colormap>(colormapCombo->currentData().toInt());
+        ds.black = rangeBlackSpin->value();
+        ds.white = std::max(rangeWhiteSpin->value(), ds.black + 1);
+        ds.tint = saturationCheck->isChecked();
+        ds.saturation = DisplayConverter::saturationFor(lastMeta.bits);
+        if (binSumCheck->isChecked()) ds.saturation = std::min(65535, ds.saturation * binXSpin->value() * binYSpin->value());
+        const QImage shifted = DriftTracker::shifted(img, c.x(), c.y());
+        displayClip = DisplayConverter::clipStats(shifted, ds, 2);
+        imageView->setConvertedImage(shifted, ds);
+    };
+    QObject::connect(focusCheck, &QCheckBox::toggled, [&](bool on){
+        focusMeter.setMetric(static_cast<FocusMeter::Metric>(focusMetricCombo->currentData().toInt()));
+        focusMeter.setRoi(imageView->selection());
+        focusMeter.setEnabled(on);
+        if (!on) focusLabel->setText("Focus: --");
+        focusPlot->clear();
+        updateAnalysisTimer();
+        logLine(QString("Focus metric %1: %2").arg(on ? "on" : "off").arg(focusMetricCombo->currentText()));
+    });
+    QObject::connect(focusMetricCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){
+        focusMeter.setMetric(static_cast<FocusMeter::Metric>(focusMetricCombo->currentData().toInt()));
+        focusPlot->clear();
+    });
+    QObject::connect(focusResetBtn, &QPushButton::clicked, [&](){
+        focusMeter.reset();
+        focusPlot->clear();
+    });
+
+    // Window, centroid and D4-sigma ellipse of the tracked spot on the live view.
+    auto drawSpot = [&](QPainter& p){
+        const SpotTracker::Spot s = spotTracker.latest();
+        if (s.window.isEmpty()) return;
+        QPen pen(QColor(255, 200, 0), 0, Qt::DashLine);
+        p.setPen(pen);
+        p.setBrush(Qt::NoBrush);
+        p.drawRect(QRectF(s.window));
+        if (!s.found) return;
+        pen.setStyle(Qt::SolidLine);
+        pen.setColor(QColor(0, 255, 0));
+        p.setPen(pen);
+        // Pixel centres sit at +0.5 in view coordinates.
+        const QPointF c(s.x + 0.5, s.y + 0.5);
+        const double arm = std::max(4.0, 0.75 * s.major);
+        p.save();
+        p.translate(c);
+        p.rotate(s.angle);
+        p.drawLine(QPointF(-arm, 0.0), QPointF(arm, 0.0));
+        p.drawLine(QPointF(0.0, -arm), QPointF(0.0, arm));
+        p.drawEllipse(QPointF(0.0, 0.0), 0.5 * s.major, 0.5 * s.minor);
+        p.restore();
+    };
+    // Fitted positions of the newest analysed frame.
+    auto drawLocalizations = [&](QPainter& p){
+        const double r = 2.0 * smlmSigmaSpin->value() / std::sqrt(static_cast<double>(smlm.binning().pixels()));
+        p.setPen(QPen(QColor(255, 60, 60), 0));
+        p.setBrush(Qt::NoBrush);
+        for (const SmlmLocalizer::Localization& l : smlm.latestFrame()) {
+            p.drawEllipse(QPointF(l.x + 0.5, l.y + 0.5), r, r);
+        }
+    };
+    // Block vectors, drawn at twice their length so one-step moves stay visible.
+    auto drawMotion = [&](QPainter& p){
+        p.setPen(QPen(QColor(0, 220, 255), 0));
+        for (const MotionEstimator::Vector& v : motion.vectors()) {
+            if (v.dx == 0.0f && v.dy == 0.0f) continue;
+            const QPointF from(v.x, v.y);
+            const QPointF to(v.x + 2.0f * v.dx, v.y + 2.0f * v.dy);
+            p.drawLine(from, to);
+            p.drawEllipse(to, 1.5, 1.5);
+        }
+    };
+    // Circles of each blob's equivalent area at its centroid. Dense scenes
+    // are capped so the overlay never costs more than the frame it covers.
+    auto drawBlobs = [&](QPainter& p){
+        constexpr size_t kMaxDrawn = 2000;
+        const std::vector<BlobCounter::Blob> found = blobCounter.blobs();
+        p.setPen(QPen(QColor(255, 160, 0), 0));
+        p.setBrush(Qt::NoBrush);
+        for (size_t i = 0; i < std::min(found.size(), kMaxDrawn); ++i) {
+            const double r = std::max(1.0, std::sqrt(found[i].area / 3.14159265358979323846));
+            p.drawEllipse(QPointF(found[i].x + 0.5, found[i].y + 0.5), r, r);
+        }
+    };
+    auto updateOverlayPainter = [&](){
+        const bool vectors = motion.isEnabled() && motionVectorsCheck->isChecked();
+        if (!spotTracker.isEnabled() && !smlm.isEnabled() && !vectors && !blobCounter.isEnabled()) {
+            imageView->setOverlayPainter(nullptr);
+            return;
+        }
+        imageView->setOverlayPainter([&](QPainter& p){
+            p.translate(driftCorrection());
+            if (spotTracker.isEnabled()) drawSpot(p);
+            if (smlm.isEnabled()) drawLocalizations(p);
+            if (motion.isEnabled() && motionVectorsCheck->isChecked()) drawMotion(p);
+            if (blobCounter.isEnabled()) drawBlobs(p);
+        });
+    };
+    QObject::connect(spotCheck, &QCheckBox::toggled, [&](bool on){
+        spotTracker.setThreshold(spotThresholdSpin->value() / 100.0);
+        spotTracker.setRoi(imageView->selection());
+        spotTracker.setEnabled(on);
+        updateOverlayPainter();
+        if (!on) {
+            spotTracker.stopLog();
+            spotLogBtn->setText("Log CSV...");
+            spotLabel->setText("Spot: --");
+        }
+        updateAnalysisTimer();
+        logLine(QString("Spot tracking %1").arg(on ? "on" : "off"));
+    });
+    QObject::connect(spotThresholdSpin, qOverload<double>(&QDoubleSpinBox::valueChanged), [&](double v){
+        spotTracker.setThreshold(v / 100.0);
+    });
+    QObject::connect(spotLogBtn, &QPushButton::clicked, [&](){
+        if (spotTracker.isLogging()) {
+            spotTracker.stopLog();
+            spotLogBtn->setText("Log CSV...");
+            logLine(QString("Spot log closed after %1 frames").arg(spotTracker.loggedFrames()));
+            return;
+        }
+        QString path = QFileDialog::getSaveFileName(&window, "Log spot track", savePathEdit->text(), "CSV (*.csv)");
+        if (path.isEmpty()) return;
+        if (!path.endsWith(".csv", Qt::CaseInsensitive)) path += ".csv";
+        QString err = spotTracker.startLog(path);
+        if (!err.isEmpty()) {
+            QMessageBox::warning(&window, "Spot log", "Failed to open log:\n" + err);
+            return;
+        }
+        if (!spotCheck->isChecked()) spotCheck->setChecked(true);
+        spotLogBtn->setText("Stop log");
+        logLine("Spot log: " + path);
+    });
+
+    auto applySmlmSettings = [&](){
+        SmlmLocalizer::Settings s = smlm.settings();
+        s.psfSigma = smlmSigmaSpin->value();
+        s.threshold = smlmThresholdSpin->value();
+        s.offset = smlmOffsetSpin->value();
+        s.gain = smlmGainSpin->value();
+        smlm.setSettings(s);
+    };
+    QObject::connect(smlmCheck, &QCheckBox::toggled, [&](bool on){
+        applySmlmSettings();
+        smlm.setRoi(imageView->selection());
+        smlm.setEnabled(on);
+        updateOverlayPainter();
+        if (!on) smlmLabel->setText("Localisations: --");
+        smlmShownCount = -1;
+        updateAnalysisTimer();
+        logLine(QString("Localisation %1").arg(on ? "on" : "off"));
+    });
+    for (QDoubleSpinBox* spin : {smlmSigmaSpin, smlmThresholdSpin, smlmOffsetSpin, smlmGainSpin}) {
+        QObject::connect(spin, qOverload<double>(&QDoubleSpinBox::valueChanged), [&](double){ applySmlmSettings(); });
+    }
+    QObject::connect(smlmClearBtn, &QPushButton::clicked, [&](){
+        smlm.reset();
+        smlmShownCount = -1;
+    });
+    QObject::connect(smlmPreviewBtn, &QPushButton::clicked, [&](){
+        if (!smlmPreview) {
+            smlmPreview = new QDialog(&window);
+            smlmPreview->setWindowTitle("Localisation preview");
+            smlmPreviewView = new ZoomImageView;
+            auto layout = new QVBoxLayout(smlmPreview);
+            layout->setContentsMargins(0, 0, 0, 0);
+            layout->addWidget(smlmPreviewView);
+            smlmPreview->resize(700, 700);
+        }
+        smlmShownCount = -1;
+        smlmPreview->show();
+        smlmPreview->raise();
+    });
+    QObject::connect(driftCheck, &QCheckBox::toggled, [&](bool on){
+        drift.setDecimation(driftEverySpin->value());
+        drift.setMaxWindow(driftWindowCombo->currentData().toInt());
+        drift.setRoi(imageView->selection());
+        drift.setEnabled(on);
+        if (!on) driftLabel->setText("Drift: --");
+        driftPlot->clear();
+        updateAnalysisTimer();
+        logLine(QString("Drift tracking %1, every %2 frames").arg(on ? "on" : "off").arg(driftEverySpin->value()));
+    });
+    QObject::connect(driftEverySpin, qOverload<int>(&QSpinBox::valueChanged), [&](int v){
+        drift.setDecimation(v);
+    });
+    QObject::connect(driftWindowCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){
+        drift.setMaxWindow(driftWindowCombo->currentData().toInt());
+        driftPlot->clear();
+    });
+    QObject::connect(driftResetBtn, &QPushButton::clicked, [&](){
+        drift.reset();
+        driftPlot->clear();
+    });
+    auto applySpectrumSettings = [&](){
+        spectrum.setRate(spectrumRateSpin->value());
+        spectrum.setAveraging(spectrumAvgSpin->value());
+    };
+    QObject::connect(spectrumCheck, &QCheckBox::toggled, [&](bool on){
+        applySpectrumSettings();
+        spectrum.setMaxSide(spectrumWindowCombo->currentData().toInt());
+        spectrum.setRoi(imageView->selection());
+        spectrum.setEnabled(on);
+        if (!on) spectrumLabel->setText("Spectrum: --");
+        spectrumShown = -1;
+        updateAnalysisTimer();
+        logLine(QString("Power spectrum %1").arg(on ? "on" : "off"));
+    });
+    QObject::connect(spectrumRateSpin, qOverload<double>(&QDoubleSpinBox::valueChanged), [&](double){ applySpectrumSettings(); });
+    QObject::connect(spectrumAvgSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int){ applySpectrumSettings(); });
+    QObject::connect(spectrumWindowCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){
+        spectrum.setMaxSide(spectrumWindowCombo->currentData().toInt());
+    });
+    QObject::connect(spectrumShowBtn, &QPushButton::clicked, [&](){
+        if (!spectrumView) {
+            spectrumView = new QDialog(&window);
+            spectrumView->setWindowTitle("Power spectrum (log scale)");
+            spectrumImageView = new ZoomImageView;
+            auto layout = new QVBoxLayout(spectrumView);
+            layout->setContentsMargins(0, 0, 0, 0);
+            layout->addWidget(spectrumImageView);
+            spectrumView->resize(600, 600);
+        }
+        spectrumShown = -1;
+        spectrumView->show();
+        spectrumView->raise();
+    });
+    // Timed off the GUI thread; the sizes cover the usual ROIs and both
+    // full-frame readouts of the camera.
+    QObject::connect(spectrumBenchBtn, &QPushButton::clicked, [&](){
+        spectrumBenchBtn->setEnabled(false);
+        logLine("FFT benchmark running...");
+        std::thread([&](){
+            const QString report = PowerSpectrum::benchmark({{64, 64}, {128, 128}, {256, 256}, {512, 512}, {1024, 1024},
+                                                             {2048, 1024}, {2048, 2048}, {2304, 2304}});
+            QMetaObject::invokeMethod(qApp, [&, report](){
+                spectrumBenchBtn->setEnabled(true);
+                for (const QString& line : report.split('\n')) logLine("FFT " + line);
+                QMessageBox::information(&window, "FFT benchmark", "Forward real 2D FFT, one thread:\n\n" + report);
+            }, Qt::QueuedConnection);
+        }).detach();
+    });
+    auto applyMotionSettings = [&](){
+        MotionEstimator::Settings ms;
+        ms.vectors = motionVectorsCheck->isChecked();
+        const QPoint grid = motionGridCombo->currentData().toPoint();
+        ms.level = grid.x();
+        ms.block = grid.y();
+        ms.search = grid.y() / 2;
+        motion.setSettings(ms);
+        motion.setThreads(motionThreadsSpin->value());
+    };
+    QObject::connect(motionCheck, &QCheckBox::toggled, [&](bool on){
+        applyMotionSettings();
+        motion.setRoi(imageView->selection());
+        motion.setEnabled(on);
+        if (!on) motionLabel->setText("Motion: --");
+        motionPlot->clear();
+        updateOverlayPainter();
+        updateAnalysisTimer();
+        logLine(QString("Motion estimation %1").arg(on ? "on" : "off"));
+    });
+    QObject::connect(motionVectorsCheck, &QCheckBox::toggled, [&](bool){
+        applyMotionSettings();
+        updateOverlayPainter();
+    });
+    QObject::connect(motionGridCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){ applyMotionSettings(); });
+    QObject::connect(motionThreadsSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int v){ motion.setThreads(v); });
+    auto applyBlobSettings = [&](){
+        BlobCounter::Settings bs;
+        bs.otsu = blobThresholdCombo->currentIndex() == 0;
+        bs.threshold = blobThresholdSpin->value();
+        bs.dark = blobDarkCheck->isChecked();
+        bs.minArea = blobMinAreaSpin->value();
+        bs.excludeEdges = blobEdgeCheck->isChecked();
+        blobCounter.setSettings(bs);
+        blobThresholdSpin->setEnabled(!bs.otsu);
+    };
+    QObject::connect(blobCheck, &QCheckBox::toggled, [&](bool on){
+        applyBlobSettings();
+        blobCounter.setRoi(imageView->selection());
+        blobCounter.setEnabled(on);
+        if (!on) {
+            blobCounter.stopLog();
+            blobLogBtn->setText("Log CSV...");
+            blobLabel->setText("Blobs: --");
+        }
+        blobPlot->clear();
+        updateOverlayPainter();
+        updateAnalysisTimer();
+        logLine(QString("Blob counting %1").arg(on ? "on" : "off"));
+    });
+    QObject::connect(blobThresholdCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){ applyBlobSettings(); });
+    QObject::connect(blobThresholdSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int){ applyBlobSettings(); });
+    QObject::connect(blobDarkCheck, &QCheckBox::toggled, [&](bool){ applyBlobSettings(); });
+    QObject::connect(blobMinAreaSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int){ applyBlobSettings(); });
+    QObject::connect(blobEdgeCheck, &QCheckBox::toggled, [&](bool){ applyBlobSettings(); });
+    QObject::connect(blobLogBtn, &QPushButton::clicked, [&](){
+        if (blobCounter.isLogging()) {
+            blobCounter.stopLog();
+            blobLogBtn->setText("Log CSV...");
+            logLine(QString("Blob log closed after %1 frames").arg(blobCounter.loggedFrames()));
+            return;
+        }
+        QString path = QFileDialog::getSaveFileName(&window, "Log blobs", savePathEdit->text(), "CSV (*.csv)");
+        if (path.isEmpty()) return;
+        if (!path.endsWith(".csv", Qt::CaseInsensitive)) path += ".csv";
+        QString err = blobCounter.startLog(path);
+        if (!err.isEmpty()) {
+            QMessageBox::warning(&window, "Blob log", "Failed to open log:\n" + err);
+            return;
+        }
+        if (!blobCheck->isChecked()) blobCheck->setChecked(true);
+        blobLogBtn->setText("Stop log");
+        logLine("Blob log: " + path);
+    });
+    QObject::connect(smlmExportBtn, &QPushButton::clicked, [&](){
+        if (smlm.count() == 0) {
+            QMessageBox::information(&window, "Localisations", "No localisations to export.");
+            return;
+        }
+        QString path = QFileDialog::getSaveFileName(&window, "Export localisations", savePathEdit->text(), "CSV (*.csv)");
+        if (path.isEmpty()) return;
+        if (!path.endsWith(".csv", Qt::CaseInsensitive)) path += ".csv";
+        QString err = smlm.exportCsv(path, smlmPixelSpin->value());
+        if (!err.isEmpty()) {
+            QMessageBox::warning(&window, "Localisations", "Export failed:\n" + err);
+            return;
+        }
+        logLine(QString("Exported %1 localisations to %2").arg(smlm.tableRows()).arg(path));
+    });
+
+    auto updateDisplayMode = [&](){
+        auto mode = static_cast<FrameProcessor::Mode>(displayModeCombo->currentData().toInt());
+        meanWindowSpin->setEnabled(mode == FrameProcessor::Mode::RollingMean || mode == FrameProcessor::Mode::RollingMedian ||
+                                   mode == FrameProcessor::Mode::BackgroundSubtract);
+        emaAlphaSpin->setEnabled(mode == FrameProcessor::Mode::ExponentialMean);
+        displayResetBtn->setEnabled(mode != FrameProcessor::Mode::Raw);
+        const bool variance = mode == FrameProcessor::Mode::TemporalVariance;
+        varianceWindowSpin->setEnabled(variance);
+        overlayOpacitySpin->setEnabled(variance);
+        varianceRangeSpin->setEnabled(variance);
+        varianceExportBtn->setEnabled(variance);
+        processor.setWindow(meanWindowSpin->value());
+        processor.setAlpha(emaAlphaSpin->value());
+        processor.setVarianceWindow(varianceWindowSpin->value());
+        processor.setOverlayOpacity(overlayOpacitySpin->value() / 100.0);
+        processor.setVarianceRange(varianceRangeSpin->value());
+        processor.setMode(mode);
+        if (!processor.replacesDisplay()) displayInfoLabel->setText("Showing raw frames");
+        logLine("Live display mode: " + displayModeCombo->currentText());
+    };
+    QObject::connect(displayModeCombo, qOverload<int>(&QComboBox::currentIndexChanged), [&](int){ updateDisplayMode(); });
+    QObject::connect(meanWindowSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int v){ processor.setWindow(v); });
+    QObject::connect(emaAlphaSpin, qOverload<double>(&QDoubleSpinBox::valueChanged), [&](double v){ processor.setAlpha(v); });
+    QObject::connect(displayResetBtn, &QPushButton::clicked, [&](){ processor.reset(); });
+    QObject::connect(varianceWindowSpin, qOverload<int>(&QSpinBox::valueChanged), [&](int v){ processor.setVarianceWindow(v); });
+    QObject::connect(overlayOpacitySpin, qOverload<int>(&QSpinBox::valueChanged), [&](int v){ processor.setOverlayOpacity(v / 100.0); });
+    QObject::connect(varianceRangeSpin, qOverload<double>(&QDoubleSpinBox::valueChanged), [&](double v){ processor.setVarianceRange(v); });
+    // The maps are copied on the processing thread and written from a
+    // detached thread, so a 32-bit float export never stalls the display.
+    QObject::connect(varianceExportBtn, &QPushButton::clicked, [&](){
+        QString path = QFileDialog::getSaveFileName(&window, "Export variance map",
+            QDir(savePathEdit->text()).filePath("variance.tiff"), "32-bit float TIFF (*.tif *.tiff)");
+        if (path.isEmpty()) return;
+        varianceExportBtn->setEnabled(false);
+        processor.requestVarianceSnapshot([&, path](const QSize& size, std::vector<float> mean, std::vector<float> variance){
+            auto maps = std::make_shared<std::pair<std::vector<float>, std::vector<float>>>(std::move(mean), std::move(variance));
+            std::thread([&, path, size, maps](){
+                QString err = TiffWriter::writeSingleFloat(path, maps->second.data(), size.width(), size.height());
+                if (err.isEmpty()) {
+                    err = TiffWriter::writeSingleFloat(FrameSequence::sidecarPath(path, "_mean.tiff"),
+                                                       maps->first.data(), size.width(), size.height());
+                }
+                QMetaObject::invokeMethod(qApp, [&, path, err](){
+                    varianceExportBtn->setEnabled(processor.mode() == FrameProcessor::Mode::TemporalVariance);
+                    logLine(err.isEmpty() ? "Variance map exported to " + path : "Variance export failed: " + err);
+                }, Qt::QueuedConnection);
+            }).detach();
+        });
+    });
+    meanWindowSpin->setEnabled(false);
+    emaAlphaSpin->setEnabled(false);
+    displayResetBtn->setEnabled(false);
+    varianceWindowSpin->setEnabled(false);
+    overlayOpacitySpin->setEnabled(false);
+    varianceRangeSpin->setEnabled(false);
+    varianceExportBtn->setEnabled(false);
+
+    QObject::connect(&processor, &FrameProcessor::frameReady, [&](const QImage& img, FrameMeta, int framesAccumulated){
+        if (!processor.replacesDisplay() || img.isNull()) return;
+        showLive(img);
+        QString text = processor.mode() == FrameProcessor::Mode::Raw
+            ? QString("Corrected raw frames")
+            : QString("%1 of %2 frames").arg(displayModeCombo->currentText()).arg(framesAccumulated);
+        if (meanWindowSpin->isEnabled() && processor.windowInUse() < meanWindowSpin->value()) {
+            text += QString(", window capped to %1 by memory").arg(processor.windowInUse());
+        }
+        if (processor.mode() == FrameProcessor::Mode::TemporalVariance) {
+            text += QString(", sigma 0 - %1 DN").arg(processor.shownVarianceRange(), 0, 'f', 1);
+        }
+        if (processor.correctsDisplay() && processor.mode() != FrameProcessor::Mode::Raw) text += ", corrected";
+        displayInfoLabel->setText(text + QString(" (dropped %1)").arg(processor.droppedFrames()));
+    });
+
+    // Calibration maps are replaced, never edited in place, so the processor
+    // and a running save keep a consistent snapshot.
+    auto describeCalibration = [&](){
+        auto cal = processor.calibrationMaps();
+        if (!cal || cal->isEmpty()) {
+            calibStatusLabel->setText("No calibration");
+            return;
+        }
+        QString text = QString("%1%2 for %3 x %4")
+            .arg(cal->hasDark() ? "Dark" : "No dark")
+            .arg(cal->hasFlat() ? " + flat" : "")
+            .arg(cal->size().width()).arg(cal->size().height());
+        if (lastMeta.width > 0 && QSize(lastMeta.width, lastMeta.height) != cal->size()) {
+            text += " (does not match the current frame size, not applied)";
+        }
+        calibStatusLabel->setText(text);
+    };
+    {
+        auto cal = std::make_shared<Calibration>();
+        QString err = cal->load(Calibration::defaultPath());
+        if (err.isEmpty()) logLine("Loaded calibration from " + Calibration::defaultPath());
+        processor.setCalibration(cal);
+        describeCalibration();
+    }
+    auto captureCalibration = [&](bool isFlat){
+        if (!grabber.isRunning()) {
+            statusLabel->setText("Start streaming before capturing calibration frames");
+            return;
+        }
+        QString prompt = isFlat
+            ? "Illuminate the field evenly at roughly half of full scale, with the same settings as the data."
+            : "Block all light (cap or shutter closed), with the same exposure and readout as the data.";
+        if (QMessageBox::information(&window, isFlat ? "Flat field" : "Dark frames", prompt + "\n\nPress OK to start.",
+                                     QMessageBox::Ok | QMessageBox::Cancel) != QMessageBox::Ok) {
+            return;
+        }
+        const int frames = calibFramesSpin->value();
+        darkBtn->setEnabled(false);
+        flatBtn->setEnabled(false);
+        calibStatusLabel->setText(QString("Capturing %1 %2 frames...").arg(frames).arg(isFlat ? "flat" : "dark"));
+        logLine(QString("Calibration: capturing %1 %2 frames").arg(frames).arg(isFlat ? "flat" : "dark"));
+        processor.captureStack(frames, [&, isFlat](const QSize& size, std::vector<float> mean, std::vector<float>){
+            auto shared = std::make_shared<std::vector<float>>(std::move(mean));
+            QMetaObject::invokeMethod(qApp, [&, isFlat, size, shared](){
+                auto current = processor.calibrationMaps();
+                auto next = current ? std::make_shared<Calibration>(*current) : std::make_shared<Calibration>();
+                QString err;
+                if (isFlat) err = next->setFlat(size, *shared);
+                else next->setDark(size, std::move(*shared));
+                darkBtn->setEnabled(true);
+                flatBtn->setEnabled(true);
+                if (!err.isEmpty()) {
+                    calibStatusLabel->setText("Flat failed: " + err);
+                    return;
+                }
+                processor.setCalibration(next);
+                QString saveErr = next->save(Calibration::defaultPath());
+                if (!saveErr.isEmpty()) logLine("Calibration save failed: " + saveErr);
+                logLine(QString("Calibration: %1 updated").arg(isFlat ? "flat" : "dark"));
+                describeCalibration();
+            }, Qt::QueuedConnection);
+        });
+    };
+    // Hot pixel map: detected from a dark stack, applied on the grabber
+    // thread so display, processing and recording all see corrected frames.
+    auto describeHotPixels = [&](){
+        if (hotMap->isEmpty()) {
+            hotStatusLabel->setText("No hot pixel map");
+            return;
+        }
+        QString text = QString("%1 hot pixels for %2 x %3").arg(hotMap->count())
+            .arg(hotMap->size().width()).arg(hotMap->size().height());
+        if (lastMeta.width > 0 && QSize(lastMeta.width, lastMeta.height) != hotMap->size()) {
+            text += " (does not match the current frame size, not applied)";
+        }
+        hotStatusLabel->setText(text);
+    };
+    auto applyHotPixels = [&](){
+        grabber.setHotPixels(hotCheck->isChecked() && !hotMap->isEmpty() ? hotMap : nullptr);
+    };
+    describeHotPixels();
+    QObject::connect(hotCheck, &QCheckBox::toggled, [&](bool){ applyHotPixels(); });
+    QObject::connect(hotDetectBtn, &QPushButton::clicked, [&](){
+        if (!grabber.isRunning()) {
+            statusLabel->setText("Start streaming before detecting hot pixels");
+            return;
+        }
+        if (QMessageBox::information(&window, "Hot pixels",
+                "Block all light (cap or shutter closed). Use the exposure of the data; "
+                "longer exposures reveal more hot pixels.\n\nPress OK to start.",
+                QMessageBox::Ok | QMessageBox::Cancel) != QMessageBox::Ok) {
+            return;
+        }
+        // The stack must be raw; stop correcting while it is captured.
+        grabber.setHotPixels(nullptr);
+        hotDetectBtn->setEnabled(false);
+        const int frames = calibFramesSpin->value();
+        hotStatusLabel->setText(QString("Capturing %1 dark frames...").arg(frames));
+        processor.captureStack(frames, [&](const QSize& size, std::vector<float> mean, std::vector<float> variance){
+            auto map = std::make_shared<HotPixelMap>(HotPixelMap::detect(size, mean, variance));
+            QMetaObject::invokeMethod(qApp, [&, map](){
+                hotMap = map;
+                QString err = hotMap->save(HotPixelMap::defaultPath());
+                if (!err.isEmpty()) logLine("Hot pixel map save failed: " + err);
+                logLine(QString("Hot pixels: %1 detected").arg(hotMap->count()));
+                hotDetectBtn->setEnabled(true);
+                applyHotPixels();
+                describeHotPixels();
+            }, Qt::QueuedConnection);
+        });
+    });
+
+    // A dark, flat or hot-pixel stack cannot finish once the stream stops
+    // (this runs after the stop handler above); drop it and give the
+    // buttons back.
+    QObject::connect(stopBtn, &QPushButton::clicked, [&](){
+        if (!processor.cancelStack()) return;
+        darkBtn->setEnabled(true);
+        flatBtn->setEnabled(true);
+        hotDetectBtn->setEnabled(true);
+        applyHotPixels();
+        describeCalibration();
+        describeHotPixels();
+        logLine("Calibration capture cancelled: streaming stopped");
+        statusLabel->setText("Capture stopped; calibration capture cancelled.");
+    });
+
+    // Photon transfer curve: an exposure sweep through DcamController::apply
+    // with frame pairs reduced on the processing thread, so no frames are
+    // kept however many pairs are taken. The live settings come back at the end.
+    QPointer<PhotonTransferRun> ptcRun;
+    QObject::connect(ptcBtn, &QPushButton::clicked, [&](){
+        if (ptcRun) return;
+        if (!grabber.isRunning()) {
+            statusLabel->setText("Start streaming before measuring a photon transfer curve");
+            return;
+        }
+        const QRect roi = imageView->selection();
+        QDialog dlg(&window);
+        dlg.setWindowTitle("Photon transfer curve");
+        auto form = new QFormLayout;
+        auto firstSpin = new QDoubleSpinBox;
+        auto lastSpin = new QDoubleSpinBox;
+        for (QDoubleSpinBox* spin : {firstSpin, lastSpin}) {
+            spin->setDecimals(3);
+            spin->setRange(exposureSpin->minimum(), exposureSpin->maximum());
+            spin->setSuffix(" ms");
+        }
+        firstSpin->setValue(exposureSpin->minimum());
+        lastSpin->setValue(std::min(exposureSpin->maximum(), 1000.0));
+        auto stepsSpin = new QSpinBox;
+        stepsSpin->setRange(3, 200);
+        stepsSpin->setValue(24);
+        auto pairsSpin = new QSpinBox;
+        pairsSpin->setRange(1, 10000);
+        pairsSpin->setValue(16);
+        auto offsetSpin = new QDoubleSpinBox;
+        offsetSpin->setDecimals(1);
+        offsetSpin->setRange(0.0, 65535.0);
+        offsetSpin->setValue(100.0);
+        offsetSpin->setSuffix(" DN");
+        auto roiCheck = new QCheckBox(roi.isEmpty()
+            ? QString("Use selection (Shift+drag in the view)")
+            : QString("Use %1,%2 %3x%4").arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()));
+        roiCheck->setEnabled(!roi.isEmpty());
+        roiCheck->setChecked(!roi.isEmpty());
+        auto outEdit = new QLineEdit(QDir(savePathEdit->text()).filePath(
+            "ptc_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")));
+        form->addRow("First exposure", firstSpin);
+        form->addRow("Last exposure", lastSpin);
+        form->addRow("Steps", stepsSpin);
+        form->addRow("Pairs per step", pairsSpin);
+        form->addRow("Black level", offsetSpin);
+        form->addRow(roiCheck);
+        form->addRow("Report", outEdit);
+        auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        auto dlgLayout = new QVBoxLayout(&dlg);
+        dlgLayout->addWidget(new QLabel("Illuminate the sensor evenly; the sweep should reach saturation."));
+        dlgLayout->addLayout(form);
+        dlgLayout->addWidget(buttons);
+        QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+        QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+        if (dlg.exec() != QDialog::Accepted) return;
+
+        PhotonTransferRun::Options opt;
+        opt.base = currentApplySettings();
+        opt.exposures = PhotonTransferCurve::exposureSteps(firstSpin->value() / 1000.0, lastSpin->value() / 1000.0,
+                                                           stepsSpin->value());
+        opt.pairs = pairsSpin->value();
+        if (roiCheck->isChecked()) opt.roi = roi;
+        opt.offset = offsetSpin->value();
+        if (opt.exposures.empty()) {
+            statusLabel->setText("Photon transfer curve: the last exposure must not be shorter than the first");
+            return;
+        }
+        const QString base = outEdit->text();
+        auto run = new PhotonTransferRun(&controller, &processor, opt, &window);
+        ptcRun = run;
+        QPointer<QProgressDialog> progressDlg = new QProgressDialog("Photon transfer curve...", "Cancel", 0,
+                                               static_cast<int>(opt.exposures.size()), &window);
+        progressDlg->setAttribute(Qt::WA_DeleteOnClose);
+        progressDlg->setWindowModality(Qt::WindowModal);
+        progressDlg->setMinimumDuration(0);
+        QObject::connect(progressDlg, &QProgressDialog::canceled, run, &PhotonTransferRun::cancel);
+        QObject::connect(run, &PhotonTransferRun::progress, progressDlg, [progressDlg](int step, int, const QString& text){
+            if (!progressDlg) return;
+            progressDlg->setValue(step);
+            progressDlg->setLabelText(text);
+        });
+        QObject::connect(run, &PhotonTransferRun::finished, &window, [&, run, progressDlg, opt, base](const QString& err){
+            if (progressDlg) progressDlg->close();
+            ptcRun = nullptr;
+            run->deleteLater();
+            if (!err.isEmpty()) {
+                statusLabel->setText("Photon transfer curve: " + err);
+                logLine("Photon transfer curve stopped: " + err);
+                return;
+            }
+            const PhotonTransferCurve::Fit fit = run->curve().fit(opt.offset);
+            QString header = QString("Photon transfer curve %1\nResolution: %2 x %3\nBits: %4\n")
+                .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss"))
+                .arg(lastMeta.width).arg(lastMeta.height).arg(lastMeta.bits);
+            if (!opt.roi.isEmpty()) {
+                header += QString("ROI: %1,%2,%3,%4\n").arg(opt.roi.x()).arg(opt.roi.y()).arg(opt.roi.width()).arg(opt.roi.height());
+            }
+            header += QString("Pairs per step: %1\n").arg(opt.pairs);
+            QString writeErr = run->curve().writeReport(base, fit, header);
+            if (!writeErr.isEmpty()) logLine("Photon transfer report failed: " + writeErr);
+            QString summary = fit.ok
+                ? QString("Gain %1 e-/DN, read noise %2 e- (%3 DN), full well %4 e-, linearity error %5 %")
+                      .arg(fit.gain, 0, 'f', 3).arg(fit.readNoiseE, 0, 'f', 2).arg(fit.readNoiseDn, 0, 'f', 2)
+                      .arg(fit.fullWellDn * fit.gain, 0, 'f', 0).arg(fit.linearityError, 0, 'f', 2)
+                : "Fit failed: " + fit.message;
+            logLine("Photon transfer curve: " + summary);
+            QMessageBox::information(&window, "Photon transfer curve", summary + "\n\nReport: " + base + ".txt / .csv / .png");
+        });
+        logLine(QString("Photon transfer curve: %1 steps of %2 pairs").arg(opt.exposures.size()).arg(opt.pairs));
+        run->start();
+    });
+
+    QObject::connect(darkBtn, &QPushButton::clicked, [&](){ captureCalibration(false); });
+    QObject::connect(flatBtn, &QPushButton::clicked, [&](){ captureCalibration(true); });
+    QObject::connect(clearCalBtn, &QPushButton::clicked, [&](){
+        processor.setCalibration(std::make_shared<Calibration>());
+        QFile::remove(Calibration::defaultPath());
+        describeCalibration();
+    });
+    QObject::connect(correctDisplayCheck, &QCheckBox::toggled, [&](bool on){
+        processor.setCorrectDisplay(on);
+        if (!on && processor.mode() == FrameProcessor::Mode::Raw) displayInfoLabel->setText("Showing raw frames");
+    });
+
     QObject::connect(&grabber, &FrameGrabber::frameReady, [&](const QImage& img, FrameMeta meta, double fps){
         if (!img.isNull()) {
-        imageView->setImage(img);
+        // Binned here, at display rate, so the grabber thread never waits on it.
+        if (!processor.replacesDisplay()) showLive(SoftwareBinning::apply(img, grabber.displayBinningSettings(), 2));
         lastFrame = img;
         }
         lastMeta = meta;
         statsLabel->setText(QString("Resolution: %1 x %2\nBinning: %3\nBits: %4\nFPS: %5 (Cam: %6)\nFrame: %7\nDelivered: %8 Dropped: %9\nReadout: %10")
             .arg(meta.width).arg(meta.height).arg(meta.binning,0,'f',1).arg(meta.bits)
-            .arg(fps,0,'f',1).arg(meta.internalFps,0,'f',1).arg(meta.frameIndex).arg(meta.delivered).arg(meta.dropped).arg(meta.readoutSpeed,0,'f',0));
+            .arg(fps,0,'f',1).arg(meta.internalFps,0,'f',1).arg(meta.frameIndex).arg(meta.delivered).arg(meta.dropped).arg(meta.readoutSpeed,0,'f',0)
+            + QString("\nSaturated: %1 % (%2 px)\nAt zero: %3 %")
+            .arg(displayClip.saturatedPercent(),0,'f',3).arg(displayClip.saturated).arg(displayClip.zeroPercent(),0,'f',3));
         if (logCheck->isChecked() && (meta.frameIndex % 100 == 0)) {
             logLine(QString("Frame=%1 FPS=%2 camfps=%3 delivered=%4 dropped=%5")
                 .arg(meta.frameIndex).arg(fps,0,'f',1).arg(meta.internalFps,0,'f',1).arg(meta.delivered).arg(meta.dropped));
@@ -1074,6 +4199,16 @@ int main(int argc, char *argv[]) {
 
     QObject::connect(&app, &QApplication::aboutToQuit, [&](){
         grabber.stopGrabbing();
+        processor.stopProcessing();
+        focusMeter.stopAnalysis();
+        spotTracker.stopAnalysis();
+        spotTracker.stopLog();
+        smlm.stopAnalysis();
+        drift.stopAnalysis();
+        spectrum.stopAnalysis();
+        motion.stopAnalysis();
+        blobCounter.stopAnalysis();
+        blobCounter.stopLog();
         controller.stop();
         controller.cleanup();
         logMessage("Exiting application");
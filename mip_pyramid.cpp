@@ -0,0 +1,66 @@
+#include "mip_pyramid.h"
+#include "simd_kernels.h"
+#include <cmath>
+
+MipPyramid::MipPyramid(const QImage& base) {
+    if (base.isNull()) return;
+    switch (base.format()) {
+    case QImage::Format_Grayscale8:
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        levels.push_back(base);
+        break;
+    case QImage::Format_Grayscale16:
+    case QImage::Format_Indexed8:
+        levels.push_back(base.allGray() ? base.convertToFormat(QImage::Format_Grayscale8)
+                                        : base.convertToFormat(QImage::Format_RGB32));
+        break;
+    default:
+        levels.push_back(base.convertToFormat(base.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                                     : QImage::Format_RGB32));
+        break;
+    }
+}
+
+qint64 MipPyramid::sizeInBytes() const {
+    qint64 total = 0;
+    for (const QImage& img : levels) total += img.sizeInBytes();
+    return total;
+}
+
+void MipPyramid::buildTo(int level) {
+    if (levels.empty()) return;
+    level = std::min(level, maxLevel(levels.front().size()));
+    while (levelCount() <= level) levels.push_back(halve(levels.back()));
+}
+
+int MipPyramid::levelForScale(double scale) {
+    if (scale <= 0.0 || scale >= 0.5) return 0;
+    return static_cast<int>(std::floor(std::log2(1.0 / scale)));
+}
+
+int MipPyramid::maxLevel(const QSize& size) {
+    int level = 0;
+    int side = std::min(size.width(), size.height());
+    while (side / 2 >= 16) {
+        side /= 2;
+        ++level;
+    }
+    return level;
+}
+
+QImage MipPyramid::halve(const QImage& src) {
+    const int w = src.width() / 2;
+    const int h = src.height() / 2;
+    if (w == 0 || h == 0) return src;
+    QImage out(w, h, src.format());
+    const bool gray = src.format() == QImage::Format_Grayscale8;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* r0 = src.constScanLine(2 * y);
+        const uint8_t* r1 = src.constScanLine(2 * y + 1);
+        if (gray) simd::downsample2xU8(r0, r1, out.scanLine(y), static_cast<size_t>(w));
+        else simd::downsample2xU8x4(r0, r1, out.scanLine(y), static_cast<size_t>(w));
+    }
+    return out;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <vector>
+
+// Successive 2x2 box-filtered halvings of a displayed frame. A zoomed-out
+// view draws the level closest to its scale instead of shrinking the full
+// frame on every paint. Levels are built lazily and only as deep as the
+// current zoom needs; copies share the level images, so a pyramid can be
+// extended on a worker thread and handed back to the GUI cheaply.
+class MipPyramid {
+public:
+    MipPyramid() = default;
+    // Grayscale8 and 32-bit RGB stay as they are; other formats are converted
+    // to one of them, the same conversion QPixmap would apply.
+    explicit MipPyramid(const QImage& base);
+
+    bool isNull() const { return levels.empty(); }
+    int levelCount() const { return static_cast<int>(levels.size()); }
+    const QImage& level(int k) const { return levels[k]; }
+    qint64 sizeInBytes() const;
+
+    // Appends levels until `level` exists or the image gets too small.
+    void buildTo(int level);
+
+    // Level k has scale 1/2^k; pick the smallest one that is still at least
+    // as large as the displayed size, so it is only ever shrunk further.
+    static int levelForScale(double scale);
+    // Deepest useful level for a frame: stop once a side would drop below 16.
+    static int maxLevel(const QSize& size);
+    static QImage halve(const QImage& src);
+
+private:
+    std::vector<QImage> levels;
+};
@@ -0,0 +1,351 @@
+#include "motion_estimator.h"
+#include "frame_sequence.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace {
+// SAD of a side x rows block of `cur` at (x, y) against `prev` at (x - u, y - v),
+// both `stride` wide. Gives up once the sum passes `limit`.
+uint64_t blockSad(const uint8_t* prev, const uint8_t* cur, int stride, int x, int y, int u, int v,
+                  int side, int rows, uint64_t limit) {
+    uint64_t sum = 0;
+    const uint8_t* c = cur + static_cast<size_t>(y) * stride + x;
+    const uint8_t* p = prev + static_cast<size_t>(y - v) * stride + (x - u);
+    for (int r = 0; r < rows && sum <= limit; ++r) {
+        sum += simd::sadU8(p, c, static_cast<size_t>(side));
+        c += stride;
+        p += stride;
+    }
+    return sum;
+}
+
+// Best displacement within +-range of (u0, v0) for the block at (x, y);
+// zero motion wins ties, so flat regions report no movement.
+void bestMatch(const uint8_t* prev, const uint8_t* cur, int w, int h, int x, int y, int side,
+               int u0, int v0, int range, int& bu, int& bv, uint64_t& best) {
+    auto fits = [&](int u, int v) {
+        return x - u >= 0 && x - u + side <= w && y - v >= 0 && y - v + side <= h;
+    };
+    best = std::numeric_limits<uint64_t>::max();
+    bu = bv = 0;
+    if (fits(0, 0)) best = blockSad(prev, cur, w, x, y, 0, 0, side, side, best);
+    for (int v = v0 - range; v <= v0 + range; ++v) {
+        for (int u = u0 - range; u <= u0 + range; ++u) {
+            if ((u == 0 && v == 0) || !fits(u, v)) continue;
+            const uint64_t s = blockSad(prev, cur, w, x, y, u, v, side, side, best);
+            if (s < best) {
+                best = s;
+                bu = u;
+                bv = v;
+            }
+        }
+    }
+}
+} // namespace
+
+MotionEstimator::MotionEstimator(QObject* parent)
+    : LiveAnalyzer(parent, 4), threads(workThreads), ring(kTraceLength) {}
+
+MotionEstimator::~MotionEstimator() {
+    stopAnalysis();
+}
+
+void MotionEstimator::setSettings(const Settings& s) {
+    {
+        QMutexLocker lk(&resultMutex);
+        current = s;
+        current.level = std::clamp(s.level, 2, 5);
+        current.block = std::clamp(s.block, 4, 64);
+        current.search = std::clamp(s.search, 1, 16);
+    }
+    reset();
+}
+
+MotionEstimator::Settings MotionEstimator::settings() const {
+    QMutexLocker lk(&resultMutex);
+    return current;
+}
+
+void MotionEstimator::setThreads(int n) {
+    threads = std::max(1, n);
+}
+
+void MotionEstimator::clearResults() {
+    previous = QImage();
+    previousPyramid = Pyramid();
+    shift = -1;
+    QMutexLocker lk(&resultMutex);
+    head = 0;
+    filled = 0;
+    field.clear();
+}
+
+std::vector<MotionEstimator::Sample> MotionEstimator::trace(int maxSamples) const {
+    QMutexLocker lk(&resultMutex);
+    const int n = std::min(filled, std::max(0, maxSamples));
+    std::vector<Sample> out;
+    out.reserve(n);
+    for (int k = n; k > 0; --k) out.push_back(ring[(head - k + kTraceLength) % kTraceLength]);
+    return out;
+}
+
+bool MotionEstimator::hasSamples() const {
+    QMutexLocker lk(&resultMutex);
+    return filled > 0;
+}
+
+MotionEstimator::Sample MotionEstimator::latest() const {
+    QMutexLocker lk(&resultMutex);
+    return filled ? ring[(head - 1 + kTraceLength) % kTraceLength] : Sample();
+}
+
+std::vector<MotionEstimator::Vector> MotionEstimator::vectors() const {
+    QMutexLocker lk(&resultMutex);
+    return field;
+}
+
+void MotionEstimator::analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) {
+    const Settings s = settings();
+    const int n = threads.load();
+    const bool fresh = previous.isNull() || previous.size() != img.size() || previous.format() != img.format()
+                       || previousRoi != roi;
+    if (shift < 0 || fresh) shift = shiftFor(img, roi);
+    Pyramid levels;
+    if (s.vectors) levels = pyramid(img, roi, s.level, shift, n);
+    if (fresh) {
+        // First frame, or a new region: nothing to compare against yet.
+        previous = img;
+        previousRoi = roi;
+        previousPyramid = std::move(levels);
+        return;
+    }
+
+    Sample smp;
+    smp.time = meta.timestamp;
+    smp.framestamp = meta.framestamp;
+    smp.energy = energy(previous, img, roi, n);
+    std::vector<Vector> found;
+    if (s.vectors && !previousPyramid.isNull()) {
+        found = match(previousPyramid, levels, roi, s, n);
+        summarize(found, smp);
+    }
+    previous = img;
+    previousPyramid = std::move(levels);
+
+    QMutexLocker lk(&resultMutex);
+    ring[head] = smp;
+    head = (head + 1) % kTraceLength;
+    filled = std::min(filled + 1, kTraceLength);
+    field = std::move(found);
+}
+
+int MotionEstimator::shiftFor(const QImage& img, const QRect& roi) {
+    if (img.format() != QImage::Format_Grayscale16) return 0;
+    uint16_t top = 0;
+    // Every fourth row is plenty to find the bit depth in use.
+    for (int y = roi.top(); y <= roi.bottom(); y += 4) {
+        const uint16_t* row = reinterpret_cast<const uint16_t*>(img.constScanLine(y)) + roi.left();
+        top = std::max(top, simd::rowMaxU16(row, static_cast<size_t>(roi.width()), nullptr));
+    }
+    int bits = 0;
+    while ((top >> bits) > 255) ++bits;
+    return bits;
+}
+
+MotionEstimator::Pyramid MotionEstimator::pyramid(const QImage& img, const QRect& roi, int depth, int shift, int threads) {
+    Pyramid p;
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    QSize size(roi.width() / 2, roi.height() / 2);
+    for (int k = 1; k <= depth && size.width() >= 4 && size.height() >= 4; ++k) {
+        std::vector<uint8_t> level(static_cast<size_t>(size.width()) * size.height());
+        const int w = size.width();
+        if (k == 1) {
+            parallelBands(size.height(), threads, [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                    const uchar* r0 = src.constScanLine(roi.top() + 2 * y);
+                    const uchar* r1 = src.constScanLine(roi.top() + 2 * y + 1);
+                    uint8_t* dst = level.data() + static_cast<size_t>(y) * w;
+                    if (deep) {
+                        simd::downsample2xU16ToU8(reinterpret_cast<const uint16_t*>(r0) + roi.left(),
+                                                  reinterpret_cast<const uint16_t*>(r1) + roi.left(), dst,
+                                                  static_cast<size_t>(w), shift);
+                    } else {
+                        simd::downsample2xU8(r0 + roi.left(), r1 + roi.left(), dst, static_cast<size_t>(w));
+                    }
+                }
+            });
+        } else {
+            const std::vector<uint8_t>& up = p.levels.back();
+            const int upW = p.sizes.back().width();
+            for (int y = 0; y < size.height(); ++y) {
+                simd::downsample2xU8(up.data() + static_cast<size_t>(2 * y) * upW,
+                                     up.data() + static_cast<size_t>(2 * y + 1) * upW,
+                                     level.data() + static_cast<size_t>(y) * w, static_cast<size_t>(w));
+            }
+        }
+        p.levels.push_back(std::move(level));
+        p.sizes.push_back(size);
+        size = QSize(size.width() / 2, size.height() / 2);
+    }
+    return p;
+}
+
+double MotionEstimator::energy(const QImage& prev, const QImage& cur, const QRect& roi, int threads) {
+    const bool deep = cur.format() == QImage::Format_Grayscale16;
+    const bool gray = deep || cur.format() == QImage::Format_Grayscale8;
+    QImage a = gray ? prev : prev.convertToFormat(QImage::Format_Grayscale8);
+    QImage b = gray ? cur : cur.convertToFormat(QImage::Format_Grayscale8);
+    std::mutex merge;
+    uint64_t total = 0;
+    parallelBands(roi.height(), threads, [&](int y0, int y1) {
+        uint64_t sum = 0;
+        for (int y = roi.top() + y0; y < roi.top() + y1; ++y) {
+            if (deep) {
+                sum += simd::sadU16(reinterpret_cast<const uint16_t*>(a.constScanLine(y)) + roi.left(),
+                                    reinterpret_cast<const uint16_t*>(b.constScanLine(y)) + roi.left(),
+                                    static_cast<size_t>(roi.width()));
+            } else {
+                sum += simd::sadU8(a.constScanLine(y) + roi.left(), b.constScanLine(y) + roi.left(),
+                                   static_cast<size_t>(roi.width()));
+            }
+        }
+        std::lock_guard<std::mutex> lk(merge);
+        total += sum;
+    });
+    return static_cast<double>(total) / (static_cast<double>(roi.width()) * roi.height());
+}
+
+std::vector<MotionEstimator::Vector> MotionEstimator::match(const Pyramid& prev, const Pyramid& cur, const QRect& roi,
+                                                            const Settings& s, int threads) {
+    // Search at the deepest level both pyramids have, refine one level up.
+    const int level = std::min({s.level, static_cast<int>(prev.levels.size()), static_cast<int>(cur.levels.size())});
+    if (level < 2 || prev.sizes[level - 1] != cur.sizes[level - 1]) return {};
+    const QSize coarse = cur.sizes[level - 1];
+    const QSize fine = cur.sizes[level - 2];
+    const int side = s.block;
+    const int cols = coarse.width() / side;
+    const int rows = coarse.height() / side;
+    if (cols == 0 || rows == 0) return {};
+    const uint8_t* pc = prev.levels[level - 1].data();
+    const uint8_t* cc = cur.levels[level - 1].data();
+    const uint8_t* pf = prev.levels[level - 2].data();
+    const uint8_t* cf = cur.levels[level - 2].data();
+    const float scale = static_cast<float>(1 << (level - 1));   // fine level to frame pixels
+
+    std::vector<Vector> out(static_cast<size_t>(cols) * rows);
+    parallelBands(rows, threads, [&](int r0, int r1) {
+        for (int by = r0; by < r1; ++by) {
+            for (int bx = 0; bx < cols; ++bx) {
+                int u = 0, v = 0;
+                uint64_t sad = 0;
+                bestMatch(pc, cc, coarse.width(), coarse.height(), bx * side, by * side, side, 0, 0, s.search, u, v, sad);
+                int fu = 0, fv = 0;
+                bestMatch(pf, cf, fine.width(), fine.height(), 2 * bx * side, 2 * by * side, 2 * side,
+                          2 * u, 2 * v, 1, fu, fv, sad);
+                Vector& vec = out[static_cast<size_t>(by) * cols + bx];
+                vec.x = roi.left() + (2 * bx * side + side) * scale;
+                vec.y = roi.top() + (2 * by * side + side) * scale;
+                vec.dx = fu * scale;
+                vec.dy = fv * scale;
+                vec.error = static_cast<float>(sad) / (4.0f * side * side);
+            }
+        }
+    }, 1);
+    return out;
+}
+
+void MotionEstimator::summarize(const std::vector<Vector>& field, Sample& s) {
+    s.speed = s.moving = s.dx = s.dy = 0.0;
+    if (field.empty()) return;
+    for (const Vector& v : field) {
+        s.speed += std::hypot(v.dx, v.dy);
+        s.moving += (v.dx != 0.0f || v.dy != 0.0f) ? 1.0 : 0.0;
+        s.dx += v.dx;
+        s.dy += v.dy;
+    }
+    const double n = static_cast<double>(field.size());
+    s.speed /= n;
+    s.moving /= n;
+    s.dx /= n;
+    s.dy /= n;
+}
+
+QString MotionEstimator::exportTrace(const QString& sourcePath, int first, int last, const QRect& roiIn, const Settings& s,
+                                     const QString& csvPath, int threads, std::vector<Sample>* samples,
+                                     const Progress& progress, const std::atomic<bool>* cancel) {
+    FrameSequence src(64);
+    QString err = src.open(sourcePath);
+    if (!err.isEmpty()) return err;
+    if (src.count() < 2) return "At least two frames are needed";
+    const int n = src.count();
+    first = std::clamp(first, 0, n - 1);
+    last = last < 0 ? n - 1 : std::clamp(last, first, n - 1);
+    if (last == first) return "At least two frames are needed";
+    QImage probe = src.read(first, &err);
+    if (probe.isNull()) return err;
+    const QRect roi = roiIn.isEmpty() ? probe.rect() : roiIn.intersected(probe.rect());
+    if (roi.isEmpty()) return "ROI does not intersect the frame";
+    const int shift = shiftFor(probe, roi);
+    if (threads <= 0) threads = std::max(1, QThread::idealThreadCount());
+
+    // Sample k compares frame first + k with the one before it. Each chunk
+    // re-reads the frame before its first one; everything else is read once.
+    const int pairs = last - first;
+    const FrameTimeline& tl = src.timeline();
+    std::vector<Sample> out(pairs);
+    std::mutex mutex;
+    std::atomic<int> done{0};
+    const int progressEvery = std::max(1, pairs / 200);
+    parallelBands(pairs, threads, [&](int k0, int k1) {
+        QImage prev;
+        Pyramid prevLevels;
+        for (int k = k0 - 1; k < k1; ++k) {
+            if (cancel && cancel->load()) return;
+            const int index = first + k + 1;
+            QString readErr;
+            QImage img = src.read(index, &readErr);
+            if (img.isNull() || img.size() != probe.size()) {
+                std::lock_guard<std::mutex> lk(mutex);
+                if (err.isEmpty()) err = QString("Frame %1: %2").arg(index)
+                                             .arg(img.isNull() ? readErr : QString("size differs from the first frame"));
+                return;
+            }
+            Pyramid levels;
+            if (s.vectors) levels = pyramid(img, roi, s.level, shift, 1);
+            if (k >= k0) {
+                Sample& smp = out[k];
+                smp.time = tl.isEmpty() ? 0.0 : tl.timeAt(index);
+                smp.framestamp = tl.isEmpty() ? index : tl.framestampAt(index);
+                smp.energy = energy(prev, img, roi, 1);
+                if (s.vectors) summarize(match(prevLevels, levels, roi, s, 1), smp);
+                const int d = ++done;
+                if (progress && (d % progressEvery == 0 || d == pairs)) progress(d, pairs);
+            }
+            prev = img;
+            prevLevels = std::move(levels);
+        }
+    }, 16);
+    if (cancel && cancel->load()) return "Analysis cancelled";
+    if (!err.isEmpty()) return err;
+
+    QFile f(csvPath);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return f.errorString();
+    QTextStream csv(&f);
+    csv << "frame,time_s,framestamp,energy_dn,speed_px,moving_fraction,mean_dx_px,mean_dy_px\n";
+    for (int k = 0; k < pairs; ++k) {
+        const Sample& smp = out[k];
+        csv << first + k + 1 << "," << QString::number(smp.time, 'f', 6) << "," << smp.framestamp << ","
+            << QString::number(smp.energy, 'f', 4) << "," << QString::number(smp.speed, 'f', 4) << ","
+            << QString::number(smp.moving, 'f', 4) << "," << QString::number(smp.dx, 'f', 4) << ","
+            << QString::number(smp.dy, 'f', 4) << "\n";
+    }
+    csv.flush();
+    if (f.error() != QFileDevice::NoError) return f.errorString();
+    if (samples) *samples = std::move(out);
+    return {};
+}
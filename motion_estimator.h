@@ -0,0 +1,97 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "live_analyzer.h"
+
+// Motion between consecutive frames of the ROI, for behaviour and flow
+// recordings. The difference energy is the mean |I(t) - I(t-1)| over the
+// full-resolution ROI. Optional block matching finds one vector per block
+// of an 8-bit pyramid: exhaustive SAD search at 1/2^level scale, refined
+// +-1 pixel one level up, so vectors come in steps of 2^(level-1) pixels.
+// Both use the SIMD SAD kernels and split rows or block rows over the
+// configured threads.
+class MotionEstimator : public LiveAnalyzer {
+    Q_OBJECT
+public:
+    struct Settings {
+        bool vectors = true;
+        int level = 3;          // search scale 1/2^level, 2..5
+        int block = 8;          // block side at the search level
+        int search = 4;         // +- range at the search level
+    };
+    struct Vector {
+        float x = 0.0f;         // block centre, frame pixels
+        float y = 0.0f;
+        float dx = 0.0f;        // displacement since the previous frame, pixels
+        float dy = 0.0f;
+        float error = 0.0f;     // mean absolute difference of the match, 8-bit levels
+    };
+    struct Sample {
+        double time = 0.0;      // camera timestamp, seconds
+        qint64 framestamp = 0;
+        double energy = 0.0;    // mean |difference|, DN per pixel
+        double speed = 0.0;     // mean vector length, pixels per frame
+        double moving = 0.0;    // fraction of blocks with a non-zero vector
+        double dx = 0.0;        // mean vector
+        double dy = 0.0;
+    };
+    // 8-bit levels 1 .. depth of a ROI; level k is 1/2^k scale.
+    struct Pyramid {
+        std::vector<std::vector<uint8_t>> levels;
+        std::vector<QSize> sizes;
+        bool isNull() const { return levels.empty(); }
+    };
+
+    explicit MotionEstimator(QObject* parent=nullptr);
+    ~MotionEstimator() override;
+
+    void setSettings(const Settings& s);
+    Settings settings() const;
+    void setThreads(int n);
+
+    std::vector<Sample> trace(int maxSamples) const;
+    bool hasSamples() const;
+    Sample latest() const;
+    std::vector<Vector> vectors() const;
+
+    // 16-bit data is shifted right by `shift` on the way to 8 bits;
+    // shiftFor picks the shift that brings a frame's ROI maximum below 256.
+    static int shiftFor(const QImage& img, const QRect& roi);
+    static Pyramid pyramid(const QImage& img, const QRect& roi, int depth, int shift, int threads);
+    static double energy(const QImage& prev, const QImage& cur, const QRect& roi, int threads);
+    static std::vector<Vector> match(const Pyramid& prev, const Pyramid& cur, const QRect& roi,
+                                     const Settings& s, int threads);
+    // Fills the vector fields of a sample.
+    static void summarize(const std::vector<Vector>& field, Sample& s);
+
+    // Offline trace of a recording range as CSV, one row per frame after
+    // the first. Contiguous chunks of frames run on separate threads.
+    using Progress = std::function<void(int done, int total)>;
+    static QString exportTrace(const QString& sourcePath, int first, int last, const QRect& roi, const Settings& s,
+                               const QString& csvPath, int threads, std::vector<Sample>* samples = nullptr,
+                               const Progress& progress = {}, const std::atomic<bool>* cancel = nullptr);
+
+protected:
+    void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) override;
+    void clearResults() override;
+
+private:
+    static constexpr int kTraceLength = 4096;
+
+    std::atomic<int> threads;
+    mutable QMutex resultMutex;
+    Settings current;
+    std::vector<Sample> ring;   // kTraceLength slots
+    int head = 0;
+    int filled = 0;
+    std::vector<Vector> field;
+
+    // Analysis thread only.
+    QImage previous;
+    QRect previousRoi;
+    Pyramid previousPyramid;
+    int shift = -1;
+};
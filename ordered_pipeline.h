@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Parallel stages with an in-order sink. produce(i) runs on `workers`
+// threads (decode/transform/encode), consume(i, T&&) runs on the calling
+// thread strictly in index order (the single writer). At most `window`
+// results are in flight so memory stays bounded however long the job is.
+// consume returns false to abort; returns false if aborted or cancelled.
+template <typename T, typename Produce, typename Consume>
+bool runOrderedPipeline(int count, int workers, int window,
+                        Produce produce, Consume consume,
+                        const std::atomic<bool>* cancel = nullptr) {
+    if (count <= 0) return true;
+    workers = std::max(1, workers);
+    window = std::max(workers, window);
+
+    std::mutex m;
+    std::condition_variable readyCv;
+    std::condition_variable slotCv;
+    std::map<int, T> ready;
+    int nextClaim = 0;
+    int nextConsume = 0;
+    bool abort = false;
+
+    auto cancelled = [&](){ return abort || (cancel && cancel->load()); };
+
+    auto worker = [&](){
+        for (;;) {
+            int index;
+            {
+                std::unique_lock<std::mutex> lk(m);
+                slotCv.wait(lk, [&](){ return cancelled() || nextClaim >= count || nextClaim < nextConsume + window; });
+                if (cancelled() || nextClaim >= count) return;
+                index = nextClaim++;
+            }
+            T result = produce(index);
+            {
+                std::lock_guard<std::mutex> lk(m);
+                ready.emplace(index, std::move(result));
+            }
+            readyCv.notify_one();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (int i = 0; i < workers; ++i) threads.emplace_back(worker);
+
+    bool ok = true;
+    while (nextConsume < count) {
+        T item;
+        {
+            std::unique_lock<std::mutex> lk(m);
+            readyCv.wait_for(lk, std::chrono::milliseconds(50), [&](){
+                return cancelled() || ready.count(nextConsume) > 0;
+            });
+            if (cancelled()) {
+                abort = true;
+                ok = false;
+                break;
+            }
+            auto it = ready.find(nextConsume);
+            if (it == ready.end()) continue;
+            item = std::move(it->second);
+            ready.erase(it);
+        }
+        if (!consume(nextConsume, std::move(item))) {
+            std::lock_guard<std::mutex> lk(m);
+            abort = true;
+            ok = false;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lk(m);
+            ++nextConsume;
+        }
+        slotCv.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(m);
+        abort = abort || !ok;
+    }
+    slotCv.notify_all();
+    for (auto& t : threads) t.join();
+    return ok;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Splits rows [0, rows) into contiguous bands and runs fn(begin, end) on
+// each, the calling thread taking the first band. Bands are at least
+// minRows tall, so small frames stay on one thread. Returns after every
+// band is done.
+template <typename Fn>
+void parallelBands(int rows, int threads, Fn&& fn, int minRows = 32) {
+    if (rows <= 0) return;
+    int bands = std::clamp(std::min(threads, rows / std::max(1, minRows)), 1, rows);
+    if (bands == 1) {
+        fn(0, rows);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(bands - 1);
+    auto bandStart = [rows, bands](int b) { return static_cast<int>(static_cast<long long>(rows) * b / bands); };
+    for (int b = 1; b < bands; ++b) {
+        workers.emplace_back([&fn, &bandStart, b]() { fn(bandStart(b), bandStart(b + 1)); });
+    }
+    fn(0, bandStart(1));
+    for (std::thread& t : workers) t.join();
+}
+
+// Persistent workers for independent jobs, such as whole frames. Each worker
+// runs its own lane oldest first and, when that is empty, steals the newest
+// job from another lane, so a slow job never holds up the rest. post()
+// spreads jobs over the lanes round-robin. Jobs still queued when the pool
+// is destroyed are run before the workers exit.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int threads) {
+        const int n = std::max(1, threads);
+        for (int i = 0; i < n; ++i) lanes.push_back(std::make_unique<Lane>());
+        for (int i = 0; i < n; ++i) workers.emplace_back([this, i]() { work(i); });
+    }
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers) t.join();
+    }
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+    void post(std::function<void()> job) {
+        Lane& lane = *lanes[nextLane++ % lanes.size()];
+        {
+            std::lock_guard<std::mutex> lk(lane.mutex);
+            lane.jobs.push_back(std::move(job));
+        }
+        {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            ++queued;
+            ++unfinished;
+        }
+        wake.notify_one();
+    }
+    // Blocks until at most n posted jobs are queued or running.
+    void waitUntilAtMost(int n) {
+        std::unique_lock<std::mutex> lk(stateMutex);
+        finished.wait(lk, [this, n]() { return unfinished <= n; });
+    }
+
+private:
+    struct Lane {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    // A worker only looks for a job once it has claimed one of the queued
+    // count, so the search always finds one.
+    std::function<void()> take(int self) {
+        for (;;) {
+            for (size_t k = 0; k < lanes.size(); ++k) {
+                Lane& lane = *lanes[(self + k) % lanes.size()];
+                std::lock_guard<std::mutex> lk(lane.mutex);
+                if (lane.jobs.empty()) continue;
+                std::function<void()> job;
+                if (k == 0) {
+                    job = std::move(lane.jobs.front());
+                    lane.jobs.pop_front();
+                } else {
+                    job = std::move(lane.jobs.back());
+                    lane.jobs.pop_back();
+                }
+                return job;
+            }
+            std::this_thread::yield();
+        }
+    }
+    void work(int self) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lk(stateMutex);
+                wake.wait(lk, [this]() { return stopping || queued > 0; });
+                if (queued == 0) return;
+                --queued;
+            }
+            take(self)();
+            {
+                std::lock_guard<std::mutex> lk(stateMutex);
+                --unfinished;
+            }
+            finished.notify_all();
+        }
+    }
+
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextLane{0};
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    int queued = 0;             // posted, not yet claimed by a worker
+    int unfinished = 0;         // posted, not yet done
+    bool stopping = false;
+};
@@ -0,0 +1,467 @@
+#include "particle_tracker.h"
+#include "frame_sequence.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace {
+using Detection = ParticleTrackResult::Detection;
+
+// Uniform grid over one frame's detections, hashed by cell so memory is
+// proportional to the detections rather than to the frame area. Points are
+// sorted by cell and each occupied cell maps to its run of the order array.
+class GridHash {
+public:
+    void build(const Detection* points, int n, double cellSize) {
+        inv = 1.0 / cellSize;
+        entries.resize(n);
+        for (int i = 0; i < n; ++i) entries[i] = {keyOf(cellOf(points[i].x), cellOf(points[i].y)), i};
+        std::sort(entries.begin(), entries.end());
+        size_t size = 16;
+        while (size < 2 * static_cast<size_t>(n)) size <<= 1;
+        slots.assign(size, Slot());
+        mask = size - 1;
+        for (int i = 0; i < n;) {
+            int j = i + 1;
+            while (j < n && entries[j].first == entries[i].first) ++j;
+            size_t h = hashOf(entries[i].first) & mask;
+            while (slots[h].end) h = (h + 1) & mask;
+            slots[h] = {entries[i].first, i, j};
+            i = j;
+        }
+    }
+    // Calls fn(index) for every point in the cells within reach of (x, y).
+    template <typename Fn>
+    void query(float x, float y, int reach, Fn&& fn) const {
+        const int cx = cellOf(x);
+        const int cy = cellOf(y);
+        for (int gy = cy - reach; gy <= cy + reach; ++gy) {
+            for (int gx = cx - reach; gx <= cx + reach; ++gx) {
+                const uint64_t key = keyOf(gx, gy);
+                for (size_t h = hashOf(key) & mask; slots[h].end; h = (h + 1) & mask) {
+                    if (slots[h].key != key) continue;
+                    for (int k = slots[h].begin; k < slots[h].end; ++k) fn(entries[k].second);
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        uint64_t key = 0;
+        int begin = 0;
+        int end = 0;            // 0 = empty slot
+    };
+    int cellOf(float v) const { return static_cast<int>(std::floor(v * inv)); }
+    static uint64_t keyOf(int cx, int cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+    static size_t hashOf(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        return static_cast<size_t>(k);
+    }
+
+    double inv = 1.0;
+    std::vector<std::pair<uint64_t, int>> entries;     // (cell, point), sorted
+    std::vector<Slot> slots;
+    size_t mask = 0;
+};
+
+struct Candidate {
+    int track;                  // index into the active list
+    int det;                    // index into the frame's detections
+    double d2;
+};
+
+// Minimum-cost assignment of n rows to m >= n columns (Hungarian method,
+// potentials form). Returns the column of each row.
+std::vector<int> assignRows(const std::vector<double>& cost, int n, int m) {
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> u(n + 1, 0.0), v(m + 1, 0.0), minv(m + 1);
+    std::vector<int> p(m + 1, 0), way(m + 1, 0);
+    std::vector<char> used(m + 1);
+    for (int i = 1; i <= n; ++i) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), inf);
+        std::fill(used.begin(), used.end(), 0);
+        do {
+            used[j0] = 1;
+            const int i0 = p[j0];
+            double delta = inf;
+            int j1 = 0;
+            for (int j = 1; j <= m; ++j) {
+                if (used[j]) continue;
+                const double cur = cost[static_cast<size_t>(i0 - 1) * m + (j - 1)] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= m; ++j) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            const int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+    std::vector<int> column(n, -1);
+    for (int j = 1; j <= m; ++j) {
+        if (p[j] > 0) column[p[j] - 1] = j - 1;
+    }
+    return column;
+}
+
+// Accepts the closest pairs first; each track and detection is used once.
+void assignGreedy(std::vector<Candidate>& cand, std::vector<int>& trackMatch, std::vector<int>& detMatch) {
+    std::sort(cand.begin(), cand.end(), [](const Candidate& a, const Candidate& b){ return a.d2 < b.d2; });
+    for (const Candidate& c : cand) {
+        if (trackMatch[c.track] >= 0 || detMatch[c.det] >= 0) continue;
+        trackMatch[c.track] = c.det;
+        detMatch[c.det] = c.track;
+    }
+}
+
+int findRoot(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Minimum total squared distance within each connected group of candidates.
+// Pairs outside the gate cost more than any gated pair, so the solver only
+// leaves a particle unlinked when linking it would displace closer pairs.
+// Very large groups fall back to greedy, which keeps the cost bounded.
+void assignGlobal(const std::vector<Candidate>& cand, int tracks, int dets, double noLink,
+                  std::vector<int>& trackMatch, std::vector<int>& detMatch) {
+    constexpr int kMaxExact = 300;
+    std::vector<int> parent(tracks + dets);
+    for (size_t i = 0; i < parent.size(); ++i) parent[i] = static_cast<int>(i);
+    for (const Candidate& c : cand) {
+        const int a = findRoot(parent, c.track);
+        const int b = findRoot(parent, tracks + c.det);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    }
+    std::vector<std::vector<Candidate>> groups;
+    std::vector<int> groupOf(parent.size(), -1);
+    for (const Candidate& c : cand) {
+        const int root = findRoot(parent, c.track);
+        if (groupOf[root] < 0) {
+            groupOf[root] = static_cast<int>(groups.size());
+            groups.emplace_back();
+        }
+        groups[groupOf[root]].push_back(c);
+    }
+    std::vector<int> rowOf(tracks, -1), colOf(dets, -1);
+    for (std::vector<Candidate>& g : groups) {
+        if (g.size() == 1) {
+            trackMatch[g[0].track] = g[0].det;
+            detMatch[g[0].det] = g[0].track;
+            continue;
+        }
+        std::vector<int> rows, cols;
+        for (const Candidate& c : g) {
+            if (rowOf[c.track] < 0) {
+                rowOf[c.track] = static_cast<int>(rows.size());
+                rows.push_back(c.track);
+            }
+            if (colOf[c.det] < 0) {
+                colOf[c.det] = static_cast<int>(cols.size());
+                cols.push_back(c.det);
+            }
+        }
+        if (static_cast<int>(std::min(rows.size(), cols.size())) > kMaxExact) {
+            assignGreedy(g, trackMatch, detMatch);
+            continue;
+        }
+        // The solver wants rows <= columns; transpose when tracks outnumber detections.
+        const bool transpose = rows.size() > cols.size();
+        const int n = static_cast<int>(transpose ? cols.size() : rows.size());
+        const int m = static_cast<int>(transpose ? rows.size() : cols.size());
+        std::vector<double> cost(static_cast<size_t>(n) * m, noLink);
+        for (const Candidate& c : g) {
+            const int r = rowOf[c.track];
+            const int k = colOf[c.det];
+            cost[transpose ? static_cast<size_t>(k) * m + r : static_cast<size_t>(r) * m + k] = c.d2;
+        }
+        const std::vector<int> column = assignRows(cost, n, m);
+        for (int i = 0; i < n; ++i) {
+            const int r = transpose ? column[i] : i;
+            const int k = transpose ? i : column[i];
+            if (cost[static_cast<size_t>(i) * m + column[i]] >= noLink) continue;
+            trackMatch[rows[r]] = cols[k];
+            detMatch[cols[k]] = rows[r];
+        }
+    }
+}
+} // namespace
+
+void ParticleTracker::link(ParticleTrackResult& result, const ParticleTrackOptions& opt) {
+    std::vector<Detection>& det = result.detections;
+    result.tracks.clear();
+    for (Detection& d : det) d.track = d.prev = d.next = -1;
+    const double step = std::max(0.1, opt.maxStep);
+    const int maxGap = std::max(0, opt.maxGap);
+    // A track skipping frames may have moved further: the gate grows with
+    // the frames since its last detection.
+    const double maxGate = step * (maxGap + 1);
+    const double noLink = 2.0 * maxGate * maxGate + 1.0;
+
+    std::vector<int> trackTail;             // last detection of every track so far
+    std::vector<int> active;                // tracks that can still be extended
+    GridHash grid;
+    std::vector<Candidate> cand;
+    std::vector<int> trackMatch, detMatch;
+    const int frames = static_cast<int>(result.frameStart.size()) - 1;
+    for (int k = 0; k < frames; ++k) {
+        const int begin = result.frameStart[k];
+        const int n = result.frameStart[k + 1] - begin;
+        const int frame = result.first + k;
+        active.erase(std::remove_if(active.begin(), active.end(), [&](int t){
+            return frame - det[trackTail[t]].frame > maxGap + 1;
+        }), active.end());
+
+        cand.clear();
+        if (n > 0 && !active.empty()) {
+            grid.build(det.data() + begin, n, step);
+            for (int a = 0; a < static_cast<int>(active.size()); ++a) {
+                const Detection& from = det[trackTail[active[a]]];
+                const int elapsed = frame - from.frame;
+                const double gate2 = step * elapsed * step * elapsed;
+                grid.query(from.x, from.y, elapsed, [&](int i){
+                    const double dx = det[begin + i].x - from.x;
+                    const double dy = det[begin + i].y - from.y;
+                    const double d2 = dx * dx + dy * dy;
+                    if (d2 <= gate2) cand.push_back({a, i, d2});
+                });
+            }
+        }
+        trackMatch.assign(active.size(), -1);
+        detMatch.assign(n, -1);
+        if (opt.global) assignGlobal(cand, static_cast<int>(active.size()), n, noLink, trackMatch, detMatch);
+        else assignGreedy(cand, trackMatch, detMatch);
+
+        for (int a = 0; a < static_cast<int>(active.size()); ++a) {
+            if (trackMatch[a] < 0) continue;
+            const int t = active[a];
+            const int d = begin + trackMatch[a];
+            det[trackTail[t]].next = d;
+            det[d].prev = trackTail[t];
+            det[d].track = t;
+            trackTail[t] = d;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (detMatch[i] >= 0) continue;
+            const int t = static_cast<int>(trackTail.size());
+            det[begin + i].track = t;
+            trackTail.push_back(begin + i);
+            active.push_back(t);
+        }
+    }
+
+    // Keep tracks of at least minLength points. Tracks were opened in
+    // detection order, so the kept ones stay ordered by their start.
+    const int minLength = std::max(1, opt.minLength);
+    for (int tail : trackTail) {
+        int head = tail;
+        int points = 1;
+        while (det[head].prev >= 0) {
+            head = det[head].prev;
+            ++points;
+        }
+        if (points < minLength) {
+            for (int d = head; d >= 0;) {
+                const int next = det[d].next;
+                det[d].track = det[d].prev = det[d].next = -1;
+                d = next;
+            }
+            continue;
+        }
+        ParticleTrackResult::Track track;
+        track.head = head;
+        track.tail = tail;
+        track.points = points;
+        const int id = static_cast<int>(result.tracks.size());
+        for (int d = head; d >= 0; d = det[d].next) det[d].track = id;
+        result.tracks.push_back(track);
+    }
+
+    // Velocity statistics; speeds are per frame so gaps do not inflate them.
+    for (ParticleTrackResult::Track& track : result.tracks) {
+        const Detection& a = det[track.head];
+        const Detection& b = det[track.tail];
+        for (int d = track.head; det[d].next >= 0; d = det[d].next) {
+            const Detection& p = det[d];
+            const Detection& q = det[p.next];
+            const double len = std::hypot(q.x - p.x, q.y - p.y);
+            track.path += len;
+            track.maxSpeed = std::max(track.maxSpeed, len / (q.frame - p.frame));
+        }
+        const int span = b.frame - a.frame;
+        track.net = std::hypot(b.x - a.x, b.y - a.y);
+        if (span > 0) {
+            track.meanSpeed = track.path / span;
+            track.vx = (b.x - a.x) / span;
+            track.vy = (b.y - a.y) / span;
+        }
+        if (!result.times.empty()) track.duration = result.times[b.frame - result.first] - result.times[a.frame - result.first];
+    }
+}
+
+QString ParticleTracker::run(const QString& sourcePath, const ParticleTrackOptions& opt, ParticleTrackResult& result,
+                             const Progress& progress, const std::atomic<bool>* cancel) {
+    FrameSequence src(64);
+    QString err = src.open(sourcePath);
+    if (!err.isEmpty()) return err;
+    const int n = src.count();
+    if (n < 2) return "At least two frames are needed";
+    const int first = std::clamp(opt.first, 0, n - 1);
+    const int last = opt.last < 0 ? n - 1 : std::clamp(opt.last, first, n - 1);
+    if (last == first) return "At least two frames are needed";
+    QImage probe = src.read(first, &err);
+    if (probe.isNull()) return err;
+    const QRect roi = opt.roi.isEmpty() ? probe.rect() : opt.roi.intersected(probe.rect());
+    if (roi.isEmpty()) return "ROI does not intersect the frame";
+    const int threads = opt.threads > 0 ? opt.threads : std::max(1, QThread::idealThreadCount());
+
+    // Detection: each chunk of frames segments on one thread.
+    const int frames = last - first + 1;
+    std::vector<std::vector<BlobCounter::Blob>> found(frames);
+    std::mutex mutex;
+    std::atomic<int> done{0};
+    const int progressEvery = std::max(1, frames / 200);
+    parallelBands(frames, threads, [&](int k0, int k1) {
+        for (int k = k0; k < k1; ++k) {
+            if (cancel && cancel->load()) return;
+            QString readErr;
+            QImage img = src.read(first + k, &readErr);
+            if (img.isNull() || img.size() != probe.size()) {
+                std::lock_guard<std::mutex> lk(mutex);
+                if (err.isEmpty()) err = QString("Frame %1: %2").arg(first + k)
+                                             .arg(img.isNull() ? readErr : QString("size differs from the first frame"));
+                return;
+            }
+            const int threshold = opt.detect.otsu ? BlobCounter::otsuThreshold(img, roi, 1) : opt.detect.threshold;
+            BlobCounter::segment(img, roi, threshold, opt.detect, 1, found[k]);
+            const int d = ++done;
+            if (progress && (d % progressEvery == 0 || d == frames)) progress(d, frames);
+        }
+    }, 8);
+    if (cancel && cancel->load()) return "Tracking cancelled";
+    if (!err.isEmpty()) return err;
+
+    ParticleTrackResult out;
+    out.first = first;
+    out.last = last;
+    out.roi = roi;
+    const FrameTimeline& tl = src.timeline();
+    if (!tl.isEmpty()) {
+        out.times.resize(frames);
+        for (int k = 0; k < frames; ++k) out.times[k] = tl.timeAt(first + k);
+    }
+    size_t total = 0;
+    for (const auto& f : found) total += f.size();
+    out.detections.reserve(total);
+    out.frameStart.reserve(frames + 1);
+    for (int k = 0; k < frames; ++k) {
+        out.frameStart.push_back(static_cast<int>(out.detections.size()));
+        for (const BlobCounter::Blob& b : found[k]) {
+            Detection d;
+            d.frame = first + k;
+            d.x = b.x;
+            d.y = b.y;
+            d.area = b.area;
+            out.detections.push_back(d);
+        }
+        std::vector<BlobCounter::Blob>().swap(found[k]);
+    }
+    out.frameStart.push_back(static_cast<int>(out.detections.size()));
+    if (out.detections.empty()) return "No particles found; check the threshold";
+    link(out, opt);
+    result = std::move(out);
+    return {};
+}
+
+QString ParticleTrackResult::summary() const {
+    if (tracks.empty()) return QString("%1 detections in %2 frames, no tracks").arg(detections.size()).arg(frames());
+    std::vector<double> speeds;
+    speeds.reserve(tracks.size());
+    qint64 linked = 0;
+    double meanLength = 0.0;
+    for (const Track& t : tracks) {
+        speeds.push_back(t.meanSpeed);
+        linked += t.points;
+        meanLength += t.points;
+    }
+    meanLength /= tracks.size();
+    std::nth_element(speeds.begin(), speeds.begin() + speeds.size() / 2, speeds.end());
+    QString text = QString("%1 detections in %2 frames, %3 tracks (%4 % of detections linked)\n"
+                           "Mean track length %5 points, median speed %6 px/frame")
+        .arg(detections.size()).arg(frames()).arg(tracks.size())
+        .arg(100.0 * linked / detections.size(), 0, 'f', 1)
+        .arg(meanLength, 0, 'f', 1).arg(speeds[speeds.size() / 2], 0, 'f', 3);
+    if (times.size() > 1 && times.back() > times.front()) {
+        const double interval = (times.back() - times.front()) / (times.size() - 1);
+        text += QString(" (%1 px/s)").arg(speeds[speeds.size() / 2] / interval, 0, 'f', 2);
+    }
+    return text;
+}
+
+QString ParticleTrackResult::save(const QString& basePath) const {
+    if (isEmpty()) return "Nothing to save";
+    const QString base = QFileInfo(basePath).absoluteDir().absoluteFilePath(QFileInfo(basePath).completeBaseName());
+    QFile pf(base + "_points.csv");
+    if (!pf.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return pf.errorString();
+    QTextStream points(&pf);
+    points << "track,frame,time_s,x,y,area\n";
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        for (int d = tracks[t].head; d >= 0; d = detections[d].next) {
+            const Detection& p = detections[d];
+            points << t << "," << p.frame << ","
+                   << (times.empty() ? QString() : QString::number(times[p.frame - first], 'f', 6)) << ","
+                   << QString::number(p.x, 'f', 2) << "," << QString::number(p.y, 'f', 2) << "," << p.area << "\n";
+        }
+    }
+    points.flush();
+    if (pf.error() != QFileDevice::NoError) return pf.errorString();
+
+    QFile tf(base + "_tracks.csv");
+    if (!tf.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return tf.errorString();
+    QTextStream out(&tf);
+    out << "track,first_frame,last_frame,points,duration_s,path_px,net_px,straightness,"
+           "mean_speed_px_per_frame,max_speed_px_per_frame,vx_px_per_frame,vy_px_per_frame,mean_speed_px_per_s\n";
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        const Track& tr = tracks[t];
+        const int span = detections[tr.tail].frame - detections[tr.head].frame;
+        out << t << "," << detections[tr.head].frame << "," << detections[tr.tail].frame << "," << tr.points << ","
+            << QString::number(tr.duration, 'f', 6) << "," << QString::number(tr.path, 'f', 3) << ","
+            << QString::number(tr.net, 'f', 3) << ","
+            << QString::number(tr.path > 0.0 ? tr.net / tr.path : 0.0, 'f', 4) << ","
+            << QString::number(tr.meanSpeed, 'f', 4) << "," << QString::number(tr.maxSpeed, 'f', 4) << ","
+            << QString::number(tr.vx, 'f', 4) << "," << QString::number(tr.vy, 'f', 4) << ","
+            << (tr.duration > 0.0 ? QString::number(tr.meanSpeed * span / tr.duration, 'f', 4) : QString()) << "\n";
+    }
+    out.flush();
+    if (tf.error() != QFileDevice::NoError) return tf.errorString();
+    return {};
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "blob_counter.h"
+
+struct ParticleTrackOptions {
+    int first = 0;
+    int last = -1;              // inclusive, -1 = last frame
+    QRect roi;                  // empty = full frame
+    BlobCounter::Settings detect;
+    double maxStep = 5.0;       // gating distance per frame, pixels
+    int maxGap = 1;             // frames a particle may go undetected
+    bool global = true;         // minimum-cost assignment; false = greedy nearest neighbour
+    int minLength = 3;          // shorter tracks are dropped
+    int threads = 0;            // 0 = one per core
+};
+
+// Particles detected per frame with the blob counter's segmentation and
+// linked into tracks. Detections are stored flat in frame order, each track
+// a doubly linked chain through them, so millions of points stay compact.
+struct ParticleTrackResult {
+    struct Detection {
+        int frame = 0;          // recording frame index
+        float x = 0.0f;         // centroid, frame pixels
+        float y = 0.0f;
+        int area = 0;
+        int track = -1;         // -1 = not part of a kept track
+        int prev = -1;          // detection before and after this one on its track
+        int next = -1;
+    };
+    struct Track {
+        int head = -1;          // first and last detection
+        int tail = -1;
+        int points = 0;
+        double path = 0.0;      // summed step lengths, pixels
+        double net = 0.0;       // first-to-last distance, pixels
+        double meanSpeed = 0.0; // path / frames spanned, pixels per frame
+        double maxSpeed = 0.0;  // fastest single step, pixels per frame
+        double vx = 0.0;        // net displacement / frames spanned
+        double vy = 0.0;
+        double duration = 0.0;  // seconds, 0 without a time axis
+    };
+
+    int first = 0;
+    int last = -1;
+    QRect roi;
+    std::vector<double> times;          // seconds per frame of the range, empty without a time axis
+    std::vector<Detection> detections;  // ordered by frame
+    std::vector<int> frameStart;        // first detection of each frame of the range, plus the end
+    std::vector<Track> tracks;
+
+    bool isEmpty() const { return detections.empty(); }
+    int frames() const { return last - first + 1; }
+    QString summary() const;
+    // <base>_points.csv (one row per linked detection) and <base>_tracks.csv.
+    QString save(const QString& basePath) const;
+};
+
+class ParticleTracker {
+public:
+    using Progress = std::function<void(int done, int total)>;
+
+    // Detection runs on contiguous chunks of frames in parallel; linking is
+    // a single pass in frame order.
+    static QString run(const QString& sourcePath, const ParticleTrackOptions& opt, ParticleTrackResult& result,
+                       const Progress& progress = {}, const std::atomic<bool>* cancel = nullptr);
+    // Links result.detections (with frameStart filled in) and fills tracks.
+    static void link(ParticleTrackResult& result, const ParticleTrackOptions& opt);
+};
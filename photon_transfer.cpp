@@ -0,0 +1,303 @@
+#include "photon_transfer.h"
+#include "dcam_controller.h"
+#include "frame_processor.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <QtGui/QPainter>
+#include <QtGui/QPainterPath>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace {
+constexpr int kSettleFrames = 2;    // frames still exposed with the previous setting
+
+struct LineFit {
+    double slope = 0.0;
+    double intercept = 0.0;
+    bool ok = false;
+};
+
+LineFit leastSquares(const std::vector<double>& x, const std::vector<double>& y) {
+    LineFit f;
+    const size_t n = x.size();
+    if (n < 2) return f;
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sx += x[i];
+        sy += y[i];
+        sxx += x[i] * x[i];
+        sxy += x[i] * y[i];
+    }
+    const double det = n * sxx - sx * sx;
+    if (std::abs(det) < 1e-12) return f;
+    f.slope = (n * sxy - sx * sy) / det;
+    f.intercept = (sy - f.slope * sx) / n;
+    f.ok = true;
+    return f;
+}
+} // namespace
+
+void FramePairStats::reset(const QRect& r) {
+    roi = r;
+    pending = QImage();
+    pairCount = 0;
+    meanSum = 0.0;
+    varianceSum = 0.0;
+}
+
+void FramePairStats::add(const QImage& img, int threads) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    if (pending.isNull() || pending.size() != src.size() || pending.format() != src.format()) {
+        pending = src;
+        return;
+    }
+    const QRect r = roi.isEmpty() ? src.rect() : roi.intersected(src.rect());
+    if (r.isEmpty()) {
+        pending = QImage();
+        return;
+    }
+    quint64 sumA = 0, sumB = 0, sumSq = 0;
+    std::mutex merge;
+    parallelBands(r.height(), threads, [&](int y0, int y1) {
+        uint64_t a = 0, b = 0, sq = 0;
+        std::vector<uint16_t> wide(deep ? 0 : static_cast<size_t>(r.width()) * 2);
+        for (int y = r.top() + y0; y < r.top() + y1; ++y) {
+            const uint16_t* ra;
+            const uint16_t* rb;
+            if (deep) {
+                ra = reinterpret_cast<const uint16_t*>(pending.constScanLine(y)) + r.left();
+                rb = reinterpret_cast<const uint16_t*>(src.constScanLine(y)) + r.left();
+            } else {
+                simd::widenU8ToU16(pending.constScanLine(y) + r.left(), wide.data(), static_cast<size_t>(r.width()));
+                simd::widenU8ToU16(src.constScanLine(y) + r.left(), wide.data() + r.width(), static_cast<size_t>(r.width()));
+                ra = wide.data();
+                rb = wide.data() + r.width();
+            }
+            simd::pairStatsU16(ra, rb, static_cast<size_t>(r.width()), a, b, sq);
+        }
+        std::lock_guard<std::mutex> lk(merge);
+        sumA += a;
+        sumB += b;
+        sumSq += sq;
+    });
+    pending = QImage();
+
+    const double n = static_cast<double>(r.width()) * r.height();
+    const double meanA = sumA / n;
+    const double meanB = sumB / n;
+    // Subtracting the mean difference removes illumination drift between the two frames.
+    const double dm = meanA - meanB;
+    meanSum += 0.5 * (meanA + meanB);
+    varianceSum += std::max(0.0, 0.5 * (sumSq / n - dm * dm));
+    ++pairCount;
+}
+
+std::vector<double> PhotonTransferCurve::exposureSteps(double first_s, double last_s, int count) {
+    std::vector<double> steps;
+    if (first_s <= 0.0 || last_s < first_s || count < 1) return steps;
+    if (count == 1) return {first_s};
+    const double ratio = std::log(last_s / first_s) / (count - 1);
+    for (int i = 0; i < count; ++i) steps.push_back(first_s * std::exp(ratio * i));
+    return steps;
+}
+
+PhotonTransferCurve::Fit PhotonTransferCurve::fit(double offset) const {
+    Fit f;
+    f.offset = offset;
+    if (pointList.size() < 3) {
+        f.message = "Need at least three exposure steps";
+        return f;
+    }
+    // Past full well the variance collapses; only points below the peak
+    // belong to the shot-noise branch.
+    size_t peak = 0;
+    for (size_t i = 1; i < pointList.size(); ++i) {
+        if (pointList[i].variance > pointList[peak].variance) peak = i;
+    }
+    f.fullWellDn = pointList[peak].mean - offset;
+    const size_t end = peak + 1 == pointList.size() ? pointList.size() : peak;
+    std::vector<double> signal, variance, exposure;
+    for (size_t i = 0; i < end; ++i) {
+        const double s = pointList[i].mean - offset;
+        if (s <= 0.0) continue;
+        signal.push_back(s);
+        variance.push_back(pointList[i].variance);
+        exposure.push_back(pointList[i].exposure_s);
+    }
+    f.pointsUsed = static_cast<int>(signal.size());
+    if (signal.size() < 3) {
+        f.message = "Fewer than three steps with signal below saturation";
+        return f;
+    }
+    LineFit noise = leastSquares(signal, variance);
+    if (!noise.ok || noise.slope <= 0.0) {
+        f.message = "Variance does not grow with signal; check illumination and offset";
+        return f;
+    }
+    f.gain = 1.0 / noise.slope;
+    f.readNoiseDn = std::sqrt(std::max(0.0, noise.intercept));
+    f.readNoiseE = f.readNoiseDn * f.gain;
+
+    LineFit response = leastSquares(exposure, signal);
+    if (response.ok) {
+        f.responsivity = response.slope;
+        double worst = 0.0;
+        for (size_t i = 0; i < signal.size(); ++i) {
+            worst = std::max(worst, std::abs(signal[i] - (response.intercept + response.slope * exposure[i])));
+        }
+        f.linearityError = 100.0 * worst / *std::max_element(signal.begin(), signal.end());
+    }
+    f.ok = true;
+    return f;
+}
+
+QString PhotonTransferCurve::writeReport(const QString& basePath, const Fit& f, const QString& header) const {
+    QDir().mkpath(QFileInfo(basePath).absolutePath());
+    QFile csv(basePath + ".csv");
+    if (!csv.open(QIODevice::WriteOnly | QIODevice::Text)) return csv.errorString();
+    QTextStream cs(&csv);
+    cs << "exposure_ms,mean_dn,signal_dn,variance_dn2,noise_dn,pairs\n";
+    for (const Point& p : pointList) {
+        cs << QString::number(p.exposure_s * 1000.0, 'f', 4) << "," << QString::number(p.mean, 'f', 3) << ","
+           << QString::number(p.mean - f.offset, 'f', 3) << "," << QString::number(p.variance, 'f', 4) << ","
+           << QString::number(std::sqrt(std::max(0.0, p.variance)), 'f', 4) << "," << p.pairs << "\n";
+    }
+    csv.close();
+
+    QFile txt(basePath + ".txt");
+    if (!txt.open(QIODevice::WriteOnly | QIODevice::Text)) return txt.errorString();
+    QTextStream ts(&txt);
+    ts << header;
+    ts << "Steps: " << pointList.size() << "\n";
+    ts << "Offset (DN): " << f.offset << "\n";
+    if (!f.ok) {
+        ts << "Fit failed: " << f.message << "\n";
+    } else {
+        ts << "Conversion gain (e-/DN): " << QString::number(f.gain, 'f', 4) << "\n";
+        ts << "Read noise (DN): " << QString::number(f.readNoiseDn, 'f', 3) << "\n";
+        ts << "Read noise (e-): " << QString::number(f.readNoiseE, 'f', 3) << "\n";
+        ts << "Full well (DN / e-): " << QString::number(f.fullWellDn, 'f', 0) << " / "
+           << QString::number(f.fullWellDn * f.gain, 'f', 0) << "\n";
+        ts << "Responsivity (DN/s): " << QString::number(f.responsivity, 'f', 1) << "\n";
+        ts << "Linearity error (%): " << QString::number(f.linearityError, 'f', 2) << "\n";
+        ts << "Points in fit: " << f.pointsUsed << "\n";
+    }
+    txt.close();
+
+    // Log-log noise over signal with the fitted sqrt(read^2 + signal / gain).
+    std::vector<QPointF> pts;
+    for (const Point& p : pointList) {
+        const double s = p.mean - f.offset;
+        if (s > 0.0 && p.variance > 0.0) pts.push_back({std::log10(s), std::log10(std::sqrt(p.variance))});
+    }
+    if (pts.empty()) return {};
+    double x0 = pts.front().x(), x1 = x0, y0 = pts.front().y(), y1 = y0;
+    for (const QPointF& p : pts) {
+        x0 = std::min(x0, p.x()); x1 = std::max(x1, p.x());
+        y0 = std::min(y0, p.y()); y1 = std::max(y1, p.y());
+    }
+    x0 = std::floor(x0); x1 = std::max(x0 + 1.0, std::ceil(x1));
+    y0 = std::floor(y0); y1 = std::max(y0 + 1.0, std::ceil(y1));
+    const QRectF plot(70, 20, 560, 400);
+    auto map = [&](double lx, double ly) {
+        return QPointF(plot.left() + (lx - x0) / (x1 - x0) * plot.width(),
+                       plot.bottom() - (ly - y0) / (y1 - y0) * plot.height());
+    };
+    QImage chart(680, 480, QImage::Format_RGB32);
+    chart.fill(Qt::white);
+    QPainter p(&chart);
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setPen(QColor(220, 220, 220));
+    for (int d = static_cast<int>(x0); d <= static_cast<int>(x1); ++d) p.drawLine(map(d, y0), map(d, y1));
+    for (int d = static_cast<int>(y0); d <= static_cast<int>(y1); ++d) p.drawLine(map(x0, d), map(x1, d));
+    p.setPen(Qt::black);
+    p.drawRect(plot);
+    for (int d = static_cast<int>(x0); d <= static_cast<int>(x1); ++d) {
+        p.drawText(QRectF(map(d, y0).x() - 30, plot.bottom() + 4, 60, 16), Qt::AlignCenter, QString("1e%1").arg(d));
+    }
+    for (int d = static_cast<int>(y0); d <= static_cast<int>(y1); ++d) {
+        p.drawText(QRectF(4, map(x0, d).y() - 8, 60, 16), Qt::AlignRight | Qt::AlignVCenter, QString("1e%1").arg(d));
+    }
+    p.drawText(QRectF(plot.left(), plot.bottom() + 22, plot.width(), 16), Qt::AlignCenter, "Signal (DN)");
+    p.drawText(QRectF(plot.left(), 2, plot.width(), 16), Qt::AlignCenter,
+               f.ok ? QString("Noise (DN): gain %1 e-/DN, read noise %2 e-").arg(f.gain, 0, 'f', 3).arg(f.readNoiseE, 0, 'f', 2)
+                    : QString("Noise (DN): fit failed"));
+    if (f.ok) {
+        QPainterPath model;
+        for (int i = 0; i <= 200; ++i) {
+            const double lx = x0 + (x1 - x0) * i / 200.0;
+            const double v = f.readNoiseDn * f.readNoiseDn + std::pow(10.0, lx) / f.gain;
+            const QPointF q = map(lx, std::log10(std::sqrt(v)));
+            if (i == 0) model.moveTo(q);
+            else model.lineTo(q);
+        }
+        p.setClipRect(plot);
+        p.setPen(QPen(QColor(200, 60, 40), 1.5));
+        p.drawPath(model);
+        p.setClipping(false);
+    }
+    p.setPen(Qt::NoPen);
+    p.setBrush(QColor(30, 90, 200));
+    for (const QPointF& q : pts) p.drawEllipse(map(q.x(), q.y()), 3.5, 3.5);
+    p.end();
+    if (!chart.save(basePath + ".png", "PNG")) return "Could not write " + basePath + ".png";
+    return {};
+}
+
+PhotonTransferRun::PhotonTransferRun(DcamController* ctrl, FrameProcessor* proc, const Options& o, QObject* parent)
+    : QObject(parent), controller(ctrl), processor(proc), opt(o) {}
+
+void PhotonTransferRun::start() {
+    ptc.clear();
+    step = 0;
+    cancelled = false;
+    done = false;
+    runStep();
+}
+
+void PhotonTransferRun::cancel() {
+    if (done || cancelled) return;
+    cancelled = true;
+    // Do not wait for the pairs: the light may already be off.
+    QMetaObject::invokeMethod(this, [this]() { finish("Cancelled"); }, Qt::QueuedConnection);
+}
+
+void PhotonTransferRun::runStep() {
+    if (done) return;
+    if (step >= static_cast<int>(opt.exposures.size())) {
+        finish({});
+        return;
+    }
+    ApplySettings s = opt.base;
+    s.exposure_s = opt.exposures[step];
+    QString err = controller->apply(s);
+    if (!err.isEmpty() && !err.startsWith("WARN:")) {
+        finish(err);
+        return;
+    }
+    emit progress(step, static_cast<int>(opt.exposures.size()),
+                  QString("Exposure %1 ms: %2 pairs").arg(s.exposure_s * 1000.0, 0, 'f', 3).arg(opt.pairs));
+    QPointer<PhotonTransferRun> self(this);
+    processor->capturePairs(opt.pairs, opt.roi, kSettleFrames, [self](double mean, double variance, int pairs) {
+        QMetaObject::invokeMethod(qApp, [self, mean, variance, pairs]() {
+            if (self) self->stepDone(mean, variance, pairs);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PhotonTransferRun::stepDone(double mean, double variance, int pairs) {
+    if (done || cancelled) return;
+    ptc.add({opt.exposures[step], mean, variance, pairs});
+    ++step;
+    runStep();
+}
+
+void PhotonTransferRun::finish(const QString& error) {
+    if (done) return;
+    done = true;
+    processor->cancelPairs();
+    QString err = controller->apply(opt.base);
+    emit finished(!error.isEmpty() ? error : (err.startsWith("WARN:") ? QString() : err));
+}
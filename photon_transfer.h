@@ -0,0 +1,113 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <vector>
+#include "frame_types.h"
+
+class DcamController;
+class FrameProcessor;
+
+// Running statistics of consecutive frame pairs inside an ROI. Only the
+// first frame of the open pair is kept, so any number of pairs costs one
+// frame of memory. The variance comes from the pair difference, which
+// cancels fixed-pattern noise: var = (mean((A - B)^2) - (mean A - mean B)^2) / 2.
+class FramePairStats {
+public:
+    void reset(const QRect& roi = QRect());
+    // Feeds one frame (Grayscale8 or Grayscale16); every second frame closes
+    // a pair. The reduction runs in row bands over `threads`.
+    void add(const QImage& img, int threads);
+
+    int pairs() const { return pairCount; }
+    double mean() const { return pairCount ? meanSum / pairCount : 0.0; }
+    double variance() const { return pairCount ? varianceSum / pairCount : 0.0; }
+
+private:
+    QRect roi;              // empty = whole frame
+    QImage pending;         // first frame of the open pair
+    int pairCount = 0;
+    double meanSum = 0.0;
+    double varianceSum = 0.0;
+};
+
+// Mean / variance per exposure step and the fitted camera constants.
+class PhotonTransferCurve {
+public:
+    struct Point {
+        double exposure_s = 0.0;
+        double mean = 0.0;          // DN, offset included
+        double variance = 0.0;      // DN^2, single frame
+        int pairs = 0;
+    };
+    struct Fit {
+        bool ok = false;
+        QString message;
+        double offset = 0.0;            // DN subtracted from every mean
+        double gain = 0.0;              // e-/DN, 1 / slope of variance over signal
+        double readNoiseDn = 0.0;       // sqrt of the intercept
+        double readNoiseE = 0.0;
+        double fullWellDn = 0.0;        // signal at the variance peak
+        double responsivity = 0.0;      // DN/s from signal over exposure
+        double linearityError = 0.0;    // max deviation from the line, % of the top signal
+        int pointsUsed = 0;
+    };
+
+    // Log-spaced exposures from first to last, inclusive.
+    static std::vector<double> exposureSteps(double first_s, double last_s, int count);
+
+    void clear() { pointList.clear(); }
+    void add(const Point& p) { pointList.push_back(p); }
+    const std::vector<Point>& points() const { return pointList; }
+
+    // Least-squares line through variance over (mean - offset), on the
+    // shot-noise branch below the variance peak.
+    Fit fit(double offset) const;
+
+    // <base>.csv (per step), <base>.txt (fit) and <base>.png (log-log curve).
+    QString writeReport(const QString& basePath, const Fit& f, const QString& header) const;
+
+private:
+    std::vector<Point> pointList;
+};
+
+// Drives a photon transfer measurement on the live camera: for every
+// exposure step it calls DcamController::apply, lets the FrameProcessor
+// reduce `pairs` frame pairs on its thread, and records the point. Steps
+// are chained through queued calls, so the GUI stays responsive.
+class PhotonTransferRun : public QObject {
+    Q_OBJECT
+public:
+    struct Options {
+        ApplySettings base;             // everything but the exposure
+        std::vector<double> exposures;
+        int pairs = 16;
+        QRect roi;
+        double offset = 100.0;          // camera black level in DN
+    };
+
+    PhotonTransferRun(DcamController* controller, FrameProcessor* processor, const Options& opt,
+                      QObject* parent = nullptr);
+
+    void start();
+    // Stops after the current apply; the pairs in flight are discarded.
+    void cancel();
+    const PhotonTransferCurve& curve() const { return ptc; }
+
+signals:
+    void progress(int step, int steps, const QString& text);
+    // Empty error on success. The camera is back on the base settings.
+    void finished(const QString& error);
+
+private:
+    void runStep();
+    void stepDone(double mean, double variance, int pairs);
+    void finish(const QString& error);
+
+    DcamController* controller;
+    FrameProcessor* processor;
+    Options opt;
+    PhotonTransferCurve ptc;
+    int step = 0;
+    bool cancelled = false;
+    bool done = false;
+};
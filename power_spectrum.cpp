@@ -0,0 +1,173 @@
+#include "power_spectrum.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+std::vector<float> hann(int n) {
+    std::vector<float> w(n);
+    for (int i = 0; i < n; ++i) w[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * (i + 0.5) / n));
+    return w;
+}
+
+// Value at fraction q of a strided sample, so the cost does not grow with the window.
+uint16_t samplePercentile(const std::vector<uint16_t>& v, double q) {
+    const size_t stride = std::max<size_t>(1, v.size() / 65536);
+    std::vector<uint16_t> s;
+    s.reserve(v.size() / stride + 1);
+    for (size_t i = 0; i < v.size(); i += stride) s.push_back(v[i]);
+    auto nth = s.begin() + static_cast<std::ptrdiff_t>(q * (s.size() - 1));
+    std::nth_element(s.begin(), nth, s.end());
+    return *nth;
+}
+}
+
+PowerSpectrum::PowerSpectrum(QObject* parent)
+    : LiveAnalyzer(parent, 1), intervalMs(200), averaging(1), maxSide(512), passes(0) {
+    clock.start();
+}
+
+PowerSpectrum::~PowerSpectrum() {
+    stopAnalysis();
+}
+
+void PowerSpectrum::setRate(double hz) {
+    intervalMs = static_cast<int>(std::lround(1000.0 / std::clamp(hz, 0.1, 60.0)));
+}
+
+void PowerSpectrum::setAveraging(int n) {
+    averaging = std::max(1, n);
+}
+
+void PowerSpectrum::setMaxSide(int side) {
+    maxSide = std::clamp(side, 32, 4096);
+    reset();
+}
+
+QImage PowerSpectrum::image() const {
+    QMutexLocker lk(&resultMutex);
+    return rendered;
+}
+
+void PowerSpectrum::clearResults() {
+    averaged = 0;
+    lastPassMs = -intervalMs.load();
+    passes = 0;
+    QMutexLocker lk(&resultMutex);
+    rendered = QImage();
+}
+
+QString PowerSpectrum::benchmark(const std::vector<QSize>& sizes) {
+    QStringList lines;
+    for (const QSize& sz : sizes) {
+        const int w = FftPlan::fastSizeAtMost(sz.width());
+        const int h = FftPlan::fastSizeAtMost(sz.height());
+        RealFft2D f(w, h);
+        std::vector<float> src(static_cast<size_t>(w) * h);
+        for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<float>((i * 2654435761u) >> 20 & 1023);
+        std::vector<FftPlan::Complex> out(static_cast<size_t>(f.spectrumWidth()) * h);
+        f.forward(src.data(), out.data());     // warm caches and plans
+        // Enough repetitions for about 0.2 s at a few ns per point.
+        const int reps = std::clamp(static_cast<int>(4e7 / (static_cast<double>(w) * h)), 3, 2000);
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r) f.forward(src.data(), out.data());
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / reps;
+        lines << QString("%1 x %2: %3 ms (%4 ns/px)").arg(w).arg(h).arg(ms, 0, 'f', 3)
+                     .arg(ms * 1e6 / (static_cast<double>(w) * h), 0, 'f', 1);
+    }
+    return lines.join("\n");
+}
+
+bool PowerSpectrum::wants() {
+    const qint64 now = clock.elapsed();
+    if (now - lastPassMs < intervalMs.load()) return false;
+    lastPassMs = now;
+    return true;
+}
+
+void PowerSpectrum::analyze(const QImage& img, const FrameMeta&, const QRect& roi) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    const int cap = maxSide.load();
+    const int w = FftPlan::fastSizeAtMost(std::min(roi.width(), cap));
+    const int h = FftPlan::fastSizeAtMost(std::min(roi.height(), cap));
+    if (w < 8 || h < 8) return;
+    const QRect window(roi.left() + (roi.width() - w) / 2, roi.top() + (roi.height() - h) / 2, w, h);
+    if (fft.width() != w || fft.height() != h) {
+        fft = RealFft2D(w, h);
+        hannX = hann(w);
+        hannY = hann(h);
+        pixels.resize(static_cast<size_t>(w) * h);
+        scratch.resize(static_cast<size_t>(w));
+        spectrum.resize(static_cast<size_t>(fft.spectrumWidth()) * h);
+        power.assign(spectrum.size(), 0.0f);
+        levels.resize(pixels.size());
+        averaged = 0;
+    }
+
+    double sum = 0.0;
+    for (int y = 0; y < h; ++y) {
+        const uint16_t* row = nullptr;
+        if (deep) {
+            row = reinterpret_cast<const uint16_t*>(src.constScanLine(window.top() + y)) + window.left();
+        } else {
+            simd::widenU8ToU16(src.constScanLine(window.top() + y) + window.left(), scratch.data(), static_cast<size_t>(w));
+            row = scratch.data();
+        }
+        float* dst = pixels.data() + static_cast<size_t>(y) * w;
+        simd::widenU16ToF32(row, dst, static_cast<size_t>(w));
+        for (int x = 0; x < w; ++x) sum += dst[x];
+    }
+    // Without the mean and the taper, DC and the window edges would swamp the display.
+    const float mean = static_cast<float>(sum / pixels.size());
+    for (int y = 0; y < h; ++y) {
+        float* row = pixels.data() + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; ++x) row[x] = (row[x] - mean) * hannX[x] * hannY[y];
+    }
+    fft.forward(pixels.data(), spectrum.data());
+
+    averaged = std::min(averaged + 1, averaging.load());
+    const float alpha = 1.0f / averaged;
+    for (size_t i = 0; i < spectrum.size(); ++i) power[i] += alpha * (std::norm(spectrum[i]) - power[i]);
+    render();
+    ++passes;
+}
+
+void PowerSpectrum::render() {
+    const int w = fft.width();
+    const int h = fft.height();
+    const int hw = fft.spectrumWidth();
+    // Log power to 16 bits over its full range, then the display window
+    // from the 1st and 99.9th percentiles of that.
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    std::vector<float> logs(power.size());
+    for (size_t i = 0; i < power.size(); ++i) {
+        logs[i] = std::log10(power[i] + 1e-6f);
+        lo = std::min(lo, logs[i]);
+        hi = std::max(hi, logs[i]);
+    }
+    const float scale = hi > lo ? 65535.0f / (hi - lo) : 0.0f;
+    for (int y = 0; y < h; ++y) {
+        // Row y shows ky = y - h/2; the left half mirrors through the origin.
+        const int ky = y - h / 2;
+        uint16_t* out = levels.data() + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; ++x) {
+            const int kx = x - w / 2;
+            const size_t idx = kx >= 0 ? static_cast<size_t>((ky + h) % h) * hw + kx
+                                       : static_cast<size_t>((h - ky) % h) * hw + (-kx);
+            out[x] = static_cast<uint16_t>((logs[idx] - lo) * scale + 0.5f);
+        }
+    }
+    const int black = samplePercentile(levels, 0.01);
+    const int white = std::max(black + 1, static_cast<int>(samplePercentile(levels, 0.999)));
+    QImage out(w, h, QImage::Format_Grayscale8);
+    for (int y = 0; y < h; ++y) {
+        simd::windowU16ToU8(levels.data() + static_cast<size_t>(y) * w, out.scanLine(y), static_cast<size_t>(w), black, white);
+    }
+    QMutexLocker lk(&resultMutex);
+    rendered = out;
+}
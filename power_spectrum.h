@@ -0,0 +1,59 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <vector>
+#include "fft.h"
+#include "live_analyzer.h"
+
+// Live 2D power spectrum of the frame or ROI, for spotting vibration lines,
+// fixed-pattern noise and the loss of high frequencies out of focus. At most
+// rate() passes a second run on this thread. Each pass Hann-tapers the
+// largest fast-FFT-sized window of the ROI, optionally averages the power
+// with earlier passes, and renders log power with DC in the centre through
+// the same 16-bit window/level path as the live display.
+class PowerSpectrum : public LiveAnalyzer {
+    Q_OBJECT
+public:
+    explicit PowerSpectrum(QObject* parent=nullptr);
+    ~PowerSpectrum() override;
+
+    void setRate(double hz);
+    // Exponential average over about `passes` spectra; 1 shows each alone.
+    void setAveraging(int passes);
+    void setMaxSide(int side);
+
+    // Grayscale8, window-sized; null before the first pass.
+    QImage image() const;
+    qint64 spectra() const { return passes.load(); }
+
+    // Milliseconds per forward real 2D FFT at each size, one line each.
+    static QString benchmark(const std::vector<QSize>& sizes);
+
+protected:
+    bool wants() override;
+    void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) override;
+    void clearResults() override;
+
+private:
+    void render();
+
+    std::atomic<int> intervalMs;
+    std::atomic<int> averaging;
+    std::atomic<int> maxSide;
+    std::atomic<qint64> passes;
+    mutable QMutex resultMutex;
+    QImage rendered;
+
+    // Analysis thread only.
+    QElapsedTimer clock;
+    qint64 lastPassMs = 0;
+    RealFft2D fft;
+    std::vector<float> hannX, hannY;
+    std::vector<float> pixels;
+    std::vector<uint16_t> scratch;
+    std::vector<FftPlan::Complex> spectrum;
+    std::vector<float> power;           // half spectrum, averaged
+    int averaged = 0;
+    std::vector<uint16_t> levels;       // full, centred, log-scaled
+};
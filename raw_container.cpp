@@ -0,0 +1,150 @@
+#include "raw_container.h"
+#include <cstring>
+
+namespace {
+const char kMagic[8] = {'D','C','R','A','W','0','1','\0'};
+
+template <typename T>
+void put(QByteArray& buf, T v) {
+    T le = qToLittleEndian(v);
+    buf.append(reinterpret_cast<const char*>(&le), sizeof(T));
+}
+
+template <typename T>
+T get(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return qFromLittleEndian(v);
+}
+} // namespace
+
+RawContainerWriter::~RawContainerWriter() {
+    close();
+}
+
+QString RawContainerWriter::open(const QString& path, int w, int h, int bitsPerPixel) {
+    close();
+    if (w <= 0 || h <= 0 || (bitsPerPixel != 8 && bitsPerPixel != 16)) return "Invalid container geometry";
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return QString("Cannot open %1: %2").arg(path, file.errorString());
+    }
+    width = w;
+    height = h;
+    bits = bitsPerPixel;
+    QByteArray hdr(kMagic, sizeof(kMagic));
+    put<quint32>(hdr, RawContainerReader::kHeaderBytes);
+    put<quint32>(hdr, static_cast<quint32>(width));
+    put<quint32>(hdr, static_cast<quint32>(height));
+    put<quint32>(hdr, static_cast<quint32>(bits));
+    put<quint64>(hdr, static_cast<quint64>(width) * height * (bits / 8));
+    hdr.append(QByteArray(RawContainerReader::kHeaderBytes - hdr.size(), '\0'));
+    if (file.write(hdr) != hdr.size()) return "Container header write failed";
+    file.flush();
+    endPos = hdr.size();
+    return {};
+}
+
+QString RawContainerWriter::append(const QImage& img, qint64 framestamp, double timeSec) {
+    if (!file.isOpen()) return "Container not open";
+    QImage::Format fmt = bits == 16 ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8;
+    QImage src = img.format() == fmt ? img : img.convertToFormat(fmt);
+    if (src.width() != width || src.height() != height) return "Frame size does not match container";
+
+    QByteArray rec;
+    put<qint64>(rec, framestamp);
+    put<double>(rec, timeSec);
+    if (file.write(rec) != rec.size()) return "Container write failed";
+    const qint64 rowBytes = static_cast<qint64>(width) * (bits / 8);
+    for (int y = 0; y < height; ++y) {
+        if (file.write(reinterpret_cast<const char*>(src.constScanLine(y)), rowBytes) != rowBytes) {
+            return "Container write failed";
+        }
+    }
+    // Flush per record so readers following the file never see a torn count.
+    file.flush();
+    endPos += rec.size() + rowBytes * height;
+    return {};
+}
+
+QString RawContainerWriter::close() {
+    if (!file.isOpen()) return {};
+    file.close();
+    if (file.error() != QFileDevice::NoError) return file.errorString();
+    return {};
+}
+
+QString RawContainerReader::open(const QString& path) {
+    *this = RawContainerReader();
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return QString("Cannot open %1: %2").arg(path, f.errorString());
+    QByteArray hdr = f.read(kHeaderBytes);
+    if (hdr.size() < kHeaderBytes || std::memcmp(hdr.constData(), kMagic, sizeof(kMagic)) != 0) {
+        return "Not a .dcraw container";
+    }
+    const char* p = hdr.constData() + sizeof(kMagic);
+    quint32 headerBytes = get<quint32>(p);
+    int w = static_cast<int>(get<quint32>(p + 4));
+    int h = static_cast<int>(get<quint32>(p + 8));
+    int b = static_cast<int>(get<quint32>(p + 12));
+    qint64 fb = static_cast<qint64>(get<quint64>(p + 16));
+    if (headerBytes != kHeaderBytes || w <= 0 || h <= 0 || (b != 8 && b != 16) ||
+        fb != static_cast<qint64>(w) * h * (b / 8)) {
+        return "Unsupported .dcraw header";
+    }
+    filePath = path;
+    width = w;
+    height = h;
+    bits = b;
+    frameBytes = fb;
+    refresh();
+    return {};
+}
+
+int RawContainerReader::refresh() {
+    if (!isOpen()) return 0;
+    qint64 size = QFileInfo(filePath).size();
+    frames = static_cast<int>(std::max<qint64>(0, size - kHeaderBytes) / recordBytes());
+    return frames;
+}
+
+QImage RawContainerReader::read(int index, QString* error) const {
+    if (index < 0 || index >= frames) {
+        if (error) *error = "Frame index out of range";
+        return {};
+    }
+    QFile f(filePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = f.errorString();
+        return {};
+    }
+    QImage img(width, height, bits == 16 ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+    const qint64 rowBytes = static_cast<qint64>(width) * (bits / 8);
+    f.seek(kHeaderBytes + index * recordBytes() + kRecordHeaderBytes);
+    if (img.bytesPerLine() == rowBytes) {
+        if (f.read(reinterpret_cast<char*>(img.bits()), frameBytes) != frameBytes) {
+            if (error) *error = "Short read";
+            return {};
+        }
+    } else {
+        for (int y = 0; y < height; ++y) {
+            if (f.read(reinterpret_cast<char*>(img.scanLine(y)), rowBytes) != rowBytes) {
+                if (error) *error = "Short read";
+                return {};
+            }
+        }
+    }
+    return img;
+}
+
+void RawContainerReader::readTimes(int first, std::vector<double>& times, std::vector<qint64>& stamps) const {
+    QFile f(filePath);
+    if (!f.open(QIODevice::ReadOnly)) return;
+    char rec[kRecordHeaderBytes];
+    for (int i = std::max(0, first); i < frames; ++i) {
+        f.seek(kHeaderBytes + i * recordBytes());
+        if (f.read(rec, kRecordHeaderBytes) != kRecordHeaderBytes) break;
+        stamps.push_back(get<qint64>(rec));
+        times.push_back(get<double>(rec + 8));
+    }
+}
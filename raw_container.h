@@ -0,0 +1,60 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <vector>
+
+// Fixed-record frame container (.dcraw). A 64-byte header is followed by
+// frames of identical size, each prefixed by its framestamp and timestamp:
+//
+//   header:  "DCRAW01\0" | u32 headerBytes | u32 width | u32 height |
+//            u32 bitsPerPixel (8/16) | u64 frameBytes | reserved
+//   record:  i64 framestamp | f64 time_s | frameBytes of packed pixels
+//
+// Frames are only ever appended, so a reader derives the frame count from
+// the file size and can follow a file that is still being written.
+class RawContainerWriter {
+public:
+    ~RawContainerWriter();
+
+    QString open(const QString& path, int width, int height, int bitsPerPixel);
+    QString append(const QImage& img, qint64 framestamp, double timeSec);
+    QString close();
+    qint64 bytesWritten() const { return endPos; }
+
+private:
+    QFile file;
+    int width = 0;
+    int height = 0;
+    int bits = 8;
+    qint64 endPos = 0;
+};
+
+class RawContainerReader {
+public:
+    static constexpr int kHeaderBytes = 64;
+    static constexpr int kRecordHeaderBytes = 16;
+
+    QString open(const QString& path);
+    // Re-reads the file size; returns the new frame count.
+    int refresh();
+
+    bool isOpen() const { return width > 0; }
+    int count() const { return frames; }
+    int frameWidth() const { return width; }
+    int frameHeight() const { return height; }
+    int bitsPerPixel() const { return bits; }
+
+    // Thread-safe: every call uses its own file handle.
+    QImage read(int index, QString* error=nullptr) const;
+    void readTimes(int first, std::vector<double>& times, std::vector<qint64>& stamps) const;
+
+private:
+    qint64 recordBytes() const { return kRecordHeaderBytes + frameBytes; }
+
+    QString filePath;
+    int width = 0;
+    int height = 0;
+    int bits = 8;
+    qint64 frameBytes = 0;
+    int frames = 0;
+};
@@ -0,0 +1,206 @@
+#include "sequence_exporter.h"
+#include "frame_sequence.h"
+#include "ordered_pipeline.h"
+#include "raw_container.h"
+#include "simd_kernels.h"
+#include "tiff_writer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+struct EncodedFrame {
+    QImage image;   // empty when the worker already wrote its own file
+    QString error;
+};
+
+QImage toGray(const QImage& img) {
+    if (img.format() == QImage::Format_Grayscale8 || img.format() == QImage::Format_Grayscale16) return img;
+    return img.convertToFormat(img.depth() == 16 ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+}
+} // namespace
+
+QString SequenceExporter::formatName(ExportOptions::Format f) {
+    switch (f) {
+    case ExportOptions::Format::TiffSequence: return "tiff";
+    case ExportOptions::Format::MultiPageTiff: return "multitiff";
+    case ExportOptions::Format::RawContainer: return "raw";
+    }
+    return {};
+}
+
+bool SequenceExporter::parseFormat(const QString& name, ExportOptions::Format& f) {
+    QString n = name.trimmed().toLower();
+    if (n == "tiff" || n == "tif") f = ExportOptions::Format::TiffSequence;
+    else if (n == "multitiff" || n == "bigtiff") f = ExportOptions::Format::MultiPageTiff;
+    else if (n == "raw" || n == "dcraw") f = ExportOptions::Format::RawContainer;
+    else return false;
+    return true;
+}
+
+int SequenceExporter::frameCount(const ExportOptions& opt, int sourceCount) {
+    if (sourceCount <= 0) return 0;
+    int first = std::clamp(opt.first, 0, sourceCount - 1);
+    int last = opt.last < 0 ? sourceCount - 1 : std::clamp(opt.last, first, sourceCount - 1);
+    return (last - first) / std::max(1, opt.step) + 1;
+}
+
+QImage SequenceExporter::transform(const QImage& src, const QRect& roi, bool applyWindow, int black, int white) {
+    if (src.isNull()) return {};
+    QImage img = toGray(src);
+    if (!roi.isEmpty()) {
+        QRect r = roi.intersected(img.rect());
+        if (r.isEmpty()) return {};
+        if (r != img.rect()) img = img.copy(r);
+    }
+    if (!applyWindow) return img;
+
+    QImage out(img.size(), QImage::Format_Grayscale8);
+    if (img.format() == QImage::Format_Grayscale16) {
+        for (int y = 0; y < img.height(); ++y) {
+            simd::windowU16ToU8(reinterpret_cast<const uint16_t*>(img.constScanLine(y)), out.scanLine(y),
+                                static_cast<size_t>(img.width()), black, white);
+        }
+    } else {
+        uchar lut[256];
+        double scale = 255.0 / std::max(1, white - black);
+        for (int v = 0; v < 256; ++v) {
+            lut[v] = static_cast<uchar>(std::clamp(static_cast<int>(std::lround((v - black) * scale)), 0, 255));
+        }
+        for (int y = 0; y < img.height(); ++y) {
+            const uchar* s = img.constScanLine(y);
+            uchar* d = out.scanLine(y);
+            for (int x = 0; x < img.width(); ++x) d[x] = lut[s[x]];
+        }
+    }
+    return out;
+}
+
+QString SequenceExporter::run(const QString& sourcePath, const ExportOptions& opt,
+                              const Progress& progress, const std::atomic<bool>* cancel) {
+    FrameSequence src(64);
+    QString err = src.open(sourcePath);
+    if (!err.isEmpty()) return err;
+    if (!src.isOpen()) return "No frames in " + sourcePath;
+    if (opt.outputPath.isEmpty()) return "No output path";
+
+    const int n = src.count();
+    const int first = std::clamp(opt.first, 0, n - 1);
+    const int step = std::max(1, opt.step);
+    const int total = frameCount(opt, n);
+    const int threads = opt.threads > 0 ? opt.threads : std::max(1, QThread::idealThreadCount());
+    auto sourceIndex = [first, step](int k){ return first + k * step; };
+
+    // Probe the first frame for the output geometry and depth.
+    auto load = [&](int idx, QString* readErr) -> QImage {
+        QImage img = src.read(idx, readErr);
+        if (img.isNull() || !opt.filter) return img;
+        img = toGray(img);
+        QString filterErr = opt.filter(idx, img);
+        if (filterErr.isEmpty()) return img;
+        if (readErr) *readErr = filterErr;
+        return {};
+    };
+    QImage probe = transform(load(first, &err), opt.roi, opt.applyWindow, opt.black, opt.white);
+    if (probe.isNull()) return err.isEmpty() ? "ROI does not intersect the frame" : err;
+    const int bits = probe.format() == QImage::Format_Grayscale16 ? 16 : 8;
+    const qint64 frameBytes = static_cast<qint64>(probe.width()) * probe.height() * (bits / 8);
+
+    // Writers and sidecars. TIFF sequences keep the capture folder layout so
+    // the result opens in the viewer like a fresh recording.
+    const bool toFolder = opt.format == ExportOptions::Format::TiffSequence;
+    QString indexPath;
+    QString infoPath;
+    if (toFolder) {
+        QDir().mkpath(opt.outputPath);
+        indexPath = QDir(opt.outputPath).filePath("frame_index.csv");
+        infoPath = QDir(opt.outputPath).filePath("capture_info.txt");
+    } else {
+        QDir().mkpath(QFileInfo(opt.outputPath).absolutePath());
+        indexPath = FrameSequence::sidecarPath(opt.outputPath, "_index.csv");
+        infoPath = FrameSequence::sidecarPath(opt.outputPath, "_info.txt");
+    }
+
+    TiffWriter tiff;
+    RawContainerWriter raw;
+    if (opt.format == ExportOptions::Format::MultiPageTiff) {
+        // Classic TIFF offsets are 32-bit; switch to BigTIFF well before that.
+        bool big = frameBytes * total > (3LL << 30);
+        err = tiff.open(opt.outputPath, big);
+    } else if (opt.format == ExportOptions::Format::RawContainer) {
+        err = raw.open(opt.outputPath, probe.width(), probe.height(), bits);
+    }
+    if (!err.isEmpty()) return err;
+
+    QFile indexFile(indexPath);
+    QTextStream indexTs(&indexFile);
+    if (opt.format != ExportOptions::Format::RawContainer &&
+        indexFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        indexTs << "index,framestamp,time_s\n";
+    }
+
+    const FrameTimeline& tl = src.timeline();
+    const int width = std::max(6, static_cast<int>(std::ceil(std::log10(std::max(1, total)))));
+    const QString outDir = opt.outputPath;
+    const int progressEvery = std::max(1, total / 200);
+    QElapsedTimer timer;
+    timer.start();
+
+    auto produce = [&](int k) -> EncodedFrame {
+        QString readErr;
+        int idx = sourceIndex(k);
+        QImage img = transform(load(idx, &readErr), opt.roi, opt.applyWindow, opt.black, opt.white);
+        if (img.isNull()) return {QImage(), QString("Frame %1: %2").arg(idx).arg(readErr)};
+        if (img.size() != probe.size()) return {QImage(), QString("Frame %1 has a different size").arg(idx)};
+        if (toFolder) {
+            // Per-file encode runs on the worker; the writer only records the index.
+            QString path = QString("%1/%2.tiff").arg(outDir).arg(k, width, 10, QChar('0'));
+            QString writeErr = TiffWriter::writeSingle(path, img);
+            return {QImage(), writeErr};
+        }
+        return {img, {}};
+    };
+
+    auto consume = [&](int k, EncodedFrame&& f) -> bool {
+        if (!f.error.isEmpty()) {
+            err = f.error;
+            return false;
+        }
+        int idx = sourceIndex(k);
+        double t = tl.timeAt(idx);
+        qint64 stamp = tl.framestampAt(idx);
+        if (opt.format == ExportOptions::Format::MultiPageTiff) err = tiff.appendPage(f.image);
+        else if (opt.format == ExportOptions::Format::RawContainer) err = raw.append(f.image, stamp, t);
+        if (!err.isEmpty()) return false;
+        if (indexFile.isOpen()) {
+            indexTs << k << "," << stamp << "," << QString::number(t, 'f', 6) << "\n";
+        }
+        if (progress && (k % progressEvery == 0 || k + 1 == total)) progress(k + 1, total);
+        return true;
+    };
+
+    bool ok = runOrderedPipeline<EncodedFrame>(total, threads, threads * 4, produce, consume, cancel);
+    indexTs.flush();
+    indexFile.close();
+    QString closeErr = tiff.close();
+    if (closeErr.isEmpty()) closeErr = raw.close();
+    if (!ok) return err.isEmpty() ? "Export cancelled" : err;
+    if (!closeErr.isEmpty()) return closeErr;
+
+    QFile infoFile(infoPath);
+    if (infoFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QTextStream ts(&infoFile);
+        ts << "Source: " << src.path() << "\n";
+        ts << "Frames: " << total << "\n";
+        ts << "Resolution: " << probe.width() << " x " << probe.height() << "\n";
+        ts << "Bits: " << bits << "\n";
+        if (src.fps() > 0.0) ts << "Internal FPS: " << src.fps() / step << "\n";
+        ts << "Range: " << first << " - " << sourceIndex(total - 1) << " step " << step << "\n";
+        if (!opt.roi.isEmpty()) {
+            ts << "ROI: " << opt.roi.x() << "," << opt.roi.y() << "," << opt.roi.width() << "," << opt.roi.height() << "\n";
+        }
+        if (opt.applyWindow) ts << "Window: " << opt.black << " - " << opt.white << "\n";
+    }
+    qInfo() << "Export" << formatName(opt.format) << total << "frames to" << opt.outputPath
+            << "in" << timer.elapsed() << "ms using" << threads << "threads";
+    return {};
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <functional>
+
+class FrameSequence;
+
+struct ExportOptions {
+    enum class Format { TiffSequence, MultiPageTiff, RawContainer };
+
+    Format format = Format::TiffSequence;
+    QString outputPath;      // folder for TIFF sequences, file otherwise
+    int first = 0;
+    int last = -1;           // inclusive, -1 = last frame
+    int step = 1;            // decimation: keep every Nth frame
+    QRect roi;               // empty = full frame
+    bool applyWindow = false;// reduce to 8 bits through a window/level LUT
+    int black = 0;
+    int white = 65535;
+    int threads = 0;         // 0 = one per core
+    // Optional per-frame correction of the full grayscale frame, before
+    // cropping and windowing. Called concurrently from the worker threads
+    // with the source index; returns an error or an empty string.
+    std::function<QString(int index, QImage& frame)> filter;
+};
+
+// Pipelined subrange export / transcoding. Worker threads decode, crop,
+// window and encode frames; a single writer commits them in order.
+class SequenceExporter {
+public:
+    using Progress = std::function<void(int done, int total)>;
+
+    static QString run(const QString& sourcePath, const ExportOptions& opt,
+                       const Progress& progress = {}, const std::atomic<bool>* cancel = nullptr);
+
+    // Crop + optional window/level, shared with the other exporters.
+    static QImage transform(const QImage& src, const QRect& roi, bool applyWindow, int black, int white);
+    static int frameCount(const ExportOptions& opt, int sourceCount);
+    static QString formatName(ExportOptions::Format f);
+    static bool parseFormat(const QString& name, ExportOptions::Format& f);
+};
@@ -0,0 +1,920 @@
+#include "simd_kernels.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace simd {
+
+void absDiffU8(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), d);
+    }
+#endif
+    for (; i < n; ++i) out[i] = static_cast<uint8_t>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+}
+
+void absDiffU16(const uint16_t* a, const uint16_t* b, uint16_t* out, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    for (; i + 8 <= n; i += 8) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), d);
+    }
+#endif
+    for (; i < n; ++i) out[i] = static_cast<uint16_t>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+}
+
+void windowU16ToU8(const uint16_t* src, uint8_t* dst, size_t n, int black, int white) {
+    if (white <= black) white = black + 1;
+    const float scale = 255.0f / static_cast<float>(white - black);
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vblack = _mm_set1_epi16(static_cast<short>(static_cast<uint16_t>(black)));
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_subs_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), vblack);
+        __m128i b = _mm_subs_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8)), vblack);
+        __m128i a0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(a, zero)), vscale));
+        __m128i a1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(a, zero)), vscale));
+        __m128i b0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero)), vscale));
+        __m128i b1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(b, zero)), vscale));
+        // packs saturates to int16, packus clamps to [0, 255]
+        __m128i out = _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(b0, b1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+#endif
+    for (; i < n; ++i) {
+        int v = static_cast<int>(src[i]) - black;
+        float f = v <= 0 ? 0.0f : v * scale;
+        dst[i] = static_cast<uint8_t>(f >= 255.0f ? 255 : static_cast<int>(f + 0.5f));
+    }
+}
+
+void downsample2xU8(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+    const __m128i two = _mm_set1_epi16(2);
+    // Even + odd bytes of each 16-bit lane give the horizontal pair sums.
+    auto pairSums = [&](const uint8_t* p) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        return _mm_add_epi16(_mm_and_si128(v, lowBytes), _mm_srli_epi16(v, 8));
+    };
+    for (; i + 16 <= n; i += 16) {
+        const size_t s = 2 * i;
+        __m128i lo = _mm_add_epi16(pairSums(row0 + s), pairSums(row1 + s));
+        __m128i hi = _mm_add_epi16(pairSums(row0 + s + 16), pairSums(row1 + s + 16));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        const size_t s = 2 * i;
+        dst[i] = static_cast<uint8_t>((row0[s] + row0[s + 1] + row1[s] + row1[s + 1] + 2) >> 2);
+    }
+}
+
+void accumulateU16(uint32_t* acc, const uint16_t* add, const uint16_t* sub, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i));
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i + 4));
+        lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(a, zero));
+        hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(a, zero));
+        if (sub) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i));
+            lo = _mm_sub_epi32(lo, _mm_unpacklo_epi16(s, zero));
+            hi = _mm_sub_epi32(hi, _mm_unpackhi_epi16(s, zero));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i + 4), hi);
+    }
+#endif
+    for (; i < n; ++i) acc[i] += add[i] - (sub ? sub[i] : 0u);
+}
+
+void emaU16(float* acc, const uint16_t* src, size_t n, float alpha) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 va = _mm_set1_ps(alpha);
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128 x0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(s, zero));
+        __m128 x1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(s, zero));
+        __m128 a0 = _mm_loadu_ps(acc + i);
+        __m128 a1 = _mm_loadu_ps(acc + i + 4);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(va, _mm_sub_ps(x0, a0)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(va, _mm_sub_ps(x1, a1)));
+        _mm_storeu_ps(acc + i, a0);
+        _mm_storeu_ps(acc + i + 4, a1);
+    }
+#endif
+    for (; i < n; ++i) acc[i] += alpha * (static_cast<float>(src[i]) - acc[i]);
+}
+
+void maxU16(uint16_t* acc, const uint16_t* src, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    // SSE2 has no unsigned 16-bit max: max(a, b) = a + sat(b - a).
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_add_epi16(a, _mm_subs_epu16(b, a)));
+    }
+#endif
+    for (; i < n; ++i) acc[i] = src[i] > acc[i] ? src[i] : acc[i];
+}
+
+#ifdef SIMD_SSE2
+namespace {
+// Four non-negative int32 lanes x2 to eight saturated uint16 lanes. SSE2 only
+// has a signed 32->16 pack, so bias into the signed range and back.
+inline __m128i packU32ToU16(__m128i lo, __m128i hi) {
+    const __m128i limit = _mm_set1_epi32(65535);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    auto clampLane = [&](__m128i v) {
+        __m128i over = _mm_cmpgt_epi32(v, limit);
+        v = _mm_or_si128(_mm_andnot_si128(over, v), _mm_and_si128(over, limit));
+        return _mm_sub_epi32(v, bias32);
+    };
+    return _mm_add_epi16(_mm_packs_epi32(clampLane(lo), clampLane(hi)), bias16);
+}
+} // namespace
+#endif
+
+void scaleU32ToU16(const uint32_t* src, uint16_t* dst, size_t n, float scale) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+        // Sums stay below 2^31 (at most 32768 frames of 16 bits), so the
+        // signed conversion is exact enough.
+        __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        __m128 b = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)));
+        __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(a, vs));
+        __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(b, vs));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packU32ToU16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        float v = static_cast<float>(src[i]) * scale + 0.5f;
+        dst[i] = static_cast<uint16_t>(v >= 65535.0f ? 65535 : static_cast<int>(v));
+    }
+}
+
+void floatToU16(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = _mm_cvtps_epi32(_mm_max_ps(_mm_loadu_ps(src + i), zero));
+        __m128i hi = _mm_cvtps_epi32(_mm_max_ps(_mm_loadu_ps(src + i + 4), zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packU32ToU16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        float v = src[i] <= 0.0f ? 0.0f : src[i] + 0.5f;
+        dst[i] = static_cast<uint16_t>(v >= 65535.0f ? 65535 : static_cast<int>(v));
+    }
+}
+
+void widenU8ToU16(const uint8_t* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i];
+}
+
+void ewVarianceU16(float* mean, float* var, const uint16_t* src, size_t n, float alpha) {
+    const float keep = 1.0f - alpha;
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 a = _mm_set1_ps(alpha);
+    const __m128 k = _mm_set1_ps(keep);
+    auto step = [&](__m128 x, size_t j) {
+        __m128 m = _mm_loadu_ps(mean + j);
+        __m128 d = _mm_sub_ps(x, m);
+        __m128 ad = _mm_mul_ps(a, d);
+        _mm_storeu_ps(mean + j, _mm_add_ps(m, ad));
+        __m128 v = _mm_add_ps(_mm_loadu_ps(var + j), _mm_mul_ps(ad, d));
+        _mm_storeu_ps(var + j, _mm_mul_ps(k, v));
+    };
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        step(_mm_cvtepi32_ps(_mm_unpacklo_epi16(s, zero)), i);
+        step(_mm_cvtepi32_ps(_mm_unpackhi_epi16(s, zero)), i + 4);
+    }
+#endif
+    for (; i < n; ++i) {
+        const float d = static_cast<float>(src[i]) - mean[i];
+        mean[i] += alpha * d;
+        var[i] = keep * (var[i] + alpha * d * d);
+    }
+}
+
+void stdDevToU8(const float* var, uint8_t* dst, size_t n, float scale) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(255.0f);
+    for (; i + 16 <= n; i += 16) {
+        __m128i q[4];
+        for (int j = 0; j < 4; ++j) {
+            __m128 v = _mm_max_ps(_mm_loadu_ps(var + i + 4 * j), zero);
+            q[j] = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(_mm_sqrt_ps(v), s), top));
+        }
+        __m128i lo = _mm_packs_epi32(q[0], q[1]);
+        __m128i hi = _mm_packs_epi32(q[2], q[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        float v = std::sqrt(var[i] > 0.0f ? var[i] : 0.0f) * scale + 0.5f;
+        dst[i] = static_cast<uint8_t>(v >= 255.0f ? 255 : static_cast<int>(v));
+    }
+}
+
+void calibrateU16(const uint16_t* src, const float* dark, const float* gain, uint16_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 fzero = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128 a = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(s, zero)), _mm_loadu_ps(dark + i));
+        __m128 b = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(s, zero)), _mm_loadu_ps(dark + i + 4));
+        // Clamp below zero before converting so the pack never sees INT_MIN.
+        a = _mm_max_ps(_mm_mul_ps(a, _mm_loadu_ps(gain + i)), fzero);
+        b = _mm_max_ps(_mm_mul_ps(b, _mm_loadu_ps(gain + i + 4)), fzero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packU32ToU16(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+#endif
+    for (; i < n; ++i) {
+        float v = (static_cast<float>(src[i]) - dark[i]) * gain[i];
+        v = v <= 0.0f ? 0.0f : v + 0.5f;
+        dst[i] = static_cast<uint16_t>(v >= 65535.0f ? 65535 : static_cast<int>(v));
+    }
+}
+
+void pairStatsU16(const uint16_t* a, const uint16_t* b, size_t n,
+                  uint64_t& sumA, uint64_t& sumB, uint64_t& sumSqDiff) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowMask = _mm_set_epi32(0, -1, 0, -1);
+    // 32-bit lanes take at most 2 * 65535 per step, so flush the pixel sums
+    // every 4096 steps; squared differences go straight to 64-bit lanes.
+    while (i + 8 <= n) {
+        __m128i accA = zero, accB = zero, accSq = zero;
+        const size_t blockEnd = std::min(n - (n - i) % 8, i + 8 * 4096);
+        for (; i < blockEnd; i += 8) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i a0 = _mm_unpacklo_epi16(va, zero), a1 = _mm_unpackhi_epi16(va, zero);
+            __m128i b0 = _mm_unpacklo_epi16(vb, zero), b1 = _mm_unpackhi_epi16(vb, zero);
+            accA = _mm_add_epi32(accA, _mm_add_epi32(a0, a1));
+            accB = _mm_add_epi32(accB, _mm_add_epi32(b0, b1));
+            // |a - b| fits 16 bits; mul_epu32 squares the even lanes to 64 bits.
+            __m128i d = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+            __m128i d0 = _mm_unpacklo_epi16(d, zero), d1 = _mm_unpackhi_epi16(d, zero);
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(d0, d0));
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(_mm_srli_epi64(d0, 32), _mm_srli_epi64(d0, 32)));
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(d1, d1));
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(_mm_srli_epi64(d1, 32), _mm_srli_epi64(d1, 32)));
+        }
+        alignas(16) uint64_t lanes[6];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(_mm_and_si128(accA, lowMask),
+                                                                          _mm_and_si128(_mm_srli_epi64(accA, 32), lowMask)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 2), _mm_add_epi64(_mm_and_si128(accB, lowMask),
+                                                                              _mm_and_si128(_mm_srli_epi64(accB, 32), lowMask)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 4), accSq);
+        sumA += lanes[0] + lanes[1];
+        sumB += lanes[2] + lanes[3];
+        sumSqDiff += lanes[4] + lanes[5];
+    }
+#endif
+    for (; i < n; ++i) {
+        sumA += a[i];
+        sumB += b[i];
+        const int64_t d = static_cast<int64_t>(a[i]) - b[i];
+        sumSqDiff += static_cast<uint64_t>(d * d);
+    }
+}
+
+void momentsU16(const uint16_t* a, size_t n, uint64_t& sum, uint64_t& sumSq) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowMask = _mm_set_epi32(0, -1, 0, -1);
+    while (i + 8 <= n) {
+        __m128i acc = zero, accSq = zero;
+        const size_t blockEnd = std::min(n - (n - i) % 8, i + 8 * 4096);
+        for (; i < blockEnd; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i v0 = _mm_unpacklo_epi16(v, zero), v1 = _mm_unpackhi_epi16(v, zero);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(v0, v1));
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(v0, v0));
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(_mm_srli_epi64(v0, 32), _mm_srli_epi64(v0, 32)));
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(v1, v1));
+            accSq = _mm_add_epi64(accSq, _mm_mul_epu32(_mm_srli_epi64(v1, 32), _mm_srli_epi64(v1, 32)));
+        }
+        alignas(16) uint64_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(_mm_and_si128(acc, lowMask),
+                                                                          _mm_and_si128(_mm_srli_epi64(acc, 32), lowMask)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 2), accSq);
+        sum += lanes[0] + lanes[1];
+        sumSq += lanes[2] + lanes[3];
+    }
+#endif
+    for (; i < n; ++i) {
+        sum += a[i];
+        sumSq += static_cast<uint64_t>(a[i]) * a[i];
+    }
+}
+
+void laplacianMomentsU16(const uint16_t* up, const uint16_t* row, const uint16_t* down, size_t n,
+                         int64_t& sum, double& sumSq) {
+    if (n < 3) return;
+    const size_t end = n - 1;
+    size_t i = 1;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    auto load = [](const uint16_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+    // |L| <= 4 * 65535, so the int32 lane sums are flushed every 2048 steps.
+    while (i + 8 <= end) {
+        __m128i acc = zero;
+        __m128d accSq = _mm_setzero_pd();
+        const size_t blockEnd = std::min(end - (end - i) % 8, i + 8 * 2048);
+        for (; i < blockEnd; i += 8) {
+            __m128i c = load(row + i), l = load(row + i - 1), r = load(row + i + 1);
+            __m128i u = load(up + i), d = load(down + i);
+            auto lap = [&](auto unpack) {
+                __m128i v = _mm_slli_epi32(unpack(c, zero), 2);
+                v = _mm_sub_epi32(v, _mm_add_epi32(unpack(l, zero), unpack(r, zero)));
+                return _mm_sub_epi32(v, _mm_add_epi32(unpack(u, zero), unpack(d, zero)));
+            };
+            __m128i lo = lap([](__m128i a, __m128i b) { return _mm_unpacklo_epi16(a, b); });
+            __m128i hi = lap([](__m128i a, __m128i b) { return _mm_unpackhi_epi16(a, b); });
+            acc = _mm_add_epi32(acc, _mm_add_epi32(lo, hi));
+            for (__m128i v : {lo, hi}) {
+                __m128d p0 = _mm_cvtepi32_pd(v);
+                __m128d p1 = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+                accSq = _mm_add_pd(accSq, _mm_add_pd(_mm_mul_pd(p0, p0), _mm_mul_pd(p1, p1)));
+            }
+        }
+        alignas(16) int32_t lanes[4];
+        alignas(16) double sq[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        _mm_store_pd(sq, accSq);
+        sum += static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        sumSq += sq[0] + sq[1];
+    }
+#endif
+    for (; i < end; ++i) {
+        const int v = 4 * row[i] - row[i - 1] - row[i + 1] - up[i] - down[i];
+        sum += v;
+        sumSq += static_cast<double>(v) * v;
+    }
+}
+
+uint16_t rowMaxU16(const uint16_t* a, size_t n, size_t* where) {
+    uint16_t best = 0;
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    if (n >= 8) {
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        for (i = 8; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            m = _mm_add_epi16(m, _mm_subs_epu16(v, m));
+        }
+        alignas(16) uint16_t lanes[8];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), m);
+        for (uint16_t v : lanes) best = v > best ? v : best;
+    }
+#endif
+    for (; i < n; ++i) best = a[i] > best ? a[i] : best;
+    if (where) {
+        // One scalar pass to locate it; the caller only asks for small windows.
+        size_t k = 0;
+        while (k < n && a[k] != best) ++k;
+        *where = k;
+    }
+    return best;
+}
+
+void spotMomentsU16(const uint16_t* a, size_t n, int threshold, int background,
+                    double& sw, double& swx, double& swxx) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    // Unsigned 16-bit compare: bias both sides into the signed range.
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i thr = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(static_cast<uint16_t>(std::clamp(threshold, 0, 65535)))), bias);
+    const __m128i bg = _mm_set1_epi32(background);
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd(), s2 = _mm_setzero_pd();
+    __m128d x = _mm_set_pd(1.0, 0.0);
+    const __m128d two = _mm_set1_pd(2.0);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i keep = _mm_cmpgt_epi16(_mm_xor_si128(v, bias), thr);
+        v = _mm_and_si128(v, keep);
+        __m128i k0 = _mm_unpacklo_epi16(keep, keep), k1 = _mm_unpackhi_epi16(keep, keep);
+        __m128i w[2] = {_mm_and_si128(_mm_sub_epi32(_mm_unpacklo_epi16(v, zero), bg), k0),
+                        _mm_and_si128(_mm_sub_epi32(_mm_unpackhi_epi16(v, zero), bg), k1)};
+        for (__m128i wi : w) {
+            for (int half = 0; half < 2; ++half) {
+                __m128d d = _mm_cvtepi32_pd(half ? _mm_srli_si128(wi, 8) : wi);
+                __m128d dx = _mm_mul_pd(d, x);
+                s0 = _mm_add_pd(s0, d);
+                s1 = _mm_add_pd(s1, dx);
+                s2 = _mm_add_pd(s2, _mm_mul_pd(dx, x));
+                x = _mm_add_pd(x, two);
+            }
+        }
+    }
+    alignas(16) double r[6];
+    _mm_store_pd(r, s0);
+    _mm_store_pd(r + 2, s1);
+    _mm_store_pd(r + 4, s2);
+    sw += r[0] + r[1];
+    swx += r[2] + r[3];
+    swxx += r[4] + r[5];
+#endif
+    for (; i < n; ++i) {
+        if (a[i] <= threshold) continue;
+        const double w = static_cast<double>(a[i]) - background;
+        const double xi = static_cast<double>(i);
+        sw += w;
+        swx += w * xi;
+        swxx += w * xi * xi;
+    }
+}
+
+void widenU16ToF32(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(s, zero)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(s, zero)));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = static_cast<float>(src[i]);
+}
+
+void axpyF32(float* acc, const float* x, float a, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128 va = _mm_set1_ps(a);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    }
+#endif
+    for (; i < n; ++i) acc[i] += a * x[i];
+}
+
+void convolveRowF32(const float* src, float* dst, size_t n, const float* taps, int count, bool accumulate) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    for (; i + 4 <= n; i += 4) {
+        __m128 acc = accumulate ? _mm_loadu_ps(dst + i) : _mm_setzero_ps();
+        for (int k = 0; k < count; ++k) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(taps[k]), _mm_loadu_ps(src + i + k)));
+        }
+        _mm_storeu_ps(dst + i, acc);
+    }
+#endif
+    for (; i < n; ++i) {
+        float acc = accumulate ? dst[i] : 0.0f;
+        for (int k = 0; k < count; ++k) acc += taps[k] * src[i + k];
+        dst[i] = acc;
+    }
+}
+
+void downsample2xU8x4(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    // Two output pixels (8 channel sums) from four source pixels of each row.
+    auto quad = [&](const uint8_t* p0, const uint8_t* p1) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        return _mm_unpacklo_epi64(lo, hi);
+    };
+    for (; i + 4 <= n; i += 4) {
+        const size_t s = 8 * i;
+        __m128i a = _mm_srli_epi16(_mm_add_epi16(quad(row0 + s, row1 + s), two), 2);
+        __m128i b = _mm_srli_epi16(_mm_add_epi16(quad(row0 + s + 16, row1 + s + 16), two), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < n; ++i) {
+        const size_t s = 8 * i;
+        for (int c = 0; c < 4; ++c) {
+            dst[4 * i + c] = static_cast<uint8_t>(
+                (row0[s + c] + row0[s + 4 + c] + row1[s + c] + row1[s + 4 + c] + 2) >> 2);
+        }
+    }
+}
+
+uint64_t sadU8(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64_t sum = 0;
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    if (i + 8 <= n) {
+        __m128i va = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        i += 8;
+    }
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i) sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    return sum;
+}
+
+uint64_t sadU16(const uint16_t* a, const uint16_t* b, size_t n) {
+    uint64_t sum = 0;
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = _mm_setzero_si128();
+    while (i + 8 <= n) {
+        // 32-bit lanes gain at most 2 * 65535 per step; flush well before they wrap.
+        const size_t end = std::min(n, i + 8 * 16384);
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 8 <= end; i += 8) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i d = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(d, zero), _mm_unpackhi_epi16(d, zero)));
+        }
+        total = _mm_add_epi64(total, _mm_add_epi64(_mm_unpacklo_epi32(acc, zero), _mm_unpackhi_epi32(acc, zero)));
+    }
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), total);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i) sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    return sum;
+}
+
+void downsample2xU16ToU8(const uint16_t* row0, const uint16_t* row1, uint8_t* dst, size_t n, int shift) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i lowHalf = _mm_set1_epi32(0xFFFF);
+    const __m128i round = _mm_set1_epi32(2);
+    const __m128i count = _mm_cvtsi32_si128(2 + shift);
+    // Four output sums in 32-bit lanes from eight source pixels of each row.
+    auto quad = [&](const uint16_t* p0, const uint16_t* p1) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+        __m128i s = _mm_add_epi32(_mm_and_si128(a, lowHalf), _mm_srli_epi32(a, 16));
+        s = _mm_add_epi32(s, _mm_add_epi32(_mm_and_si128(b, lowHalf), _mm_srli_epi32(b, 16)));
+        return _mm_srl_epi32(_mm_add_epi32(s, round), count);
+    };
+    for (; i + 8 <= n; i += 8) {
+        const size_t s = 2 * i;
+        __m128i v = _mm_packs_epi32(quad(row0 + s, row1 + s), quad(row0 + s + 8, row1 + s + 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(v, v));
+    }
+#endif
+    for (; i < n; ++i) {
+        const size_t s = 2 * i;
+        const uint32_t v = (static_cast<uint32_t>(row0[s]) + row0[s + 1] + row1[s] + row1[s + 1] + 2) >> (2 + shift);
+        dst[i] = static_cast<uint8_t>(std::min<uint32_t>(v, 255));
+    }
+}
+
+void thresholdU16(const uint16_t* src, uint8_t* mask, size_t n, int threshold, bool below) {
+    size_t i = 0;
+    if (threshold <= 0) {
+        std::fill(mask, mask + n, static_cast<uint8_t>(below ? 0 : 0xFF));
+        return;
+    }
+    const uint8_t hit = below ? 0 : 0xFF;
+    if (threshold > 65535) {
+        std::fill(mask, mask + n, static_cast<uint8_t>(~hit));
+        return;
+    }
+#ifdef SIMD_SSE2
+    // Unsigned v >= t as signed (v ^ 0x8000) > ((t - 1) ^ 0x8000).
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i limit = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(static_cast<uint16_t>(threshold - 1))), bias);
+    const __m128i flip = _mm_set1_epi8(static_cast<char>(below ? 0xFF : 0));
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        a = _mm_cmpgt_epi16(_mm_xor_si128(a, bias), limit);
+        b = _mm_cmpgt_epi16(_mm_xor_si128(b, bias), limit);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), _mm_xor_si128(_mm_packs_epi16(a, b), flip));
+    }
+#endif
+    for (; i < n; ++i) mask[i] = src[i] >= threshold ? hit : static_cast<uint8_t>(~hit);
+}
+
+namespace {
+// Batcher's odd-even merge sort on 16 inputs, keeping only comparators
+// whose inputs are both below count: missing inputs act as +infinity and
+// would never move, so the pruned network still sorts count values.
+const std::vector<std::pair<int, int>>& sortingNetwork(int count) {
+    static const std::array<std::vector<std::pair<int, int>>, 17> networks = [](){
+        std::array<std::vector<std::pair<int, int>>, 17> t;
+        constexpr int kInputs = 16;
+        for (int c = 1; c <= kInputs; ++c) {
+            for (int p = 1; p < kInputs; p <<= 1) {
+                for (int k = p; k >= 1; k >>= 1) {
+                    for (int j = k % p; j + k < kInputs; j += 2 * k) {
+                        for (int i = 0; i < k && i + j + k < kInputs; ++i) {
+                            if ((i + j) / (2 * p) == (i + j + k) / (2 * p) && i + j + k < c) t[c].push_back({i + j, i + j + k});
+                        }
+                    }
+                }
+            }
+        }
+        return t;
+    }();
+    return networks[count];
+}
+} // namespace
+
+void rankMeanU16(const uint16_t* const* rows, int count, int lo, int hi, uint16_t* dst, size_t n) {
+    count = std::clamp(count, 1, 16);
+    hi = std::clamp(hi, 0, count - 1);
+    lo = std::clamp(lo, 0, hi);
+    const std::vector<std::pair<int, int>>& network = sortingNetwork(count);
+    const float inv = 1.0f / (hi - lo + 1);
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    // Unsigned order through the signed min/max of SSE2: flip the top bit.
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vinv = _mm_set1_ps(inv);
+    __m128i v[16];
+    for (; i + 8 <= n; i += 8) {
+        for (int k = 0; k < count; ++k) {
+            v[k] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i)), bias);
+        }
+        for (const auto& c : network) {
+            const __m128i a = v[c.first];
+            v[c.first] = _mm_min_epi16(a, v[c.second]);
+            v[c.second] = _mm_max_epi16(a, v[c.second]);
+        }
+        if (lo == hi) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(v[lo], bias));
+            continue;
+        }
+        __m128i sumLo = zero, sumHi = zero;
+        for (int k = lo; k <= hi; ++k) {
+            const __m128i x = _mm_xor_si128(v[k], bias);
+            sumLo = _mm_add_epi32(sumLo, _mm_unpacklo_epi16(x, zero));
+            sumHi = _mm_add_epi32(sumHi, _mm_unpackhi_epi16(x, zero));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         packU32ToU16(_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sumLo), vinv)),
+                                      _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sumHi), vinv))));
+    }
+#endif
+    uint16_t s[16];
+    for (; i < n; ++i) {
+        for (int k = 0; k < count; ++k) s[k] = rows[k][i];
+        for (const auto& c : network) {
+            const uint16_t a = s[c.first];
+            s[c.first] = std::min(a, s[c.second]);
+            s[c.second] = std::max(a, s[c.second]);
+        }
+        uint32_t sum = 0;
+        for (int k = lo; k <= hi; ++k) sum += s[k];
+        dst[i] = static_cast<uint16_t>(std::lrint(sum * inv));
+    }
+}
+
+void bin2x2U16(const uint16_t* row0, const uint16_t* row1, uint16_t* dst, size_t n, bool sum) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i lowHalf = _mm_set1_epi32(0xFFFF);
+    const __m128i round = _mm_set1_epi32(sum ? 0 : 2);
+    const __m128i count = _mm_cvtsi32_si128(sum ? 0 : 2);
+    // Same pairing as downsample2xU16ToU8: even and odd pixels of each row
+    // in 32-bit lanes, so four 2x2 sums come out of one load per row.
+    auto quad = [&](const uint16_t* p0, const uint16_t* p1) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+        __m128i s = _mm_add_epi32(_mm_and_si128(a, lowHalf), _mm_srli_epi32(a, 16));
+        s = _mm_add_epi32(s, _mm_add_epi32(_mm_and_si128(b, lowHalf), _mm_srli_epi32(b, 16)));
+        return _mm_srl_epi32(_mm_add_epi32(s, round), count);
+    };
+    for (; i + 8 <= n; i += 8) {
+        const size_t s = 2 * i;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         packU32ToU16(quad(row0 + s, row1 + s), quad(row0 + s + 8, row1 + s + 8)));
+    }
+#endif
+    for (; i < n; ++i) {
+        const size_t s = 2 * i;
+        const uint32_t v = static_cast<uint32_t>(row0[s]) + row0[s + 1] + row1[s] + row1[s + 1];
+        dst[i] = static_cast<uint16_t>(sum ? std::min<uint32_t>(v, 65535) : (v + 2) >> 2);
+    }
+}
+
+void binColumnsU32(const uint32_t* src, uint32_t* dst, size_t n, int factor) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    // Horizontal pair sums of eight lanes: even lanes plus odd lanes.
+    auto pairs = [](__m128i a, __m128i b) {
+        const __m128 fa = _mm_castsi128_ps(a);
+        const __m128 fb = _mm_castsi128_ps(b);
+        return _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0))),
+                             _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1))));
+    };
+    auto load = [src](size_t k) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k)); };
+    if (factor == 2) {
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), pairs(load(2 * i), load(2 * i + 4)));
+        }
+    } else if (factor == 4) {
+        for (; i + 4 <= n; i += 4) {
+            const size_t s = 4 * i;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                             pairs(pairs(load(s), load(s + 4)), pairs(load(s + 8), load(s + 12))));
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        const uint32_t* p = src + i * static_cast<size_t>(factor);
+        uint32_t v = 0;
+        for (int k = 0; k < factor; ++k) v += p[k];
+        dst[i] = v;
+    }
+}
+
+#ifdef SIMD_SSE2
+namespace {
+// Sixteen pixels through the window/level of windowU16ToU8.
+inline __m128i windowBlock(__m128i a, __m128i b, __m128i vblack, __m128 vscale) {
+    const __m128i zero = _mm_setzero_si128();
+    a = _mm_subs_epu16(a, vblack);
+    b = _mm_subs_epu16(b, vblack);
+    __m128i a0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(a, zero)), vscale));
+    __m128i a1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(a, zero)), vscale));
+    __m128i b0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero)), vscale));
+    __m128i b1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(b, zero)), vscale));
+    return _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(b0, b1));
+}
+
+// Per-lane clip masks and counts. Counters are 16-bit lanes that take one
+// step per block, flushed into the totals before they can wrap.
+struct ClipCounter {
+    __m128i vlow, vhigh;
+    __m128i lowOn, highOn;      // all ones, or zero for a side that is off
+    __m128i lowAcc = _mm_setzero_si128();
+    __m128i highAcc = _mm_setzero_si128();
+    int pending = 0;
+
+    ClipCounter(int low, int high)
+        : vlow(_mm_set1_epi16(static_cast<short>(std::clamp(low, 0, 65535)))),
+          vhigh(_mm_set1_epi16(static_cast<short>(std::clamp(high, 0, 65535)))),
+          lowOn(_mm_set1_epi16(static_cast<short>(low >= 0 ? -1 : 0))),
+          highOn(_mm_set1_epi16(static_cast<short>(high <= 65535 ? -1 : 0))) {}
+
+    // 0xFFFF lanes where v <= low and where v >= high (unsigned).
+    void masks(__m128i v, __m128i& lo, __m128i& hi) {
+        const __m128i zero = _mm_setzero_si128();
+        lo = _mm_and_si128(_mm_cmpeq_epi16(_mm_subs_epu16(v, vlow), zero), lowOn);
+        hi = _mm_and_si128(_mm_cmpeq_epi16(_mm_subs_epu16(vhigh, v), zero), highOn);
+        lowAcc = _mm_sub_epi16(lowAcc, lo);
+        highAcc = _mm_sub_epi16(highAcc, hi);
+    }
+    void step(uint64_t& lowCount, uint64_t& highCount) {
+        if (++pending == 16384) flush(lowCount, highCount);
+    }
+    void flush(uint64_t& lowCount, uint64_t& highCount) {
+        alignas(16) uint16_t l[8], h[8];
+        _mm_store_si128(reinterpret_cast<__m128i*>(l), lowAcc);
+        _mm_store_si128(reinterpret_cast<__m128i*>(h), highAcc);
+        for (int k = 0; k < 8; ++k) {
+            lowCount += l[k];
+            highCount += h[k];
+        }
+        lowAcc = highAcc = _mm_setzero_si128();
+        pending = 0;
+    }
+};
+} // namespace
+#endif
+
+void countClipU16(const uint16_t* src, size_t n, int low, int high, uint64_t& lowCount, uint64_t& highCount) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    ClipCounter clip(low, high);
+    uint64_t lows = 0, highs = 0;   // locals, so the counters stay in registers
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo, hi;
+        clip.masks(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), lo, hi);
+        clip.step(lows, highs);
+    }
+    clip.flush(lows, highs);
+    lowCount += lows;
+    highCount += highs;
+#endif
+    for (; i < n; ++i) {
+        lowCount += src[i] <= low;
+        highCount += src[i] >= high;
+    }
+}
+
+void paletteU16ToRgb32(const uint16_t* src, uint32_t* dst, size_t n, int black, int white, const uint32_t* palette,
+                       int low, int high, uint32_t lowColour, uint32_t highColour) {
+    if (white <= black) white = black + 1;
+    const float scale = 255.0f / static_cast<float>(white - black);
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128i vblack = _mm_set1_epi16(static_cast<short>(static_cast<uint16_t>(black)));
+    const __m128 vscale = _mm_set1_ps(scale);
+    const bool paint = low >= 0 || high <= 65535;
+    const __m128i lowRgb = _mm_set1_epi32(static_cast<int>(lowColour));
+    const __m128i highRgb = _mm_set1_epi32(static_cast<int>(highColour));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vlow = _mm_set1_epi16(static_cast<short>(std::clamp(low, 0, 65535)));
+    const __m128i vhigh = _mm_set1_epi16(static_cast<short>(std::clamp(high, 0, 65535)));
+    const __m128i lowOn = _mm_set1_epi16(static_cast<short>(low >= 0 ? -1 : 0));
+    const __m128i highOn = _mm_set1_epi16(static_cast<short>(high <= 65535 ? -1 : 0));
+    // Clipped lanes of eight looked-up pixels swapped for their colour.
+    auto tint = [&](uint32_t* out, __m128i v) {
+        const __m128i lo = _mm_and_si128(_mm_cmpeq_epi16(_mm_subs_epu16(v, vlow), zero), lowOn);
+        const __m128i hi = _mm_and_si128(_mm_cmpeq_epi16(_mm_subs_epu16(vhigh, v), zero), highOn);
+        for (int half = 0; half < 2; ++half) {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + 4 * half));
+            __m128i m = half ? _mm_unpackhi_epi16(lo, lo) : _mm_unpacklo_epi16(lo, lo);
+            px = _mm_or_si128(_mm_andnot_si128(m, px), _mm_and_si128(m, lowRgb));
+            m = half ? _mm_unpackhi_epi16(hi, hi) : _mm_unpacklo_epi16(hi, hi);
+            px = _mm_or_si128(_mm_andnot_si128(m, px), _mm_and_si128(m, highRgb));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * half), px);
+        }
+    };
+    alignas(16) uint8_t index[16];
+    for (; i + 16 <= n; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), windowBlock(a, b, vblack, vscale));
+        uint32_t* d = dst + i;
+        for (int k = 0; k < 16; ++k) d[k] = palette[index[k]];
+        if (paint) {
+            tint(d, a);
+            tint(d + 8, b);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        const int v = src[i];
+        const float f = v <= black ? 0.0f : (v - black) * scale;
+        uint32_t px = palette[f >= 255.0f ? 255 : static_cast<int>(f + 0.5f)];
+        if (v <= low) px = lowColour;
+        if (v >= high) px = highColour;
+        dst[i] = px;
+    }
+}
+
+} // namespace simd
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Row kernels shared by the live processing and viewer paths.
+// SSE2 is baseline on x64; other targets fall back to the scalar loops.
+namespace simd {
+
+// out[i] = |a[i] - b[i]|
+void absDiffU8(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t n);
+void absDiffU16(const uint16_t* a, const uint16_t* b, uint16_t* out, size_t n);
+
+// Linear window/level to 8 bits: black -> 0, white -> 255, clamped.
+void windowU16ToU8(const uint16_t* src, uint8_t* dst, size_t n, int black, int white);
+
+// 2x2 box average of two source rows into n output pixels, rounded.
+// The source rows hold 2 * n pixels; x4 treats each pixel as 4 channels.
+void downsample2xU8(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t n);
+void downsample2xU8x4(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t n);
+
+// Temporal accumulators over native 16-bit frames.
+// acc[i] += add[i] - sub[i]; sub may be null. The caller keeps acc >= 0.
+void accumulateU16(uint32_t* acc, const uint16_t* add, const uint16_t* sub, size_t n);
+// acc[i] += alpha * (src[i] - acc[i])
+void emaU16(float* acc, const uint16_t* src, size_t n, float alpha);
+// acc[i] = max(acc[i], src[i])
+void maxU16(uint16_t* acc, const uint16_t* src, size_t n);
+// dst[i] = round(src[i] * scale), saturated to 16 bits.
+void scaleU32ToU16(const uint32_t* src, uint16_t* dst, size_t n, float scale);
+void floatToU16(const float* src, uint16_t* dst, size_t n);
+void widenU8ToU16(const uint8_t* src, uint16_t* dst, size_t n);
+// Exponentially weighted Welford step:
+//   d = src[i] - mean[i]; mean[i] += alpha * d;
+//   var[i] = (1 - alpha) * (var[i] + alpha * d * d)
+// With alpha = 1/k on the k-th frame this is the exact running variance.
+void ewVarianceU16(float* mean, float* var, const uint16_t* src, size_t n, float alpha);
+// dst[i] = min(255, round(sqrt(var[i]) * scale))
+void stdDevToU8(const float* var, uint8_t* dst, size_t n, float scale);
+
+// Flat/dark correction: dst[i] = round((src[i] - dark[i]) * gain[i]),
+// clamped to [0, 65535].
+void calibrateU16(const uint16_t* src, const float* dark, const float* gain, uint16_t* dst, size_t n);
+
+// Frame-pair reduction for the photon transfer curve: adds sum(a), sum(b)
+// and sum((a - b)^2) to the running totals. Exact in 64 bits.
+void pairStatsU16(const uint16_t* a, const uint16_t* b, size_t n,
+                  uint64_t& sumA, uint64_t& sumB, uint64_t& sumSqDiff);
+
+// Focus measures. momentsU16 adds sum(a) and sum(a^2). laplacianMomentsU16
+// takes three consecutive rows and adds the sum and sum of squares of the
+// 4-neighbour Laplacian 4c - l - r - u - d at pixels 1 .. n-2 of the middle row.
+void momentsU16(const uint16_t* a, size_t n, uint64_t& sum, uint64_t& sumSq);
+void laplacianMomentsU16(const uint16_t* up, const uint16_t* row, const uint16_t* down, size_t n,
+                         int64_t& sum, double& sumSq);
+
+// Largest value of a row and the first index holding it.
+uint16_t rowMaxU16(const uint16_t* a, size_t n, size_t* where);
+// Thresholded beam moments of a row: with w = a[i] - background where
+// a[i] > threshold (0 elsewhere), adds sum(w), sum(w * i) and sum(w * i^2).
+void spotMomentsU16(const uint16_t* a, size_t n, int threshold, int background,
+                    double& sw, double& swx, double& swxx);
+
+// Float filtering for the localisation engine. convolveRowF32 writes (or with
+// accumulate adds) dst[i] = sum(taps[k] * src[i + k]), k < count, so src
+// holds n + count - 1 values, already padded by the caller.
+void widenU16ToF32(const uint16_t* src, float* dst, size_t n);
+// acc[i] += a * x[i]
+void axpyF32(float* acc, const float* x, float a, size_t n);
+void convolveRowF32(const float* src, float* dst, size_t n, const float* taps, int count, bool accumulate);
+
+// Motion estimation. sadU8 / sadU16 return sum(|a[i] - b[i]|), exact.
+// downsample2xU16ToU8 is downsample2xU8 for 16-bit rows, with the rounded
+// average shifted right by `shift` and saturated to 8 bits.
+uint64_t sadU8(const uint8_t* a, const uint8_t* b, size_t n);
+uint64_t sadU16(const uint16_t* a, const uint16_t* b, size_t n);
+void downsample2xU16ToU8(const uint16_t* row0, const uint16_t* row1, uint8_t* dst, size_t n, int shift);
+
+// Segmentation mask: mask[i] = 0xFF where src[i] >= threshold (or, with
+// below, where src[i] < threshold), 0 elsewhere.
+void thresholdU16(const uint16_t* src, uint8_t* mask, size_t n, int threshold, bool below);
+
+// Temporal order statistics across count rows (1..16), sorted per pixel by
+// a sorting network: dst[i] = rounded mean of the values at ranks lo..hi of
+// rows[0][i] .. rows[count - 1][i]. lo = hi = (count - 1) / 2 is the median.
+void rankMeanU16(const uint16_t* const* rows, int count, int lo, int hi, uint16_t* dst, size_t n);
+
+// Software binning. bin2x2U16 sums 2x2 blocks of two source rows (2 * n
+// pixels each) into n outputs, as the rounded mean or the saturated sum.
+// binColumnsU32 sums runs of `factor` adjacent values into n outputs; with
+// accumulateU16 over the rows of a bin it covers any N x M; dst may be src.
+void bin2x2U16(const uint16_t* row0, const uint16_t* row1, uint16_t* dst, size_t n, bool sum);
+void binColumnsU32(const uint32_t* src, uint32_t* dst, size_t n, int factor);
+
+// Display conversion. countClipU16 counts pixels <= low into lowCount and
+// >= high into highCount (low < 0 or high > 65535 switches a side off).
+// paletteU16ToRgb32 is a two-stage lookup: the window of windowU16ToU8
+// (in SIMD) gives an 8-bit index into a 256-entry RGB32 palette, which
+// stays in L1; clipped pixels, by the same low / high rule, are painted
+// lowColour / highColour. Grey is just another palette, so false colour
+// costs the same as grey.
+void countClipU16(const uint16_t* src, size_t n, int low, int high, uint64_t& lowCount, uint64_t& highCount);
+void paletteU16ToRgb32(const uint16_t* src, uint32_t* dst, size_t n, int black, int white, const uint32_t* palette,
+                       int low, int high, uint32_t lowColour, uint32_t highColour);
+
+} // namespace simd
@@ -0,0 +1,377 @@
+#include "smlm_localizer.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+std::vector<float> gaussianTaps(double sigma) {
+    const int r = std::max(1, static_cast<int>(std::ceil(3.0 * sigma)));
+    std::vector<float> taps(2 * r + 1);
+    double sum = 0.0;
+    for (int k = -r; k <= r; ++k) sum += taps[k + r] = static_cast<float>(std::exp(-0.5 * k * k / (sigma * sigma)));
+    for (float& t : taps) t = static_cast<float>(t / sum);
+    return taps;
+}
+
+// Pixel-integrated 1D Gaussian around centre c at pixel offsets 0 .. n-1:
+// e = integral over the pixel, d1 and d2 its first and second derivatives in c.
+void integratedGaussian(double c, double sigma, int n, double* e, double* d1, double* d2) {
+    const double invSqrt2s = 1.0 / (std::sqrt(2.0) * sigma);
+    const double norm = 1.0 / (std::sqrt(2.0 * kPi) * sigma);
+    for (int i = 0; i < n; ++i) {
+        const double lo = i - c - 0.5;
+        const double hi = i - c + 0.5;
+        const double gLo = std::exp(-0.5 * lo * lo / (sigma * sigma));
+        const double gHi = std::exp(-0.5 * hi * hi / (sigma * sigma));
+        e[i] = 0.5 * (std::erf(hi * invSqrt2s) - std::erf(lo * invSqrt2s));
+        d1[i] = norm * (gLo - gHi);
+        d2[i] = norm / (sigma * sigma) * (lo * gLo - hi * gHi);
+    }
+}
+
+// MLE fit of a (2r+1)^2 box centred on (cx, cy). Returns false when the fit
+// leaves the box or does not converge to a positive amplitude.
+bool fitSpot(const float* pixels, int width, int cx, int cy, const SmlmLocalizer::Settings& s,
+             SmlmLocalizer::Localization& out) {
+    const int r = s.boxRadius;
+    const int n = 2 * r + 1;
+    std::vector<double> data(static_cast<size_t>(n) * n);
+    double lowest = 1e300;
+    for (int j = 0; j < n; ++j) {
+        const float* row = pixels + static_cast<size_t>(cy - r + j) * width + (cx - r);
+        for (int i = 0; i < n; ++i) {
+            const double photons = std::max(0.0, (row[i] - s.offset) * s.gain);
+            data[j * n + i] = photons;
+            lowest = std::min(lowest, photons);
+        }
+    }
+    // Start from the background-subtracted centroid of the box.
+    double bg = std::max(lowest, 0.01);
+    double amp = 0.0, mx = 0.0, my = 0.0;
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            const double w = data[j * n + i] - bg;
+            amp += w;
+            mx += w * i;
+            my += w * j;
+        }
+    }
+    if (amp <= 0.0) return false;
+    double x = mx / amp;
+    double y = my / amp;
+    const double sigma = s.psfSigma;
+
+    std::vector<double> ex(n), dx(n), ddx(n), ey(n), dy(n), ddy(n);
+    for (int it = 0; it < s.iterations; ++it) {
+        integratedGaussian(x, sigma, n, ex.data(), dx.data(), ddx.data());
+        integratedGaussian(y, sigma, n, ey.data(), dy.data(), ddy.data());
+        double num[4] = {0, 0, 0, 0};
+        double den[4] = {0, 0, 0, 0};
+        for (int j = 0; j < n; ++j) {
+            for (int i = 0; i < n; ++i) {
+                const double model = amp * ex[i] * ey[j] + bg;
+                const double ratio = data[j * n + i] / model;
+                const double d[4] = {amp * dx[i] * ey[j], amp * ex[i] * dy[j], ex[i] * ey[j], 1.0};
+                const double dd[2] = {amp * ddx[i] * ey[j], amp * ex[i] * ddy[j]};
+                for (int p = 0; p < 4; ++p) {
+                    num[p] += d[p] * (ratio - 1.0);
+                    den[p] += (p < 2 ? dd[p] * (ratio - 1.0) : 0.0) - d[p] * d[p] * ratio / model;
+                }
+            }
+        }
+        if (den[0] >= 0.0 || den[1] >= 0.0 || den[2] >= 0.0 || den[3] >= 0.0) return false;
+        // Limit position steps to a pixel so a poor start cannot overshoot.
+        x -= std::clamp(num[0] / den[0], -1.0, 1.0);
+        y -= std::clamp(num[1] / den[1], -1.0, 1.0);
+        amp = std::max(1.0, amp - num[2] / den[2]);
+        bg = std::max(0.01, bg - num[3] / den[3]);
+    }
+    if (!std::isfinite(x) || !std::isfinite(y) || std::abs(x - r) > r - 0.5 || std::abs(y - r) > r - 0.5) return false;
+
+    // Mortensen et al. 2010 with a = 1 pixel, MLE without excess noise.
+    const double sa2 = sigma * sigma + 1.0 / 12.0;
+    const double variance = sa2 / amp * (16.0 / 9.0 + 8.0 * kPi * sa2 * bg / amp);
+    out.x = static_cast<float>(cx - r + x);
+    out.y = static_cast<float>(cy - r + y);
+    out.photons = static_cast<float>(amp);
+    out.background = static_cast<float>(bg);
+    out.precision = static_cast<float>(std::sqrt(variance));
+    return true;
+}
+} // namespace
+
+SmlmLocalizer::SmlmLocalizer(QObject* parent) : LiveAnalyzer(parent, 32), pool(workThreads) {}
+
+SmlmLocalizer::~SmlmLocalizer() {
+    stopAnalysis();
+    pool.waitUntilAtMost(0);
+}
+
+void SmlmLocalizer::setSettings(const Settings& s) {
+    QMutexLocker lk(&settingsMutex);
+    current = s;
+    current.psfSigma = std::clamp(current.psfSigma, 0.5, 5.0);
+    current.gain = std::max(current.gain, 1e-3);
+    current.boxRadius = std::clamp(current.boxRadius, 2, 8);
+    current.iterations = std::clamp(current.iterations, 1, 50);
+}
+
+SmlmLocalizer::Settings SmlmLocalizer::settings() const {
+    QMutexLocker lk(&settingsMutex);
+    return current;
+}
+
+void SmlmLocalizer::clearResults() {
+    // Frames already on the pool would land in the cleared table.
+    pool.waitUntilAtMost(0);
+    QMutexLocker lk(&resultMutex);
+    locs.clear();
+    total = 0;
+    latestBegin = 0;
+    std::fill(histogram.begin(), histogram.end(), 0u);
+    histogramMax = 0;
+}
+
+qint64 SmlmLocalizer::count() const {
+    QMutexLocker lk(&resultMutex);
+    return total;
+}
+
+qint64 SmlmLocalizer::tableRows() const {
+    QMutexLocker lk(&resultMutex);
+    return static_cast<qint64>(locs.size());
+}
+
+std::vector<SmlmLocalizer::Localization> SmlmLocalizer::table() const {
+    QMutexLocker lk(&resultMutex);
+    return std::vector<Localization>(locs.begin(), locs.end());
+}
+
+std::vector<SmlmLocalizer::Localization> SmlmLocalizer::latestFrame() const {
+    QMutexLocker lk(&resultMutex);
+    return std::vector<Localization>(locs.begin() + static_cast<std::ptrdiff_t>(latestBegin), locs.end());
+}
+
+int SmlmLocalizer::magnification() const {
+    QMutexLocker lk(&resultMutex);
+    return mag;
+}
+
+QImage SmlmLocalizer::render() const {
+    QMutexLocker lk(&resultMutex);
+    if (histogramMax == 0) return {};
+    const int w = frameSize.width() * mag;
+    const int h = frameSize.height() * mag;
+    QImage out(w, h, QImage::Format_Grayscale8);
+    const float scale = 255.0f / std::sqrt(static_cast<float>(histogramMax));
+    for (int y = 0; y < h; ++y) {
+        const quint32* src = histogram.data() + static_cast<size_t>(y) * w;
+        uchar* dst = out.scanLine(y);
+        for (int x = 0; x < w; ++x) {
+            dst[x] = src[x] ? static_cast<uchar>(std::min(255.0f, std::sqrt(static_cast<float>(src[x])) * scale + 0.5f)) : 0;
+        }
+    }
+    return out;
+}
+
+SmlmLocalizer::Settings SmlmLocalizer::forBinning(const Settings& s, const SoftwareBinning::Settings& b) {
+    if (b.isNone()) return s;
+    Settings out = s;
+    const int n = b.pixels();
+    out.psfSigma = std::max(0.5, s.psfSigma / std::sqrt(static_cast<double>(n)));
+    // A mean bin holds the average of n pixels, a summed one n offsets.
+    if (b.sum) out.offset = s.offset * n;
+    else out.gain = s.gain * n;
+    return out;
+}
+
+QString SmlmLocalizer::exportCsv(const QString& path, double pixelSizeNm) const {
+    const std::vector<Localization> rows = table();
+    const double sigmaNm = settings().psfSigma * pixelSizeNm;
+    // Rows are in binned pixels; the table is cleared whenever that changes.
+    const SoftwareBinning::Settings bin = binning();
+    const double spread = std::sqrt(static_cast<double>(bin.pixels()));
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return f.errorString();
+    QTextStream out(&f);
+    out << "\"id\",\"frame\",\"x [nm]\",\"y [nm]\",\"sigma [nm]\",\"intensity [photon]\",\"offset [photon]\",\"uncertainty [nm]\"\n";
+    qint64 id = 1;
+    for (const Localization& l : rows) {
+        out << id++ << "," << l.frame << ","
+            << QString::number((bin.sensorX(l.x) + 0.5) * pixelSizeNm, 'f', 2) << ","
+            << QString::number((bin.sensorY(l.y) + 0.5) * pixelSizeNm, 'f', 2) << ","
+            << QString::number(sigmaNm, 'f', 2) << ","
+            << QString::number(l.photons, 'f', 1) << ","
+            << QString::number(l.background / bin.pixels(), 'f', 2) << ","
+            << QString::number(l.precision * spread * pixelSizeNm, 'f', 2) << "\n";
+    }
+    out.flush();
+    if (f.error() != QFileDevice::NoError) return f.errorString();
+    return {};
+}
+
+void SmlmLocalizer::localize(const float* pixels, int width, int height, const Settings& s, int threads,
+                             std::vector<Localization>& out) {
+    const int border = s.boxRadius;
+    if (width <= 2 * border + 2 || height <= 2 * border + 2) return;
+
+    // DoG = G(sigma) - G(2 sigma): the narrow kernel matches the PSF, the wide
+    // one takes out the local background. Both are separable; the vertical
+    // pass builds one filtered row, the horizontal pass runs on it padded.
+    const std::vector<float> narrow = gaussianTaps(s.psfSigma);
+    std::vector<float> wide = gaussianTaps(2.0 * s.psfSigma);
+    for (float& t : wide) t = -t;
+    const int rn = static_cast<int>(narrow.size()) / 2;
+    const int rw = static_cast<int>(wide.size()) / 2;
+    std::vector<float> dog(static_cast<size_t>(width) * height);
+    std::mutex merge;
+    double total = 0.0, totalSq = 0.0;
+    parallelBands(height, threads, [&](int y0, int y1) {
+        std::vector<float> vn(width + 2 * rn), vw(width + 2 * rw);
+        double sum = 0.0, sumSq = 0.0;
+        auto verticalPass = [&](std::vector<float>& row, const std::vector<float>& taps, int r, int y, float sign) {
+            float* mid = row.data() + r;
+            std::fill(mid, mid + width, 0.0f);
+            for (int k = -r; k <= r; ++k) {
+                const int sy = std::clamp(y + k, 0, height - 1);
+                simd::axpyF32(mid, pixels + static_cast<size_t>(sy) * width, sign * taps[k + r], static_cast<size_t>(width));
+            }
+            std::fill(row.begin(), row.begin() + r, mid[0]);
+            std::fill(row.end() - r, row.end(), mid[width - 1]);
+        };
+        for (int y = y0; y < y1; ++y) {
+            // The horizontal taps carry the sign, so the vertical taps stay positive.
+            verticalPass(vn, narrow, rn, y, 1.0f);
+            verticalPass(vw, wide, rw, y, -1.0f);
+            float* d = dog.data() + static_cast<size_t>(y) * width;
+            simd::convolveRowF32(vn.data(), d, static_cast<size_t>(width), narrow.data(), 2 * rn + 1, false);
+            simd::convolveRowF32(vw.data(), d, static_cast<size_t>(width), wide.data(), 2 * rw + 1, true);
+            for (int x = 0; x < width; ++x) {
+                sum += d[x];
+                sumSq += static_cast<double>(d[x]) * d[x];
+            }
+        }
+        std::lock_guard<std::mutex> lk(merge);
+        total += sum;
+        totalSq += sumSq;
+    });
+    const double count = static_cast<double>(width) * height;
+    const double mean = total / count;
+    const float level = static_cast<float>(mean + s.threshold * std::sqrt(std::max(0.0, totalSq / count - mean * mean)));
+
+    // Candidates: 3x3 maxima far enough from the edge for a full fit box.
+    // Ties go to the first pixel in raster order.
+    std::vector<QPoint> candidates;
+    parallelBands(height - 2 * border, threads, [&](int y0, int y1) {
+        std::vector<QPoint> found;
+        for (int y = border + y0; y < border + y1; ++y) {
+            const float* up = dog.data() + static_cast<size_t>(y - 1) * width;
+            const float* row = up + width;
+            const float* down = row + width;
+            for (int x = border; x < width - border; ++x) {
+                const float v = row[x];
+                if (v <= level) continue;
+                if (v <= up[x - 1] || v <= up[x] || v <= up[x + 1] || v <= row[x - 1]) continue;
+                if (v < row[x + 1] || v < down[x - 1] || v < down[x] || v < down[x + 1]) continue;
+                found.push_back(QPoint(x, y));
+            }
+        }
+        std::lock_guard<std::mutex> lk(merge);
+        candidates.insert(candidates.end(), found.begin(), found.end());
+    }, 16);
+    std::sort(candidates.begin(), candidates.end(), [](const QPoint& a, const QPoint& b) {
+        return a.y() != b.y() ? a.y() < b.y() : a.x() < b.x();
+    });
+
+    std::vector<Localization> fits(candidates.size());
+    std::vector<char> ok(candidates.size(), 0);
+    parallelBands(static_cast<int>(candidates.size()), threads, [&](int c0, int c1) {
+        for (int c = c0; c < c1; ++c) {
+            ok[c] = fitSpot(pixels, width, candidates[c].x(), candidates[c].y(), s, fits[c]) ? 1 : 0;
+        }
+    }, 8);
+    for (size_t c = 0; c < fits.size(); ++c) {
+        if (ok[c]) out.push_back(fits[c]);
+    }
+}
+
+void SmlmLocalizer::analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) {
+    // Two frames per worker keep the pool busy; beyond that frames wait in
+    // the analyzer queue, which drops the oldest when the fits fall behind.
+    pool.waitUntilAtMost(2 * pool.size());
+    const quint64 seq = posted++;
+    const Settings s = forBinning(settings(), binning());
+    const quint32 frame = static_cast<quint32>(meta.framestamp);
+    pool.post([this, seq, img, frame, roi, s]() { localizeFrame(seq, img, frame, roi, s); });
+}
+
+void SmlmLocalizer::localizeFrame(quint64 seq, const QImage& img, quint32 frame, const QRect& roi, const Settings& s) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    const int w = roi.width();
+    const int h = roi.height();
+    thread_local std::vector<float> pixels;
+    thread_local std::vector<uint16_t> scratch;
+    pixels.resize(static_cast<size_t>(w) * h);
+    if (!deep) scratch.resize(static_cast<size_t>(w));
+    for (int y = 0; y < h; ++y) {
+        const uint16_t* row = nullptr;
+        if (deep) {
+            row = reinterpret_cast<const uint16_t*>(src.constScanLine(roi.top() + y)) + roi.left();
+        } else {
+            simd::widenU8ToU16(src.constScanLine(roi.top() + y) + roi.left(), scratch.data(), static_cast<size_t>(w));
+            row = scratch.data();
+        }
+        simd::widenU16ToF32(row, pixels.data() + static_cast<size_t>(y) * w, static_cast<size_t>(w));
+    }
+
+    Finished done;
+    done.frameSize = img.size();
+    localize(pixels.data(), w, h, s, 1, done.found);
+    for (Localization& l : done.found) {
+        l.frame = frame;
+        l.x += roi.left();
+        l.y += roi.top();
+    }
+
+    QMutexLocker lk(&resultMutex);
+    waiting.emplace(seq, std::move(done));
+    while (!waiting.empty() && waiting.begin()->first == nextCommit) {
+        commit(waiting.begin()->second);
+        waiting.erase(waiting.begin());
+        ++nextCommit;
+    }
+}
+
+void SmlmLocalizer::commit(const Finished& done) {
+    if (frameSize != done.frameSize) {
+        // A new frame geometry invalidates both the histogram and the table.
+        frameSize = done.frameSize;
+        mag = std::clamp(kMaxRenderSide / std::max(1, std::max(frameSize.width(), frameSize.height())), 1, 8);
+        histogram.assign(static_cast<size_t>(frameSize.width()) * mag * frameSize.height() * mag, 0u);
+        histogramMax = 0;
+        locs.clear();
+        total = 0;
+    }
+    latestBegin = locs.size();
+    const int hw = frameSize.width() * mag;
+    const int hh = frameSize.height() * mag;
+    for (const Localization& l : done.found) {
+        locs.push_back(l);
+        const int hx = static_cast<int>(std::floor((l.x + 0.5) * mag));
+        const int hy = static_cast<int>(std::floor((l.y + 0.5) * mag));
+        if (hx < 0 || hy < 0 || hx >= hw || hy >= hh) continue;
+        quint32& bin = histogram[static_cast<size_t>(hy) * hw + hx];
+        histogramMax = std::max(histogramMax, ++bin);
+    }
+    total += static_cast<qint64>(done.found.size());
+    if (locs.size() > kMaxTableRows) {
+        const size_t excess = locs.size() - kMaxTableRows;
+        locs.erase(locs.begin(), locs.begin() + static_cast<std::ptrdiff_t>(excess));
+        latestBegin -= std::min(latestBegin, excess);
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <deque>
+#include <map>
+#include <vector>
+#include "live_analyzer.h"
+#include "parallel.h"
+
+// Single-molecule localisation of every acquired frame. Candidates are local
+// maxima of a separable difference-of-Gaussians image above a multiple of its
+// noise; each is refined by a fixed-width integrated-Gaussian maximum-
+// likelihood fit (Newton steps as in Smith et al., Nat. Methods 2010).
+// Whole frames are jobs on a work-stealing pool, each localised on one
+// worker, and finished frames enter the table in acquisition order. The table
+// keeps the newest kMaxTableRows rows; every localisation is also binned into
+// a super-resolution histogram for the live preview, which keeps them all.
+class SmlmLocalizer : public LiveAnalyzer {
+    Q_OBJECT
+public:
+    // In sensor pixels and DN. Binned frames are fitted with the PSF width,
+    // offset and gain scaled to the bin (see forBinning).
+    struct Settings {
+        double psfSigma = 1.3;      // PSF standard deviation, pixels
+        double threshold = 5.0;     // detection level in DoG noise sigmas
+        double offset = 100.0;      // camera offset, DN
+        double gain = 1.0;          // photoelectrons per DN
+        int boxRadius = 3;          // fit box is 2r+1 pixels square
+        int iterations = 10;
+    };
+    // One row of the table (24 bytes). Positions are in analysed (binned)
+    // frame pixels with pixel centres at integers.
+    struct Localization {
+        quint32 frame = 0;          // camera framestamp
+        float x = 0.0f;
+        float y = 0.0f;
+        float photons = 0.0f;
+        float background = 0.0f;    // photons per pixel
+        float precision = 0.0f;     // Mortensen lower bound, pixels
+    };
+
+    explicit SmlmLocalizer(QObject* parent=nullptr);
+    ~SmlmLocalizer() override;
+
+    // Applies from the next frame.
+    void setSettings(const Settings& s);
+    Settings settings() const;
+
+    // Every localisation since the last reset, and the rows the table still
+    // holds (the oldest go first once it is full).
+    qint64 count() const;
+    qint64 tableRows() const;
+    std::vector<Localization> table() const;
+    std::vector<Localization> latestFrame() const;
+    // Histogram of all localisations, magnification() render pixels per
+    // camera pixel, square-root scaled to 8 bits. Null before the first hit.
+    QImage render() const;
+    int magnification() const;
+    // ThunderSTORM-style CSV; positions measured from the frame's top-left
+    // corner, in nm of the sensor whatever the binning.
+    QString exportCsv(const QString& path, double pixelSizeNm) const;
+    // Settings for frames binned as b: PSF width in binned pixels, and the
+    // offset and gain that turn a binned value into the bin's photons.
+    static Settings forBinning(const Settings& s, const SoftwareBinning::Settings& b);
+
+    // Localisations in a width x height float image (DN), positions relative
+    // to it. frame is left at 0.
+    static void localize(const float* pixels, int width, int height, const Settings& s, int threads,
+                         std::vector<Localization>& out);
+
+protected:
+    void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) override;
+    void clearResults() override;
+
+private:
+    static constexpr int kMaxRenderSide = 4096;
+    static constexpr size_t kMaxTableRows = 2000000;   // 48 MB
+
+    // A frame's localisations, waiting for the frames before it.
+    struct Finished {
+        std::vector<Localization> found;
+        QSize frameSize;
+    };
+    void localizeFrame(quint64 seq, const QImage& img, quint32 frame, const QRect& roi, const Settings& s);
+    void commit(const Finished& done);
+
+    mutable QMutex settingsMutex;
+    Settings current;
+
+    mutable QMutex resultMutex;
+    std::deque<Localization> locs;
+    qint64 total = 0;
+    size_t latestBegin = 0;     // first row of the newest frame
+    QSize frameSize;
+    int mag = 1;
+    std::vector<quint32> histogram;
+    quint32 histogramMax = 0;
+    std::map<quint64, Finished> waiting;   // by sequence, guarded by resultMutex
+    quint64 nextCommit = 0;                // guarded by resultMutex
+
+    quint64 posted = 0;         // analysis thread only
+    // Last member: destroyed first, finishing its jobs while the rest lives.
+    WorkStealingPool pool;
+};
@@ -0,0 +1,69 @@
+#include "software_binning.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <vector>
+
+QString SoftwareBinning::describe(const Settings& s) {
+    if (s.isNone()) return "off";
+    return QString("%1x%2 %3").arg(s.x).arg(s.y).arg(s.sum ? "sum" : "mean");
+}
+
+QImage SoftwareBinning::apply(const QImage& img, const Settings& s, int threads) {
+    if (s.isNone() || img.isNull()) return img;
+    const int bx = std::clamp(s.x, 1, kMaxFactor);
+    const int by = std::clamp(s.y, 1, kMaxFactor);
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    const QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    const int w = src.width() / bx;
+    const int h = src.height() / by;
+    if (w == 0 || h == 0) return img;
+    const bool wide = deep || s.sum;
+    QImage out(w, h, wide ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+
+    // 16-bit 2x2 has its own kernel; every other case sums the bin's rows
+    // into a 32-bit row, folds runs of bx columns and scales back down.
+    const bool fast = deep && bx == 2 && by == 2;
+    const size_t span = static_cast<size_t>(w) * bx;
+    const float scale = s.sum ? 1.0f : 1.0f / (bx * by);
+    // scanLine() detaches (and touches the cache key) on every call, so the
+    // band threads work from one row pointer.
+    uchar* base = out.bits();
+    const qsizetype bpl = out.bytesPerLine();
+    parallelBands(h, threads, [&](int y0, int y1) {
+        std::vector<uint32_t> acc(fast ? 0 : span);
+        std::vector<uint16_t> widened(deep ? 0 : span);
+        std::vector<uint16_t> row16(wide ? 0 : static_cast<size_t>(w));
+        for (int y = y0; y < y1; ++y) {
+            if (fast) {
+                simd::bin2x2U16(reinterpret_cast<const uint16_t*>(src.constScanLine(2 * y)),
+                                reinterpret_cast<const uint16_t*>(src.constScanLine(2 * y + 1)),
+                                reinterpret_cast<uint16_t*>(base + y * bpl), static_cast<size_t>(w), s.sum);
+                continue;
+            }
+            std::fill(acc.begin(), acc.end(), 0u);
+            for (int k = 0; k < by; ++k) {
+                const uchar* line = src.constScanLine(y * by + k);
+                const uint16_t* in = reinterpret_cast<const uint16_t*>(line);
+                if (!deep) {
+                    simd::widenU8ToU16(line, widened.data(), span);
+                    in = widened.data();
+                }
+                simd::accumulateU16(acc.data(), in, nullptr, span);
+            }
+            simd::binColumnsU32(acc.data(), acc.data(), static_cast<size_t>(w), bx);
+            if (wide) {
+                simd::scaleU32ToU16(acc.data(), reinterpret_cast<uint16_t*>(base + y * bpl), static_cast<size_t>(w), scale);
+            } else {
+                simd::scaleU32ToU16(acc.data(), row16.data(), static_cast<size_t>(w), scale);
+                simd::windowU16ToU8(row16.data(), base + y * bpl, static_cast<size_t>(w), 0, 255);
+            }
+        }
+    }, 16);
+    return out;
+}
+
+const QImage& SharedBinnedFrame::binned(int threads) {
+    std::call_once(once, [&]{ result = SoftwareBinning::apply(source, bin, threads); });
+    return result;
+}
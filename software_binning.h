@@ -0,0 +1,50 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <mutex>
+
+// Software binning of native 16-bit (or 8-bit) frames for the live display
+// and analysis. Unlike the sensor binning in DcamController::apply it
+// never touches the capture mode, so recording stays at full resolution;
+// only the frames that are shown or measured shrink, and everything
+// downstream of the binning reads a fraction of the data.
+class SoftwareBinning {
+public:
+    struct Settings {
+        int x = 1;              // pixels per bin across and down, 1..16
+        int y = 1;
+        bool sum = false;       // summed (saturating at 16 bits) instead of the rounded mean
+        bool isNone() const { return x <= 1 && y <= 1; }
+        int pixels() const { return x * y; }
+        // Binned pixel coordinates (centres at integers) in sensor pixels.
+        double sensorX(double bx) const { return (bx + 0.5) * x - 0.5; }
+        double sensorY(double by) const { return (by + 0.5) * y - 0.5; }
+        bool operator==(const Settings& o) const { return x == o.x && y == o.y && sum == o.sum; }
+        bool operator!=(const Settings& o) const { return !(*this == o); }
+    };
+    static constexpr int kMaxFactor = 16;
+
+    // Partial bins at the right and bottom edges are dropped, like the
+    // sensor does. 16-bit frames stay 16-bit; 8-bit frames stay 8-bit for
+    // the mean and become 16-bit for the sum. Returns img unchanged when
+    // no binning is set or the frame is smaller than one bin.
+    static QImage apply(const QImage& img, const Settings& s, int threads = 1);
+    static QString describe(const Settings& s);
+};
+
+// One acquired frame shared by several consumers that each want it binned
+// the same way: the first to ask bins it on its own thread and the rest
+// reuse the result, so the grabber thread never bins and no frame is
+// binned twice.
+class SharedBinnedFrame {
+public:
+    SharedBinnedFrame(const QImage& img, const SoftwareBinning::Settings& s) : source(img), bin(s) {}
+    const QImage& binned(int threads);
+    const SoftwareBinning::Settings& settings() const { return bin; }
+
+private:
+    const QImage source;
+    const SoftwareBinning::Settings bin;
+    std::once_flag once;
+    QImage result;
+};
@@ -0,0 +1,170 @@
+#include "spot_tracker.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+constexpr int kMinHalfWindow = 16;
+constexpr double kMinContrast = 8.0;    // DN above background to call it a spot
+}
+
+SpotTracker::SpotTracker(QObject* parent)
+    : LiveAnalyzer(parent), threshold(0.1f), logging(false), logged(0) {}
+
+SpotTracker::~SpotTracker() {
+    stopAnalysis();
+    stopLog();
+}
+
+void SpotTracker::setThreshold(double fraction) {
+    threshold = static_cast<float>(std::clamp(fraction, 0.0, 0.9));
+}
+
+SpotTracker::Spot SpotTracker::latest() const {
+    QMutexLocker lk(&resultMutex);
+    return last;
+}
+
+void SpotTracker::clearResults() {
+    nextWindow = QRect();
+    QMutexLocker lk(&resultMutex);
+    last = Spot();
+}
+
+QString SpotTracker::startLog(const QString& path) {
+    QMutexLocker lk(&logMutex);
+    if (logFile.isOpen()) logFile.close();
+    logFile.setFileName(path);
+    if (!logFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return logFile.errorString();
+    logStream.setDevice(&logFile);
+    logStream << "framestamp,time_s,skipped,found,x,y,sigma_x,sigma_y,d4s_major,d4s_minor,angle_deg,ellipticity,peak,background,sum\n";
+    logged = 0;
+    lastLoggedStamp = -1;
+    logging = true;
+    return {};
+}
+
+void SpotTracker::stopLog() {
+    QMutexLocker lk(&logMutex);
+    logging = false;
+    if (!logFile.isOpen()) return;
+    logStream.flush();
+    logStream.setDevice(nullptr);
+    logFile.close();
+}
+
+void SpotTracker::analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    QImage src = (deep || img.format() == QImage::Format_Grayscale8) ? img : img.convertToFormat(QImage::Format_Grayscale8);
+    QRect win = nextWindow.intersected(roi);
+    if (win.width() < 3 || win.height() < 3) win = roi;
+
+    // The window is small once tracking, so keep its rows at 16 bits for both passes.
+    const int w = win.width();
+    const int h = win.height();
+    std::vector<uint16_t> pixels;
+    const uint16_t* rows = nullptr;
+    qsizetype stride = 0;
+    if (deep) {
+        rows = reinterpret_cast<const uint16_t*>(src.constScanLine(win.top())) + win.left();
+        stride = src.bytesPerLine() / 2;
+    } else {
+        pixels.resize(static_cast<size_t>(w) * h);
+        for (int y = 0; y < h; ++y) {
+            simd::widenU8ToU16(src.constScanLine(win.top() + y) + win.left(), pixels.data() + static_cast<size_t>(y) * w,
+                               static_cast<size_t>(w));
+        }
+        rows = pixels.data();
+        stride = w;
+    }
+    auto row = [&](int y) { return rows + y * stride; };
+
+    Spot s;
+    s.framestamp = meta.framestamp;
+    s.time = meta.timestamp;
+    s.window = win;
+
+    // Pass 1: peak and the border mean as the local background.
+    uint16_t peak = 0;
+    double border = 0.0;
+    for (int y = 0; y < h; ++y) {
+        peak = std::max(peak, simd::rowMaxU16(row(y), static_cast<size_t>(w), nullptr));
+        if (y == 0 || y == h - 1) {
+            uint64_t sum = 0, sq = 0;
+            simd::momentsU16(row(y), static_cast<size_t>(w), sum, sq);
+            border += static_cast<double>(sum);
+        } else {
+            border += row(y)[0] + row(y)[w - 1];
+        }
+    }
+    s.background = border / (2.0 * w + 2.0 * (h - 2));
+    s.peak = peak;
+
+    // Pass 2: moments above the threshold, x per row from the kernel, y folded in here.
+    double sw = 0, sx = 0, sxx = 0, sy = 0, syy = 0, sxy = 0;
+    if (peak - s.background >= kMinContrast) {
+        const int thr = static_cast<int>(s.background + threshold.load() * (peak - s.background));
+        const int bg = static_cast<int>(std::lround(s.background));
+        for (int y = 0; y < h; ++y) {
+            double rw = 0, rx = 0, rxx = 0;
+            simd::spotMomentsU16(row(y), static_cast<size_t>(w), thr, bg, rw, rx, rxx);
+            sw += rw;
+            sx += rx;
+            sxx += rxx;
+            sy += rw * y;
+            syy += rw * y * y;
+            sxy += rx * y;
+        }
+    }
+    if (sw > 0.0) {
+        const double cx = sx / sw;
+        const double cy = sy / sw;
+        const double vxx = std::max(0.0, sxx / sw - cx * cx);
+        const double vyy = std::max(0.0, syy / sw - cy * cy);
+        const double vxy = sxy / sw - cx * cy;
+        const double mid = 0.5 * (vxx + vyy);
+        const double spread = std::sqrt(0.25 * (vxx - vyy) * (vxx - vyy) + vxy * vxy);
+        s.found = true;
+        s.x = win.left() + cx;
+        s.y = win.top() + cy;
+        s.sigmaX = std::sqrt(vxx);
+        s.sigmaY = std::sqrt(vyy);
+        s.major = 4.0 * std::sqrt(mid + spread);
+        s.minor = 4.0 * std::sqrt(std::max(0.0, mid - spread));
+        s.angle = qRadiansToDegrees(0.5 * std::atan2(2.0 * vxy, vxx - vyy));
+        s.ellipticity = s.major > 0.0 ? s.minor / s.major : 0.0;
+        s.sum = sw;
+        // Next frame: three D4-sigma widths around this centroid.
+        const int half = std::max(kMinHalfWindow, static_cast<int>(std::ceil(1.5 * s.major)));
+        nextWindow = QRect(static_cast<int>(std::lround(s.x)) - half, static_cast<int>(std::lround(s.y)) - half,
+                           2 * half + 1, 2 * half + 1);
+    } else {
+        nextWindow = QRect();   // lost: search the whole ROI again
+    }
+
+    {
+        QMutexLocker lk(&resultMutex);
+        last = s;
+    }
+    if (!logging.load()) return;
+    QMutexLocker lk(&logMutex);
+    if (!logFile.isOpen()) return;
+    // Logged in sensor pixels, like a recording of the same run; the
+    // principal widths of a non-square bin use the mean scale.
+    const SoftwareBinning::Settings bin = binning();
+    const double scale = std::sqrt(static_cast<double>(bin.pixels()));
+    const double sum = bin.sum ? s.sum : s.sum * bin.pixels();
+    // Frames dropped by the queue (or by the camera) leave a gap in the
+    // framestamps; the row after one says how many frames are missing.
+    const qint64 skipped = lastLoggedStamp < 0 ? 0 : std::max<qint64>(0, s.framestamp - lastLoggedStamp - 1);
+    lastLoggedStamp = s.framestamp;
+    logStream << s.framestamp << "," << QString::number(s.time, 'f', 6) << "," << skipped << "," << (s.found ? 1 : 0) << ","
+              << QString::number(s.found ? bin.sensorX(s.x) : 0.0, 'f', 3) << ","
+              << QString::number(s.found ? bin.sensorY(s.y) : 0.0, 'f', 3) << ","
+              << QString::number(s.sigmaX * bin.x, 'f', 3) << "," << QString::number(s.sigmaY * bin.y, 'f', 3) << ","
+              << QString::number(s.major * scale, 'f', 3) << "," << QString::number(s.minor * scale, 'f', 3) << ","
+              << QString::number(s.angle, 'f', 2) << "," << QString::number(s.ellipticity, 'f', 4) << ","
+              << s.peak << "," << QString::number(s.background, 'f', 2) << "," << QString::number(sum, 'f', 0) << "\n";
+    ++logged;
+}
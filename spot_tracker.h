@@ -0,0 +1,63 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include "live_analyzer.h"
+
+// Beam / spot profile of every acquired frame: background-subtracted first
+// and second moments above a threshold, in the ISO 11146 D4-sigma sense.
+// After the first hit only a window of three beam widths around the last
+// centroid is read, so the cost follows the spot size, not the frame size.
+// Results can be logged to CSV at the camera rate from the analysis thread,
+// with positions and widths in sensor pixels under software binning. Each
+// row carries the number of frames missing before it (dropped under load).
+class SpotTracker : public LiveAnalyzer {
+    Q_OBJECT
+public:
+    struct Spot {
+        bool found = false;
+        qint64 framestamp = 0;
+        double time = 0.0;
+        double x = 0.0;             // centroid, frame pixels
+        double y = 0.0;
+        double sigmaX = 0.0;        // second-moment widths along x / y
+        double sigmaY = 0.0;
+        double major = 0.0;         // D4-sigma widths of the principal axes
+        double minor = 0.0;
+        double angle = 0.0;         // major axis against +x, degrees
+        double ellipticity = 0.0;   // minor / major
+        double peak = 0.0;
+        double background = 0.0;    // mean of the window border
+        double sum = 0.0;           // integrated signal above background
+        QRect window;               // pixels read for this frame
+    };
+
+    explicit SpotTracker(QObject* parent=nullptr);
+    ~SpotTracker() override;
+
+    // Pixels count when they exceed background + fraction * (peak - background).
+    void setThreshold(double fraction);
+    Spot latest() const;
+
+    QString startLog(const QString& path);
+    void stopLog();
+    bool isLogging() const { return logging.load(); }
+    qint64 loggedFrames() const { return logged.load(); }
+
+protected:
+    void analyze(const QImage& img, const FrameMeta& meta, const QRect& roi) override;
+    void clearResults() override;
+
+private:
+    std::atomic<float> threshold;
+    mutable QMutex resultMutex;
+    Spot last;
+    QRect nextWindow;           // analysis thread only
+
+    QMutex logMutex;
+    QFile logFile;
+    QTextStream logStream;
+    std::atomic<bool> logging;
+    std::atomic<qint64> logged;
+    qint64 lastLoggedStamp = -1;    // guarded by logMutex
+};
@@ -0,0 +1,296 @@
+#include "temporal_median.h"
+#include "frame_sequence.h"
+#include "ordered_pipeline.h"
+#include "parallel.h"
+#include "raw_container.h"
+#include "simd_kernels.h"
+#include "tiff_writer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+struct DecodedFrame {
+    QImage image;
+    QString error;
+};
+
+QImage toGray(const QImage& img) {
+    if (img.format() == QImage::Format_Grayscale8 || img.format() == QImage::Format_Grayscale16) return img;
+    return img.convertToFormat(img.depth() == 16 ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+}
+} // namespace
+
+void TemporalMedian::configure(int window, Statistic statistic, double trimFraction) {
+    win = std::clamp(window, 1, kMaxWindow);
+    stat = statistic;
+    trim = std::clamp(trimFraction, 0.0, 0.45);
+    reset();
+}
+
+void TemporalMedian::reset() {
+    width = height = 0;
+    pixels = 0;
+    ring.clear();
+    head = fill = 0;
+    sorted.clear();
+}
+
+qint64 TemporalMedian::memoryBytes(int w, int h, int window) {
+    const qint64 n = static_cast<qint64>(w) * h;
+    return n * window * 2 * (window > kMaxNetwork ? 2 : 1);
+}
+
+void TemporalMedian::subtract(const uint16_t* frame, const uint16_t* background, int pedestal, uint16_t* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<uint16_t>(std::clamp(static_cast<int>(frame[i]) - background[i] + pedestal, 0, 65535));
+    }
+}
+
+const uint16_t* TemporalMedian::frame(int age) const {
+    if (age < 0 || age >= fill) return nullptr;
+    return ring[(head - 1 - age + 2 * win) % win].data();
+}
+
+void TemporalMedian::rankRange(int count, int& rlo, int& rhi) const {
+    if (stat == Statistic::Median) {
+        // Even counts average the two middle values.
+        rlo = (count - 1) / 2;
+        rhi = count / 2;
+        return;
+    }
+    const int t = std::min(static_cast<int>(trim * count), (count - 1) / 2);
+    rlo = t;
+    rhi = count - 1 - t;
+}
+
+void TemporalMedian::push(const uint16_t* src, int w, int h, int threads) {
+    if (w != width || h != height || ring.empty()) {
+        reset();
+        width = w;
+        height = h;
+        pixels = static_cast<size_t>(w) * h;
+        ring.assign(win, std::vector<uint16_t>(pixels));
+        if (keepsSorted()) sorted.assign(pixels * win, 0);
+    }
+    std::vector<uint16_t>& slot = ring[head];
+    const bool full = fill == win;
+    parallelBands(height, threads, [&](int y0, int y1) {
+        const size_t i0 = static_cast<size_t>(y0) * width;
+        const size_t i1 = static_cast<size_t>(y1) * width;
+        if (keepsSorted()) {
+            // The oldest sample leaves and the new one goes in with a single
+            // shift of the values ranked between them.
+            for (size_t i = i0; i < i1; ++i) {
+                uint16_t* c = sorted.data() + i * win;
+                const uint16_t v = src[i];
+                if (!full) {
+                    uint16_t* at = std::upper_bound(c, c + fill, v);
+                    std::memmove(at + 1, at, (c + fill - at) * sizeof(uint16_t));
+                    *at = v;
+                    continue;
+                }
+                const uint16_t old = slot[i];
+                uint16_t* from = std::lower_bound(c, c + win, old);
+                if (v > old) {
+                    uint16_t* to = std::upper_bound(from + 1, c + win, v) - 1;
+                    std::memmove(from, from + 1, (to - from) * sizeof(uint16_t));
+                    *to = v;
+                } else {
+                    uint16_t* to = std::upper_bound(c, from, v);
+                    std::memmove(to + 1, to, (from - to) * sizeof(uint16_t));
+                    *to = v;
+                }
+            }
+        }
+        std::memcpy(slot.data() + i0, src + i0, (i1 - i0) * sizeof(uint16_t));
+    });
+    head = (head + 1) % win;
+    fill = full ? fill : fill + 1;
+}
+
+void TemporalMedian::compute(uint16_t* out, int threads) const {
+    if (fill == 0) return;
+    int rlo = 0, rhi = 0;
+    rankRange(fill, rlo, rhi);
+    if (!keepsSorted()) {
+        parallelBands(height, threads, [&](int y0, int y1) {
+            const size_t base = static_cast<size_t>(y0) * width;
+            const uint16_t* rows[kMaxNetwork];
+            for (int k = 0; k < fill; ++k) rows[k] = ring[k].data() + base;
+            simd::rankMeanU16(rows, fill, rlo, rhi, out + base, static_cast<size_t>(y1 - y0) * width);
+        });
+        return;
+    }
+    const float inv = 1.0f / (rhi - rlo + 1);
+    parallelBands(height, threads, [&](int y0, int y1) {
+        for (size_t i = static_cast<size_t>(y0) * width; i < static_cast<size_t>(y1) * width; ++i) {
+            const uint16_t* c = sorted.data() + i * win;
+            if (rlo == rhi) {
+                out[i] = c[rlo];
+                continue;
+            }
+            uint32_t sum = 0;
+            for (int k = rlo; k <= rhi; ++k) sum += c[k];
+            out[i] = static_cast<uint16_t>(std::lround(sum * inv));
+        }
+    });
+}
+
+QString TemporalFilter::run(const QString& sourcePath, const TemporalFilterOptions& opt,
+                            const Progress& progress, const std::atomic<bool>* cancel) {
+    FrameSequence src(64);
+    QString err = src.open(sourcePath);
+    if (!err.isEmpty()) return err;
+    if (!src.isOpen()) return "No frames in " + sourcePath;
+    const ExportOptions& out = opt.output;
+    if (out.outputPath.isEmpty()) return "No output path";
+
+    const int n = src.count();
+    const int first = std::clamp(out.first, 0, n - 1);
+    const int step = std::max(1, out.step);
+    const int total = SequenceExporter::frameCount(out, n);
+    const int threads = out.threads > 0 ? out.threads : std::max(1, QThread::idealThreadCount());
+    auto sourceIndex = [first, step](int k){ return first + k * step; };
+
+    QImage probe = SequenceExporter::transform(src.read(first, &err), out.roi, false, 0, 0);
+    if (probe.isNull()) return err.isEmpty() ? "ROI does not intersect the frame" : err;
+    const int w = probe.width();
+    const int h = probe.height();
+    const size_t pixels = static_cast<size_t>(w) * h;
+    const bool deep = probe.format() == QImage::Format_Grayscale16;
+    const int bits = deep && !out.applyWindow ? 16 : 8;
+    const int window = std::clamp(opt.window, 1, TemporalMedian::kMaxWindow);
+    const int half = (window - 1) / 2;
+
+    const bool toFolder = out.format == ExportOptions::Format::TiffSequence;
+    QString indexPath;
+    QString infoPath;
+    if (toFolder) {
+        QDir().mkpath(out.outputPath);
+        indexPath = QDir(out.outputPath).filePath("frame_index.csv");
+        infoPath = QDir(out.outputPath).filePath("capture_info.txt");
+    } else {
+        QDir().mkpath(QFileInfo(out.outputPath).absolutePath());
+        indexPath = FrameSequence::sidecarPath(out.outputPath, "_index.csv");
+        infoPath = FrameSequence::sidecarPath(out.outputPath, "_info.txt");
+    }
+    TiffWriter tiff;
+    RawContainerWriter raw;
+    if (out.format == ExportOptions::Format::MultiPageTiff) {
+        err = tiff.open(out.outputPath, static_cast<qint64>(pixels) * (bits / 8) * total > (3LL << 30));
+    } else if (out.format == ExportOptions::Format::RawContainer) {
+        err = raw.open(out.outputPath, w, h, bits);
+    }
+    if (!err.isEmpty()) return err;
+    QFile indexFile(indexPath);
+    QTextStream indexTs(&indexFile);
+    if (out.format != ExportOptions::Format::RawContainer && indexFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        indexTs << "index,framestamp,time_s\n";
+    }
+
+    const FrameTimeline& tl = src.timeline();
+    const int digits = std::max(6, static_cast<int>(std::ceil(std::log10(std::max(1, total)))));
+    const int progressEvery = std::max(1, total / 200);
+    QElapsedTimer timer;
+    timer.start();
+
+    TemporalMedian filter;
+    filter.configure(window, opt.statistic, opt.trim);
+    std::vector<uint16_t> input(pixels);
+    std::vector<uint16_t> background(pixels);
+    std::vector<uint16_t> result(pixels);
+    int nextOut = 0;
+
+    // Writes outputs nextOut..last against the current window; `newest` is
+    // the range position of the frame pushed last.
+    auto emitUpTo = [&](int last, int newest) -> bool {
+        if (nextOut > last) return true;
+        filter.compute(background.data(), threads);
+        for (; nextOut <= last; ++nextOut) {
+            const uint16_t* values = background.data();
+            if (opt.subtract) {
+                TemporalMedian::subtract(filter.frame(newest - nextOut), background.data(), opt.pedestal, result.data(), pixels);
+                values = result.data();
+            }
+            QImage img(w, h, deep ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+            for (int y = 0; y < h; ++y) {
+                const uint16_t* row = values + static_cast<size_t>(y) * w;
+                if (deep) std::memcpy(img.scanLine(y), row, static_cast<size_t>(w) * sizeof(uint16_t));
+                else simd::windowU16ToU8(row, img.scanLine(y), static_cast<size_t>(w), 0, 255);
+            }
+            if (out.applyWindow) img = SequenceExporter::transform(img, {}, true, out.black, out.white);
+            const int idx = sourceIndex(nextOut);
+            const double t = tl.timeAt(idx);
+            const qint64 stamp = tl.framestampAt(idx);
+            if (toFolder) err = TiffWriter::writeSingle(QString("%1/%2.tiff").arg(out.outputPath).arg(nextOut, digits, 10, QChar('0')), img);
+            else if (out.format == ExportOptions::Format::MultiPageTiff) err = tiff.appendPage(img);
+            else err = raw.append(img, stamp, t);
+            if (!err.isEmpty()) return false;
+            if (indexFile.isOpen()) indexTs << nextOut << "," << stamp << "," << QString::number(t, 'f', 6) << "\n";
+            if (progress && (nextOut % progressEvery == 0 || nextOut + 1 == total)) progress(nextOut + 1, total);
+        }
+        return true;
+    };
+
+    auto produce = [&](int k) -> DecodedFrame {
+        QString readErr;
+        const int idx = sourceIndex(k);
+        QImage img = SequenceExporter::transform(src.read(idx, &readErr), out.roi, false, 0, 0);
+        if (img.isNull()) return {QImage(), QString("Frame %1: %2").arg(idx).arg(readErr)};
+        if (img.size() != probe.size() || img.format() != probe.format()) {
+            return {QImage(), QString("Frame %1 differs in size or depth from the first frame").arg(idx)};
+        }
+        return {img, {}};
+    };
+
+    auto consume = [&](int k, DecodedFrame&& f) -> bool {
+        if (!f.error.isEmpty()) {
+            err = f.error;
+            return false;
+        }
+        for (int y = 0; y < h; ++y) {
+            uint16_t* row = input.data() + static_cast<size_t>(y) * w;
+            if (deep) std::memcpy(row, f.image.constScanLine(y), static_cast<size_t>(w) * sizeof(uint16_t));
+            else simd::widenU8ToU16(f.image.constScanLine(y), row, static_cast<size_t>(w));
+        }
+        filter.push(input.data(), w, h, threads);
+        // Frame c is centred in [c - half, c + window - 1 - half]; the first
+        // full window also covers the frames before its centre.
+        if (filter.filled() < window) return true;
+        return emitUpTo(k - (window - 1 - half), k);
+    };
+
+    bool ok = runOrderedPipeline<DecodedFrame>(total, threads, threads * 4, produce, consume, cancel);
+    // The tail, and short ranges that never fill the window, use the last one.
+    if (ok && !(cancel && cancel->load())) ok = emitUpTo(total - 1, total - 1);
+    indexTs.flush();
+    indexFile.close();
+    QString closeErr = tiff.close();
+    if (closeErr.isEmpty()) closeErr = raw.close();
+    if (!ok) return err.isEmpty() ? "Filter cancelled" : err;
+    if (cancel && cancel->load()) return "Filter cancelled";
+    if (!closeErr.isEmpty()) return closeErr;
+
+    const QString what = QString("temporal %1 of %2 frames%3")
+        .arg(opt.statistic == TemporalMedian::Statistic::Median ? "median" : QString("trimmed mean (%1)").arg(opt.trim))
+        .arg(window).arg(opt.subtract ? QString(", subtracted, pedestal %1").arg(opt.pedestal) : QString());
+    QFile infoFile(infoPath);
+    if (infoFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QTextStream ts(&infoFile);
+        ts << "Source: " << src.path() << "\n";
+        ts << "Frames: " << total << "\n";
+        ts << "Resolution: " << w << " x " << h << "\n";
+        ts << "Bits: " << bits << "\n";
+        if (src.fps() > 0.0) ts << "Internal FPS: " << src.fps() / step << "\n";
+        ts << "Range: " << first << " - " << sourceIndex(total - 1) << " step " << step << "\n";
+        if (!out.roi.isEmpty()) {
+            ts << "ROI: " << out.roi.x() << "," << out.roi.y() << "," << out.roi.width() << "," << out.roi.height() << "\n";
+        }
+        ts << "Filter: " << what << "\n";
+        if (out.applyWindow) ts << "Window: " << out.black << " - " << out.white << "\n";
+    }
+    qInfo() << "Temporal filter" << what << "," << total << "frames to" << out.outputPath
+            << "in" << timer.elapsed() << "ms";
+    return {};
+}
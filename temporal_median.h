@@ -0,0 +1,76 @@
+#pragma once
+#include <QtCore>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "sequence_exporter.h"
+
+// Per-pixel temporal median or trimmed mean over a sliding window of
+// frames, for denoising and background models. Windows of up to
+// kMaxNetwork frames are sorted per pixel by the SIMD sorting network.
+// Longer windows also keep every pixel's samples in sorted order, updated
+// by one insertion and removal per frame, so the ranks are read directly
+// and stay exact at twice the ring's memory. Work is split over row bands.
+class TemporalMedian {
+public:
+    enum class Statistic { Median, TrimmedMean };
+    static constexpr int kMaxNetwork = 16;
+    static constexpr int kMaxWindow = 255;
+
+    // Window in frames (1..kMaxWindow); trim is the fraction dropped at
+    // each end for the trimmed mean (0..0.45). Also resets.
+    void configure(int window, Statistic statistic, double trim);
+    void reset();
+    int window() const { return win; }
+    int filled() const { return fill; }
+    bool isEmpty() const { return fill == 0; }
+
+    // Adds a width x height frame; once the window is full the oldest
+    // frame leaves. A change of geometry starts over.
+    void push(const uint16_t* frame, int width, int height, int threads);
+    // The statistic over the frames currently in the window.
+    void compute(uint16_t* out, int threads) const;
+    // Frame pushed `age` frames ago (0 = newest), age < filled().
+    const uint16_t* frame(int age) const;
+    // Ring (plus sorted copy) memory for a window at this frame size.
+    static qint64 memoryBytes(int width, int height, int window);
+    // dst = max(0, frame - background + pedestal), clamped to 16 bits.
+    static void subtract(const uint16_t* frame, const uint16_t* background, int pedestal, uint16_t* dst, size_t n);
+
+private:
+    bool keepsSorted() const { return win > kMaxNetwork; }
+    void rankRange(int count, int& lo, int& hi) const;
+
+    int win = 9;
+    Statistic stat = Statistic::Median;
+    double trim = 0.2;
+    int width = 0;
+    int height = 0;
+    size_t pixels = 0;
+    std::vector<std::vector<uint16_t>> ring;
+    int head = 0;                   // slot of the next frame
+    int fill = 0;
+    std::vector<uint16_t> sorted;   // long windows: win ascending samples per pixel
+};
+
+struct TemporalFilterOptions {
+    ExportOptions output;           // range, crop, format and threads of the written sequence
+    int window = 9;                 // frames, centred on each output frame
+    TemporalMedian::Statistic statistic = TemporalMedian::Statistic::Median;
+    double trim = 0.2;
+    bool subtract = false;          // write frame - background instead of the filtered frame
+    int pedestal = 100;             // added after subtraction so negative residuals survive
+};
+
+// Denoised (or background-subtracted) copy of a recording range. Frames are
+// decoded and cropped on worker threads and fed to the filter in order;
+// each output frame uses the window centred on it, and the first and last
+// few frames reuse the nearest full window.
+class TemporalFilter {
+public:
+    using Progress = std::function<void(int done, int total)>;
+
+    static QString run(const QString& sourcePath, const TemporalFilterOptions& opt,
+                       const Progress& progress = {}, const std::atomic<bool>* cancel = nullptr);
+};
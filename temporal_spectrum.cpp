@@ -0,0 +1,325 @@
+#include "temporal_spectrum.h"
+#include "fft.h"
+#include "frame_sequence.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include "tiff_writer.h"
+#include <QtGui/QColor>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kPixelBlock = 16;     // pixels resampled together: one 32-byte run per frame
+
+using Complex = FftPlan::Complex;
+
+// Uniform sample j lies between local frames at[j] and at[j] + 1, weight
+// frac[j] on the later one.
+struct Resampling {
+    std::vector<int> at;
+    std::vector<float> frac;
+};
+
+// Hann-tapered, mean-free spectra of two real series at once: pack them as
+// a + i b, transform, and split the halves by conjugate symmetry.
+class PairSpectra {
+public:
+    PairSpectra(int n, const std::vector<float>& window)
+        : plan(FftPlan::cached(n)), n(n), window(window), z(n), work(n) {
+        double sumSq = 0.0;
+        for (float w : window) sumSq += static_cast<double>(w) * w;
+        // One-sided: the AC bins of a series sum to its variance, in DN^2.
+        norm = static_cast<float>(2.0 / (n * sumSq));
+    }
+
+    // b may be null. Power goes to pa / pb, n / 2 + 1 bins each.
+    void run(const float* a, const float* b, float* pa, float* pb) {
+        double ma = 0.0, mb = 0.0;
+        for (int j = 0; j < n; ++j) {
+            ma += a[j];
+            if (b) mb += b[j];
+        }
+        const float meanA = static_cast<float>(ma / n);
+        const float meanB = static_cast<float>(mb / n);
+        for (int j = 0; j < n; ++j) {
+            z[j] = Complex((a[j] - meanA) * window[j], b ? (b[j] - meanB) * window[j] : 0.0f);
+        }
+        plan->forward(z.data(), work.data());
+        for (int k = 0; k <= n / 2; ++k) {
+            const Complex zk = z[k];
+            const Complex zn = std::conj(z[(n - k) % n]);
+            pa[k] = std::norm(zk + zn) * 0.25f * norm;
+            if (b) pb[k] = std::norm(zk - zn) * 0.25f * norm;
+        }
+    }
+
+private:
+    std::shared_ptr<const FftPlan> plan;
+    int n;
+    const std::vector<float>& window;
+    float norm;
+    std::vector<Complex> z;
+    std::vector<Complex> work;
+};
+
+// Largest bin at or above kMin, refined by a parabola through its neighbours,
+// and its share of the AC power.
+void dominant(const float* power, int bins, int kMin, double binHz, float& hz, float& share) {
+    double total = 0.0;
+    int best = -1;
+    for (int k = 1; k < bins; ++k) {
+        total += power[k];
+        if (k >= kMin && (best < 0 || power[k] > power[best])) best = k;
+    }
+    if (best < 0 || total <= 0.0) {
+        hz = 0.0f;
+        share = 0.0f;
+        return;
+    }
+    double offset = 0.0;
+    if (best > 0 && best + 1 < bins) {
+        const double l = power[best - 1], c = power[best], r = power[best + 1];
+        const double den = l - 2.0 * c + r;
+        if (den < 0.0) offset = std::clamp(0.5 * (l - r) / den, -0.5, 0.5);
+    }
+    hz = static_cast<float>((best + offset) * binHz);
+    share = static_cast<float>(power[best] / total);
+}
+} // namespace
+
+QString TemporalSpectrum::run(const QString& sourcePath, const TemporalSpectrumOptions& opt, TemporalSpectrumResult& result,
+                              const Progress& progress, const std::atomic<bool>* cancel) {
+    result = TemporalSpectrumResult();
+    FrameSequence src(64);
+    QString err = src.open(sourcePath);
+    if (!err.isEmpty()) return err;
+    if (!src.isOpen()) return "No frames in " + sourcePath;
+    const FrameTimeline& tl = src.timeline();
+    const double dt = tl.nominalInterval();
+    if (tl.isEmpty() || dt <= 0.0) return "The recording has no time axis (no frame index and no frame rate)";
+
+    // Uniform grid from the first frame at the median interval, as long as
+    // the range allows and no longer than asked.
+    const int count = src.count();
+    const int first = std::clamp(opt.first, 0, count - 1);
+    const int last = opt.last < 0 ? count - 1 : std::clamp(opt.last, first, count - 1);
+    const double t0 = tl.timeAt(first);
+    const int available = static_cast<int>(std::floor((tl.timeAt(last) - t0) / dt + 1e-6)) + 1;
+    const int n = FftPlan::fastSizeAtMost(std::min(available, std::max(16, opt.maxSamples)));
+    if (n < 16) return QString("Only %1 samples in the range; at least 16 are needed").arg(available);
+
+    Resampling grid;
+    grid.at.resize(n);
+    grid.frac.resize(n);
+    int frames = 1;
+    for (int j = 0, i = first; j < n; ++j) {
+        const double t = t0 + j * dt;
+        while (i + 1 <= last && tl.timeAt(i + 1) <= t) ++i;
+        const double ta = tl.timeAt(i);
+        const double tb = i + 1 <= last ? tl.timeAt(i + 1) : ta;
+        grid.at[j] = i - first;
+        grid.frac[j] = tb > ta ? static_cast<float>(std::clamp((t - ta) / (tb - ta), 0.0, 1.0)) : 0.0f;
+        frames = std::max(frames, std::min(i + 1, last) - first + 1);
+    }
+
+    QImage probe = src.read(first, &err);
+    if (probe.isNull()) return err;
+    const QRect roi = opt.roi.isEmpty() ? probe.rect() : opt.roi.intersected(probe.rect());
+    if (roi.isEmpty()) return "ROI does not intersect the frame";
+    const int w = roi.width();
+    const int h = roi.height();
+
+    // Each pass holds every frame of a band of rows as 16-bit samples.
+    const qint64 rowBytes = static_cast<qint64>(frames) * w * 2;
+    const int bandRows = static_cast<int>(std::clamp<qint64>(opt.memoryBytes / std::max<qint64>(1, rowBytes), 1, h));
+    const int passes = (h + bandRows - 1) / bandRows;
+    const int threads = opt.threads > 0 ? opt.threads : std::max(1, QThread::idealThreadCount());
+    const int bins = n / 2 + 1;
+    const double binHz = 1.0 / (n * dt);
+    const int kMin = std::clamp(static_cast<int>(std::ceil(opt.minHz / binHz)), 1, bins - 1);
+
+    std::vector<float> window(n);
+    for (int j = 0; j < n; ++j) window[j] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * (j + 0.5) / n));
+
+    result.roi = roi;
+    result.samples = n;
+    result.framesRead = frames;
+    result.passes = passes;
+    result.sampleRate = 1.0 / dt;
+    result.frequency.resize(bins);
+    for (int k = 0; k < bins; ++k) result.frequency[k] = k * binHz;
+    result.meanPower.assign(bins, 0.0);
+    result.dominantHz.assign(static_cast<size_t>(w) * h, 0.0f);
+    result.dominantShare.assign(static_cast<size_t>(w) * h, 0.0f);
+
+    std::vector<double> frameSum(frames, 0.0);
+    std::vector<uint16_t> band;
+    std::mutex mutex;
+    std::atomic<int> done{0};
+    const int total = passes * frames + h;
+    auto report = [&](int step) {
+        const int d = done += step;
+        if (progress) progress(d, total);
+    };
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int pass = 0; pass < passes; ++pass) {
+        const int y0 = pass * bandRows;
+        const int rows = std::min(bandRows, h - y0);
+        const size_t bandPixels = static_cast<size_t>(rows) * w;
+        band.resize(static_cast<size_t>(frames) * bandPixels);
+
+        // Decode in parallel; each frame lands in its own slice, so workers
+        // never share a cache line.
+        parallelBands(frames, threads, [&](int f0, int f1) {
+            std::vector<uint16_t> widened(w);
+            for (int f = f0; f < f1; ++f) {
+                if (cancel && cancel->load()) return;
+                QString readErr;
+                QImage img = src.read(first + f, &readErr);
+                if (!img.isNull() && img.format() != QImage::Format_Grayscale8 && img.format() != QImage::Format_Grayscale16) {
+                    img = img.convertToFormat(QImage::Format_Grayscale16);
+                }
+                if (img.isNull() || img.size() != probe.size()) {
+                    std::lock_guard<std::mutex> lk(mutex);
+                    if (err.isEmpty()) err = QString("Frame %1: %2").arg(first + f)
+                                                 .arg(img.isNull() ? readErr : QString("size differs from the first frame"));
+                    return;
+                }
+                uint16_t* dst = band.data() + static_cast<size_t>(f) * bandPixels;
+                uint64_t sum = 0;
+                for (int y = 0; y < rows; ++y) {
+                    const uchar* line = img.constScanLine(roi.top() + y0 + y);
+                    const uint16_t* row = nullptr;
+                    if (img.format() == QImage::Format_Grayscale16) {
+                        row = reinterpret_cast<const uint16_t*>(line) + roi.left();
+                    } else {
+                        simd::widenU8ToU16(line + roi.left(), widened.data(), static_cast<size_t>(w));
+                        row = widened.data();
+                    }
+                    std::copy(row, row + w, dst + static_cast<size_t>(y) * w);
+                    for (int x = 0; x < w; ++x) sum += row[x];
+                }
+                frameSum[f] += static_cast<double>(sum);
+                report(1);
+            }
+        }, 1);
+        if (cancel && cancel->load()) return "Analysis cancelled";
+        if (!err.isEmpty()) return err;
+
+        // Tiles of kPixelBlock pixels, in parallel: resample the block's
+        // series from the band, transform them in pairs, keep the peak.
+        const int blocks = static_cast<int>((bandPixels + kPixelBlock - 1) / kPixelBlock);
+        parallelBands(blocks, threads, [&](int b0, int b1) {
+            PairSpectra spectra(n, window);
+            std::vector<float> series(static_cast<size_t>(kPixelBlock) * n);
+            std::vector<float> power(static_cast<size_t>(kPixelBlock) * bins);
+            std::vector<double> sum(bins, 0.0);
+            for (int b = b0; b < b1; ++b) {
+                if (cancel && cancel->load()) return;
+                const size_t p0 = static_cast<size_t>(b) * kPixelBlock;
+                const int count = static_cast<int>(std::min<size_t>(kPixelBlock, bandPixels - p0));
+                for (int j = 0; j < n; ++j) {
+                    const uint16_t* fa = band.data() + static_cast<size_t>(grid.at[j]) * bandPixels + p0;
+                    const uint16_t* fb = grid.at[j] + 1 < frames ? fa + bandPixels : fa;
+                    const float t = grid.frac[j];
+                    for (int k = 0; k < count; ++k) {
+                        series[static_cast<size_t>(k) * n + j] = fa[k] + t * (static_cast<float>(fb[k]) - fa[k]);
+                    }
+                }
+                for (int k = 0; k < count; k += 2) {
+                    const bool pair = k + 1 < count;
+                    float* pa = power.data() + static_cast<size_t>(k) * bins;
+                    spectra.run(series.data() + static_cast<size_t>(k) * n,
+                                pair ? series.data() + static_cast<size_t>(k + 1) * n : nullptr,
+                                pa, pair ? pa + bins : nullptr);
+                }
+                for (int k = 0; k < count; ++k) {
+                    const float* pk = power.data() + static_cast<size_t>(k) * bins;
+                    const size_t out = static_cast<size_t>(y0) * w + p0 + k;
+                    dominant(pk, bins, kMin, binHz, result.dominantHz[out], result.dominantShare[out]);
+                    for (int q = 0; q < bins; ++q) sum[q] += pk[q];
+                }
+                // Progress in whole rows of the ROI.
+                const int rowsNow = static_cast<int>((p0 + count) / w) - static_cast<int>(p0 / w);
+                if (rowsNow > 0) report(rowsNow);
+            }
+            std::lock_guard<std::mutex> lk(mutex);
+            for (int q = 0; q < bins; ++q) result.meanPower[q] += sum[q];
+        }, 4);
+        if (cancel && cancel->load()) return "Analysis cancelled";
+    }
+
+    const double pixels = static_cast<double>(w) * h;
+    for (double& p : result.meanPower) p /= pixels;
+    // Flicker moves every pixel together, so it survives averaging over the
+    // ROI; vibration mostly moves edges in opposite directions and does not.
+    std::vector<float> trace(n);
+    for (int j = 0; j < n; ++j) {
+        const int a = grid.at[j];
+        const int b = std::min(a + 1, frames - 1);
+        trace[j] = static_cast<float>((frameSum[a] + grid.frac[j] * (frameSum[b] - frameSum[a])) / pixels);
+    }
+    std::vector<float> coherent(bins);
+    PairSpectra(n, window).run(trace.data(), nullptr, coherent.data(), nullptr);
+    result.coherentPower.assign(coherent.begin(), coherent.end());
+
+    qInfo() << "Temporal spectrum of" << w << "x" << h << "pixels," << n << "samples at"
+            << result.sampleRate << "Hz from" << frames << "frames in" << passes << "passes,"
+            << timer.elapsed() << "ms using" << threads << "threads";
+    return {};
+}
+
+QImage TemporalSpectrumResult::renderMap() const {
+    if (isEmpty()) return {};
+    const double nyquist = 0.5 * sampleRate;
+    // A pure tone through the Hann window keeps about 2/3 of its power in
+    // the peak bin; scale so that reads as full brightness.
+    constexpr double kFullShare = 0.6;
+    QImage out(roi.size(), QImage::Format_RGB32);
+    for (int y = 0; y < roi.height(); ++y) {
+        QRgb* dst = reinterpret_cast<QRgb*>(out.scanLine(y));
+        for (int x = 0; x < roi.width(); ++x) {
+            const size_t i = static_cast<size_t>(y) * roi.width() + x;
+            const double hue = std::clamp(dominantHz[i] / nyquist, 0.0, 1.0) * (240.0 / 360.0);
+            const double value = std::sqrt(std::clamp(dominantShare[i] / kFullShare, 0.0, 1.0));
+            dst[x] = QColor::fromHsvF(static_cast<float>(hue), 1.0f, static_cast<float>(value)).rgb();
+        }
+    }
+    return out;
+}
+
+QString TemporalSpectrumResult::peaks(const std::vector<double>& power, double minHz, int count) const {
+    std::vector<int> maxima;
+    for (int k = 1; k + 1 < static_cast<int>(power.size()); ++k) {
+        if (frequency[k] >= minHz && power[k] > power[k - 1] && power[k] >= power[k + 1]) maxima.push_back(k);
+    }
+    std::sort(maxima.begin(), maxima.end(), [&](int a, int b) { return power[a] > power[b]; });
+    if (static_cast<int>(maxima.size()) > count) maxima.resize(count);
+    QStringList lines;
+    for (int k : maxima) lines << QString("%1 Hz (power %2)").arg(frequency[k], 0, 'f', 2).arg(power[k], 0, 'g', 3);
+    return lines.join("\n");
+}
+
+QString TemporalSpectrumResult::save(const QString& basePath) const {
+    if (isEmpty()) return "Nothing to save";
+    const QString base = QFileInfo(basePath).absoluteDir().absoluteFilePath(QFileInfo(basePath).completeBaseName());
+    QString err = TiffWriter::writeSingleFloat(base + ".tiff", dominantHz.data(), roi.width(), roi.height());
+    if (err.isEmpty()) err = TiffWriter::writeSingleFloat(base + "_share.tiff", dominantShare.data(), roi.width(), roi.height());
+    if (!err.isEmpty()) return err;
+    QFile f(base + "_spectrum.csv");
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return f.errorString();
+    QTextStream out(&f);
+    out << "frequency_hz,mean_pixel_power,roi_mean_power\n";
+    for (size_t k = 0; k < frequency.size(); ++k) {
+        out << QString::number(frequency[k], 'f', 4) << ","
+            << QString::number(meanPower[k], 'g', 6) << ","
+            << QString::number(coherentPower[k], 'g', 6) << "\n";
+    }
+    out.flush();
+    if (f.error() != QFileDevice::NoError) return f.errorString();
+    return {};
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+struct TemporalSpectrumOptions {
+    int first = 0;
+    int last = -1;              // inclusive, -1 = last frame
+    int maxSamples = 1024;      // series length, rounded down to a fast FFT size
+    QRect roi;                  // empty = full frame
+    double minHz = 0.0;         // dominant-frequency search starts here, to skip slow drift
+    qint64 memoryBytes = qint64(512) << 20;  // frame data held at once; sets the tile height
+    int threads = 0;            // 0 = one per core
+};
+
+// Per-pixel temporal spectra of a recording chunk, for finding illumination
+// flicker and mechanical resonances. Frame times come from the recording's
+// index and are resampled linearly onto a uniform grid at the median frame
+// interval, so jitter and dropped frames do not smear the frequency axis.
+struct TemporalSpectrumResult {
+    QRect roi;
+    int samples = 0;            // uniform samples per series
+    int framesRead = 0;         // source frames spanning them
+    int passes = 0;             // tiles of rows streamed through memory
+    double sampleRate = 0.0;    // Hz
+    std::vector<double> frequency;      // Hz of each bin, samples / 2 + 1 of them
+    // One-sided power per bin, DN^2: the AC bins of a series sum to its variance.
+    std::vector<double> meanPower;      // per-pixel power averaged over the ROI
+    std::vector<double> coherentPower;  // power of the ROI's mean intensity
+    std::vector<float> dominantHz;      // per pixel, row-major over roi
+    std::vector<float> dominantShare;   // that peak's fraction of the pixel's AC power
+
+    bool isEmpty() const { return samples == 0; }
+    // Hue runs from red at 0 Hz to blue at Nyquist, brightness follows the share.
+    QImage renderMap() const;
+    // Strongest local maxima of a spectrum at or above minHz, as "f Hz" lines.
+    QString peaks(const std::vector<double>& power, double minHz, int count) const;
+    // <base>.tiff (dominant Hz), <base>_share.tiff and <base>_spectrum.csv.
+    QString save(const QString& basePath) const;
+};
+
+class TemporalSpectrum {
+public:
+    using Progress = std::function<void(int done, int total)>;
+
+    static QString run(const QString& sourcePath, const TemporalSpectrumOptions& opt, TemporalSpectrumResult& result,
+                       const Progress& progress = {}, const std::atomic<bool>* cancel = nullptr);
+};
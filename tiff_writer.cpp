@@ -0,0 +1,373 @@
+#include "tiff_writer.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+namespace {
+enum TiffType : quint16 { Short = 3, Long = 4, Long8 = 16 };
+
+template <typename T>
+void put(QByteArray& buf, T v) {
+    T le = qToLittleEndian(v);
+    buf.append(reinterpret_cast<const char*>(&le), sizeof(T));
+}
+
+// Unsigned field of 1..8 bytes in the file's byte order.
+quint64 field(const char* p, int bytes, bool bigEndian) {
+    quint64 v = 0;
+    for (int i = 0; i < bytes; ++i) {
+        const quint64 b = static_cast<uchar>(p[bigEndian ? i : bytes - 1 - i]);
+        v = (v << 8) | b;
+    }
+    return v;
+}
+
+int typeBytes(quint64 type) {
+    switch (type) {
+    case 1: return 1;           // BYTE
+    case 3: return 2;           // SHORT
+    case 4: return 4;           // LONG
+    case Long8: return 8;
+    default: return 0;
+    }
+}
+
+constexpr int kMaxPages = 1 << 24;
+constexpr quint64 kMaxStrips = 1 << 20;
+} // namespace
+
+TiffWriter::~TiffWriter() {
+    close();
+}
+
+QString TiffWriter::open(const QString& path, bool bigTiff) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return QString("Cannot open %1: %2").arg(path, file.errorString());
+    }
+    big = bigTiff;
+    pages = 0;
+    endPos = 0;
+    QByteArray hdr;
+    hdr.append("II", 2);
+    if (big) {
+        put<quint16>(hdr, 43);
+        put<quint16>(hdr, 8);
+        put<quint16>(hdr, 0);
+        nextOffsetPos = hdr.size();
+        put<quint64>(hdr, 0);
+    } else {
+        put<quint16>(hdr, 42);
+        nextOffsetPos = hdr.size();
+        put<quint32>(hdr, 0);
+    }
+    if (file.write(hdr) != hdr.size()) return "TIFF header write failed";
+    endPos = hdr.size();
+    return {};
+}
+
+QString TiffWriter::appendPage(const QImage& img) {
+    if (img.isNull()) return "Empty image";
+    QImage gray = img;
+    if (gray.format() != QImage::Format_Grayscale8 && gray.format() != QImage::Format_Grayscale16) {
+        gray = img.convertToFormat(img.depth() > 8 && img.isGrayscale() ? QImage::Format_Grayscale16
+                                                                          : QImage::Format_Grayscale8);
+    }
+    int bits = gray.format() == QImage::Format_Grayscale16 ? 16 : 8;
+    return appendPage(gray.constBits(), gray.width(), gray.height(), gray.bytesPerLine(), bits);
+}
+
+QString TiffWriter::appendFloatPage(const float* data, int width, int height) {
+    return appendPage(reinterpret_cast<const uchar*>(data), width, height,
+                      static_cast<qsizetype>(width) * sizeof(float), 32, 3);
+}
+
+QString TiffWriter::appendPage(const uchar* data, int width, int height, qsizetype bytesPerLine, int bitsPerSample,
+                               int sampleFormat) {
+    if (!file.isOpen()) return "TIFF not open";
+    if (!data || width <= 0 || height <= 0) return "Empty page";
+
+    const qint64 rowBytes = static_cast<qint64>(width) * (bitsPerSample / 8);
+    const qint64 dataBytes = rowBytes * height;
+    qint64 dataOffset = endPos;
+    if (!big && dataOffset + dataBytes + 512 > 0xFFFFFFFFLL) {
+        return "TIFF would exceed 4 GB; use BigTIFF";
+    }
+    file.seek(dataOffset);
+    if (bytesPerLine == rowBytes) {
+        if (file.write(reinterpret_cast<const char*>(data), dataBytes) != dataBytes) return "TIFF data write failed";
+    } else {
+        for (int y = 0; y < height; ++y) {
+            if (file.write(reinterpret_cast<const char*>(data + y * bytesPerLine), rowBytes) != rowBytes) {
+                return "TIFF data write failed";
+            }
+        }
+    }
+
+    qint64 ifdOffset = file.pos();
+    if (ifdOffset & 1) {
+        file.write("\0", 1);
+        ++ifdOffset;
+    }
+
+    struct Entry { quint16 tag; quint16 type; quint64 value; };
+    std::vector<Entry> entries = {
+        {254, Long, 0},                                        // NewSubfileType: full image, every page
+        {256, Long, static_cast<quint64>(width)},
+        {257, Long, static_cast<quint64>(height)},
+        {258, Short, static_cast<quint64>(bitsPerSample)},
+        {259, Short, 1},                                       // no compression
+        {262, Short, 1},                                       // BlackIsZero
+        {273, big ? Long8 : Long, static_cast<quint64>(dataOffset)},
+        {277, Short, 1},
+        {278, Long, static_cast<quint64>(height)},
+        {279, big ? Long8 : Long, static_cast<quint64>(dataBytes)},
+        {284, Short, 1},
+    };
+    if (sampleFormat != 1) entries.push_back({339, Short, static_cast<quint64>(sampleFormat)});
+
+    QByteArray ifd;
+    if (big) put<quint64>(ifd, entries.size());
+    else put<quint16>(ifd, static_cast<quint16>(entries.size()));
+    for (const Entry& e : entries) {
+        put<quint16>(ifd, e.tag);
+        put<quint16>(ifd, e.type);
+        if (big) {
+            put<quint64>(ifd, 1);
+            put<quint64>(ifd, e.value);
+        } else {
+            put<quint32>(ifd, 1);
+            put<quint32>(ifd, static_cast<quint32>(e.value));
+        }
+    }
+    qint64 newNextPos = ifdOffset + ifd.size();
+    if (big) put<quint64>(ifd, 0);
+    else put<quint32>(ifd, 0);
+
+    if (file.write(ifd) != ifd.size()) return "TIFF IFD write failed";
+    endPos = ifdOffset + ifd.size();
+
+    // Link the new IFD from the previous one (or the header).
+    QByteArray link;
+    if (big) put<quint64>(link, static_cast<quint64>(ifdOffset));
+    else put<quint32>(link, static_cast<quint32>(ifdOffset));
+    file.seek(nextOffsetPos);
+    if (file.write(link) != link.size()) return "TIFF link write failed";
+    nextOffsetPos = newNextPos;
+    ++pages;
+    // Pages are linked only after their data and IFD are written; flushing
+    // here lets a viewer follow the file while it grows.
+    file.flush();
+    return {};
+}
+
+QString TiffWriter::close() {
+    if (!file.isOpen()) return {};
+    file.close();
+    if (file.error() != QFileDevice::NoError) return file.errorString();
+    return {};
+}
+
+QString TiffWriter::writeSingle(const QString& path, const QImage& img) {
+    TiffWriter w;
+    QString err = w.open(path, false);
+    if (err.isEmpty()) err = w.appendPage(img);
+    QString closeErr = w.close();
+    return err.isEmpty() ? closeErr : err;
+}
+
+QString TiffWriter::writeSingleFloat(const QString& path, const float* data, int width, int height) {
+    TiffWriter w;
+    QString err = w.open(path, false);
+    if (err.isEmpty()) err = w.appendFloatPage(data, width, height);
+    QString closeErr = w.close();
+    return err.isEmpty() ? closeErr : err;
+}
+
+QString TiffReader::open(const QString& path) {
+    *this = TiffReader();
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return QString("Cannot open %1: %2").arg(path, f.errorString());
+    const QByteArray hdr = f.read(16);
+    if (hdr.size() < 8 || (!hdr.startsWith("II") && !hdr.startsWith("MM"))) return "Not a TIFF file";
+    const bool be = hdr.startsWith("MM");
+    const quint64 magic = field(hdr.constData() + 2, 2, be);
+    if (magic == 43 && hdr.size() == 16 && field(hdr.constData() + 4, 2, be) == 8) {
+        big = true;
+        lastLinkPos = 8;
+    } else if (magic == 42) {
+        lastLinkPos = 4;
+    } else {
+        return "Not a TIFF file";
+    }
+    filePath = path;
+    swapped = be;
+    chunks = std::make_shared<const std::vector<std::shared_ptr<Chunk>>>();
+    refresh();
+    return {};
+}
+
+int TiffReader::refresh() {
+    if (!isOpen()) return 0;
+    QFile f(filePath);
+    if (!f.open(QIODevice::ReadOnly)) return count();
+    const int linkBytes = big ? 8 : 4;
+    if (!f.seek(lastLinkPos)) return count();
+    const QByteArray link = f.read(linkBytes);
+    if (link.size() != linkBytes) return count();
+    qint64 ifd = static_cast<qint64>(field(link.constData(), linkBytes, swapped));
+    if (ifd == 0) return count();
+
+    QSet<qint64> seen;
+    const qint64 size = f.size();
+    while (ifd > 0 && ifd < size && pageCount < kMaxPages && !seen.contains(ifd)) {
+        seen.insert(ifd);
+        Page page;
+        qint64 linkPos = 0;
+        qint64 next = 0;
+        if (!readPage(f, ifd, page, linkPos, next)) break;
+        append(std::move(page));
+        lastLinkPos = linkPos;
+        ifd = next;
+    }
+    return count();
+}
+
+void TiffReader::append(Page&& p) {
+    const int used = pageCount % kChunkPages;
+    if (used == 0 || static_cast<int>(chunks->back()->size()) != used) {
+        // A new chunk, or a copy of the last one when another copy of this
+        // reader has appended to it since this one was taken.
+        auto list = std::make_shared<std::vector<std::shared_ptr<Chunk>>>(*chunks);
+        auto chunk = std::make_shared<Chunk>();
+        chunk->reserve(kChunkPages);
+        if (used > 0) {
+            chunk->insert(chunk->end(), list->back()->begin(), list->back()->begin() + used);
+            list->back() = chunk;
+        } else {
+            list->push_back(chunk);
+        }
+        chunks = std::move(list);
+    }
+    chunks->back()->push_back(std::move(p));
+    ++pageCount;
+}
+
+bool TiffReader::readPage(QFile& f, qint64 ifd, Page& page, qint64& linkPos, qint64& next) const {
+    const int countBytes = big ? 8 : 2;
+    const int entryBytes = big ? 20 : 12;
+    const int valueBytes = big ? 8 : 4;
+    if (!f.seek(ifd)) return false;
+    const QByteArray head = f.read(countBytes);
+    if (head.size() != countBytes) return false;
+    const quint64 n = field(head.constData(), countBytes, swapped);
+    if (n == 0 || n > 4096) return false;
+    const QByteArray table = f.read(static_cast<qint64>(n) * entryBytes + valueBytes);
+    if (table.size() != static_cast<qsizetype>(n * entryBytes + valueBytes)) return false;
+
+    // Array values live in the entry when they fit, elsewhere otherwise.
+    auto values = [&](const char* e) {
+        std::vector<qint64> out;
+        const quint64 type = field(e + 2, 2, swapped);
+        const quint64 count = field(e + 4, big ? 8 : 4, swapped);
+        const int size = typeBytes(type);
+        if (size == 0 || count == 0 || count > kMaxStrips) return out;
+        const char* data = e + (big ? 12 : 8);
+        QByteArray remote;
+        if (count * size > static_cast<quint64>(valueBytes)) {
+            if (!f.seek(static_cast<qint64>(field(data, valueBytes, swapped)))) return out;
+            remote = f.read(static_cast<qint64>(count * size));
+            if (remote.size() != static_cast<qsizetype>(count * size)) return out;
+            data = remote.constData();
+        }
+        out.resize(count);
+        for (quint64 i = 0; i < count; ++i) out[i] = static_cast<qint64>(field(data + i * size, size, swapped));
+        return out;
+    };
+    auto first = [&](const char* e) -> qint64 {
+        const std::vector<qint64> v = values(e);
+        return v.empty() ? -1 : v.front();
+    };
+
+    qint64 compression = 1, photometric = -1, samples = 1, sampleFormat = 1;
+    for (quint64 i = 0; i < n; ++i) {
+        const char* e = table.constData() + i * entryBytes;
+        switch (field(e, 2, swapped)) {
+        case 256: page.width = static_cast<int>(first(e)); break;
+        case 257: page.height = static_cast<int>(first(e)); break;
+        case 258: page.bits = static_cast<int>(first(e)); break;
+        case 259: compression = first(e); break;
+        case 262: photometric = first(e); break;
+        case 273: page.stripOffsets = values(e); break;
+        case 277: samples = first(e); break;
+        case 278: page.rowsPerStrip = static_cast<int>(std::min<qint64>(first(e), INT_MAX)); break;
+        case 279: page.stripBytes = values(e); break;
+        case 339: sampleFormat = first(e); break;
+        default: break;
+        }
+    }
+    linkPos = ifd + countBytes + static_cast<qint64>(n) * entryBytes;
+    next = static_cast<qint64>(field(table.constData() + n * entryBytes, valueBytes, swapped));
+
+    if (page.rowsPerStrip <= 0 || page.rowsPerStrip > page.height) page.rowsPerStrip = page.height;
+    const qint64 rowBytes = static_cast<qint64>(page.width) * (page.bits / 8);
+    bool plain = page.width > 0 && page.height > 0 && (page.bits == 8 || page.bits == 16) && compression == 1 &&
+                 photometric == 1 && samples == 1 && sampleFormat == 1 &&
+                 page.stripOffsets.size() == static_cast<size_t>((page.height + page.rowsPerStrip - 1) / page.rowsPerStrip) &&
+                 page.stripBytes.size() == page.stripOffsets.size();
+    for (size_t k = 0; plain && k < page.stripBytes.size(); ++k) {
+        const int rows = std::min(page.rowsPerStrip, page.height - static_cast<int>(k) * page.rowsPerStrip);
+        plain = page.stripBytes[k] >= rowBytes * rows;
+    }
+    page.plain = plain;
+    if (!plain) {
+        page.stripOffsets.clear();
+        page.stripBytes.clear();
+    }
+    return true;
+}
+
+bool TiffReader::canDecode(int index) const {
+    return index >= 0 && index < count() && page(index).plain;
+}
+
+QImage TiffReader::read(int index, QString* error) const {
+    if (!canDecode(index)) {
+        if (error) *error = QString("Page %1 is not an uncompressed grayscale page").arg(index + 1);
+        return {};
+    }
+    const Page& p = page(index);
+    QFile f(filePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = f.errorString();
+        return {};
+    }
+    QImage img(p.width, p.height, p.bits == 16 ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+    uchar* base = img.bits();
+    const qsizetype bpl = img.bytesPerLine();
+    const qint64 rowBytes = static_cast<qint64>(p.width) * (p.bits / 8);
+    for (size_t k = 0; k < p.stripOffsets.size(); ++k) {
+        const int y0 = static_cast<int>(k) * p.rowsPerStrip;
+        const int rows = std::min(p.rowsPerStrip, p.height - y0);
+        bool ok = f.seek(p.stripOffsets[k]);
+        if (ok && bpl == rowBytes) {
+            ok = f.read(reinterpret_cast<char*>(base + y0 * bpl), rowBytes * rows) == rowBytes * rows;
+        } else {
+            for (int y = y0; ok && y < y0 + rows; ++y) {
+                ok = f.read(reinterpret_cast<char*>(base + y * bpl), rowBytes) == rowBytes;
+            }
+        }
+        if (!ok) {
+            if (error) *error = "Short read";
+            return {};
+        }
+    }
+    if (swapped && p.bits == 16) {
+        for (int y = 0; y < p.height; ++y) {
+            quint16* row = reinterpret_cast<quint16*>(base + y * bpl);
+            for (int x = 0; x < p.width; ++x) row[x] = qbswap(row[x]);
+        }
+    }
+    return img;
+}
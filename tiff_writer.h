@@ -0,0 +1,88 @@
+#pragma once
+#include <QtCore>
+#include <QtGui/QImage>
+#include <memory>
+#include <vector>
+
+// Minimal uncompressed grayscale TIFF writer for single and multi-page files.
+// Qt's TIFF plugin writes one page per file; exports and archives need
+// stacks, and BigTIFF once a stack passes 4 GB.
+class TiffWriter {
+public:
+    TiffWriter() = default;
+    ~TiffWriter();
+
+    QString open(const QString& path, bool bigTiff);
+    // Grayscale8 / Grayscale16 pages; other formats are converted.
+    QString appendPage(const QImage& img);
+    // sampleFormat is the TIFF SampleFormat tag: 1 unsigned, 3 IEEE float.
+    QString appendPage(const uchar* data, int width, int height, qsizetype bytesPerLine, int bitsPerSample,
+                       int sampleFormat = 1);
+    // 32-bit float page, tightly packed rows.
+    QString appendFloatPage(const float* data, int width, int height);
+    QString close();
+
+    bool isOpen() const { return file.isOpen(); }
+    qint64 bytesWritten() const { return endPos; }
+    int pageCount() const { return pages; }
+
+    static QString writeSingle(const QString& path, const QImage& img);
+    static QString writeSingleFloat(const QString& path, const float* data, int width, int height);
+
+private:
+    QFile file;
+    bool big = false;
+    int pages = 0;
+    qint64 nextOffsetPos = 0; // where the previous IFD's "next IFD" pointer lives
+    qint64 endPos = 0;
+};
+
+// Page table of a classic or BigTIFF stack. The IFD chain is walked once
+// (and continued by refresh() while a writer appends), so reading page n
+// is a seek instead of QImageReader::jumpToImage's walk from page 0.
+// Uncompressed single-sample 8/16-bit grayscale pages, as TiffWriter and
+// most acquisition software write them, are decoded here; for anything
+// else canDecode() is false and the caller falls back to QImageReader.
+// Copies share the page table, so they are cheap to hand to workers. The
+// table is stored in fixed-capacity chunks that refresh() only appends to:
+// a copy taken earlier keeps reading its own pages while another grows the
+// table, and only one copy should refresh at a time.
+class TiffReader {
+public:
+    QString open(const QString& path);
+    // Follows pages linked since open(); returns the new page count.
+    int refresh();
+
+    bool isOpen() const { return chunks != nullptr; }
+    int count() const { return pageCount; }
+    bool canDecode(int index) const;
+    // Thread-safe: every call uses its own file handle.
+    QImage read(int index, QString* error=nullptr) const;
+
+private:
+    struct Page {
+        int width = 0;
+        int height = 0;
+        int bits = 0;
+        bool plain = false;             // decodable here
+        int rowsPerStrip = 0;
+        std::vector<qint64> stripOffsets;
+        std::vector<qint64> stripBytes;
+    };
+    // Reserved up front, so appending never moves pages a copy is reading.
+    using Chunk = std::vector<Page>;
+    static constexpr int kChunkPages = 4096;
+
+    // Parses the IFD at ifd; linkPos is where its "next IFD" pointer lives.
+    bool readPage(QFile& f, qint64 ifd, Page& page, qint64& linkPos, qint64& next) const;
+    const Page& page(int index) const { return (*(*chunks)[index / kChunkPages])[index % kChunkPages]; }
+    void append(Page&& p);
+
+    QString filePath;
+    bool big = false;
+    bool swapped = false;               // big-endian ("MM") file
+    qint64 lastLinkPos = 0;             // "next IFD" pointer of the last page read
+    // The chunk list is copied only when a chunk is added.
+    std::shared_ptr<const std::vector<std::shared_ptr<Chunk>>> chunks;
+    int pageCount = 0;
+};
@@ -0,0 +1,173 @@
+#include "video_exporter.h"
+#include "avi_writer.h"
+#include "frame_sequence.h"
+#include "ordered_pipeline.h"
+#include "sequence_exporter.h"
+#include <QtGui/QImageWriter>
+#include <QtGui/QPainter>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+struct JpegFrame {
+    QByteArray data;
+    QString error;
+    bool repeat = false;        // same source frame as the previous one
+};
+
+// 0.1 / 99.9 percentile window of a frame, so 12-bit data is not crushed
+// into the bottom of the 16-bit range.
+void percentileWindow(const QImage& img, int& black, int& white) {
+    const bool deep = img.format() == QImage::Format_Grayscale16;
+    std::vector<quint32> hist(deep ? 65536 : 256, 0);
+    for (int y = 0; y < img.height(); ++y) {
+        if (deep) {
+            const quint16* s = reinterpret_cast<const quint16*>(img.constScanLine(y));
+            for (int x = 0; x < img.width(); ++x) ++hist[s[x]];
+        } else {
+            const uchar* s = img.constScanLine(y);
+            for (int x = 0; x < img.width(); ++x) ++hist[s[x]];
+        }
+    }
+    const quint64 total = static_cast<quint64>(img.width()) * img.height();
+    const quint64 lo = total / 1000;
+    const quint64 hi = total - total / 1000;
+    quint64 acc = 0;
+    black = 0;
+    white = static_cast<int>(hist.size()) - 1;
+    bool haveBlack = false;
+    for (size_t v = 0; v < hist.size(); ++v) {
+        acc += hist[v];
+        if (!haveBlack && acc > lo) {
+            black = static_cast<int>(v);
+            haveBlack = true;
+        }
+        if (acc >= hi) {
+            white = static_cast<int>(v);
+            break;
+        }
+    }
+    if (white <= black) white = black + 1;
+}
+
+QString timestampText(double seconds, int frameIndex) {
+    int totalMs = static_cast<int>(std::lround(std::max(0.0, seconds) * 1000.0));
+    return QString("%1:%2.%3  #%4")
+        .arg(totalMs / 60000, 2, 10, QChar('0'))
+        .arg((totalMs / 1000) % 60, 2, 10, QChar('0'))
+        .arg(totalMs % 1000, 3, 10, QChar('0'))
+        .arg(frameIndex);
+}
+} // namespace
+
+QString VideoExporter::run(const QString& sourcePath, const VideoExportOptions& opt,
+                           const Progress& progress, const std::atomic<bool>* cancel,
+                           int* framesWritten) {
+    if (framesWritten) *framesWritten = 0;
+    FrameSequence src(64);
+    QString err = src.open(sourcePath);
+    if (!err.isEmpty()) return err;
+    if (!src.isOpen()) return "No frames in " + sourcePath;
+    if (opt.outputPath.isEmpty()) return "No output path";
+    if (opt.outputFps <= 0.0 || opt.speed <= 0.0) return "Invalid frame rate";
+
+    const int n = src.count();
+    const int first = std::clamp(opt.first, 0, n - 1);
+    const int last = opt.last < 0 ? n - 1 : std::clamp(opt.last, first, n - 1);
+    const FrameTimeline& tl = src.timeline();
+
+    // Resample on the recording's time axis: output frame k shows the source
+    // frame nearest to t0 + k * speed / fps. Without a time axis, map 1:1.
+    std::vector<int> sourceIndex;
+    if (!tl.isEmpty()) {
+        const double t0 = tl.timeAt(first);
+        const double t1 = tl.timeAt(last);
+        const double dt = opt.speed / opt.outputFps;
+        const int frames = static_cast<int>(std::floor((t1 - t0) / dt)) + 1;
+        sourceIndex.reserve(frames);
+        for (int k = 0; k < frames; ++k) {
+            sourceIndex.push_back(std::clamp(tl.indexAtTime(t0 + k * dt), first, last));
+        }
+    } else {
+        for (int i = first; i <= last; ++i) sourceIndex.push_back(i);
+    }
+    const int total = static_cast<int>(sourceIndex.size());
+
+    QImage probe = SequenceExporter::transform(src.read(first, &err), opt.roi, false, 0, 0);
+    if (probe.isNull()) return err.isEmpty() ? "ROI does not intersect the frame" : err;
+    int black = opt.black;
+    int white = opt.white;
+    if (opt.autoWindow) percentileWindow(probe, black, white);
+
+    AviWriter avi;
+    // Windowed frames are Grayscale8 and Qt writes them as one-channel
+    // JPEGs; the timestamp overlay makes them colour.
+    err = avi.open(opt.outputPath, probe.width(), probe.height(), opt.outputFps, !opt.overlayTimestamp);
+    if (!err.isEmpty()) return err;
+    const qint64 cap = opt.maxBytes > 0 ? std::min(opt.maxBytes, AviWriter::kMaxBytes) : AviWriter::kMaxBytes;
+    const int threads = opt.threads > 0 ? opt.threads : std::max(1, QThread::idealThreadCount());
+    const int progressEvery = std::max(1, total / 200);
+    bool capped = false;
+    QElapsedTimer timer;
+    timer.start();
+
+    auto produce = [&](int k) -> JpegFrame {
+        QString readErr;
+        const int idx = sourceIndex[k];
+        // Slowed-down exports show a source frame several times; the
+        // overlay depends only on the source frame, so it is encoded once.
+        if (k > 0 && sourceIndex[k - 1] == idx) return {{}, {}, true};
+        QImage img = SequenceExporter::transform(src.read(idx, &readErr), opt.roi, true, black, white);
+        if (img.isNull()) return {{}, QString("Frame %1: %2").arg(idx).arg(readErr)};
+        if (img.size() != probe.size()) return {{}, QString("Frame %1 has a different size").arg(idx)};
+        if (opt.overlayTimestamp) {
+            img = img.convertToFormat(QImage::Format_RGB32);
+            QPainter p(&img);
+            QFont font = p.font();
+            font.setPixelSize(std::max(12, img.height() / 30));
+            p.setFont(font);
+            const QString text = timestampText(tl.timeAt(idx) - tl.timeAt(first), idx);
+            QRect box = p.fontMetrics().boundingRect(text).adjusted(-4, -2, 4, 2);
+            box.moveTopLeft(QPoint(6, 6));
+            p.fillRect(box, QColor(0, 0, 0, 160));
+            p.setPen(Qt::white);
+            p.drawText(box, Qt::AlignCenter, text);
+        }
+        QByteArray jpeg;
+        QBuffer buf(&jpeg);
+        buf.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buf, "jpeg");
+        writer.setQuality(opt.quality);
+        if (!writer.write(img)) return {{}, "JPEG encode failed: " + writer.errorString()};
+        return {jpeg, {}};
+    };
+
+    QByteArray previous;
+    auto consume = [&](int k, JpegFrame&& f) -> bool {
+        if (!f.error.isEmpty()) {
+            err = f.error;
+            return false;
+        }
+        if (f.repeat) f.data = previous;
+        else previous = f.data;
+        if (avi.projectedSize(f.data.size()) > cap) {
+            capped = true;
+            return false;
+        }
+        err = avi.addFrame(f.data);
+        if (!err.isEmpty()) return false;
+        if (progress && (k % progressEvery == 0 || k + 1 == total)) progress(k + 1, total);
+        return true;
+    };
+
+    bool ok = runOrderedPipeline<JpegFrame>(total, threads, threads * 4, produce, consume, cancel);
+    const int written = avi.frameCount();
+    QString closeErr = avi.close();
+    if (framesWritten) *framesWritten = written;
+    if (!ok && !capped) return err.isEmpty() ? "Export cancelled" : err;
+    if (!closeErr.isEmpty()) return closeErr;
+    qInfo() << "Video export" << written << "of" << total << "frames to" << opt.outputPath
+            << "in" << timer.elapsed() << "ms using" << threads << "threads" << (capped ? "(size cap reached)" : "");
+    return {};
+}
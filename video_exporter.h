@@ -0,0 +1,32 @@
+#pragma once
+#include <QtCore>
+#include <atomic>
+#include <functional>
+
+struct VideoExportOptions {
+    QString outputPath;
+    int first = 0;
+    int last = -1;              // inclusive, -1 = last frame
+    double outputFps = 30.0;    // frame rate of the video
+    double speed = 1.0;         // recording seconds per video second
+    QRect roi;                  // empty = full frame
+    bool autoWindow = true;     // 0.1 / 99.9 percentiles of the first frame
+    int black = 0;
+    int white = 65535;
+    bool overlayTimestamp = true;
+    int quality = 85;
+    qint64 maxBytes = 0;        // 0 = AVI 1.0 limit
+    int threads = 0;            // 0 = one per core
+};
+
+// Motion-JPEG AVI export. Output frames are resampled on the recording's
+// time axis, JPEG-encoded in parallel with Qt's bundled encoder and muxed
+// in order by a single writer.
+class VideoExporter {
+public:
+    using Progress = std::function<void(int done, int total)>;
+
+    static QString run(const QString& sourcePath, const VideoExportOptions& opt,
+                       const Progress& progress = {}, const std::atomic<bool>* cancel = nullptr,
+                       int* framesWritten = nullptr);
+};